@@ -0,0 +1,450 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+/*
+ * This is a differential test for the FPU instructions that the JIT compiles
+ * to native code instead of falling back to the interpreter: FDIV, FMAC,
+ * FSQRT, FSRRA, FSCA, FIPR and FTRV.
+ *
+ * Every test case loads the same register state into the SH4 twice.  The
+ * first time the instruction is executed by the interpreter, and the second
+ * time it is executed by the x86_64 backend.  FR0-FR15, XF0-XF15, FPUL and
+ * FPSCR then have to match bit-for-bit.
+ *
+ * This test does not need the firmware or any test programs, so unlike
+ * sh4div_test and sh4tmu_test it can always be run.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "config.h"
+#include "dc_sched.h"
+#include "dreamcast.h"
+#include "memory.h"
+#include "washdc/MemoryMap.h"
+#include "hw/sh4/sh4.h"
+#include "hw/sh4/sh4_inst.h"
+#include "hw/sh4/sh4_jit.h"
+#include "jit/jit.h"
+#include "jit/jit_block_prof.h"
+#include "jit/x86_64/code_block_x86_64.h"
+#include "jit/x86_64/native_dispatch.h"
+#include "jit/x86_64/exec_mem.h"
+
+// bit patterns for the single-precision values the test cases use
+#define F_POS_ZERO   0x00000000
+#define F_NEG_ZERO   0x80000000
+#define F_ONE        0x3f800000
+#define F_NEG_ONE    0xbf800000
+#define F_TWO        0x40000000
+#define F_THREE      0x40400000
+#define F_ONE_THIRD  0x3eaaaaab
+#define F_PI         0x40490fdb
+#define F_NEG_PI     0xc0490fdb
+#define F_FLT_MAX    0x7f7fffff
+#define F_FLT_MIN    0x00800000
+#define F_DENORM_MIN 0x00000001
+#define F_DENORM_MAX 0x007fffff
+#define F_NEG_DENORM 0x807ffffe
+#define F_POS_INF    0x7f800000
+#define F_NEG_INF    0xff800000
+#define F_QNAN       0x7fc00000
+#define F_QNAN_PAYLD 0x7fc12345
+#define F_NEG_QNAN   0xffc00001
+#define F_SNAN       0x7f800001
+
+// every test case's code goes in its own 16-byte slot in system memory
+#define TEST_CODE_BASE 0x8c010000
+#define TEST_CODE_STRIDE 16
+
+#define MAX_REG_INIT 8
+
+struct reg_init {
+    unsigned reg;
+    uint32_t val;
+};
+
+struct fpu_test_case {
+    char const *name;
+    uint16_t inst;
+    unsigned n_init;
+    struct reg_init init[MAX_REG_INIT];
+};
+
+#define FR(n) (SH4_REG_FR0 + (n))
+
+// FDIV FRm, FRn
+#define INST_FDIV(m, n) ((uint16_t)(0xf003 | ((n) << 8) | ((m) << 4)))
+// FMAC FR0, FRm, FRn
+#define INST_FMAC(m, n) ((uint16_t)(0xf00e | ((n) << 8) | ((m) << 4)))
+// FSQRT FRn
+#define INST_FSQRT(n) ((uint16_t)(0xf06d | ((n) << 8)))
+// FSRRA FRn
+#define INST_FSRRA(n) ((uint16_t)(0xf07d | ((n) << 8)))
+// FSCA FPUL, DRn
+#define INST_FSCA(n) ((uint16_t)(0xf0fd | (((n) / 2) << 9)))
+// FIPR FVm, FVn
+#define INST_FIPR(m, n) ((uint16_t)(0xf0ed | (((n) / 4) << 10) | (((m) / 4) << 8)))
+// FTRV XMTRX, FVn
+#define INST_FTRV(n) ((uint16_t)(0xf1fd | (((n) / 4) << 10)))
+
+#define INST_BRA_SELF 0xaffe
+#define INST_NOP 0x0009
+
+static struct fpu_test_case const test_cases[] = {
+    { "FDIV FR1, FR2 (finite)", INST_FDIV(1, 2), 2,
+      { { FR(1), F_THREE }, { FR(2), F_ONE } } },
+    { "FDIV FR1, FR2 (+0 / +0)", INST_FDIV(1, 2), 2,
+      { { FR(1), F_POS_ZERO }, { FR(2), F_POS_ZERO } } },
+    { "FDIV FR1, FR2 (-1 / +0)", INST_FDIV(1, 2), 2,
+      { { FR(1), F_POS_ZERO }, { FR(2), F_NEG_ONE } } },
+    { "FDIV FR1, FR2 (+1 / -0)", INST_FDIV(1, 2), 2,
+      { { FR(1), F_NEG_ZERO }, { FR(2), F_ONE } } },
+    { "FDIV FR1, FR2 (denormal / denormal)", INST_FDIV(1, 2), 2,
+      { { FR(1), F_DENORM_MIN }, { FR(2), F_DENORM_MAX } } },
+    { "FDIV FR1, FR2 (FLT_MIN / 3)", INST_FDIV(1, 2), 2,
+      { { FR(1), F_THREE }, { FR(2), F_FLT_MIN } } },
+    { "FDIV FR1, FR2 (FLT_MAX / 1/3)", INST_FDIV(1, 2), 2,
+      { { FR(1), F_ONE_THIRD }, { FR(2), F_FLT_MAX } } },
+    { "FDIV FR1, FR2 (inf / inf)", INST_FDIV(1, 2), 2,
+      { { FR(1), F_NEG_INF }, { FR(2), F_POS_INF } } },
+    { "FDIV FR1, FR2 (1 / inf)", INST_FDIV(1, 2), 2,
+      { { FR(1), F_POS_INF }, { FR(2), F_ONE } } },
+    { "FDIV FR1, FR2 (qNaN / 2)", INST_FDIV(1, 2), 2,
+      { { FR(1), F_TWO }, { FR(2), F_QNAN_PAYLD } } },
+    { "FDIV FR1, FR2 (2 / sNaN)", INST_FDIV(1, 2), 2,
+      { { FR(1), F_SNAN }, { FR(2), F_TWO } } },
+    { "FDIV FR7, FR7", INST_FDIV(7, 7), 1,
+      { { FR(7), F_PI } } },
+
+    { "FMAC FR0, FR3, FR4 (finite)", INST_FMAC(3, 4), 3,
+      { { FR(0), F_PI }, { FR(3), F_ONE_THIRD }, { FR(4), F_NEG_PI } } },
+    /*
+     * FR0 * FRm rounds to exactly 1.0, so this only comes out to zero if the
+     * multiply and add do not get fused together.
+     */
+    { "FMAC FR0, FR3, FR4 (no fusing)", INST_FMAC(3, 4), 3,
+      { { FR(0), 0x3f800001 }, { FR(3), 0x3f7fffff }, { FR(4), F_NEG_ONE } } },
+    { "FMAC FR0, FR3, FR4 (-0 * +0 + -0)", INST_FMAC(3, 4), 3,
+      { { FR(0), F_NEG_ZERO }, { FR(3), F_POS_ZERO }, { FR(4), F_NEG_ZERO } } },
+    { "FMAC FR0, FR3, FR4 (denormal)", INST_FMAC(3, 4), 3,
+      { { FR(0), F_DENORM_MAX }, { FR(3), F_ONE_THIRD },
+        { FR(4), F_NEG_DENORM } } },
+    { "FMAC FR0, FR3, FR4 (inf * 0)", INST_FMAC(3, 4), 3,
+      { { FR(0), F_POS_INF }, { FR(3), F_POS_ZERO }, { FR(4), F_ONE } } },
+    { "FMAC FR0, FR3, FR4 (inf - inf)", INST_FMAC(3, 4), 3,
+      { { FR(0), F_POS_INF }, { FR(3), F_ONE }, { FR(4), F_NEG_INF } } },
+    { "FMAC FR0, FR3, FR4 (overflow)", INST_FMAC(3, 4), 3,
+      { { FR(0), F_FLT_MAX }, { FR(3), F_TWO }, { FR(4), F_NEG_ONE } } },
+    { "FMAC FR0, FR3, FR4 (NaN addend)", INST_FMAC(3, 4), 3,
+      { { FR(0), F_TWO }, { FR(3), F_THREE }, { FR(4), F_NEG_QNAN } } },
+    { "FMAC FR0, FR0, FR0", INST_FMAC(0, 0), 1,
+      { { FR(0), F_ONE_THIRD } } },
+
+    { "FSQRT FR5 (finite)", INST_FSQRT(5), 1,
+      { { FR(5), F_TWO } } },
+    { "FSQRT FR5 (+0)", INST_FSQRT(5), 1,
+      { { FR(5), F_POS_ZERO } } },
+    { "FSQRT FR5 (-0)", INST_FSQRT(5), 1,
+      { { FR(5), F_NEG_ZERO } } },
+    { "FSQRT FR5 (denormal)", INST_FSQRT(5), 1,
+      { { FR(5), F_DENORM_MIN } } },
+    { "FSQRT FR5 (+inf)", INST_FSQRT(5), 1,
+      { { FR(5), F_POS_INF } } },
+    { "FSQRT FR5 (-1)", INST_FSQRT(5), 1,
+      { { FR(5), F_NEG_ONE } } },
+    { "FSQRT FR5 (-denormal)", INST_FSQRT(5), 1,
+      { { FR(5), F_NEG_DENORM } } },
+    { "FSQRT FR5 (-inf)", INST_FSQRT(5), 1,
+      { { FR(5), F_NEG_INF } } },
+    { "FSQRT FR5 (qNaN)", INST_FSQRT(5), 1,
+      { { FR(5), F_QNAN } } },
+    { "FSQRT FR5 (-qNaN)", INST_FSQRT(5), 1,
+      { { FR(5), F_NEG_QNAN } } },
+    { "FSQRT FR5 (sNaN)", INST_FSQRT(5), 1,
+      { { FR(5), F_SNAN } } },
+    // FLAG_V is already set, so this checks that it doesn't get cleared
+    { "FSQRT FR5 (-1, FLAG_V already set)", INST_FSQRT(5), 2,
+      { { FR(5), F_NEG_PI },
+        { SH4_REG_FPSCR, 0x00040001 | SH4_FPSCR_FLAG_V_MASK } } },
+
+    { "FSRRA FR6 (finite)", INST_FSRRA(6), 1,
+      { { FR(6), F_THREE } } },
+    { "FSRRA FR6 (+0)", INST_FSRRA(6), 1,
+      { { FR(6), F_POS_ZERO } } },
+    { "FSRRA FR6 (-0)", INST_FSRRA(6), 1,
+      { { FR(6), F_NEG_ZERO } } },
+    { "FSRRA FR6 (denormal)", INST_FSRRA(6), 1,
+      { { FR(6), F_DENORM_MAX } } },
+    { "FSRRA FR6 (FLT_MAX)", INST_FSRRA(6), 1,
+      { { FR(6), F_FLT_MAX } } },
+    { "FSRRA FR6 (+inf)", INST_FSRRA(6), 1,
+      { { FR(6), F_POS_INF } } },
+    { "FSRRA FR6 (-1)", INST_FSRRA(6), 1,
+      { { FR(6), F_NEG_ONE } } },
+    { "FSRRA FR6 (qNaN)", INST_FSRRA(6), 1,
+      { { FR(6), F_QNAN_PAYLD } } },
+
+    { "FSCA FPUL, DR0 (0)", INST_FSCA(0), 1,
+      { { SH4_REG_FPUL, 0x00000000 } } },
+    { "FSCA FPUL, DR2 (pi/4)", INST_FSCA(2), 1,
+      { { SH4_REG_FPUL, 0x00002000 } } },
+    { "FSCA FPUL, DR8 (max angle)", INST_FSCA(8), 1,
+      { { SH4_REG_FPUL, 0x0000ffff } } },
+    // only the lower 16 bits of FPUL are used
+    { "FSCA FPUL, DR14 (wraparound)", INST_FSCA(14), 1,
+      { { SH4_REG_FPUL, 0xdead4000 } } },
+    { "FSCA FPUL, DR14 (negative)", INST_FSCA(14), 1,
+      { { SH4_REG_FPUL, 0xffffc001 } } },
+
+    { "FIPR FV0, FV0", INST_FIPR(0, 0), 0 },
+    { "FIPR FV4, FV12", INST_FIPR(4, 12), 0 },
+    { "FIPR FV8, FV4 (signed zeros)", INST_FIPR(8, 4), 8,
+      { { FR(4), F_NEG_ZERO }, { FR(5), F_NEG_ZERO },
+        { FR(6), F_POS_ZERO }, { FR(7), F_NEG_ZERO },
+        { FR(8), F_ONE }, { FR(9), F_NEG_ONE },
+        { FR(10), F_NEG_ZERO }, { FR(11), F_PI } } },
+    { "FIPR FV12, FV8 (denormals)", INST_FIPR(12, 8), 4,
+      { { FR(8), F_DENORM_MAX }, { FR(9), F_FLT_MIN },
+        { FR(12), F_ONE_THIRD }, { FR(13), F_DENORM_MIN } } },
+    { "FIPR FV4, FV0 (inf)", INST_FIPR(4, 0), 2,
+      { { FR(0), F_POS_INF }, { FR(6), F_NEG_INF } } },
+    { "FIPR FV4, FV0 (inf * 0)", INST_FIPR(4, 0), 2,
+      { { FR(1), F_POS_INF }, { FR(5), F_POS_ZERO } } },
+    { "FIPR FV0, FV12 (NaN)", INST_FIPR(0, 12), 1,
+      { { FR(14), F_QNAN_PAYLD } } },
+    { "FIPR FV8, FV12 (overflow)", INST_FIPR(8, 12), 2,
+      { { FR(8), F_FLT_MAX }, { FR(12), F_FLT_MAX } } },
+    // the sum of the first two products cancels out the third one
+    { "FIPR FV0, FV4 (cancellation)", INST_FIPR(0, 4), 8,
+      { { FR(0), F_FLT_MAX }, { FR(1), F_FLT_MAX }, { FR(2), F_NEG_ONE },
+        { FR(3), F_ONE_THIRD }, { FR(4), F_ONE }, { FR(5), F_NEG_ONE },
+        { FR(6), F_PI }, { FR(7), F_THREE } } },
+
+    { "FTRV XMTRX, FV0", INST_FTRV(0), 0 },
+    { "FTRV XMTRX, FV4", INST_FTRV(4), 0 },
+    { "FTRV XMTRX, FV8", INST_FTRV(8), 0 },
+    { "FTRV XMTRX, FV12", INST_FTRV(12), 0 },
+    { "FTRV XMTRX, FV8 (signed zeros)", INST_FTRV(8), 4,
+      { { FR(8), F_NEG_ZERO }, { FR(9), F_POS_ZERO },
+        { FR(10), F_NEG_ZERO }, { FR(11), F_NEG_ZERO } } },
+    { "FTRV XMTRX, FV12 (denormals)", INST_FTRV(12), 4,
+      { { FR(12), F_DENORM_MAX }, { FR(13), F_NEG_DENORM },
+        { SH4_REG_XF0, F_DENORM_MIN }, { SH4_REG_XF5, F_FLT_MIN } } },
+    { "FTRV XMTRX, FV4 (inf and NaN)", INST_FTRV(4), 3,
+      { { FR(4), F_POS_INF }, { SH4_REG_XF1, F_POS_ZERO },
+        { SH4_REG_XF14, F_QNAN_PAYLD } } },
+    { "FTRV XMTRX, FV0 (overflow)", INST_FTRV(0), 3,
+      { { FR(0), F_FLT_MAX }, { SH4_REG_XF2, F_FLT_MAX },
+        { SH4_REG_XF6, F_NEG_INF } } }
+};
+
+#define N_TEST_CASES (sizeof(test_cases) / sizeof(test_cases[0]))
+
+/*
+ * the state every test case starts from.  None of these are zero, and the
+ * matrix in XF0-XF15 isn't symmetric so that mixing up its rows and columns
+ * changes the result.
+ */
+static reg32_t const fr_init[16] = {
+    0x3f800000, 0x40000000, 0xbfc00000, 0x40490fdb,
+    0x3eaaaaab, 0xc1200000, 0x3dcccccd, 0x42f60000,
+    0xbf000000, 0x3f4ccccd, 0x447a0000, 0xbe800000,
+    0x40a00000, 0xc0e00000, 0x3c23d70a, 0x41100000
+};
+
+static reg32_t const xf_init[16] = {
+    0x3f000000, 0xbf800000, 0x40400000, 0x3e4ccccd,
+    0xc0000000, 0x3f19999a, 0x3f800000, 0x41200000,
+    0x3fc00000, 0xbdcccccd, 0x40800000, 0xbf400000,
+    0x3eaaaaab, 0x40200000, 0xc0400000, 0x3f99999a
+};
+
+#define FPUL_INIT 0x00001234
+#define FPSCR_INIT 0x00040001
+
+// the SH4 runs on sh4_clock from dreamcast.c instead of a clock of its own
+static struct Memory test_mem;
+static struct memory_map test_mem_map;
+static Sh4 cpu;
+static struct native_dispatch_meta test_dispatch_meta;
+
+struct fpu_state {
+    reg32_t fr[16];
+    reg32_t xf[16];
+    reg32_t fpul;
+    reg32_t fpscr;
+};
+
+static void load_state(struct fpu_test_case const *test) {
+    memcpy(cpu.reg + SH4_REG_FR0, fr_init, sizeof(fr_init));
+    memcpy(cpu.reg + SH4_REG_XF0, xf_init, sizeof(xf_init));
+    cpu.reg[SH4_REG_FPUL] = FPUL_INIT;
+    cpu.reg[SH4_REG_FPSCR] = FPSCR_INIT;
+
+    unsigned idx;
+    for (idx = 0; idx < test->n_init; idx++)
+        cpu.reg[test->init[idx].reg] = test->init[idx].val;
+}
+
+static void save_state(struct fpu_state *state) {
+    memcpy(state->fr, cpu.reg + SH4_REG_FR0, sizeof(state->fr));
+    memcpy(state->xf, cpu.reg + SH4_REG_XF0, sizeof(state->xf));
+    state->fpul = cpu.reg[SH4_REG_FPUL];
+    state->fpscr = cpu.reg[SH4_REG_FPSCR];
+}
+
+static void run_intp(struct fpu_test_case const *test) {
+    InstOpcode const *op = sh4_decode_inst(test->inst);
+    op->func(&cpu, test->inst);
+}
+
+/*
+ * the test case's instruction is followed by a BRA so that it gets compiled
+ * as a block of its own.  Nothing is ever scheduled on the clock, so the
+ * countdown is always zero when native code gets entered; that means that
+ * exactly one block runs before it returns.
+ */
+static void run_native(struct fpu_test_case const *test, addr32_t pc) {
+    memory_write_16((pc + 0) & ADDR_AREA3_MASK, test->inst, &test_mem);
+    memory_write_16((pc + 2) & ADDR_AREA3_MASK, INST_BRA_SELF, &test_mem);
+    memory_write_16((pc + 4) & ADDR_AREA3_MASK, INST_NOP, &test_mem);
+
+    jit_hash hash =
+        sh4_jit_hash(&cpu, pc, sh4_fpscr_pr(&cpu), sh4_fpscr_sz(&cpu));
+
+    cpu.reg[SH4_REG_PC] = test_dispatch_meta.entry(pc, hash);
+}
+
+static void print_reg_mismatch(char const *reg_name, unsigned idx,
+                               reg32_t intp_val, reg32_t native_val) {
+    if (intp_val != native_val) {
+        fprintf(stderr, "\t%s%u: interpreter 0x%08x, native 0x%08x\n",
+                reg_name, idx, (unsigned)intp_val, (unsigned)native_val);
+    }
+}
+
+static bool check_state(struct fpu_test_case const *test,
+                        struct fpu_state const *intp,
+                        struct fpu_state const *native) {
+    if (memcmp(intp, native, sizeof(*intp)) == 0)
+        return true;
+
+    fprintf(stderr, "FAILURE: %s (opcode 0x%04x)\n",
+            test->name, (unsigned)test->inst);
+
+    unsigned idx;
+    for (idx = 0; idx < 16; idx++)
+        print_reg_mismatch("FR", idx, intp->fr[idx], native->fr[idx]);
+    for (idx = 0; idx < 16; idx++)
+        print_reg_mismatch("XF", idx, intp->xf[idx], native->xf[idx]);
+    if (intp->fpul != native->fpul) {
+        fprintf(stderr, "\tFPUL: interpreter 0x%08x, native 0x%08x\n",
+                (unsigned)intp->fpul, (unsigned)native->fpul);
+    }
+    if (intp->fpscr != native->fpscr) {
+        fprintf(stderr, "\tFPSCR: interpreter 0x%08x, native 0x%08x\n",
+                (unsigned)intp->fpscr, (unsigned)native->fpscr);
+    }
+
+    return false;
+}
+
+static void test_init(void) {
+    config_set_jit(true);
+    config_set_native_jit(true);
+
+    // these tests don't touch memory, so there's no need for native_mem
+    config_set_inline_mem(false);
+
+    memory_map_init(&test_mem_map);
+    memory_init(&test_mem);
+
+    dc_clock_init(&sh4_clock);
+    sh4_init(&cpu, &sh4_clock);
+
+    memory_map_add_host_mem(&test_mem_map, 0x0c000000, 0x0fffffff,
+                            RANGE_MASK_EXT, MEMORY_MAP_REGION_RAM,
+                            &ram_intf, &test_mem, test_mem.mem, MEMORY_MASK);
+    sh4_set_mem_map(&cpu, &test_mem_map);
+
+    jit_x86_64_backend_init();
+    exec_mem_init();
+    sh4_jit_set_native_dispatch_meta(&test_dispatch_meta);
+    test_dispatch_meta.clk = &sh4_clock;
+    native_dispatch_init(&test_dispatch_meta, &cpu);
+
+    jit_block_prof_init(false);
+    jit_init(&sh4_clock, &test_mem);
+}
+
+static void test_cleanup(void) {
+    jit_cleanup();
+    native_dispatch_cleanup(&test_dispatch_meta);
+    jit_x86_64_backend_cleanup();
+
+    /*
+     * exec_mem_cleanup isn't called because it logs its statistics, and the
+     * log can't be opened without the hostfile API that the frontend passes
+     * to washdc_init.  The process is about to exit anyways.
+     */
+
+    sh4_cleanup(&cpu);
+    dc_clock_cleanup(&sh4_clock);
+    memory_cleanup(&test_mem);
+    memory_map_cleanup(&test_mem_map);
+}
+
+int main(int argc, char **argv) {
+    unsigned n_failed = 0;
+    unsigned test_no;
+
+    test_init();
+
+    for (test_no = 0; test_no < N_TEST_CASES; test_no++) {
+        struct fpu_test_case const *test = test_cases + test_no;
+        addr32_t pc = TEST_CODE_BASE + test_no * TEST_CODE_STRIDE;
+        struct fpu_state intp_state, native_state;
+
+        load_state(test);
+        run_intp(test);
+        save_state(&intp_state);
+
+        load_state(test);
+        run_native(test, pc);
+        save_state(&native_state);
+
+        if (!check_state(test, &intp_state, &native_state))
+            n_failed++;
+    }
+
+    test_cleanup();
+
+    printf("%u of %u tests passed\n",
+           (unsigned)(N_TEST_CASES - n_failed), (unsigned)N_TEST_CASES);
+
+    return n_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,624 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+/*
+ * This is a differential test for the integer instructions that the JIT
+ * compiles to IL instead of falling back to the interpreter: ADDC, SUBC, NEGC,
+ * DIV0U, DIV0S, DIV1, DMULS.L, DMULU.L, MUL.L, MAC.L, MAC.W, ROTL, ROTR,
+ * ROTCL, ROTCR, XTRCT and AND.B/OR.B/XOR.B/TST.B #imm, @(R0, GBR).
+ *
+ * Every test case loads the same register and memory state into the SH4
+ * twice.  The first time the instruction is executed by the interpreter, and
+ * the second time it is executed by the x86_64 backend.  R0-R15, SR, MACH,
+ * MACL and the test's data memory then have to match exactly.
+ *
+ * This test does not need the firmware or any test programs, so unlike
+ * sh4div_test and sh4tmu_test it can always be run.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "config.h"
+#include "dc_sched.h"
+#include "dreamcast.h"
+#include "memory.h"
+#include "washdc/MemoryMap.h"
+#include "hw/sh4/sh4.h"
+#include "hw/sh4/sh4_inst.h"
+#include "hw/sh4/sh4_jit.h"
+#include "jit/jit.h"
+#include "jit/jit_block_prof.h"
+#include "jit/x86_64/code_block_x86_64.h"
+#include "jit/x86_64/native_dispatch.h"
+#include "jit/x86_64/exec_mem.h"
+
+// every test case's code goes in its own 16-byte slot in system memory
+#define TEST_CODE_BASE 0x8c010000
+#define TEST_CODE_STRIDE 16
+
+/*
+ * the memory that MAC.L, MAC.W and the @(R0, GBR) instructions operate on.
+ * This is on a different page from the code so that writing to it doesn't
+ * throw out any compiled blocks.
+ */
+#define TEST_DATA_BASE 0x8c020000
+#define TEST_DATA_LEN 256
+
+#define MAX_REG_INIT 6
+#define MAX_MEM_INIT 4
+
+struct reg_init {
+    unsigned reg;
+    uint32_t val;
+};
+
+// 32-bit value to write at the given offset into the data memory
+struct mem_init {
+    unsigned offs;
+    uint32_t val;
+};
+
+struct int_test_case {
+    char const *name;
+    uint16_t inst;
+
+    // initial values of the T, S, Q and M bits in SR
+    reg32_t sr_flags;
+
+    unsigned n_init;
+    struct reg_init init[MAX_REG_INIT];
+
+    unsigned n_mem;
+    struct mem_init mem[MAX_MEM_INIT];
+};
+
+#define R(n) (SH4_REG_R0 + (n))
+
+#define SR_T SH4_SR_FLAG_T_MASK
+#define SR_S SH4_SR_FLAG_S_MASK
+#define SR_Q SH4_SR_Q_MASK
+#define SR_M SH4_SR_M_MASK
+
+#define SR_FLAGS_MASK (SR_T | SR_S | SR_Q | SR_M)
+
+#define INST_RM_RN(cons, m, n) ((uint16_t)((cons) | ((n) << 8) | ((m) << 4)))
+#define INST_RN(cons, n) ((uint16_t)((cons) | ((n) << 8)))
+#define INST_IMM8(cons, imm) ((uint16_t)((cons) | (imm)))
+
+// ADDC Rm, Rn
+#define INST_ADDC(m, n) INST_RM_RN(0x300e, m, n)
+// SUBC Rm, Rn
+#define INST_SUBC(m, n) INST_RM_RN(0x300a, m, n)
+// NEGC Rm, Rn
+#define INST_NEGC(m, n) INST_RM_RN(0x600a, m, n)
+// DIV0U
+#define INST_DIV0U 0x0019
+// DIV0S Rm, Rn
+#define INST_DIV0S(m, n) INST_RM_RN(0x2007, m, n)
+// DIV1 Rm, Rn
+#define INST_DIV1(m, n) INST_RM_RN(0x3004, m, n)
+// DMULS.L Rm, Rn
+#define INST_DMULS(m, n) INST_RM_RN(0x300d, m, n)
+// DMULU.L Rm, Rn
+#define INST_DMULU(m, n) INST_RM_RN(0x3005, m, n)
+// MUL.L Rm, Rn
+#define INST_MULL(m, n) INST_RM_RN(0x0007, m, n)
+// MAC.L @Rm+, @Rn+
+#define INST_MACL(m, n) INST_RM_RN(0x000f, m, n)
+// MAC.W @Rm+, @Rn+
+#define INST_MACW(m, n) INST_RM_RN(0x400f, m, n)
+// ROTL Rn
+#define INST_ROTL(n) INST_RN(0x4004, n)
+// ROTR Rn
+#define INST_ROTR(n) INST_RN(0x4005, n)
+// ROTCL Rn
+#define INST_ROTCL(n) INST_RN(0x4024, n)
+// ROTCR Rn
+#define INST_ROTCR(n) INST_RN(0x4025, n)
+// XTRCT Rm, Rn
+#define INST_XTRCT(m, n) INST_RM_RN(0x200d, m, n)
+// AND.B #imm, @(R0, GBR)
+#define INST_ANDB(imm) INST_IMM8(0xcd00, imm)
+// OR.B #imm, @(R0, GBR)
+#define INST_ORB(imm) INST_IMM8(0xcf00, imm)
+// XOR.B #imm, @(R0, GBR)
+#define INST_XORB(imm) INST_IMM8(0xce00, imm)
+// TST.B #imm, @(R0, GBR)
+#define INST_TSTB(imm) INST_IMM8(0xcc00, imm)
+
+#define INST_BRA_SELF 0xaffe
+#define INST_NOP 0x0009
+
+// the MAC tests read from these two offsets into the data memory
+#define MAC_OFFS_M 0x40
+#define MAC_OFFS_N 0x80
+
+#define MAC_PTRS(m, n)                                  \
+    { R(m), TEST_DATA_BASE + MAC_OFFS_M },              \
+    { R(n), TEST_DATA_BASE + MAC_OFFS_N }
+
+// the MAC.W tests read halfwords, so both go in the low half of the word
+#define MACW_OPERANDS(lhs, rhs)                         \
+    { MAC_OFFS_M, (uint16_t)(lhs) },                    \
+    { MAC_OFFS_N, (uint16_t)(rhs) }
+
+#define MACL_OPERANDS(lhs, rhs)                         \
+    { MAC_OFFS_M, (lhs) },                              \
+    { MAC_OFFS_N, (rhs) }
+
+// R0 is the offset from GBR for the @(R0, GBR) instructions
+#define GBR_OFFS 0x10
+
+static struct int_test_case const test_cases[] = {
+    // ADDC
+    { "ADDC R1, R2 (T=0)", INST_ADDC(1, 2), 0, 2,
+      { { R(1), 1 }, { R(2), 2 } } },
+    { "ADDC R1, R2 (T=1)", INST_ADDC(1, 2), SR_T, 2,
+      { { R(1), 1 }, { R(2), 2 } } },
+    { "ADDC R1, R2 (carry out)", INST_ADDC(1, 2), 0, 2,
+      { { R(1), 0xffffffff }, { R(2), 2 } } },
+    { "ADDC R1, R2 (carry out from carry in)", INST_ADDC(1, 2), SR_T, 2,
+      { { R(1), 0xffffffff }, { R(2), 0 } } },
+    { "ADDC R1, R2 (all ones with carry in)", INST_ADDC(1, 2), SR_T, 2,
+      { { R(1), 0xffffffff }, { R(2), 0xffffffff } } },
+    { "ADDC R1, R2 (signed overflow, no carry)", INST_ADDC(1, 2), SR_T, 2,
+      { { R(1), 0x7fffffff }, { R(2), 0 } } },
+    { "ADDC R3, R3", INST_ADDC(3, 3), SR_T, 1,
+      { { R(3), 0x80000000 } } },
+
+    // SUBC
+    { "SUBC R1, R2 (T=0)", INST_SUBC(1, 2), 0, 2,
+      { { R(1), 1 }, { R(2), 5 } } },
+    { "SUBC R1, R2 (T=1)", INST_SUBC(1, 2), SR_T, 2,
+      { { R(1), 1 }, { R(2), 5 } } },
+    { "SUBC R1, R2 (borrow)", INST_SUBC(1, 2), 0, 2,
+      { { R(1), 6 }, { R(2), 5 } } },
+    { "SUBC R1, R2 (borrow from borrow in)", INST_SUBC(1, 2), SR_T, 2,
+      { { R(1), 5 }, { R(2), 5 } } },
+    { "SUBC R1, R2 (0 - 0 - 1)", INST_SUBC(1, 2), SR_T, 2,
+      { { R(1), 0 }, { R(2), 0 } } },
+    { "SUBC R1, R2 (0 - all ones - 1)", INST_SUBC(1, 2), SR_T, 2,
+      { { R(1), 0xffffffff }, { R(2), 0 } } },
+    { "SUBC R1, R2 (signed overflow, no borrow)", INST_SUBC(1, 2), 0, 2,
+      { { R(1), 1 }, { R(2), 0x80000000 } } },
+    { "SUBC R3, R3", INST_SUBC(3, 3), SR_T, 1,
+      { { R(3), 0x12345678 } } },
+
+    // NEGC
+    { "NEGC R1, R2 (0, T=0)", INST_NEGC(1, 2), 0, 1,
+      { { R(1), 0 } } },
+    { "NEGC R1, R2 (0, T=1)", INST_NEGC(1, 2), SR_T, 1,
+      { { R(1), 0 } } },
+    { "NEGC R1, R2 (1, T=0)", INST_NEGC(1, 2), 0, 1,
+      { { R(1), 1 } } },
+    { "NEGC R1, R2 (all ones, T=1)", INST_NEGC(1, 2), SR_T, 1,
+      { { R(1), 0xffffffff } } },
+    { "NEGC R1, R2 (INT_MIN, T=0)", INST_NEGC(1, 2), 0, 1,
+      { { R(1), 0x80000000 } } },
+    { "NEGC R3, R3", INST_NEGC(3, 3), SR_T, 1,
+      { { R(3), 0x00000007 } } },
+
+    // DIV0U and DIV0S
+    { "DIV0U", INST_DIV0U, SR_T | SR_Q | SR_M, 0 },
+    { "DIV0S R1, R2 (+, +)", INST_DIV0S(1, 2), SR_T | SR_Q | SR_M, 2,
+      { { R(1), 0x00000003 }, { R(2), 0x7fffffff } } },
+    { "DIV0S R1, R2 (-, +)", INST_DIV0S(1, 2), 0, 2,
+      { { R(1), 0x80000000 }, { R(2), 0x00000001 } } },
+    { "DIV0S R1, R2 (+, -)", INST_DIV0S(1, 2), 0, 2,
+      { { R(1), 0x00000001 }, { R(2), 0xffffffff } } },
+    { "DIV0S R1, R2 (-, -)", INST_DIV0S(1, 2), SR_T, 2,
+      { { R(1), 0xfffffffd }, { R(2), 0x80000000 } } },
+
+    // DIV1 with every combination of Q and M
+    { "DIV1 R1, R2 (Q=0 M=0 T=0)", INST_DIV1(1, 2), 0, 2,
+      { { R(1), 0x30000000 }, { R(2), 0x40000000 } } },
+    { "DIV1 R1, R2 (Q=0 M=0 T=1)", INST_DIV1(1, 2), SR_T, 2,
+      { { R(1), 0x7fffffff }, { R(2), 0x80000001 } } },
+    { "DIV1 R1, R2 (Q=0 M=0, borrow)", INST_DIV1(1, 2), 0, 2,
+      { { R(1), 0x30000000 }, { R(2), 0x10000000 } } },
+    { "DIV1 R1, R2 (Q=0 M=1 T=0)", INST_DIV1(1, 2), SR_M, 2,
+      { { R(1), 0xc0000000 }, { R(2), 0x40000000 } } },
+    { "DIV1 R1, R2 (Q=0 M=1 T=1)", INST_DIV1(1, 2), SR_M | SR_T, 2,
+      { { R(1), 0x80000000 }, { R(2), 0x80000000 } } },
+    { "DIV1 R1, R2 (Q=0 M=1, carry)", INST_DIV1(1, 2), SR_M, 2,
+      { { R(1), 0xffffffff }, { R(2), 0x00000001 } } },
+    { "DIV1 R1, R2 (Q=1 M=0 T=0)", INST_DIV1(1, 2), SR_Q, 2,
+      { { R(1), 0x30000000 }, { R(2), 0x40000000 } } },
+    { "DIV1 R1, R2 (Q=1 M=0 T=1)", INST_DIV1(1, 2), SR_Q | SR_T, 2,
+      { { R(1), 0x50000000 }, { R(2), 0xc0000000 } } },
+    { "DIV1 R1, R2 (Q=1 M=0, carry)", INST_DIV1(1, 2), SR_Q, 2,
+      { { R(1), 0xffffffff }, { R(2), 0x00000001 } } },
+    { "DIV1 R1, R2 (Q=1 M=1 T=0)", INST_DIV1(1, 2), SR_Q | SR_M, 2,
+      { { R(1), 0xc0000000 }, { R(2), 0x40000000 } } },
+    { "DIV1 R1, R2 (Q=1 M=1 T=1)", INST_DIV1(1, 2), SR_Q | SR_M | SR_T, 2,
+      { { R(1), 0xffffffff }, { R(2), 0x80000000 } } },
+    { "DIV1 R1, R2 (Q=1 M=1, borrow)", INST_DIV1(1, 2), SR_Q | SR_M, 2,
+      { { R(1), 0x00000001 }, { R(2), 0x7fffffff } } },
+    { "DIV1 R1, R2 (divide by zero)", INST_DIV1(1, 2), SR_M | SR_T, 2,
+      { { R(1), 0x00000000 }, { R(2), 0x89abcdef } } },
+    { "DIV1 R3, R3", INST_DIV1(3, 3), SR_Q | SR_T, 1,
+      { { R(3), 0xa5a5a5a5 } } },
+
+    // 32x32 multiplies
+    { "DMULS.L R1, R2", INST_DMULS(1, 2), 0, 2,
+      { { R(1), 0xfffffffe }, { R(2), 0x7fffffff } } },
+    { "DMULS.L R1, R2 (INT_MIN squared)", INST_DMULS(1, 2), 0, 2,
+      { { R(1), 0x80000000 }, { R(2), 0x80000000 } } },
+    { "DMULU.L R1, R2", INST_DMULU(1, 2), 0, 2,
+      { { R(1), 0xfffffffe }, { R(2), 0xffffffff } } },
+    { "MUL.L R1, R2", INST_MULL(1, 2), 0, 2,
+      { { R(1), 0x12345678 }, { R(2), 0x9abcdef0 } } },
+
+    // MAC.L
+    { "MAC.L @R5+, @R4+", INST_MACL(5, 4), 0, 4,
+      { MAC_PTRS(5, 4), { SH4_REG_MACH, 0 }, { SH4_REG_MACL, 0 } }, 2,
+      { MACL_OPERANDS(0x12345678, 0x00010000) } },
+    { "MAC.L @R5+, @R4+ (negative)", INST_MACL(5, 4), 0, 2,
+      { MAC_PTRS(5, 4) }, 2,
+      { MACL_OPERANDS(0xfffffff0, 0x7fffffff) } },
+    { "MAC.L @R5+, @R4+ (64-bit carry)", INST_MACL(5, 4), 0, 4,
+      { MAC_PTRS(5, 4), { SH4_REG_MACH, 0x7fffffff },
+        { SH4_REG_MACL, 0xffffffff } }, 2,
+      { MACL_OPERANDS(0x00000001, 0x00000001) } },
+    { "MAC.L @R5+, @R4+ (S=1, no overflow)", INST_MACL(5, 4), SR_S, 4,
+      { MAC_PTRS(5, 4), { SH4_REG_MACH, 0x00001234 },
+        { SH4_REG_MACL, 0x56789abc } }, 2,
+      { MACL_OPERANDS(0x00001000, 0xffff0000) } },
+    { "MAC.L @R5+, @R4+ (S=1, positive saturation)", INST_MACL(5, 4), SR_S, 4,
+      { MAC_PTRS(5, 4), { SH4_REG_MACH, 0x00007fff },
+        { SH4_REG_MACL, 0xfffffff0 } }, 2,
+      { MACL_OPERANDS(0x7fffffff, 0x7fffffff) } },
+    { "MAC.L @R5+, @R4+ (S=1, negative saturation)", INST_MACL(5, 4), SR_S, 4,
+      { MAC_PTRS(5, 4), { SH4_REG_MACH, 0xffff8000 },
+        { SH4_REG_MACL, 0x00000010 } }, 2,
+      { MACL_OPERANDS(0x80000000, 0x7fffffff) } },
+    { "MAC.L @R5+, @R4+ (S=1, wraparound)", INST_MACL(5, 4), SR_S, 4,
+      { MAC_PTRS(5, 4), { SH4_REG_MACH, 0x7fffffff },
+        { SH4_REG_MACL, 0xffffffff } }, 2,
+      { MACL_OPERANDS(0x00000002, 0x00000003) } },
+    { "MAC.L @R4+, @R4+", INST_MACL(4, 4), 0, 1,
+      { { R(4), TEST_DATA_BASE + MAC_OFFS_M } }, 2,
+      { { MAC_OFFS_M, 0xfffffffd }, { MAC_OFFS_M + 4, 0x00000011 } } },
+
+    // MAC.W
+    { "MAC.W @R5+, @R4+", INST_MACW(5, 4), 0, 4,
+      { MAC_PTRS(5, 4), { SH4_REG_MACH, 0 }, { SH4_REG_MACL, 0 } }, 2,
+      { MACW_OPERANDS(0x1234, 0x0100) } },
+    { "MAC.W @R5+, @R4+ (negative)", INST_MACW(5, 4), 0, 2,
+      { MAC_PTRS(5, 4) }, 2,
+      { MACW_OPERANDS(0x8000, 0x7fff) } },
+    { "MAC.W @R5+, @R4+ (64-bit carry)", INST_MACW(5, 4), 0, 4,
+      { MAC_PTRS(5, 4), { SH4_REG_MACH, 0x00000000 },
+        { SH4_REG_MACL, 0xffffffff } }, 2,
+      { MACW_OPERANDS(0x0001, 0x0001) } },
+    { "MAC.W @R5+, @R4+ (S=1, no overflow)", INST_MACW(5, 4), SR_S, 4,
+      { MAC_PTRS(5, 4), { SH4_REG_MACH, 0x00000000 },
+        { SH4_REG_MACL, 0x00001000 } }, 2,
+      { MACW_OPERANDS(0xfff0, 0x0010) } },
+    { "MAC.W @R5+, @R4+ (S=1, positive saturation)", INST_MACW(5, 4), SR_S, 4,
+      { MAC_PTRS(5, 4), { SH4_REG_MACH, 0x00000000 },
+        { SH4_REG_MACL, 0x7fffff00 } }, 2,
+      { MACW_OPERANDS(0x7fff, 0x7fff) } },
+    { "MAC.W @R5+, @R4+ (S=1, negative saturation)", INST_MACW(5, 4), SR_S, 4,
+      { MAC_PTRS(5, 4), { SH4_REG_MACH, 0x00000000 },
+        { SH4_REG_MACL, 0x80000100 } }, 2,
+      { MACW_OPERANDS(0x8000, 0x7fff) } },
+    { "MAC.W @R5+, @R4+ (S=1, MACH already set)", INST_MACW(5, 4), SR_S, 4,
+      { MAC_PTRS(5, 4), { SH4_REG_MACH, 0xdeadbeee },
+        { SH4_REG_MACL, 0x7ffffff0 } }, 2,
+      { MACW_OPERANDS(0x0100, 0x0100) } },
+    { "MAC.W @R4+, @R4+", INST_MACW(4, 4), 0, 1,
+      { { R(4), TEST_DATA_BASE + MAC_OFFS_M } }, 1,
+      { { MAC_OFFS_M, 0x8001fffd } } },
+
+    // rotates
+    { "ROTL R2 (MSB=0)", INST_ROTL(2), SR_T, 1,
+      { { R(2), 0x7ffffffe } } },
+    { "ROTL R2 (MSB=1)", INST_ROTL(2), 0, 1,
+      { { R(2), 0x80000001 } } },
+    { "ROTR R2 (LSB=0)", INST_ROTR(2), SR_T, 1,
+      { { R(2), 0x7ffffffe } } },
+    { "ROTR R2 (LSB=1)", INST_ROTR(2), 0, 1,
+      { { R(2), 0x80000001 } } },
+    { "ROTCL R2 (T=0, MSB=0)", INST_ROTCL(2), 0, 1,
+      { { R(2), 0x7fffffff } } },
+    { "ROTCL R2 (T=0, MSB=1)", INST_ROTCL(2), 0, 1,
+      { { R(2), 0x80000000 } } },
+    { "ROTCL R2 (T=1, MSB=0)", INST_ROTCL(2), SR_T, 1,
+      { { R(2), 0x00000000 } } },
+    { "ROTCL R2 (T=1, MSB=1)", INST_ROTCL(2), SR_T, 1,
+      { { R(2), 0xffffffff } } },
+    { "ROTCR R2 (T=0, LSB=0)", INST_ROTCR(2), 0, 1,
+      { { R(2), 0xfffffffe } } },
+    { "ROTCR R2 (T=0, LSB=1)", INST_ROTCR(2), 0, 1,
+      { { R(2), 0x00000001 } } },
+    { "ROTCR R2 (T=1, LSB=0)", INST_ROTCR(2), SR_T, 1,
+      { { R(2), 0x00000000 } } },
+    { "ROTCR R2 (T=1, LSB=1)", INST_ROTCR(2), SR_T, 1,
+      { { R(2), 0xffffffff } } },
+
+    // XTRCT
+    { "XTRCT R1, R2", INST_XTRCT(1, 2), 0, 2,
+      { { R(1), 0x12345678 }, { R(2), 0x9abcdef0 } } },
+    { "XTRCT R3, R3", INST_XTRCT(3, 3), 0, 1,
+      { { R(3), 0x12345678 } } },
+
+    // @(R0, GBR)
+    { "AND.B #0x0f, @(R0, GBR)", INST_ANDB(0x0f), 0, 1,
+      { { R(0), GBR_OFFS } }, 1,
+      { { GBR_OFFS, 0x5a5a5aa5 } } },
+    { "AND.B #0x00, @(R0, GBR)", INST_ANDB(0x00), SR_T, 1,
+      { { R(0), GBR_OFFS } }, 1,
+      { { GBR_OFFS, 0x5a5a5aff } } },
+    { "OR.B #0xf0, @(R0, GBR)", INST_ORB(0xf0), 0, 1,
+      { { R(0), GBR_OFFS } }, 1,
+      { { GBR_OFFS, 0x5a5a5a05 } } },
+    { "OR.B #0x81, @(R0, GBR) (odd offset)", INST_ORB(0x81), 0, 1,
+      { { R(0), GBR_OFFS + 3 } }, 1,
+      { { GBR_OFFS, 0x24000000 } } },
+    { "XOR.B #0xff, @(R0, GBR)", INST_XORB(0xff), 0, 1,
+      { { R(0), GBR_OFFS } }, 1,
+      { { GBR_OFFS, 0x5a5a5aa5 } } },
+    { "XOR.B #0x3c, @(R0, GBR) (odd offset)", INST_XORB(0x3c), SR_T, 1,
+      { { R(0), GBR_OFFS + 1 } }, 1,
+      { { GBR_OFFS, 0x5a5a3c5a } } },
+    { "TST.B #0x5a, @(R0, GBR) (zero, T=0)", INST_TSTB(0x5a), 0, 1,
+      { { R(0), GBR_OFFS } }, 1,
+      { { GBR_OFFS, 0xffffffa5 } } },
+    { "TST.B #0x81, @(R0, GBR) (nonzero, T=1)", INST_TSTB(0x81), SR_T, 1,
+      { { R(0), GBR_OFFS } }, 1,
+      { { GBR_OFFS, 0x000000a5 } } },
+    { "TST.B #0x80, @(R0, GBR) (sign bit)", INST_TSTB(0x80), 0, 1,
+      { { R(0), GBR_OFFS } }, 1,
+      { { GBR_OFFS, 0x00000080 } } },
+    { "TST.B #0xff, @(R0, GBR) (zero byte)", INST_TSTB(0xff), 0, 1,
+      { { R(0), GBR_OFFS } }, 1,
+      { { GBR_OFFS, 0xffffff00 } } }
+};
+
+#define N_TEST_CASES (sizeof(test_cases) / sizeof(test_cases[0]))
+
+/*
+ * the state every test case starts from.  None of the general-purpose
+ * registers are zero except for the ones the test cases set, and R0 is the
+ * offset from GBR that the @(R0, GBR) instructions use.
+ */
+static reg32_t const gen_reg_init[16] = {
+    GBR_OFFS,   0x01234567, 0x89abcdef, 0xfedcba98,
+    0x76543210, 0x0badf00d, 0xdeadbeef, 0x13579bdf,
+    0x2468ace0, 0xc0ffee00, 0x00c0ffee, 0x55555555,
+    0xaaaaaaaa, 0x0f0f0f0f, 0xf0f0f0f0, 0x8c00fff0
+};
+
+#define MACH_INIT 0x0000abcd
+#define MACL_INIT 0x12345678
+#define GBR_INIT TEST_DATA_BASE
+
+// the SH4 runs on sh4_clock from dreamcast.c instead of a clock of its own
+static struct Memory test_mem;
+static struct memory_map test_mem_map;
+static Sh4 cpu;
+static struct native_dispatch_meta test_dispatch_meta;
+
+// SR as sh4_init leaves it; load_state only changes T, S, Q and M
+static reg32_t sr_init;
+
+struct int_state {
+    reg32_t gen[16];
+    reg32_t sr;
+    reg32_t mach;
+    reg32_t macl;
+    uint8_t data[TEST_DATA_LEN];
+};
+
+static void load_state(struct int_test_case const *test) {
+    memcpy(cpu.reg + SH4_REG_R0, gen_reg_init, sizeof(gen_reg_init));
+    cpu.reg[SH4_REG_SR] = (sr_init & ~SR_FLAGS_MASK) | test->sr_flags;
+    cpu.reg[SH4_REG_MACH] = MACH_INIT;
+    cpu.reg[SH4_REG_MACL] = MACL_INIT;
+    cpu.reg[SH4_REG_GBR] = GBR_INIT;
+
+    unsigned idx;
+    for (idx = 0; idx < test->n_init; idx++)
+        cpu.reg[test->init[idx].reg] = test->init[idx].val;
+
+    // fill the data memory with a pattern where no two neighbours match
+    addr32_t addr = TEST_DATA_BASE & ADDR_AREA3_MASK;
+    for (idx = 0; idx < TEST_DATA_LEN; idx++)
+        memory_write_8(addr + idx, (idx * 0x9d + 0x3b) & 0xff, &test_mem);
+
+    for (idx = 0; idx < test->n_mem; idx++) {
+        memory_write_32(addr + test->mem[idx].offs, test->mem[idx].val,
+                        &test_mem);
+    }
+}
+
+static void save_state(struct int_state *state) {
+    memcpy(state->gen, cpu.reg + SH4_REG_R0, sizeof(state->gen));
+    state->sr = cpu.reg[SH4_REG_SR];
+    state->mach = cpu.reg[SH4_REG_MACH];
+    state->macl = cpu.reg[SH4_REG_MACL];
+
+    addr32_t addr = TEST_DATA_BASE & ADDR_AREA3_MASK;
+    unsigned idx;
+    for (idx = 0; idx < TEST_DATA_LEN; idx++)
+        state->data[idx] = memory_read_8(addr + idx, &test_mem);
+}
+
+static void run_intp(struct int_test_case const *test) {
+    InstOpcode const *op = sh4_decode_inst(test->inst);
+    op->func(&cpu, test->inst);
+}
+
+/*
+ * the test case's instruction is followed by a BRA so that it gets compiled
+ * as a block of its own.  Nothing is ever scheduled on the clock, so the
+ * countdown is always zero when native code gets entered; that means that
+ * exactly one block runs before it returns.
+ */
+static void run_native(struct int_test_case const *test, addr32_t pc) {
+    memory_write_16((pc + 0) & ADDR_AREA3_MASK, test->inst, &test_mem);
+    memory_write_16((pc + 2) & ADDR_AREA3_MASK, INST_BRA_SELF, &test_mem);
+    memory_write_16((pc + 4) & ADDR_AREA3_MASK, INST_NOP, &test_mem);
+
+    jit_hash hash =
+        sh4_jit_hash(&cpu, pc, sh4_fpscr_pr(&cpu), sh4_fpscr_sz(&cpu));
+
+    cpu.reg[SH4_REG_PC] = test_dispatch_meta.entry(pc, hash);
+}
+
+static void print_reg_mismatch(char const *reg_name,
+                               reg32_t intp_val, reg32_t native_val) {
+    if (intp_val != native_val) {
+        fprintf(stderr, "\t%s: interpreter 0x%08x, native 0x%08x\n",
+                reg_name, (unsigned)intp_val, (unsigned)native_val);
+    }
+}
+
+static void print_sr_flag_mismatch(char const *flag_name, reg32_t mask,
+                                   reg32_t intp_sr, reg32_t native_sr) {
+    if ((intp_sr & mask) != (native_sr & mask)) {
+        fprintf(stderr, "\tSR.%s: interpreter %d, native %d\n", flag_name,
+                (int)!!(intp_sr & mask), (int)!!(native_sr & mask));
+    }
+}
+
+static bool check_state(struct int_test_case const *test,
+                        struct int_state const *intp,
+                        struct int_state const *native) {
+    if (memcmp(intp, native, sizeof(*intp)) == 0)
+        return true;
+
+    fprintf(stderr, "FAILURE: %s (opcode 0x%04x)\n",
+            test->name, (unsigned)test->inst);
+
+    unsigned idx;
+    for (idx = 0; idx < 16; idx++) {
+        char reg_name[4];
+        snprintf(reg_name, sizeof(reg_name), "R%u", idx);
+        print_reg_mismatch(reg_name, intp->gen[idx], native->gen[idx]);
+    }
+
+    print_sr_flag_mismatch("T", SR_T, intp->sr, native->sr);
+    print_sr_flag_mismatch("S", SR_S, intp->sr, native->sr);
+    print_sr_flag_mismatch("Q", SR_Q, intp->sr, native->sr);
+    print_sr_flag_mismatch("M", SR_M, intp->sr, native->sr);
+    if ((intp->sr & ~SR_FLAGS_MASK) != (native->sr & ~SR_FLAGS_MASK))
+        print_reg_mismatch("SR", intp->sr, native->sr);
+
+    print_reg_mismatch("MACH", intp->mach, native->mach);
+    print_reg_mismatch("MACL", intp->macl, native->macl);
+
+    for (idx = 0; idx < TEST_DATA_LEN; idx++) {
+        if (intp->data[idx] != native->data[idx]) {
+            fprintf(stderr, "\tbyte 0x%08x: interpreter 0x%02x, "
+                    "native 0x%02x\n", (unsigned)(TEST_DATA_BASE + idx),
+                    (unsigned)intp->data[idx], (unsigned)native->data[idx]);
+        }
+    }
+
+    return false;
+}
+
+static void test_init(void) {
+    config_set_jit(true);
+    config_set_native_jit(true);
+
+    /*
+     * the memory accesses go through the memory map so that both the
+     * interpreter and the JIT use the same path to RAM.
+     */
+    config_set_inline_mem(false);
+
+    memory_map_init(&test_mem_map);
+    memory_init(&test_mem);
+
+    dc_clock_init(&sh4_clock);
+    sh4_init(&cpu, &sh4_clock);
+    sr_init = cpu.reg[SH4_REG_SR];
+
+    memory_map_add_host_mem(&test_mem_map, 0x0c000000, 0x0fffffff,
+                            RANGE_MASK_EXT, MEMORY_MAP_REGION_RAM,
+                            &ram_intf, &test_mem, test_mem.mem, MEMORY_MASK);
+    sh4_set_mem_map(&cpu, &test_mem_map);
+
+    jit_x86_64_backend_init();
+    exec_mem_init();
+    sh4_jit_set_native_dispatch_meta(&test_dispatch_meta);
+    test_dispatch_meta.clk = &sh4_clock;
+    native_dispatch_init(&test_dispatch_meta, &cpu);
+
+    jit_block_prof_init(false);
+    jit_init(&sh4_clock, &test_mem);
+}
+
+static void test_cleanup(void) {
+    jit_cleanup();
+    native_dispatch_cleanup(&test_dispatch_meta);
+    jit_x86_64_backend_cleanup();
+
+    /*
+     * exec_mem_cleanup isn't called because it logs its statistics, and the
+     * log can't be opened without the hostfile API that the frontend passes
+     * to washdc_init.  The process is about to exit anyways.
+     */
+
+    sh4_cleanup(&cpu);
+    dc_clock_cleanup(&sh4_clock);
+    memory_cleanup(&test_mem);
+    memory_map_cleanup(&test_mem_map);
+}
+
+int main(int argc, char **argv) {
+    unsigned n_failed = 0;
+    unsigned test_no;
+
+    test_init();
+
+    for (test_no = 0; test_no < N_TEST_CASES; test_no++) {
+        struct int_test_case const *test = test_cases + test_no;
+        addr32_t pc = TEST_CODE_BASE + test_no * TEST_CODE_STRIDE;
+        struct int_state intp_state, native_state;
+
+        load_state(test);
+        run_intp(test);
+        save_state(&intp_state);
+
+        load_state(test);
+        run_native(test, pc);
+        save_state(&native_state);
+
+        if (!check_state(test, &intp_state, &native_state))
+            n_failed++;
+    }
+
+    test_cleanup();
+
+    printf("%u of %u tests passed\n",
+           (unsigned)(N_TEST_CASES - n_failed), (unsigned)N_TEST_CASES);
+
+    return n_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,288 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+/*
+ * This test makes sure that native blocks which are only ever reached through
+ * direct links still count as recently-used when the code cache has to evict
+ * blocks to stay under its memory budget.
+ *
+ * Two hot blocks branch back and forth to each other, so once they've been
+ * linked the second one never goes through the dispatcher.  In between runs of
+ * the hot loop, cold blocks get compiled to keep the code cache over its
+ * budget.  After every code_cache_gc, both hot blocks have to still be in the
+ * cache and the hot loop has to have spent its time in linked blocks.
+ *
+ * Every block has been referenced at least once by the time it first gets
+ * looked at for eviction, so the oldest blocks go first whenever an eviction
+ * sweep finds that everything has been referenced.  Some cold blocks get
+ * compiled before the hot ones so that those are what gets thrown out then.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "config.h"
+#include "dc_sched.h"
+#include "dreamcast.h"
+#include "memory.h"
+#include "washdc/MemoryMap.h"
+#include "hw/sh4/sh4.h"
+#include "hw/sh4/sh4_jit.h"
+#include "jit/jit.h"
+#include "jit/jit_block_prof.h"
+#include "jit/code_cache.h"
+#include "jit/x86_64/code_block_x86_64.h"
+#include "jit/x86_64/native_dispatch.h"
+#include "jit/x86_64/exec_mem.h"
+
+/*
+ * HOT_A:  ADD #1, R0
+ *         BRA HOT_B
+ *         NOP
+ *
+ * HOT_B:  ADD #1, R1
+ *         BRA HOT_A
+ *         NOP
+ */
+#define HOT_A 0x8c010000
+#define HOT_B 0x8c010100
+
+#define INST_ADD_1_R0 0x7001
+#define INST_ADD_1_R1 0x7101
+#define INST_BRA_A_TO_B 0xa07d
+#define INST_BRA_B_TO_A 0xaf7d
+
+// every cold block is a BRA to itself followed by a NOP
+#define COLD_BASE 0x8c100000
+#define COLD_STRIDE 4
+
+#define INST_BRA_SELF 0xaffe
+#define INST_NOP 0x0009
+
+#define N_COLD_PER_ROUND 512
+
+// number of rounds of cold blocks which get compiled before the hot blocks
+#define N_OLDER_ROUNDS 2
+
+#define N_ROUNDS 32
+
+#define N_COLD_BLOCKS ((N_OLDER_ROUNDS + N_ROUNDS) * N_COLD_PER_ROUND)
+
+// how long the hot loop gets to run every round
+#define HOT_CYCLES 4096
+
+#define BUDGET_MB 1
+
+// the SH4 runs on sh4_clock from dreamcast.c instead of a clock of its own
+static struct Memory test_mem;
+static struct memory_map test_mem_map;
+static Sh4 cpu;
+static struct native_dispatch_meta test_dispatch_meta;
+
+static void stop_hot_loop(struct SchedEvent *event) {
+}
+
+static struct SchedEvent stop_event = {
+    .handler = stop_hot_loop
+};
+
+static void write_inst(addr32_t addr, uint16_t inst) {
+    memory_write_16(addr & ADDR_AREA3_MASK, inst, &test_mem);
+}
+
+static jit_hash block_hash(addr32_t pc) {
+    return sh4_jit_hash(&cpu, pc, sh4_fpscr_pr(&cpu), sh4_fpscr_sz(&cpu));
+}
+
+static void write_code(void) {
+    write_inst(HOT_A, INST_ADD_1_R0);
+    write_inst(HOT_A + 2, INST_BRA_A_TO_B);
+    write_inst(HOT_A + 4, INST_NOP);
+
+    write_inst(HOT_B, INST_ADD_1_R1);
+    write_inst(HOT_B + 2, INST_BRA_B_TO_A);
+    write_inst(HOT_B + 4, INST_NOP);
+
+    unsigned blk_no;
+    for (blk_no = 0; blk_no < N_COLD_BLOCKS; blk_no++) {
+        addr32_t pc = COLD_BASE + blk_no * COLD_STRIDE;
+        write_inst(pc, INST_BRA_SELF);
+        write_inst(pc + 2, INST_NOP);
+    }
+}
+
+/*
+ * the hot loop never leaves on its own, so it runs until stop_event comes up.
+ * The event never actually gets run; it's just there so that the countdown
+ * doesn't run out after the first block.
+ *
+ * The number of linked and dispatched block transitions that happened while
+ * the hot loop was running get added to *n_linked and *n_dispatched.
+ */
+static void run_hot_loop(uint64_t *n_linked, uint64_t *n_dispatched) {
+    uint64_t linked_before, dispatched_before, linked_after, dispatched_after;
+
+    native_dispatch_get_link_stats(&test_dispatch_meta,
+                                   &linked_before, &dispatched_before);
+
+    stop_event.when = clock_cycle_stamp(&sh4_clock) + HOT_CYCLES;
+    sched_event(&sh4_clock, &stop_event);
+
+    cpu.reg[SH4_REG_PC] =
+        test_dispatch_meta.entry(HOT_A, block_hash(HOT_A));
+
+    cancel_event(&sh4_clock, &stop_event);
+
+    native_dispatch_get_link_stats(&test_dispatch_meta,
+                                   &linked_after, &dispatched_after);
+    *n_linked += linked_after - linked_before;
+    *n_dispatched += dispatched_after - dispatched_before;
+}
+
+/*
+ * nothing is scheduled while the cold blocks run, so the countdown is zero
+ * when native code gets entered and exactly one block runs.
+ */
+static void run_cold_blocks(void) {
+    static unsigned next_cold;
+
+    unsigned blk_no;
+    for (blk_no = 0; blk_no < N_COLD_PER_ROUND; blk_no++) {
+        addr32_t pc = COLD_BASE + next_cold++ * COLD_STRIDE;
+        cpu.reg[SH4_REG_PC] = test_dispatch_meta.entry(pc, block_hash(pc));
+    }
+}
+
+static bool hot_block_alive(char const *name, addr32_t pc,
+                            struct cache_entry *ent, unsigned round_no) {
+    if (code_cache_lookup(block_hash(pc)) == ent)
+        return true;
+    fprintf(stderr, "FAILURE: %s was evicted in round %u\n", name, round_no);
+    return false;
+}
+
+static void test_init(void) {
+    config_set_jit(true);
+    config_set_native_jit(true);
+    config_set_inline_mem(false);
+    config_set_jit_cache_budget_mb(BUDGET_MB);
+
+    memory_map_init(&test_mem_map);
+    memory_init(&test_mem);
+
+    dc_clock_init(&sh4_clock);
+    sh4_init(&cpu, &sh4_clock);
+
+    memory_map_add_host_mem(&test_mem_map, 0x0c000000, 0x0fffffff,
+                            RANGE_MASK_EXT, MEMORY_MAP_REGION_RAM,
+                            &ram_intf, &test_mem, test_mem.mem, MEMORY_MASK);
+    sh4_set_mem_map(&cpu, &test_mem_map);
+
+    jit_x86_64_backend_init();
+    exec_mem_init();
+    sh4_jit_set_native_dispatch_meta(&test_dispatch_meta);
+    test_dispatch_meta.clk = &sh4_clock;
+    native_dispatch_init(&test_dispatch_meta, &cpu);
+
+    jit_block_prof_init(false);
+    jit_init(&sh4_clock, &test_mem);
+}
+
+static void test_cleanup(void) {
+    jit_cleanup();
+    native_dispatch_cleanup(&test_dispatch_meta);
+    jit_x86_64_backend_cleanup();
+
+    /*
+     * exec_mem_cleanup isn't called because it logs its statistics, and the
+     * log can't be opened without the hostfile API that the frontend passes
+     * to washdc_init.  The process is about to exit anyways.
+     */
+
+    sh4_cleanup(&cpu);
+    dc_clock_cleanup(&sh4_clock);
+    memory_cleanup(&test_mem);
+    memory_map_cleanup(&test_mem_map);
+}
+
+int main(int argc, char **argv) {
+    bool success = true;
+    unsigned round_no;
+    uint64_t n_evicted, n_spared;
+    uint64_t n_linked = 0, n_dispatched = 0;
+
+    test_init();
+    write_code();
+
+    for (round_no = 0; round_no < N_OLDER_ROUNDS; round_no++)
+        run_cold_blocks();
+
+    // compile both hot blocks and link them to each other
+    run_hot_loop(&n_linked, &n_dispatched);
+
+    struct cache_entry *hot_a = code_cache_lookup(block_hash(HOT_A));
+    struct cache_entry *hot_b = code_cache_lookup(block_hash(HOT_B));
+    if (!hot_a || !hot_b) {
+        fprintf(stderr, "FAILURE: the hot blocks never got compiled\n");
+        success = false;
+    }
+
+    for (round_no = 0; success && round_no < N_ROUNDS; round_no++) {
+        run_cold_blocks();
+        run_hot_loop(&n_linked, &n_dispatched);
+        code_cache_gc();
+
+        success = hot_block_alive("HOT_A", HOT_A, hot_a, round_no) &&
+            hot_block_alive("HOT_B", HOT_B, hot_b, round_no);
+    }
+
+    code_cache_get_evict_stats(&n_evicted, &n_spared);
+
+    printf("%llu blocks evicted, %llu given a second chance\n",
+           (unsigned long long)n_evicted, (unsigned long long)n_spared);
+    printf("hot loop: %llu linked block transitions, %llu dispatched\n",
+           (unsigned long long)n_linked, (unsigned long long)n_dispatched);
+
+    // if nothing got evicted then the cache was never under any pressure
+    if (success && !n_evicted) {
+        fprintf(stderr, "FAILURE: the code cache never went over budget\n");
+        success = false;
+    }
+
+    /*
+     * the hot blocks get unlinked every time something is evicted, so there
+     * are a few dispatches every round when they get relinked.  Other than
+     * that they should always be going straight to each other.
+     */
+    if (success && n_linked < 8 * n_dispatched) {
+        fprintf(stderr, "FAILURE: the hot blocks were not linked\n");
+        success = false;
+    }
+
+    test_cleanup();
+
+    printf("%s\n", success ? "test passed" : "test failed");
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -77,6 +77,27 @@ static inline void washdc_atomic_int_init(washdc_atomic_int *atom, int val) {
     *atom = val;
 }
 
+static inline void washdc_atomic_int_store(washdc_atomic_int *atom, int val) {
+    InterlockedExchange(atom, val);
+}
+
+typedef LONG64 volatile washdc_atomic_u64;
+
+static inline unsigned long long
+washdc_atomic_u64_load(washdc_atomic_u64 *atom) {
+    return InterlockedCompareExchange64(atom, 0, 0);
+}
+
+static inline void
+washdc_atomic_u64_store(washdc_atomic_u64 *atom, unsigned long long val) {
+    InterlockedExchange64(atom, val);
+}
+
+static inline void
+washdc_atomic_u64_init(washdc_atomic_u64 *atom, unsigned long long val) {
+    *atom = val;
+}
+
 #else
 /*
  * Here we foolishly assume that any compiler which isn't MSVC will support C11
@@ -114,6 +135,27 @@ static inline void washdc_atomic_int_init(washdc_atomic_int *atom, int val) {
     atomic_init(atom, val);
 }
 
+static inline void washdc_atomic_int_store(washdc_atomic_int *atom, int val) {
+    atomic_store(atom, val);
+}
+
+typedef atomic_ullong washdc_atomic_u64;
+
+static inline unsigned long long
+washdc_atomic_u64_load(washdc_atomic_u64 *atom) {
+    return atomic_load(atom);
+}
+
+static inline void
+washdc_atomic_u64_store(washdc_atomic_u64 *atom, unsigned long long val) {
+    atomic_store(atom, val);
+}
+
+static inline void
+washdc_atomic_u64_init(washdc_atomic_u64 *atom, unsigned long long val) {
+    atomic_init(atom, val);
+}
+
 #endif
 
 #ifdef __cplusplus
@@ -247,7 +247,7 @@ void washdbg_do_help(int argc, char **argv) {
         "bpset <addr> - set a breakpoint\n"
         "continue     - continue execution when suspended.\n"
         "crash        - crash the emulator.\n"
-        "dump         - dump memory to disk\n"
+        "dump         - dump memory or the jit block profile to disk\n"
         "echo         - echo back text\n"
         "exit         - exit the debugger and close WashingtonDC\n"
         "help         - display this message\n"
@@ -1111,7 +1111,7 @@ static bool washdbg_is_dump_cmd(char const *str) {
 static void washdbg_dump(int argc, char **argv) {
     if (argc != 3) {
         washdbg_print_error("usage: dump <type> path\n");
-        washdbg_print_error("type should be either aica or main\n");
+        washdbg_print_error("type should be either aica, main or jitprof\n");
         return;
     }
 
@@ -1125,6 +1125,10 @@ static void washdbg_dump(int argc, char **argv) {
         snprintf(dump_state.msg, sizeof(dump_state.msg),
                  "aica memory dumped\n");
         return;
+    } else if (strcmp(tp, "jitprof") == 0) {
+        washdc_dump_jit_profile(argv[2]);
+        snprintf(dump_state.msg, sizeof(dump_state.msg),
+                 "jit block profile dumped\n");
     } else {
         washdbg_print_error("invalid memory type");
         return;
@@ -21,6 +21,7 @@
  ******************************************************************************/
 
 #include <stddef.h>
+#include <string.h>
 
 #include "dreamcast.h"
 #include "washdc/error.h"
@@ -39,22 +40,18 @@ void memory_map_cleanup(struct memory_map *map) {
 #define MEMORY_MAP_READ_TMPL(type, type_postfix)                        \
     type memory_map_read_##type_postfix(struct memory_map *map,         \
                                         uint32_t addr) {                \
-        uint32_t first_addr = addr;                                     \
-        uint32_t last_addr = sizeof(type) - 1 + first_addr;             \
+        struct memory_map_region *reg =                                 \
+            memory_map_get_region(map, addr, sizeof(type));             \
+        if (reg) {                                                      \
+            CHECK_R_WATCHPOINT(addr, type);                             \
                                                                         \
-        unsigned region_no;                                             \
-        for (region_no = 0; region_no < map->n_regions; region_no++) {  \
-            struct memory_map_region *reg = map->regions + region_no;   \
-            uint32_t range_mask = reg->range_mask;                      \
-            if ((first_addr & range_mask) >= reg->first_addr &&         \
-                (last_addr & range_mask) <= reg->last_addr) {           \
-                struct memory_interface const *intf = reg->intf;        \
-                void *ctxt = reg->ctxt;                                 \
-                                                                        \
-                CHECK_R_WATCHPOINT(addr, type);                         \
-                                                                        \
-                return intf->read##type_postfix(addr, ctxt);            \
+            if (reg->host_ptr) {                                        \
+                type val;                                               \
+                memcpy(&val, (uint8_t*)reg->host_ptr +                  \
+                       (addr & reg->host_mask), sizeof(val));           \
+                return val;                                             \
             }                                                           \
+            return reg->intf->read##type_postfix(addr, reg->ctxt);      \
         }                                                               \
                                                                         \
         struct memory_interface const *unmap = map->unmap;              \
@@ -77,25 +74,17 @@ MEMORY_MAP_READ_TMPL(double, double)
 #define MEMORY_MAP_TRY_READ_TMPL(type, type_postfix)                    \
     int memory_map_try_read_##type_postfix(struct memory_map *map,      \
                                            uint32_t addr, type *val) {  \
-        uint32_t first_addr = addr;                                     \
-        uint32_t last_addr = sizeof(type) - 1 + first_addr;             \
-                                                                        \
-        unsigned region_no;                                             \
-        for (region_no = 0; region_no < map->n_regions; region_no++) {  \
-            struct memory_map_region *reg = map->regions + region_no;   \
-            uint32_t range_mask = reg->range_mask;                      \
-            if ((first_addr & range_mask) >= reg->first_addr &&         \
-                (last_addr & range_mask) <= reg->last_addr) {           \
-                struct memory_interface const *intf = reg->intf;        \
-                void *ctxt = reg->ctxt;                                 \
-                if (intf->try_read##type_postfix) {                     \
-                    return intf->try_read##type_postfix(addr,    \
-                                                        val, ctxt);     \
-                } else {                                                \
-                    *val = intf->read##type_postfix(addr, ctxt); \
-                }                                                       \
-                return 0;                                               \
+        struct memory_map_region *reg =                                 \
+            memory_map_get_region(map, addr, sizeof(type));             \
+        if (reg) {                                                      \
+            struct memory_interface const *intf = reg->intf;            \
+            void *ctxt = reg->ctxt;                                     \
+            if (intf->try_read##type_postfix) {                         \
+                return intf->try_read##type_postfix(addr, val, ctxt);   \
+            } else {                                                    \
+                *val = intf->read##type_postfix(addr, ctxt);            \
             }                                                           \
+            return 0;                                                   \
         }                                                               \
                                                                         \
         return 1;                                                       \
@@ -110,23 +99,22 @@ MEMORY_MAP_TRY_READ_TMPL(double, double)
 #define MEM_MAP_WRITE_TMPL(type, type_postfix)                          \
     void memory_map_write_##type_postfix(struct memory_map *map,        \
                                          uint32_t addr, type val) {     \
-        uint32_t first_addr = addr;                                     \
-        uint32_t last_addr = sizeof(type) - 1 + first_addr;             \
-                                                                        \
-        unsigned region_no;                                             \
-        for (region_no = 0; region_no < map->n_regions; region_no++) {  \
-            struct memory_map_region *reg = map->regions + region_no;   \
-            uint32_t range_mask = reg->range_mask;                      \
-            if ((first_addr & range_mask) >= reg->first_addr &&         \
-                (last_addr & range_mask) <= reg->last_addr) {           \
-                struct memory_interface const *intf = reg->intf;        \
-                void *ctxt = reg->ctxt;                                 \
+        struct memory_map_region *reg =                                 \
+            memory_map_get_region(map, addr, sizeof(type));             \
+        if (reg) {                                                      \
+            CHECK_W_WATCHPOINT(addr, type);                             \
                                                                         \
-                CHECK_W_WATCHPOINT(addr, type);                         \
-                                                                        \
-                intf->write##type_postfix(addr, val, ctxt);             \
-                return;                                                 \
+            if (reg->host_ptr) {                                        \
+                uint32_t offs = addr & reg->host_mask;                  \
+                if (!reg->host_watch ||                                 \
+                    !reg->host_watch[offs >> reg->host_watch_shift]) {  \
+                    memcpy((uint8_t*)reg->host_ptr + offs,              \
+                           &val, sizeof(val));                          \
+                    return;                                             \
+                }                                                       \
             }                                                           \
+            reg->intf->write##type_postfix(addr, val, reg->ctxt);       \
+            return;                                                     \
         }                                                               \
                                                                         \
         struct memory_interface const *unmap = map->unmap;              \
@@ -149,25 +137,17 @@ MEM_MAP_WRITE_TMPL(double, double)
 #define MEM_MAP_TRY_WRITE_TMPL(type, type_postfix)                      \
     int memory_map_try_write_##type_postfix(struct memory_map *map,     \
                                             uint32_t addr, type val) {  \
-        uint32_t first_addr = addr;                                     \
-        uint32_t last_addr = sizeof(type) - 1 + first_addr;             \
-                                                                        \
-        unsigned region_no;                                             \
-        for (region_no = 0; region_no < map->n_regions; region_no++) {  \
-            struct memory_map_region *reg = map->regions + region_no;   \
-            uint32_t range_mask = reg->range_mask;                      \
-            if ((first_addr & range_mask) >= reg->first_addr &&         \
-                (last_addr & range_mask) <= reg->last_addr) {           \
-                struct memory_interface const *intf = reg->intf;        \
-                void *ctxt = reg->ctxt;                                 \
-                if (intf->try_write##type_postfix) {                    \
-                    return intf->try_write##type_postfix(addr,          \
-                                                         val, ctxt);    \
-                } else {                                                \
-                    intf->write##type_postfix(addr, val, ctxt);         \
-                }                                                       \
-                return 0;                                               \
+        struct memory_map_region *reg =                                 \
+            memory_map_get_region(map, addr, sizeof(type));             \
+        if (reg) {                                                      \
+            struct memory_interface const *intf = reg->intf;            \
+            void *ctxt = reg->ctxt;                                     \
+            if (intf->try_write##type_postfix) {                        \
+                return intf->try_write##type_postfix(addr, val, ctxt);  \
+            } else {                                                    \
+                intf->write##type_postfix(addr, val, ctxt);             \
             }                                                           \
+            return 0;                                                   \
         }                                                               \
         return 1;                                                       \
     }                                                                   \
@@ -178,6 +158,97 @@ MEM_MAP_TRY_WRITE_TMPL(uint32_t, 32)
 MEM_MAP_TRY_WRITE_TMPL(float, float)
 MEM_MAP_TRY_WRITE_TMPL(double, double)
 
+void memory_map_read_block(struct memory_map *map, uint32_t addr,
+                           void *dst, unsigned n_bytes) {
+    if (!n_bytes)
+        return;
+
+    struct memory_map_region *reg = memory_map_get_region(map, addr, n_bytes);
+    if (reg && reg->intf->read_block) {
+        CHECK_R_WATCHPOINT_BLOCK(addr, n_bytes);
+        reg->intf->read_block(addr, dst, n_bytes, reg->ctxt);
+        return;
+    }
+
+    uint8_t *dst8 = (uint8_t*)dst;
+    if (n_bytes % 4 == 0) {
+        for (; n_bytes; n_bytes -= 4, addr += 4, dst8 += 4) {
+            uint32_t val = memory_map_read_32(map, addr);
+            memcpy(dst8, &val, sizeof(val));
+        }
+    } else if (n_bytes % 2 == 0) {
+        for (; n_bytes; n_bytes -= 2, addr += 2, dst8 += 2) {
+            uint16_t val = memory_map_read_16(map, addr);
+            memcpy(dst8, &val, sizeof(val));
+        }
+    } else {
+        for (; n_bytes; n_bytes--, addr++, dst8++)
+            *dst8 = memory_map_read_8(map, addr);
+    }
+}
+
+void memory_map_write_block(struct memory_map *map, uint32_t addr,
+                            void const *src, unsigned n_bytes) {
+    if (!n_bytes)
+        return;
+
+    struct memory_map_region *reg = memory_map_get_region(map, addr, n_bytes);
+    if (reg && reg->intf->write_block) {
+        CHECK_W_WATCHPOINT_BLOCK(addr, n_bytes);
+        reg->intf->write_block(addr, src, n_bytes, reg->ctxt);
+        return;
+    }
+
+    uint8_t const *src8 = (uint8_t const*)src;
+    if (n_bytes % 4 == 0) {
+        for (; n_bytes; n_bytes -= 4, addr += 4, src8 += 4) {
+            uint32_t val;
+            memcpy(&val, src8, sizeof(val));
+            memory_map_write_32(map, addr, val);
+        }
+    } else if (n_bytes % 2 == 0) {
+        for (; n_bytes; n_bytes -= 2, addr += 2, src8 += 2) {
+            uint16_t val;
+            memcpy(&val, src8, sizeof(val));
+            memory_map_write_16(map, addr, val);
+        }
+    } else {
+        for (; n_bytes; n_bytes--, addr++, src8++)
+            memory_map_write_8(map, addr, *src8);
+    }
+}
+
+/*
+ * update the page table after the given region has been appended to the
+ * regions array.  Regions that were added earlier take priority, so a page
+ * which is already claimed by another region is never handed to this one.
+ */
+static void
+memory_map_update_page_tbl(struct memory_map *map, unsigned region_no) {
+    struct memory_map_region const *reg = map->regions + region_no;
+    uint32_t range_mask = reg->range_mask;
+    uint32_t page_sz = 1 << MEMORY_MAP_PAGE_SHIFT;
+    unsigned page_no;
+
+    for (page_no = 0; page_no < MEMORY_MAP_N_PAGES; page_no++) {
+        uint32_t page_first = (uint32_t)page_no << MEMORY_MAP_PAGE_SHIFT;
+        uint32_t page_last = page_first + (page_sz - 1);
+
+        if ((page_last & range_mask) < reg->first_addr ||
+            (page_first & range_mask) > reg->last_addr)
+            continue; // no overlap
+
+        if (map->page_tbl[page_no] != MEMORY_MAP_PAGE_UNMAPPED)
+            continue; // already claimed (or shared) by an earlier region
+
+        if ((page_first & range_mask) >= reg->first_addr &&
+            (page_last & range_mask) <= reg->last_addr)
+            map->page_tbl[page_no] = region_no + 1;
+        else
+            map->page_tbl[page_no] = MEMORY_MAP_PAGE_MIXED;
+    }
+}
+
 void
 memory_map_add(struct memory_map *map,
                uint32_t addr_first,
@@ -186,14 +257,32 @@ memory_map_add(struct memory_map *map,
                enum memory_map_region_id id,
                struct memory_interface const *intf,
                void *ctxt) {
+    memory_map_add_host_mem(map, addr_first, addr_last, range_mask,
+                            id, intf, ctxt, NULL, 0);
+}
+
+void
+memory_map_add_host_mem(struct memory_map *map,
+                        uint32_t addr_first,
+                        uint32_t addr_last,
+                        uint32_t range_mask,
+                        enum memory_map_region_id id,
+                        struct memory_interface const *intf, void *ctxt,
+                        void *host_ptr, uint32_t host_mask) {
     if (range_mask != RANGE_MASK_NONE &&
         range_mask != RANGE_MASK_EXT)
         RAISE_ERROR(ERROR_UNIMPLEMENTED);
 
-    if (map->n_regions >= MAX_MEM_MAP_REGIONS)
+    /*
+     * MEMORY_MAP_PAGE_MIXED is reserved in the page table, so the number of
+     * regions must stay below it.
+     */
+    if (map->n_regions >= MAX_MEM_MAP_REGIONS ||
+        map->n_regions + 1 >= MEMORY_MAP_PAGE_MIXED)
         RAISE_ERROR(ERROR_OVERFLOW);
 
-    struct memory_map_region *reg = map->regions + map->n_regions++;
+    unsigned region_no = map->n_regions++;
+    struct memory_map_region *reg = map->regions + region_no;
 
     reg->first_addr = addr_first;
     reg->last_addr = addr_last;
@@ -201,4 +290,22 @@ memory_map_add(struct memory_map *map,
     reg->id = id;
     reg->intf = intf;
     reg->ctxt = ctxt;
+    reg->host_ptr = host_ptr;
+    reg->host_mask = host_mask;
+    reg->host_watch = NULL;
+    reg->host_watch_shift = 0;
+
+    memory_map_update_page_tbl(map, region_no);
+}
+
+void memory_map_watch_host_mem(struct memory_map *map, void const *host_ptr,
+                               uint8_t const *watch, unsigned watch_shift) {
+    unsigned region_no;
+    for (region_no = 0; region_no < map->n_regions; region_no++) {
+        struct memory_map_region *reg = map->regions + region_no;
+        if (reg->host_ptr && reg->host_ptr == host_ptr) {
+            reg->host_watch = watch;
+            reg->host_watch_shift = watch_shift;
+        }
+    }
 }
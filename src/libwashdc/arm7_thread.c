@@ -0,0 +1,517 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "washdc/error.h"
+#include "log.h"
+#include "atomics.h"
+#include "threading.h"
+#include "dc_sched.h"
+#include "hw/aica/aica.h"
+#include "hw/aica/aica_wave_mem.h"
+#include "hw/sys/holly_intc.h"
+
+#include "arm7_thread.h"
+
+enum arm7_thread_msg_tp {
+    // SH4 to ARM7
+    ARM7_THREAD_MSG_WRITE_8,
+    ARM7_THREAD_MSG_WRITE_16,
+    ARM7_THREAD_MSG_WRITE_32,
+    ARM7_THREAD_MSG_WAVE_WRITTEN, // val is the length
+
+    // ARM7 to SH4
+    ARM7_THREAD_MSG_RAISE_INT,
+    ARM7_THREAD_MSG_CLEAR_INT
+};
+
+struct arm7_thread_msg {
+    enum arm7_thread_msg_tp tp;
+    addr32_t addr;
+    uint32_t val;
+};
+
+#define ARM7_THREAD_QUEUE_LEN 4096
+
+/*
+ * single-producer, single-consumer ring buffer.  One slot is always left empty
+ * so that head == tail can only mean the queue is empty.
+ */
+struct arm7_thread_queue {
+    washdc_atomic_int head; // next message the consumer will read
+    washdc_atomic_int tail; // next slot the producer will write
+    struct arm7_thread_msg msgs[ARM7_THREAD_QUEUE_LEN];
+};
+
+/*
+ * to_arm7 is produced by the SH4 thread and consumed by whoever holds
+ * aica_lock.  to_sh4 is produced by whoever holds aica_lock and consumed by
+ * the SH4 thread.
+ */
+static struct arm7_thread_queue to_arm7, to_sh4;
+
+static struct aica *aica;
+static struct dc_clock *arm7_clk, *sh4_clk;
+static dc_cycle_stamp_t skew_cycles;
+
+static washdc_thread arm7_td;
+static washdc_mutex aica_lock = WASHDC_MUTEX_STATIC_INIT;
+
+/*
+ * the cycle stamps are only ever written by their own thread.  stamp_lock and
+ * stamp_cond are only used to go to sleep when one side gets too far ahead.
+ */
+static washdc_atomic_u64 sh4_stamp, arm7_stamp;
+static washdc_atomic_int exit_flag;
+static washdc_mutex stamp_lock = WASHDC_MUTEX_STATIC_INIT;
+static washdc_cvar stamp_cond = WASHDC_CVAR_STATIC_INIT;
+
+/*
+ * range of wave memory the SH4 has written to which the ARM7 thread hasn't
+ * been told about yet.  Only touched by the SH4 thread.
+ */
+static bool wave_dirty;
+static addr32_t wave_dirty_first, wave_dirty_end;
+
+static void arm7_thread_main(void *argp);
+
+static void arm7_thread_sh4_int(bool raise);
+static void arm7_thread_drain(void);
+static void arm7_thread_drain_sh4(void);
+static void arm7_thread_flush_wave(void);
+
+static void arm7_thread_queue_init(struct arm7_thread_queue *queue) {
+    washdc_atomic_int_init(&queue->head, 0);
+    washdc_atomic_int_init(&queue->tail, 0);
+}
+
+static bool
+arm7_thread_queue_push(struct arm7_thread_queue *queue,
+                       struct arm7_thread_msg const *msg) {
+    int tail = washdc_atomic_int_load(&queue->tail);
+    int next = (tail + 1) % ARM7_THREAD_QUEUE_LEN;
+    if (next == washdc_atomic_int_load(&queue->head))
+        return false; // full
+
+    queue->msgs[tail] = *msg;
+    washdc_atomic_int_store(&queue->tail, next);
+    return true;
+}
+
+static bool
+arm7_thread_queue_pop(struct arm7_thread_queue *queue,
+                      struct arm7_thread_msg *msg) {
+    int head = washdc_atomic_int_load(&queue->head);
+    if (head == washdc_atomic_int_load(&queue->tail))
+        return false; // empty
+
+    *msg = queue->msgs[head];
+    washdc_atomic_int_store(&queue->head, (head + 1) % ARM7_THREAD_QUEUE_LEN);
+    return true;
+}
+
+void arm7_thread_init(struct aica *aica_in, struct dc_clock *arm7_clk_in,
+                      struct dc_clock *sh4_clk_in, unsigned skew) {
+    aica = aica_in;
+    arm7_clk = arm7_clk_in;
+    sh4_clk = sh4_clk_in;
+
+    if (!skew)
+        skew = 1;
+    skew_cycles = (dc_cycle_stamp_t)skew * DC_TIMESLICE;
+
+    arm7_thread_queue_init(&to_arm7);
+    arm7_thread_queue_init(&to_sh4);
+    wave_dirty = false;
+
+    aica->sh4_int_hook = arm7_thread_sh4_int;
+}
+
+void arm7_thread_cleanup(void) {
+    aica->sh4_int_hook = NULL;
+    aica = NULL;
+    arm7_clk = NULL;
+    sh4_clk = NULL;
+}
+
+void arm7_thread_start(void) {
+    washdc_atomic_u64_init(&sh4_stamp, clock_cycle_stamp(sh4_clk));
+    washdc_atomic_u64_init(&arm7_stamp, clock_cycle_stamp(arm7_clk));
+    washdc_atomic_int_init(&exit_flag, 0);
+
+    LOG_INFO("%s - launching ARM7 thread (skew is %u cycles)\n",
+             __func__, (unsigned)skew_cycles);
+    washdc_thread_create(&arm7_td, arm7_thread_main, NULL);
+}
+
+void arm7_thread_stop(void) {
+    washdc_atomic_int_store(&exit_flag, 1);
+    washdc_mutex_lock(&stamp_lock);
+    washdc_cvar_signal(&stamp_cond);
+    washdc_mutex_unlock(&stamp_lock);
+
+    washdc_thread_join(&arm7_td);
+
+    // apply anything that was left over so both sides are consistent.
+    arm7_thread_flush_wave();
+    arm7_thread_drain();
+    arm7_thread_drain_sh4();
+}
+
+static void arm7_thread_publish(washdc_atomic_u64 *stamp,
+                                dc_cycle_stamp_t val) {
+    washdc_atomic_u64_store(stamp, val);
+    washdc_mutex_lock(&stamp_lock);
+    washdc_cvar_signal(&stamp_cond);
+    washdc_mutex_unlock(&stamp_lock);
+}
+
+/*
+ * wait until own is less than skew_cycles ahead of the other side's stamp.
+ * Returns false if the thread was told to exit while waiting.
+ *
+ * There's no way for both threads to be waiting at the same time since only
+ * one of them can be ahead of the other.
+ */
+static bool arm7_thread_wait(dc_cycle_stamp_t own, washdc_atomic_u64 *other) {
+    if (own < washdc_atomic_u64_load(other) + skew_cycles)
+        return true;
+
+    washdc_mutex_lock(&stamp_lock);
+    while (own >= washdc_atomic_u64_load(other) + skew_cycles &&
+           !washdc_atomic_int_load(&exit_flag))
+        washdc_cvar_wait(&stamp_cond, &stamp_lock);
+    washdc_mutex_unlock(&stamp_lock);
+
+    return !washdc_atomic_int_load(&exit_flag);
+}
+
+// only call this while holding aica_lock
+static void arm7_thread_drain(void) {
+    struct arm7_thread_msg msg;
+    while (arm7_thread_queue_pop(&to_arm7, &msg)) {
+        switch (msg.tp) {
+        case ARM7_THREAD_MSG_WRITE_8:
+            aica_sys_intf.write8(msg.addr, msg.val, aica);
+            break;
+        case ARM7_THREAD_MSG_WRITE_16:
+            aica_sys_intf.write16(msg.addr, msg.val, aica);
+            break;
+        case ARM7_THREAD_MSG_WRITE_32:
+            aica_sys_intf.write32(msg.addr, msg.val, aica);
+            break;
+        case ARM7_THREAD_MSG_WAVE_WRITTEN:
+            aica_wave_mem_invalidate(&aica->mem, msg.addr, msg.val);
+            break;
+        default:
+            RAISE_ERROR(ERROR_INTEGRITY);
+        }
+    }
+}
+
+static void arm7_thread_main(void *argp) {
+    for (;;) {
+        if (!arm7_thread_wait(clock_cycle_stamp(arm7_clk), &sh4_stamp))
+            break;
+
+        washdc_mutex_lock(&aica_lock);
+        arm7_thread_drain();
+        dc_clock_run_timeslice(arm7_clk);
+        washdc_mutex_unlock(&aica_lock);
+
+        arm7_thread_publish(&arm7_stamp, clock_cycle_stamp(arm7_clk));
+    }
+}
+
+// SH4 thread only
+static void arm7_thread_push(struct arm7_thread_msg const *msg) {
+    if (!arm7_thread_queue_push(&to_arm7, msg)) {
+        /*
+         * the ARM7 thread has fallen behind, so apply everything that's
+         * queued up ourselves to make room.
+         */
+        washdc_mutex_lock(&aica_lock);
+        arm7_thread_drain();
+        washdc_mutex_unlock(&aica_lock);
+
+        if (!arm7_thread_queue_push(&to_arm7, msg))
+            RAISE_ERROR(ERROR_INTEGRITY);
+    }
+}
+
+// SH4 thread only
+static void arm7_thread_flush_wave(void) {
+    if (wave_dirty) {
+        struct arm7_thread_msg msg = {
+            .tp = ARM7_THREAD_MSG_WAVE_WRITTEN,
+            .addr = wave_dirty_first,
+            .val = wave_dirty_end - wave_dirty_first
+        };
+        wave_dirty = false;
+        arm7_thread_push(&msg);
+    }
+}
+
+/*
+ * SH4 thread only.  Sequential writes (which is what most uploads to wave
+ * memory look like) get merged into a single message.
+ */
+static void arm7_thread_wave_written(addr32_t addr, unsigned len) {
+    if (wave_dirty) {
+        if (addr == wave_dirty_end) {
+            wave_dirty_end += len;
+            return;
+        } else if (addr >= wave_dirty_first && addr + len <= wave_dirty_end) {
+            return;
+        }
+        arm7_thread_flush_wave();
+    }
+    wave_dirty = true;
+    wave_dirty_first = addr;
+    wave_dirty_end = addr + len;
+}
+
+// called by whoever holds aica_lock
+static void arm7_thread_sh4_int(bool raise) {
+    struct arm7_thread_msg msg = {
+        .tp = raise ? ARM7_THREAD_MSG_RAISE_INT : ARM7_THREAD_MSG_CLEAR_INT
+    };
+
+    /*
+     * the SH4 empties this every timeslice and the ARM7 can't get more than
+     * skew timeslices ahead, so this can only fill up if something is badly
+     * wrong.
+     */
+    if (!arm7_thread_queue_push(&to_sh4, &msg))
+        RAISE_ERROR(ERROR_OVERFLOW);
+}
+
+// SH4 thread only
+static void arm7_thread_drain_sh4(void) {
+    struct arm7_thread_msg msg;
+    while (arm7_thread_queue_pop(&to_sh4, &msg)) {
+        if (msg.tp == ARM7_THREAD_MSG_RAISE_INT)
+            holly_raise_ext_int(HOLLY_EXT_INT_AICA);
+        else
+            holly_clear_ext_int(HOLLY_EXT_INT_AICA);
+    }
+}
+
+void arm7_thread_sh4_sync(void) {
+    arm7_thread_flush_wave();
+    arm7_thread_drain_sh4();
+
+    arm7_thread_publish(&sh4_stamp, clock_cycle_stamp(sh4_clk));
+    arm7_thread_wait(clock_cycle_stamp(sh4_clk), &arm7_stamp);
+}
+
+/*
+ * AICA register accesses from the SH4.  Writes get queued up for the ARM7
+ * thread; everything else has to be done right away, so it takes the lock and
+ * brings the AICA up to date first.
+ */
+
+static void arm7_thread_aica_sys_write_8(addr32_t addr, uint8_t val,
+                                         void *ctxt) {
+    struct arm7_thread_msg msg = {
+        .tp = ARM7_THREAD_MSG_WRITE_8, .addr = addr, .val = val
+    };
+    arm7_thread_flush_wave();
+    arm7_thread_push(&msg);
+}
+
+static void arm7_thread_aica_sys_write_16(addr32_t addr, uint16_t val,
+                                          void *ctxt) {
+    struct arm7_thread_msg msg = {
+        .tp = ARM7_THREAD_MSG_WRITE_16, .addr = addr, .val = val
+    };
+    arm7_thread_flush_wave();
+    arm7_thread_push(&msg);
+}
+
+static void arm7_thread_aica_sys_write_32(addr32_t addr, uint32_t val,
+                                          void *ctxt) {
+    struct arm7_thread_msg msg = {
+        .tp = ARM7_THREAD_MSG_WRITE_32, .addr = addr, .val = val
+    };
+    arm7_thread_flush_wave();
+    arm7_thread_push(&msg);
+}
+
+static void arm7_thread_aica_sys_write_float(addr32_t addr, float val,
+                                             void *ctxt) {
+    arm7_thread_flush_wave();
+    washdc_mutex_lock(&aica_lock);
+    arm7_thread_drain();
+    aica_sys_intf.writefloat(addr, val, ctxt);
+    washdc_mutex_unlock(&aica_lock);
+}
+
+static void arm7_thread_aica_sys_write_double(addr32_t addr, double val,
+                                              void *ctxt) {
+    arm7_thread_flush_wave();
+    washdc_mutex_lock(&aica_lock);
+    arm7_thread_drain();
+    aica_sys_intf.writedouble(addr, val, ctxt);
+    washdc_mutex_unlock(&aica_lock);
+}
+
+static uint8_t arm7_thread_aica_sys_read_8(addr32_t addr, void *ctxt) {
+    uint8_t val;
+    washdc_mutex_lock(&aica_lock);
+    arm7_thread_drain();
+    val = aica_sys_intf.read8(addr, ctxt);
+    washdc_mutex_unlock(&aica_lock);
+    return val;
+}
+
+static uint16_t arm7_thread_aica_sys_read_16(addr32_t addr, void *ctxt) {
+    uint16_t val;
+    washdc_mutex_lock(&aica_lock);
+    arm7_thread_drain();
+    val = aica_sys_intf.read16(addr, ctxt);
+    washdc_mutex_unlock(&aica_lock);
+    return val;
+}
+
+static uint32_t arm7_thread_aica_sys_read_32(addr32_t addr, void *ctxt) {
+    uint32_t val;
+    washdc_mutex_lock(&aica_lock);
+    arm7_thread_drain();
+    val = aica_sys_intf.read32(addr, ctxt);
+    washdc_mutex_unlock(&aica_lock);
+    return val;
+}
+
+static float arm7_thread_aica_sys_read_float(addr32_t addr, void *ctxt) {
+    float val;
+    washdc_mutex_lock(&aica_lock);
+    arm7_thread_drain();
+    val = aica_sys_intf.readfloat(addr, ctxt);
+    washdc_mutex_unlock(&aica_lock);
+    return val;
+}
+
+static double arm7_thread_aica_sys_read_double(addr32_t addr, void *ctxt) {
+    double val;
+    washdc_mutex_lock(&aica_lock);
+    arm7_thread_drain();
+    val = aica_sys_intf.readdouble(addr, ctxt);
+    washdc_mutex_unlock(&aica_lock);
+    return val;
+}
+
+struct memory_interface arm7_thread_aica_sys_intf = {
+    .read32 = arm7_thread_aica_sys_read_32,
+    .read16 = arm7_thread_aica_sys_read_16,
+    .read8 = arm7_thread_aica_sys_read_8,
+    .readfloat = arm7_thread_aica_sys_read_float,
+    .readdouble = arm7_thread_aica_sys_read_double,
+
+    .write32 = arm7_thread_aica_sys_write_32,
+    .write16 = arm7_thread_aica_sys_write_16,
+    .write8 = arm7_thread_aica_sys_write_8,
+    .writefloat = arm7_thread_aica_sys_write_float,
+    .writedouble = arm7_thread_aica_sys_write_double
+};
+
+/*
+ * wave memory writes from the SH4.  Reads don't need anything special so they
+ * go straight to the aica_wave_mem functions.
+ */
+
+static void arm7_thread_wave_write(addr32_t addr, void const *val,
+                                   unsigned len, void *ctxt) {
+    struct aica_wave_mem *wm = (struct aica_wave_mem*)ctxt;
+    addr &= ADDR_AICA_WAVE_MASK;
+
+    if ((len - 1 + addr) >= AICA_WAVE_MEM_LEN) {
+        error_set_feature("out-of-bounds AICA memory access");
+        error_set_address(addr);
+        error_set_length(len);
+        RAISE_ERROR(ERROR_UNIMPLEMENTED);
+    }
+
+    memcpy(wm->mem + addr, val, len);
+    arm7_thread_wave_written(addr, len);
+}
+
+static void arm7_thread_wave_write_8(addr32_t addr, uint8_t val, void *ctxt) {
+    arm7_thread_wave_write(addr, &val, sizeof(val), ctxt);
+}
+
+static void arm7_thread_wave_write_16(addr32_t addr, uint16_t val,
+                                      void *ctxt) {
+    arm7_thread_wave_write(addr, &val, sizeof(val), ctxt);
+}
+
+static void arm7_thread_wave_write_32(addr32_t addr, uint32_t val,
+                                      void *ctxt) {
+    arm7_thread_wave_write(addr, &val, sizeof(val), ctxt);
+}
+
+static void arm7_thread_wave_write_float(addr32_t addr, float val,
+                                         void *ctxt) {
+    arm7_thread_wave_write(addr, &val, sizeof(val), ctxt);
+}
+
+static void arm7_thread_wave_write_double(addr32_t addr, double val,
+                                          void *ctxt) {
+    arm7_thread_wave_write(addr, &val, sizeof(val), ctxt);
+}
+
+static void arm7_thread_wave_write_block(addr32_t addr, void const *src,
+                                         unsigned n_bytes, void *ctxt) {
+    uint8_t const *src8 = (uint8_t const*)src;
+
+    addr &= ADDR_AICA_WAVE_MASK;
+    while (n_bytes) {
+        unsigned chunk = AICA_WAVE_MEM_LEN - addr;
+        if (chunk > n_bytes)
+            chunk = n_bytes;
+        arm7_thread_wave_write(addr, src8, chunk, ctxt);
+        src8 += chunk;
+        n_bytes -= chunk;
+        addr = 0;
+    }
+}
+
+struct memory_interface arm7_thread_aica_wave_intf = {
+    .read32 = aica_wave_mem_read_32,
+    .read16 = aica_wave_mem_read_16,
+    .read8 = aica_wave_mem_read_8,
+    .readfloat = aica_wave_mem_read_float,
+    .readdouble = aica_wave_mem_read_double,
+
+    .write32 = arm7_thread_wave_write_32,
+    .write16 = arm7_thread_wave_write_16,
+    .write8 = arm7_thread_wave_write_8,
+    .writefloat = arm7_thread_wave_write_float,
+    .writedouble = arm7_thread_wave_write_double,
+
+    .read_block = aica_wave_mem_read_block,
+    .write_block = arm7_thread_wave_write_block
+};
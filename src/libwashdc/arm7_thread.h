@@ -0,0 +1,81 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#ifndef ARM7_THREAD_H_
+#define ARM7_THREAD_H_
+
+#include "washdc/MemoryMap.h"
+#include "dc_sched.h"
+
+/*
+ * Optional mode where the ARM7 and the rest of the AICA run on their own host
+ * thread instead of taking turns with the SH4 in run_one_frame.
+ *
+ * The two threads each run whole timeslices on their own dc_clock and
+ * publish their cycle stamps when a timeslice ends.  Neither side is allowed
+ * to start a timeslice if it's already skew timeslices ahead of the other
+ * side, so the two clocks never drift apart by more than that.
+ *
+ * Everything on the AICA side of things is owned by whoever holds the AICA
+ * lock, which is normally the ARM7 thread for the duration of one timeslice.
+ * Communication in both directions goes through lock-free single-producer,
+ * single-consumer queues:
+ *
+ * - writes from the SH4 to AICA registers get queued up and applied by the
+ *   ARM7 thread at the start of its next timeslice.
+ * - interrupts from the AICA to holly get queued up and applied by the SH4
+ *   thread at the start of its next timeslice.
+ *
+ * Reads of AICA registers from the SH4 can't wait that long, so those take the
+ * AICA lock and apply anything still in the queue before doing the read.
+ * Wave memory is shared by both threads the same way it is on real hardware.
+ * The SH4 writes to it directly, and the ARM7's predecoded instructions and
+ * JIT pages covering what it wrote get invalidated through the queue.
+ */
+
+struct aica;
+
+void arm7_thread_init(struct aica *aica, struct dc_clock *arm7_clk,
+                      struct dc_clock *sh4_clk, unsigned skew);
+void arm7_thread_cleanup(void);
+
+// these are called from the SH4 thread around main_loop_sched
+void arm7_thread_start(void);
+void arm7_thread_stop(void);
+
+/*
+ * call this from the SH4 thread before every SH4 timeslice.  This applies
+ * anything the ARM7 thread has sent to the SH4, publishes the SH4's cycle
+ * stamp and waits for the ARM7 thread if the SH4 is too far ahead.
+ */
+void arm7_thread_sh4_sync(void);
+
+/*
+ * These go in the SH4's memory map in place of aica_sys_intf and
+ * aica_wave_mem_intf.  They take the same contexts as the interfaces they're
+ * replacing.
+ */
+extern struct memory_interface arm7_thread_aica_sys_intf;
+extern struct memory_interface arm7_thread_aica_wave_intf;
+
+#endif
@@ -85,6 +85,21 @@ CONFIG_DEF_BOOL(jit, false);
 CONFIG_DEF_BOOL(native_jit, false);
 #endif
 
+CONFIG_DEF_INT(jit_cache_budget_mb, 0);
+CONFIG_DEF_INT(jit_tier_threshold, 0);
+CONFIG_DEF_BOOL(jit_superblocks, false);
+CONFIG_DEF_BOOL(jit_arm7, false);
+
+CONFIG_DEF_INT(jit_perf, 0);
+
+CONFIG_DEF_BOOL(jit_block_prof, false);
+CONFIG_DEF_BOOL(jit_pin_regs, false);
+
+CONFIG_DEF_BOOL(idle_skip, true);
+
+CONFIG_DEF_BOOL(arm7_thread, false);
+CONFIG_DEF_INT(arm7_skew, 1);
+
 CONFIG_DEF_BOOL(inline_mem, true);
 
 CONFIG_DEF_BOOL(log_verbose, false);
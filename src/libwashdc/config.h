@@ -89,6 +89,63 @@ CONFIG_DECL_BOOL(jit);
 CONFIG_DECL_BOOL(native_jit);
 #endif
 
+/*
+ * how much memory (in megabytes) the jit's code cache may use before it starts
+ * evicting blocks.  If this is zero then a default is used.
+ */
+CONFIG_DECL_INT(jit_cache_budget_mb);
+
+/*
+ * how many times a block runs in the IL interpreter before the native jit's
+ * compile thread compiles it to native code.  If this is zero (the default)
+ * then blocks get compiled to native code right away on the emulation thread.
+ */
+CONFIG_DECL_INT(jit_tier_threshold);
+
+/*
+ * if this is set (default is false) then the native jit keeps compiling past
+ * conditional branches, turning them into side exits from the block.
+ */
+CONFIG_DECL_BOOL(jit_superblocks);
+
+/*
+ * if this is set (default is false) then the AICA's ARM7 runs through its own
+ * JIT instead of the interpreter.
+ */
+CONFIG_DECL_BOOL(jit_arm7);
+
+/*
+ * host profiler output for native jit code: 0 for none, 1 for a
+ * /tmp/perf-<pid>.map file, 2 for a jitdump file.
+ */
+CONFIG_DECL_INT(jit_perf);
+
+/*
+ * if true, the jit keeps per-block hit counts and host timing, and writes them
+ * to sh4_block_prof.csv when it shuts down.
+ */
+CONFIG_DECL_BOOL(jit_block_prof);
+
+/*
+ * if true, the x86_64 jit keeps a few of the SH4's general-purpose registers
+ * in host registers for as long as native code is running.
+ */
+CONFIG_DECL_BOOL(jit_pin_regs);
+
+/*
+ * if this is set (default is true) then the SH4 skips ahead to its next event
+ * when it's spinning in an idle loop (see hw/sh4/sh4_idle.h).
+ */
+CONFIG_DECL_BOOL(idle_skip);
+
+/*
+ * if this is set (default is false) then the ARM7 and AICA run on their own
+ * host thread (see arm7_thread.h).  arm7_skew is how many timeslices either
+ * side is allowed to get ahead of the other.
+ */
+CONFIG_DECL_BOOL(arm7_thread);
+CONFIG_DECL_INT(arm7_skew);
+
 /*
  * if this is set (default is true) then the jit's x86_64 backend will
  * inline memory accesses.
@@ -31,6 +31,7 @@
 
 static DEF_ERROR_U64_ATTR(current_dc_cycle_stamp)
 static DEF_ERROR_U64_ATTR(event_sched_dc_cycle_stamp)
+static DEF_ERROR_INT_ATTR(max_length)
 
 void dc_clock_init(struct dc_clock *clk) {
     memset(clk, 0, sizeof(*clk));
@@ -38,6 +39,11 @@ void dc_clock_init(struct dc_clock *clk) {
 }
 
 void dc_clock_cleanup(struct dc_clock *clk) {
+    // orphan any events that are still pending so they can be scheduled again
+    unsigned idx;
+    for (idx = 0; idx < clk->ev_count_priv; idx++)
+        clk->ev_heap_priv[idx]->heap_idx_priv = 0;
+    clk->ev_count_priv = 0;
 }
 
 static void update_target_stamp(struct dc_clock *clock) {
@@ -45,8 +51,8 @@ static void update_target_stamp(struct dc_clock *clock) {
         clock->ptrs_priv[WASHDC_CLOCK_IDX_TARGET] -
         clock->ptrs_priv[WASHDC_CLOCK_IDX_COUNTDOWN];
 
-    if (clock->ev_next_priv) {
-        clock->ptrs_priv[WASHDC_CLOCK_IDX_TARGET] = clock->ev_next_priv->when;
+    if (clock->ev_count_priv) {
+        clock->ptrs_priv[WASHDC_CLOCK_IDX_TARGET] = clock->ev_heap_priv[0]->when;
     } else {
         /*
          * Somehow there are no events scheduled.
@@ -71,6 +77,72 @@ static void update_target_stamp(struct dc_clock *clock) {
         clock->ptrs_priv[WASHDC_CLOCK_IDX_STAMP];
 }
 
+/*
+ * returns true if ev_a needs to execute before ev_b.  Among events which are
+ * scheduled for the same cycle, the most recently-scheduled one wins.
+ */
+static inline bool event_before(struct SchedEvent const *ev_a,
+                                struct SchedEvent const *ev_b) {
+    return ev_a->when < ev_b->when ||
+        (ev_a->when == ev_b->when && ev_a->seq_priv > ev_b->seq_priv);
+}
+
+static inline void heap_put(struct dc_clock *clock, unsigned idx,
+                            struct SchedEvent *event) {
+    clock->ev_heap_priv[idx] = event;
+    event->heap_idx_priv = idx + 1;
+}
+
+static void heap_sift_up(struct dc_clock *clock, unsigned idx) {
+    struct SchedEvent *event = clock->ev_heap_priv[idx];
+    while (idx) {
+        unsigned parent = (idx - 1) / 2;
+        struct SchedEvent *parent_ev = clock->ev_heap_priv[parent];
+        if (!event_before(event, parent_ev))
+            break;
+        heap_put(clock, idx, parent_ev);
+        idx = parent;
+    }
+    heap_put(clock, idx, event);
+}
+
+static void heap_sift_down(struct dc_clock *clock, unsigned idx) {
+    struct SchedEvent *event = clock->ev_heap_priv[idx];
+    unsigned count = clock->ev_count_priv;
+    for (;;) {
+        unsigned child = 2 * idx + 1;
+        if (child >= count)
+            break;
+        if (child + 1 < count &&
+            event_before(clock->ev_heap_priv[child + 1],
+                         clock->ev_heap_priv[child]))
+            child++;
+        if (!event_before(clock->ev_heap_priv[child], event))
+            break;
+        heap_put(clock, idx, clock->ev_heap_priv[child]);
+        idx = child;
+    }
+    heap_put(clock, idx, event);
+}
+
+// remove the event at the given index from the heap
+static void heap_remove(struct dc_clock *clock, unsigned idx) {
+    struct SchedEvent *event = clock->ev_heap_priv[idx];
+    unsigned last = --clock->ev_count_priv;
+
+    if (idx != last) {
+        struct SchedEvent *last_ev = clock->ev_heap_priv[last];
+        heap_put(clock, idx, last_ev);
+        if (idx && event_before(last_ev, clock->ev_heap_priv[(idx - 1) / 2]))
+            heap_sift_up(clock, idx);
+        else
+            heap_sift_down(clock, idx);
+    }
+    clock->ev_heap_priv[last] = NULL;
+
+    event->heap_idx_priv = 0;
+}
+
 void sched_event(struct dc_clock *clock, struct SchedEvent *event) {
 #ifdef INVARIANTS
     /*
@@ -83,19 +155,21 @@ void sched_event(struct dc_clock *clock, struct SchedEvent *event) {
         error_set_event_sched_dc_cycle_stamp(event->when);
         RAISE_ERROR(ERROR_INTEGRITY);
     }
+
+    if (event_is_scheduled(event))
+        RAISE_ERROR(ERROR_INTEGRITY);
 #endif
 
-    struct SchedEvent *next_ptr = clock->ev_next_priv;
-    struct SchedEvent **pprev_ptr = &clock->ev_next_priv;
-    while (next_ptr && next_ptr->when < event->when) {
-        pprev_ptr = &next_ptr->next_event;
-        next_ptr = next_ptr->next_event;
+    if (clock->ev_count_priv >= DC_SCHED_MAX_EVENTS) {
+        error_set_max_length(DC_SCHED_MAX_EVENTS);
+        RAISE_ERROR(ERROR_OVERFLOW);
     }
-    *pprev_ptr = event;
-    if (next_ptr)
-        next_ptr->pprev_event = &event->next_event;
-    event->next_event = next_ptr;
-    event->pprev_event = pprev_ptr;
+
+    event->seq_priv = clock->ev_seq_priv++;
+    clock->ev_heap_priv[clock->ev_count_priv++] = event;
+    heap_sift_up(clock, clock->ev_count_priv - 1);
+
+    clock->n_sched++;
 
     update_target_stamp(clock);
 }
@@ -112,21 +186,22 @@ void cancel_event(struct dc_clock *clock, struct SchedEvent *event) {
         error_set_event_sched_dc_cycle_stamp(event->when);
         RAISE_ERROR(ERROR_INTEGRITY);
     }
+
+    if (!event_is_scheduled(event) ||
+        clock->ev_heap_priv[event->heap_idx_priv - 1] != event)
+        RAISE_ERROR(ERROR_INTEGRITY);
 #endif
 
-    if (event->next_event)
-        event->next_event->pprev_event = event->pprev_event;
-    *event->pprev_event = event->next_event;
+    heap_remove(clock, event->heap_idx_priv - 1);
 
-    // XXX this is unnecessary, but I'm trying to be extra-safe here
-    event->next_event = NULL;
-    event->pprev_event = NULL;
+    clock->n_cancel++;
 
     update_target_stamp(clock);
 }
 
 struct SchedEvent *pop_event(struct dc_clock *clock) {
-    struct SchedEvent *ev_ret = clock->ev_next_priv;
+    struct SchedEvent *ev_ret =
+        clock->ev_count_priv ? clock->ev_heap_priv[0] : NULL;
 
 #ifdef INVARIANTS
     /*
@@ -141,16 +216,9 @@ struct SchedEvent *pop_event(struct dc_clock *clock) {
     }
 #endif
 
-    if (clock->ev_next_priv) {
-        clock->ev_next_priv = clock->ev_next_priv->next_event;
-        if (clock->ev_next_priv)
-            clock->ev_next_priv->pprev_event = &clock->ev_next_priv;
-    }
-
-    // XXX this is unnecessary, but I'm trying to be extra-safe here
     if (ev_ret) {
-        ev_ret->next_event = NULL;
-        ev_ret->pprev_event = NULL;
+        heap_remove(clock, 0);
+        clock->n_pop++;
     }
 
     update_target_stamp(clock);
@@ -159,7 +227,7 @@ struct SchedEvent *pop_event(struct dc_clock *clock) {
 }
 
 struct SchedEvent *peek_event(struct dc_clock *clock) {
-    return clock->ev_next_priv;
+    return clock->ev_count_priv ? clock->ev_heap_priv[0] : NULL;
 }
 
 dc_cycle_stamp_t clock_target_stamp(struct dc_clock *clock) {
@@ -34,7 +34,16 @@
 
 #define DC_TIMESLICE (SCHED_FREQUENCY / 400)
 
-// simple priority-queue scheduler
+/*
+ * simple priority-queue scheduler.
+ *
+ * The queue is a binary min-heap of pointers to SchedEvents, so scheduling,
+ * canceling and popping an event are all O(log n) in the number of pending
+ * events.  The heap storage lives inside of struct dc_clock, so its capacity
+ * is fixed at compile-time.  There are only a few dozen SchedEvents in the
+ * entire system, so DC_SCHED_MAX_EVENTS is very generous.
+ */
+#define DC_SCHED_MAX_EVENTS 128
 
 typedef uint64_t dc_cycle_stamp_t;
 
@@ -49,9 +58,19 @@ struct SchedEvent {
 
     void *arg_ptr;
 
-    // linked list, only the scheduler gets to touch these
-    struct SchedEvent **pprev_event;
-    struct SchedEvent *next_event;
+    /*
+     * heap bookkeeping, only the scheduler gets to touch these.
+     *
+     * heap_idx_priv is the event's position in the heap plus one, so that
+     * zero (the default for statically-initialized events) means the event
+     * is not currently scheduled.
+     *
+     * seq_priv breaks ties between events which are scheduled for the same
+     * cycle.  The most recently-scheduled event runs first; this mimics the
+     * ordering of the linked-list that the heap replaced.
+     */
+    unsigned heap_idx_priv;
+    uint64_t seq_priv;
 };
 
 enum washdc_clock_idx {
@@ -83,8 +102,16 @@ struct dc_clock {
     dc_cycle_stamp_t priv[WASHDC_CLOCK_IDX_COUNT];
     dc_cycle_stamp_t *ptrs_priv;
 
-    // the next scheduled event
-    struct SchedEvent *ev_next_priv;
+    // binary min-heap of scheduled events, ev_heap_priv[0] is the next event
+    struct SchedEvent *ev_heap_priv[DC_SCHED_MAX_EVENTS];
+    unsigned ev_count_priv;
+    uint64_t ev_seq_priv;
+
+    /*
+     * event churn statistics.  These are printed along with the other
+     * performance statistics when WashingtonDC exits.
+     */
+    uint64_t n_sched, n_cancel, n_pop;
 };
 
 void dc_clock_init(struct dc_clock *clk);
@@ -101,6 +128,10 @@ void cancel_event(struct dc_clock *clock, struct SchedEvent *event);
 struct SchedEvent *pop_event(struct dc_clock *clock);
 struct SchedEvent *peek_event(struct dc_clock *clock);
 
+static inline bool event_is_scheduled(struct SchedEvent const *event) {
+    return event->heap_idx_priv != 0;
+}
+
 /*
  * This represents the timestamp of the next event.
  * It can change whenever an event is scheduled, canceled, or popped.
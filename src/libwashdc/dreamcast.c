@@ -73,8 +73,10 @@
 #include "jit/jit_intp/code_block_intp.h"
 #include "jit/code_cache.h"
 #include "jit/jit.h"
+#include "jit/jit_block_prof.h"
 #include "hw/boot_rom.h"
 #include "hw/arm7/arm7.h"
+#include "hw/arm7/arm7_jit.h"
 #include "title.h"
 #include "mount.h"
 #include "gdi.h"
@@ -87,6 +89,7 @@
 #include "hw/sys/holly_intc.h"
 #include "load_elf.h"
 #include "trace_proxy.h"
+#include "arm7_thread.h"
 
 #ifdef DEEP_SYSCALL_TRACE
 #include "deep_syscall_trace.h"
@@ -100,6 +103,11 @@
 #include "jit/x86_64/native_dispatch.h"
 #include "jit/x86_64/native_mem.h"
 #include "jit/x86_64/exec_mem.h"
+#include "jit/x86_64/compile_thread.h"
+#include "jit/x86_64/jit_perf.h"
+#ifdef ENABLE_FASTMEM
+#include "jit/x86_64/fastmem.h"
+#endif
 #endif
 
 #include "dreamcast.h"
@@ -127,6 +135,9 @@ static bool end_of_frame;
 
 static bool using_debugger;
 
+// if true, the ARM7 runs on its own thread (see arm7_thread.h)
+static bool arm7_threaded;
+
 static washdc_real_time last_frame_realtime;
 static dc_cycle_stamp_t last_frame_virttime;
 
@@ -171,6 +182,8 @@ static bool run_to_next_sh4_event_jit(void *ctxt);
 
 static bool run_to_next_arm7_event(void *ctxt);
 
+static bool run_to_next_arm7_event_jit(void *ctxt);
+
 static int lmmode0, lmmode1;
 
 static double dc_framerate, dc_virt_framerate;
@@ -206,7 +219,7 @@ void washdc_dump_main_memory(char const *path) {
     // TODO: use washdc_hostfile instead of FILE
     FILE *outfile = fopen(path, "wb");
     if (outfile) {
-        fwrite(dc_mem.mem, sizeof(dc_mem.mem), 1, outfile);
+        fwrite(dc_mem.mem, sizeof(dc_mem.mem[0]) * MEMORY_SIZE, 1, outfile);
         fclose(outfile);
     }
 }
@@ -220,6 +233,10 @@ void washdc_dump_aica_memory(char const *path) {
     }
 }
 
+void washdc_dump_jit_profile(char const *path) {
+    jit_block_prof_dump(path);
+}
+
 static uint32_t on_pdtra_read(struct Sh4*);
 static void on_pdtra_write(struct Sh4*, uint32_t);
 
@@ -761,8 +778,14 @@ dreamcast_init(char const *gdi_path,
     dc_clock_init(&arm7_clock);
     LOG_INFO("initializing SuperH-4...\n");
     sh4_init(&cpu, &sh4_clock);
+    holly_intc_update_irl();
+    sh4_predecode_init(&cpu.predecode, &dc_mem);
     LOG_INFO("initializing ARM7DI...\n");
     arm7_init(&arm7, &arm7_clock, &aica.mem);
+    if (config_get_jit_arm7()) {
+        LOG_INFO("initializing ARM7 JIT...\n");
+        arm7_jit_init();
+    }
 
     if (boot_mode == (int)DC_BOOT_DIRECT) {
         /*
@@ -787,6 +810,8 @@ dreamcast_init(char const *gdi_path,
     if (config_get_native_jit()) {
         LOG_INFO("initializing x86-64 JIT backend...\n");
         jit_x86_64_backend_init();
+        if (config_get_jit_pin_regs())
+            sh4_jit_pin_regs(&cpu);
         exec_mem_init();
         sh4_jit_set_native_dispatch_meta(&sh4_native_dispatch_meta);
         sh4_native_dispatch_meta.clk = &sh4_clock;
@@ -796,7 +821,8 @@ dreamcast_init(char const *gdi_path,
     }
 #endif
     LOG_INFO("initializing JIT...\n");
-    jit_init(&sh4_clock);
+    jit_block_prof_init(config_get_jit_block_prof() && config_get_jit());
+    jit_init(&sh4_clock, &dc_mem);
 
     LOG_INFO("initializing G1 bus...\n");
     g1_init();
@@ -807,6 +833,27 @@ dreamcast_init(char const *gdi_path,
     LOG_INFO("initializing AICA...\n");
     aica_init(&aica, &arm7, &arm7_clock, &sh4_clock);
 
+    /*
+     * the debugger and the AICA trace proxies both expect the ARM7 to be on
+     * the same thread as the SH4.
+     */
+    arm7_threaded = config_get_arm7_thread();
+#ifdef ENABLE_DEBUGGER
+    if (arm7_threaded && config_get_dbg_enable()) {
+        LOG_WARN("ARM7 thread is not available with the debugger enabled\n");
+        arm7_threaded = false;
+    }
+#endif
+    if (arm7_threaded && aica_trace_file != WASHDC_HOSTFILE_INVALID) {
+        LOG_WARN("ARM7 thread is not available with AICA tracing enabled\n");
+        arm7_threaded = false;
+    }
+    if (arm7_threaded) {
+        int skew = config_get_arm7_skew();
+        arm7_thread_init(&aica, &arm7_clock, &sh4_clock,
+                         skew > 0 ? (unsigned)skew : 1);
+    }
+
     LOG_INFO("initializing PowerVR2...\n");
     void(*pvr2_int_cb)(HollyNrmInt);
     if (pvr2_tracefile)
@@ -850,9 +897,6 @@ dreamcast_init(char const *gdi_path,
         }
     }
 
-    // hook up the irl line
-    sh4_register_irl_line(&cpu, holly_intc_irl_line_fn, NULL);
-
     // hook up pdtra read/write handlers
     sh4_register_pdtra_read_handler(&cpu, on_pdtra_read);
     sh4_register_pdtra_write_handler(&cpu, on_pdtra_write);
@@ -865,8 +909,25 @@ dreamcast_init(char const *gdi_path,
     arm7_set_mem_map(&arm7, &arm7_mem_map);
 
 #ifdef ENABLE_JIT_X86_64
-    if (config_get_native_jit() && config_get_inline_mem())
+    if (config_get_native_jit() && config_get_inline_mem()) {
         native_mem_register(cpu.mem.map);
+#ifdef ENABLE_FASTMEM
+        fastmem_init(cpu.mem.map, &dc_mem);
+#endif
+    }
+
+    if (config_get_native_jit()) {
+        int tier_threshold = config_get_jit_tier_threshold();
+        compile_thread_init(tier_threshold > 0 ? tier_threshold : 0);
+
+        int perf_mode = config_get_jit_perf();
+        if (perf_mode == 1)
+            jit_perf_init(JIT_PERF_MAP);
+        else if (perf_mode == 2)
+            jit_perf_init(JIT_PERF_JITDUMP);
+        else
+            jit_perf_init(JIT_PERF_NONE);
+    }
 #endif
 
     LOG_INFO("initializing real-time clock...\n");
@@ -920,29 +981,40 @@ void dreamcast_cleanup() {
     sh4_register_pdtra_write_handler(&cpu, NULL);
 
 
-    // disconnect the irl line
-    sh4_register_irl_line(&cpu, NULL, NULL);
-
     maple_cleanup(&maple);
     gdrom_cleanup(&gdrom);
     sys_block_cleanup(&sys_block);
     pvr2_cleanup(&dc_pvr2);
+    if (arm7_threaded)
+        arm7_thread_cleanup();
     aica_cleanup(&aica);
     g2_cleanup();
     g1_cleanup();
 
     jit_cleanup();
+    if (jit_block_prof_enabled())
+        jit_block_prof_dump("sh4_block_prof.csv");
+    jit_block_prof_cleanup();
 #ifdef ENABLE_JIT_X86_64
     if (config_get_native_jit()) {
-        if (config_get_inline_mem())
+        compile_thread_cleanup();
+        jit_perf_cleanup();
+        if (config_get_inline_mem()) {
+#ifdef ENABLE_FASTMEM
+            fastmem_cleanup();
+#endif
             native_mem_cleanup();
+        }
         native_dispatch_cleanup(&sh4_native_dispatch_meta);
         exec_mem_cleanup();
         jit_x86_64_backend_cleanup();
     }
 #endif
 
+    if (config_get_jit_arm7())
+        arm7_jit_cleanup();
     arm7_cleanup(&arm7);
+    sh4_predecode_cleanup(&cpu.predecode);
     sh4_cleanup(&cpu);
     dc_clock_cleanup(&arm7_clock);
     dc_clock_cleanup(&sh4_clock);
@@ -975,9 +1047,11 @@ static washdc_real_time start_time;
 
 static void run_one_frame(void) {
     while (!end_of_frame) {
+        if (arm7_threaded)
+            arm7_thread_sh4_sync();
         if (dc_clock_run_timeslice(&sh4_clock))
             return;
-        if (dc_clock_run_timeslice(&arm7_clock))
+        if (!arm7_threaded && dc_clock_run_timeslice(&arm7_clock))
             return;
         if (config_get_jit())
             code_cache_gc();
@@ -1042,6 +1116,8 @@ static cpu_backend_func select_arm7_backend(void) {
     if (use_debugger)
         return run_to_next_arm7_event_debugger;
 #endif
+    if (config_get_jit_arm7())
+        return run_to_next_arm7_event_jit;
     return run_to_next_arm7_event;
 }
 
@@ -1077,10 +1153,16 @@ void dreamcast_run() {
     arm7_clock.dispatch = select_arm7_backend();
     arm7_clock.dispatch_ctxt = &arm7;
 
+    if (arm7_threaded)
+        arm7_thread_start();
+
     LOG_INFO("%s - entering main loop\n", __func__);
     main_loop_sched();
     LOG_INFO("%s - main loop exited.\n", __func__);
 
+    if (arm7_threaded)
+        arm7_thread_stop();
+
     dc_print_perf_stats();
 
     // tell the other threads it's time to clean up and exit
@@ -1110,10 +1192,10 @@ static bool run_to_next_arm7_event(void *ctxt) {
         dc_cycle_stamp_t cycles_after;
         for (;;) {
             int extra_cycles;
-            arm7_inst inst = arm7_fetch_inst(&arm7, &extra_cycles);
+            struct arm7_icache_ent const *ent =
+                arm7_icache_fetch(&arm7, &extra_cycles);
             dc_cycle_stamp_t cycles_adv;
-            arm7_op_fn handler = arm7_decode(&arm7, inst);
-            unsigned inst_cycles = handler(&arm7, inst);
+            unsigned inst_cycles = ent->handler(&arm7, ent->inst);
             cycles_adv =
                 (inst_cycles + extra_cycles) * ARM7_CLOCK_SCALE;
 
@@ -1145,6 +1227,26 @@ static bool run_to_next_arm7_event(void *ctxt) {
     return false;
 }
 
+static bool run_to_next_arm7_event_jit(void *ctxt) {
+    dc_cycle_stamp_t tgt_stamp = clock_target_stamp(&arm7_clock);
+
+    if (arm7.enabled) {
+        do {
+            dc_cycle_stamp_t cycles_after = clock_cycle_stamp(&arm7_clock) +
+                arm7_jit_run_block(&arm7) * ARM7_CLOCK_SCALE;
+            clock_set_cycle_stamp(&arm7_clock, cycles_after);
+            tgt_stamp = clock_target_stamp(&arm7_clock);
+        } while (tgt_stamp > clock_cycle_stamp(&arm7_clock));
+        if (clock_cycle_stamp(&arm7_clock) > tgt_stamp)
+            clock_set_cycle_stamp(&arm7_clock, tgt_stamp);
+    } else {
+        // see the comment in run_to_next_arm7_event
+        clock_set_cycle_stamp(&arm7_clock, tgt_stamp);
+    }
+
+    return false;
+}
+
 #ifdef ENABLE_DEBUGGER
 static bool run_to_next_arm7_event_debugger(void *ctxt) {
     dc_cycle_stamp_t tgt_stamp = clock_target_stamp(&arm7_clock);
@@ -1232,6 +1334,11 @@ static bool run_to_next_sh4_event_debugger(void *ctxt) {
     if ((exit_now = dreamcast_check_debugger()))
         return exit_now;
 
+    if (sh4_idle_sleeping(sh4)) {
+        sh4_idle_fast_forward(sh4);
+        return exit_now;
+    }
+
     dc_cycle_stamp_t cycles_after = clock_target_stamp(&sh4_clock);
     while (!(exit_now = dreamcast_check_debugger())) {
         dc_cycle_stamp_t cycles_adv = 0;
@@ -1262,6 +1369,12 @@ static bool run_to_next_sh4_event(void *ctxt) {
 
     Sh4 *sh4 = (void*)ctxt;
 
+    // nothing to do until an interrupt wakes the CPU up
+    if (sh4_idle_sleeping(sh4)) {
+        sh4_idle_fast_forward(sh4);
+        return false;
+    }
+
     for (;;) {
         dc_cycle_stamp_t cycles_adv = 0;
 
@@ -1284,12 +1397,28 @@ static bool run_to_next_sh4_event(void *ctxt) {
 static bool run_to_next_sh4_event_jit_native(void *ctxt) {
     Sh4 *sh4 = (Sh4*)ctxt;
 
+    if (sh4_idle_sleeping(sh4)) {
+        sh4_idle_fast_forward(sh4);
+        return false;
+    }
+
     reg32_t newpc = sh4->reg[SH4_REG_PC];
 
+    // install any blocks the compile thread finished since last time
+    compile_thread_publish();
+
     jit_hash hash =
         sh4_jit_hash(ctxt, newpc, sh4_fpscr_pr(sh4), sh4_fpscr_sz(sh4));
+
+    bool prof = jit_block_prof_enabled();
+    if (prof)
+        jit_block_prof_switch(NULL);
+
     newpc = sh4_native_dispatch_meta.entry(newpc, hash);
 
+    if (prof)
+        jit_block_prof_switch(NULL);
+
     sh4->reg[SH4_REG_PC] = newpc;
 
     return false;
@@ -1299,8 +1428,14 @@ static bool run_to_next_sh4_event_jit_native(void *ctxt) {
 static bool run_to_next_sh4_event_jit(void *ctxt) {
     Sh4 *sh4 = (Sh4*)ctxt;
 
+    if (sh4_idle_sleeping(sh4)) {
+        sh4_idle_fast_forward(sh4);
+        return false;
+    }
+
     reg32_t newpc = sh4->reg[SH4_REG_PC];
     dc_cycle_stamp_t tgt_stamp = clock_target_stamp(&sh4_clock);
+    bool prof = jit_block_prof_enabled();
 
     do {
         addr32_t blk_addr = newpc;
@@ -1312,13 +1447,18 @@ static bool run_to_next_sh4_event_jit(void *ctxt) {
         struct code_block_intp *intp_blk = &blk->intp;
         if (!ent->valid) {
             sh4_jit_compile_intp(sh4, blk, blk_addr);
-            ent->valid = true;
+            code_cache_set_valid(ent);
         }
 
 #ifdef JIT_PROFILE
         jit_profile_notify(&sh4->jit_profile, blk->profile);
 #endif
 
+        if (prof) {
+            jit_block_prof_switch(blk->prof);
+            blk->prof->guest_cycles += intp_blk->cycle_count;
+        }
+
         newpc = code_block_intp_exec(sh4, intp_blk);
 
         dc_cycle_stamp_t cycles_after = clock_cycle_stamp(&sh4_clock) +
@@ -1329,11 +1469,34 @@ static bool run_to_next_sh4_event_jit(void *ctxt) {
     if (clock_cycle_stamp(&sh4_clock) > tgt_stamp)
         clock_set_cycle_stamp(&sh4_clock, tgt_stamp);
 
+    if (prof)
+        jit_block_prof_switch(NULL);
+
     sh4->reg[SH4_REG_PC] = newpc;
 
     return false;
 }
 
+/*
+ * Print the number of scheduler operations per emulated second.  This is a
+ * measure of how much event churn the scheduler has to deal with.
+ */
+static void dc_print_sched_stats(char const *name, struct dc_clock *clk) {
+    double emu_seconds =
+        (double)clock_cycle_stamp(clk) / (double)SCHED_FREQUENCY;
+    if (emu_seconds <= 0.0)
+        return;
+
+    double sched_rate = (double)clk->n_sched / emu_seconds;
+    double cancel_rate = (double)clk->n_cancel / emu_seconds;
+    double pop_rate = (double)clk->n_pop / emu_seconds;
+
+    LOG_INFO("%s scheduler: %f events scheduled, %f canceled, %f popped "
+             "per emulated second\n", name, sched_rate, cancel_rate, pop_rate);
+    printf("%s scheduler: %f events scheduled, %f canceled, %f popped "
+           "per emulated second\n", name, sched_rate, cancel_rate, pop_rate);
+}
+
 void dc_print_perf_stats(void) {
     if (init_complete) {
         washdc_real_time end_time, delta_time;
@@ -1356,6 +1519,34 @@ void dc_print_perf_stats(void) {
                  hz / 1000000.0, hz_ratio * 100.0);
         printf("Average Performance is %f MHz (%f%%)\n",
                hz / 1000000.0, hz_ratio * 100.0);
+
+        dc_print_sched_stats("SH4", &sh4_clock);
+        dc_print_sched_stats("ARM7", &arm7_clock);
+
+#ifdef ENABLE_JIT_X86_64
+        if (config_get_native_jit()) {
+            uint64_t n_linked, n_dispatched;
+            native_dispatch_get_link_stats(&sh4_native_dispatch_meta,
+                                           &n_linked, &n_dispatched);
+            LOG_INFO("SH4 JIT: %llu linked block transitions, %llu "
+                     "dispatched\n", (unsigned long long)n_linked,
+                     (unsigned long long)n_dispatched);
+            printf("SH4 JIT: %llu linked block transitions, %llu "
+                   "dispatched\n", (unsigned long long)n_linked,
+                   (unsigned long long)n_dispatched);
+        }
+#endif
+
+        if (config_get_jit()) {
+            uint64_t n_evicted, n_spared;
+            code_cache_get_evict_stats(&n_evicted, &n_spared);
+            LOG_INFO("SH4 JIT: %llu blocks evicted, %llu given a second "
+                     "chance\n", (unsigned long long)n_evicted,
+                     (unsigned long long)n_spared);
+            printf("SH4 JIT: %llu blocks evicted, %llu given a second "
+                   "chance\n", (unsigned long long)n_evicted,
+                   (unsigned long long)n_spared);
+        }
     } else {
         LOG_INFO("Program execution halted before WashingtonDC was completely "
                  "initialized.\n");
@@ -1561,6 +1752,13 @@ static void construct_arm7_mem_map(struct memory_map *map,
 static void construct_sh4_mem_map(struct Sh4 *sh4, struct memory_map *map,
                                   washdc_hostfile pvr2_trace_file,
                                   washdc_hostfile aica_trace_file) {
+    struct memory_interface const *aica_wave_intf = &aica_wave_mem_intf;
+    struct memory_interface const *aica_sys_intf_sh4 = &aica_sys_intf;
+    if (arm7_threaded) {
+        aica_wave_intf = &arm7_thread_aica_wave_intf;
+        aica_sys_intf_sh4 = &arm7_thread_aica_sys_intf;
+    }
+
     /*
      * I don't like the idea of putting SH4_AREA_P4 ahead of AREA3 (memory),
      * but this absolutely needs to be at the front of the list because the
@@ -1577,9 +1775,11 @@ static void construct_sh4_mem_map(struct Sh4 *sh4, struct memory_map *map,
                    &sh4_p4_intf, sh4);
 
     // area 3 (main system memory)
-    memory_map_add(map, 0x0c000000, 0x0fffffff,
-                   RANGE_MASK_EXT, MEMORY_MAP_REGION_RAM,
-                   &ram_intf, &dc_mem);
+    memory_map_add_host_mem(map, 0x0c000000, 0x0fffffff,
+                            RANGE_MASK_EXT, MEMORY_MAP_REGION_RAM,
+                            &ram_intf, &dc_mem, dc_mem.mem, MEMORY_MASK);
+    memory_map_watch_host_mem(map, dc_mem.mem, dc_mem.page_flags,
+                              MEMORY_PAGE_SHIFT);
 
     if (pvr2_trace_file != WASHDC_HOSTFILE_INVALID) {
         static struct trace_proxy ta_fifo_traceproxy, ta_yuv_fifo_traceproxy,
@@ -1702,10 +1902,10 @@ static void construct_sh4_mem_map(struct Sh4 *sh4, struct memory_map *map,
     } else {
         memory_map_add(map, ADDR_AICA_WAVE_FIRST, ADDR_AICA_WAVE_LAST,
                        RANGE_MASK_EXT, MEMORY_MAP_REGION_UNKNOWN,
-                       &aica_wave_mem_intf, &aica.mem);
+                       aica_wave_intf, &aica.mem);
         memory_map_add(map, 0x00700000, 0x00707fff,
                        RANGE_MASK_EXT, MEMORY_MAP_REGION_UNKNOWN,
-                       &aica_sys_intf, &aica);
+                       aica_sys_intf_sh4, &aica);
     }
     memory_map_add(map, ADDR_AICA_RTC_FIRST, ADDR_AICA_RTC_LAST,
                    RANGE_MASK_EXT, MEMORY_MAP_REGION_UNKNOWN,
@@ -1741,10 +1941,10 @@ static void construct_sh4_mem_map(struct Sh4 *sh4, struct memory_map *map,
                    &modem_intf, NULL);
     memory_map_add(map, ADDR_AICA_WAVE_FIRST + 0x02000000, ADDR_AICA_WAVE_LAST + 0x02000000,
                    RANGE_MASK_EXT, MEMORY_MAP_REGION_UNKNOWN,
-                   &aica_wave_mem_intf, &aica.mem);
+                   aica_wave_intf, &aica.mem);
     memory_map_add(map, 0x00700000 + 0x02000000, 0x00707fff + 0x02000000,
                    RANGE_MASK_EXT, MEMORY_MAP_REGION_UNKNOWN,
-                   &aica_sys_intf, &aica);
+                   aica_sys_intf_sh4, &aica);
     memory_map_add(map, ADDR_AICA_RTC_FIRST + 0x02000000, ADDR_AICA_RTC_LAST + 0x02000000,
                    RANGE_MASK_EXT, MEMORY_MAP_REGION_UNKNOWN,
                    &aica_rtc_intf, &rtc);
@@ -1873,70 +2073,30 @@ dc_ch2_dma_xfer(addr32_t xfer_src, addr32_t xfer_dst, unsigned n_words) {
         goto the_end;
     }
 
-    memory_map_read32_func read32 = src_region->intf->read32;
-    void *src_ctxt = src_region->ctxt;
     if ((xfer_dst >= ADDR_TA_FIFO_POLY_FIRST) &&
         (xfer_dst <= ADDR_TA_FIFO_POLY_LAST)) {
-        struct memory_map_region *dst_region =
-            memory_map_get_region(&mem_map, xfer_dst, n_words * 4);
-        memory_map_write32_func write32 = dst_region->intf->write32;
-        void *dst_ctxt = dst_region->ctxt;
-        while (n_words--) {
-            uint32_t buf = read32(xfer_src, src_ctxt);
-            write32(xfer_dst, buf, dst_ctxt);
-            xfer_dst += sizeof(buf);
-            xfer_src += sizeof(buf);
-        }
+        sh4_dmac_transfer_words(&cpu, xfer_src, xfer_dst, n_words);
     } else if ((xfer_dst >= ADDR_AREA4_TEX_REGION_0_FIRST) &&
                (xfer_dst <= ADDR_AREA4_TEX_REGION_0_LAST)) {
-        // TODO: do tex DMA transfers in large chuks instead of 4-byte increments
         xfer_dst -= ADDR_AREA4_TEX_REGION_0_FIRST;
         if (dc_get_lmmode0() == 0)
             xfer_dst += ADDR_TEX64_FIRST;
         else
             xfer_dst += ADDR_TEX32_FIRST;
 
-        struct memory_map_region *dst_region =
-            memory_map_get_region(&mem_map, xfer_dst, n_words * 4);
-        memory_map_write32_func write32 = dst_region->intf->write32;
-        void *dst_ctxt = dst_region->ctxt;
-        while (n_words--) {
-                uint32_t buf = read32(xfer_src, src_ctxt);
-                write32(xfer_dst, buf, dst_ctxt);
-                xfer_dst += sizeof(buf);
-                xfer_src += sizeof(buf);
-        }
+        sh4_dmac_transfer_words(&cpu, xfer_src, xfer_dst, n_words);
     } else if ((xfer_dst >= ADDR_AREA4_TEX_REGION_1_FIRST) &&
                (xfer_dst <= ADDR_AREA4_TEX_REGION_1_LAST)) {
-        // TODO: do tex DMA transfers in large chuks instead of 4-byte increments
         xfer_dst -= ADDR_AREA4_TEX_REGION_1_FIRST;
         if (dc_get_lmmode1() == 0)
             xfer_dst += ADDR_TEX64_FIRST;
         else
             xfer_dst += ADDR_TEX32_FIRST;
 
-        struct memory_map_region *dst_region =
-            memory_map_get_region(&mem_map, xfer_dst, n_words * 4);
-        memory_map_write32_func write32 = dst_region->intf->write32;
-        void *dst_ctxt = dst_region->ctxt;
-        while (n_words--) {
-                uint32_t buf = read32(xfer_src, src_ctxt);
-                write32(xfer_dst, buf, dst_ctxt);
-                xfer_dst += sizeof(buf);
-                xfer_src += sizeof(buf);
-        }
+        sh4_dmac_transfer_words(&cpu, xfer_src, xfer_dst, n_words);
     } else if (xfer_dst >= ADDR_TA_FIFO_YUV_FIRST &&
                xfer_dst <= ADDR_TA_FIFO_YUV_LAST) {
-        struct memory_map_region *dst_region =
-            memory_map_get_region(&mem_map, xfer_dst, n_words * 4);
-        memory_map_write32_func write32 = dst_region->intf->write32;
-        void *dst_ctxt = dst_region->ctxt;
-        while (n_words--) {
-            uint32_t in = read32(xfer_src, src_ctxt);
-            write32(xfer_dst, in, dst_ctxt);
-            xfer_src += sizeof(in);
-            xfer_dst += sizeof(in);
-        }
+        sh4_dmac_transfer_words(&cpu, xfer_src, xfer_dst, n_words);
     } else {
         error_set_address(xfer_dst);
         error_set_length(n_words * 4);
@@ -176,6 +176,7 @@ typedef uint32_t aica_atten;
 static DEF_ERROR_INT_ATTR(channel)
 
 static void raise_aica_sh4_int(struct aica *aica);
+static void aica_set_sh4_int(struct aica *aica, bool raise);
 static void post_delay_raise_aica_sh4_int(struct SchedEvent *event);
 
 // If this is defined, WashingtonDC will panic on unrecognized AICA addresses.
@@ -500,7 +501,7 @@ aica_sys_reg_post_write(struct aica *aica, unsigned idx, bool from_sh4) {
         aica->int_pending_sh4 &= ~val;
         aica_update_interrupts(aica);
         if (val & (1<<5))
-            holly_clear_ext_int(HOLLY_EXT_INT_AICA);
+            aica_set_sh4_int(aica, false);
         break;
     case AICA_SCIPD:
         /*
@@ -1822,8 +1823,17 @@ static void aica_process_sample(struct aica *aica) {
     dc_submit_sound_samples(&sample_total, 1);
 }
 
+static void aica_set_sh4_int(struct aica *aica, bool raise) {
+    if (aica->sh4_int_hook)
+        aica->sh4_int_hook(raise);
+    else if (raise)
+        holly_raise_ext_int(HOLLY_EXT_INT_AICA);
+    else
+        holly_clear_ext_int(HOLLY_EXT_INT_AICA);
+}
+
 static void raise_aica_sh4_int(struct aica *aica) {
-    holly_raise_ext_int(HOLLY_EXT_INT_AICA);
+    aica_set_sh4_int(aica, true);
     aica->int_pending_sh4 |= (1<<5);
     aica->aica_sh4_int_scheduled = false;
 }
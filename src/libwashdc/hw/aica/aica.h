@@ -213,6 +213,14 @@ struct aica {
 
     struct dc_clock *clk;
     struct dc_clock *sh4_clk;
+
+    /*
+     * If this is non-NULL, the AICA's interrupt line to holly goes through
+     * here instead of straight to holly_raise_ext_int/holly_clear_ext_int.
+     * This is for when the ARM7 is running on its own thread and the SH4 side
+     * can't be touched directly (see arm7_thread.h).
+     */
+    void (*sh4_int_hook)(bool raise);
 };
 
 void aica_init(struct aica *aica, struct arm7 *arm7,
@@ -21,6 +21,7 @@
  ******************************************************************************/
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "mem_code.h"
@@ -36,15 +37,49 @@
 
 bool aica_log_verbose_val;
 
+// call this after writing len bytes to addr
+static inline void
+aica_wave_mem_written(struct aica_wave_mem *wm, addr32_t addr, unsigned len) {
+    wm->arm7_icache[addr >> 2].handler = NULL;
+    wm->arm7_icache[(addr + len - 1) >> 2].handler = NULL;
+    aica_wave_mem_note_write(wm, addr);
+}
+
+void aica_wave_mem_invalidate(struct aica_wave_mem *wm,
+                              addr32_t addr, unsigned len) {
+    addr32_t first = addr & AICA_WAVE_MEM_MASK;
+    addr32_t last = (first + len - 1) & AICA_WAVE_MEM_MASK;
+    if (!len || last < first)
+        return;
+
+    addr32_t word;
+    for (word = first >> 2; word <= (last >> 2); word++)
+        wm->arm7_icache[word].handler = NULL;
+
+    addr32_t page;
+    for (page = first >> AICA_WAVE_MEM_PAGE_SHIFT;
+         page <= (last >> AICA_WAVE_MEM_PAGE_SHIFT); page++)
+        aica_wave_mem_note_write(wm, page << AICA_WAVE_MEM_PAGE_SHIFT);
+}
+
 void aica_log_verbose(bool verbose) {
     aica_log_verbose_val = verbose;
 }
 
 void aica_wave_mem_init(struct aica_wave_mem *wm) {
     memset(wm->mem, 0, sizeof(wm->mem));
+    memset(wm->page_flags, 0, sizeof(wm->page_flags));
+    wm->n_dirty_pages = 0;
+
+    wm->arm7_icache = (struct arm7_icache_ent*)
+        calloc(AICA_WAVE_MEM_LEN / 4, sizeof(struct arm7_icache_ent));
+    if (!wm->arm7_icache)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
 }
 
 void aica_wave_mem_cleanup(struct aica_wave_mem *wm) {
+    free(wm->arm7_icache);
+    wm->arm7_icache = NULL;
 }
 
 float aica_wave_mem_read_float(addr32_t addr, void *ctxt) {
@@ -124,6 +159,7 @@ void aica_wave_mem_write_8(addr32_t addr, uint8_t val, void *ctxt) {
     }
 
     *outp = val;
+    aica_wave_mem_written(wm, addr, sizeof(val));
 }
 
 uint16_t aica_wave_mem_read_16(addr32_t addr, void *ctxt) {
@@ -173,6 +209,7 @@ void aica_wave_mem_write_16(addr32_t addr, uint16_t val, void *ctxt) {
     }
 
     memcpy(wm->mem + addr, &val, sizeof(val));
+    aica_wave_mem_written(wm, addr, sizeof(val));
 }
 
 void aica_wave_mem_write_32(addr32_t addr, uint32_t val, void *ctxt) {
@@ -196,6 +233,46 @@ void aica_wave_mem_write_32(addr32_t addr, uint32_t val, void *ctxt) {
     }
 
     memcpy(wm->mem + addr, &val, sizeof(val));
+    aica_wave_mem_written(wm, addr, sizeof(val));
+}
+
+/*
+ * blocks which run off the end of wave memory wrap around to the beginning,
+ * same as the masking above does for individual accesses.
+ */
+void aica_wave_mem_read_block(addr32_t addr, void *dst,
+                              unsigned n_bytes, void *ctxt) {
+    struct aica_wave_mem *wm = (struct aica_wave_mem*)ctxt;
+    uint8_t *dst8 = (uint8_t*)dst;
+
+    addr &= ADDR_AICA_WAVE_MASK;
+    while (n_bytes) {
+        unsigned chunk = AICA_WAVE_MEM_LEN - addr;
+        if (chunk > n_bytes)
+            chunk = n_bytes;
+        memcpy(dst8, wm->mem + addr, chunk);
+        dst8 += chunk;
+        n_bytes -= chunk;
+        addr = 0;
+    }
+}
+
+void aica_wave_mem_write_block(addr32_t addr, void const *src,
+                               unsigned n_bytes, void *ctxt) {
+    struct aica_wave_mem *wm = (struct aica_wave_mem*)ctxt;
+    uint8_t const *src8 = (uint8_t const*)src;
+
+    addr &= ADDR_AICA_WAVE_MASK;
+    while (n_bytes) {
+        unsigned chunk = AICA_WAVE_MEM_LEN - addr;
+        if (chunk > n_bytes)
+            chunk = n_bytes;
+        memcpy(wm->mem + addr, src8, chunk);
+        aica_wave_mem_invalidate(wm, addr, chunk);
+        src8 += chunk;
+        n_bytes -= chunk;
+        addr = 0;
+    }
 }
 
 struct memory_interface aica_wave_mem_intf = {
@@ -209,5 +286,8 @@ struct memory_interface aica_wave_mem_intf = {
     .write16 = aica_wave_mem_write_16,
     .write8 = aica_wave_mem_write_8,
     .writefloat = aica_wave_mem_write_float,
-    .writedouble = aica_wave_mem_write_double
+    .writedouble = aica_wave_mem_write_double,
+
+    .read_block = aica_wave_mem_read_block,
+    .write_block = aica_wave_mem_write_block
 };
@@ -42,10 +42,63 @@ static_assert(!(AICA_WAVE_MEM_LEN & (AICA_WAVE_MEM_LEN - 1)),
 
 #define AICA_WAVE_MEM_MASK (AICA_WAVE_MEM_LEN - 1)
 
+/*
+ * wave memory is divided into 4KB pages so that the ARM7 JIT can find out when
+ * code it has already compiled gets overwritten.  This works the same way as
+ * the page flags in struct Memory.
+ */
+#define AICA_WAVE_MEM_PAGE_SHIFT 12
+#define AICA_WAVE_MEM_PAGE_SIZE (1 << AICA_WAVE_MEM_PAGE_SHIFT)
+#define AICA_WAVE_MEM_N_PAGES (AICA_WAVE_MEM_LEN >> AICA_WAVE_MEM_PAGE_SHIFT)
+
+// the ARM7 JIT has compiled code from this page
+#define AICA_WAVE_MEM_PAGE_CODE 1
+
+// this page has been written to since the ARM7 JIT compiled code from it
+#define AICA_WAVE_MEM_PAGE_DIRTY 2
+
+struct arm7;
+
+/*
+ * predecoded ARM7 instruction.  handler is the instruction's handler from
+ * arm7_inst_lut, or NULL if the word hasn't been decoded yet or has been
+ * written to since.
+ */
+struct arm7_icache_ent {
+    unsigned(*handler)(struct arm7*, uint32_t);
+    uint32_t inst;
+};
+
 struct aica_wave_mem {
     uint8_t mem[AICA_WAVE_MEM_LEN];
+
+    /*
+     * one arm7_icache_ent for every 32-bit word of wave memory.  The ARM7
+     * interpreter fetches instructions from here instead of decoding them
+     * every time they're executed.  Writes to wave memory clear the entries
+     * they overlap.
+     */
+    struct arm7_icache_ent *arm7_icache;
+
+    /*
+     * one byte of AICA_WAVE_MEM_PAGE_* flags for every page.  Writes to a page
+     * which has AICA_WAVE_MEM_PAGE_CODE set will also set
+     * AICA_WAVE_MEM_PAGE_DIRTY.
+     */
+    uint8_t page_flags[AICA_WAVE_MEM_N_PAGES];
+    unsigned n_dirty_pages;
 };
 
+// addr must already be masked with AICA_WAVE_MEM_MASK
+static inline void
+aica_wave_mem_note_write(struct aica_wave_mem *wm, addr32_t addr) {
+    uint8_t *flags = wm->page_flags + (addr >> AICA_WAVE_MEM_PAGE_SHIFT);
+    if (*flags == AICA_WAVE_MEM_PAGE_CODE) {
+        *flags |= AICA_WAVE_MEM_PAGE_DIRTY;
+        wm->n_dirty_pages++;
+    }
+}
+
 float aica_wave_mem_read_float(addr32_t addr, void *ctxt);
 void aica_wave_mem_write_float(addr32_t addr, float val, void *ctxt);
 double aica_wave_mem_read_double(addr32_t addr, void *ctxt);
@@ -55,6 +108,10 @@ void aica_wave_mem_write_8(addr32_t addr, uint8_t val, void *ctxt);
 uint16_t aica_wave_mem_read_16(addr32_t addr, void *ctxt);
 void aica_wave_mem_write_16(addr32_t addr, uint16_t val, void *ctxt);
 void aica_wave_mem_write_32(addr32_t addr, uint32_t val, void *ctxt);
+void aica_wave_mem_read_block(addr32_t addr, void *dst,
+                              unsigned n_bytes, void *ctxt);
+void aica_wave_mem_write_block(addr32_t addr, void const *src,
+                               unsigned n_bytes, void *ctxt);
 
 
 extern bool aica_log_verbose_val;
@@ -92,6 +149,16 @@ void aica_log_verbose(bool verbose);
 
 extern struct memory_interface aica_wave_mem_intf;
 
+/*
+ * does the same bookkeeping as a write to [addr, addr+len) without touching
+ * the contents of wave memory: clears the ARM7's predecoded instructions in
+ * that range and marks the pages dirty if the ARM7 JIT compiled code from
+ * them.  This is for when the SH4 writes to wave memory from another thread
+ * and the ARM7 needs to catch up later.
+ */
+void aica_wave_mem_invalidate(struct aica_wave_mem *wm,
+                              addr32_t addr, unsigned len);
+
 void aica_wave_mem_init(struct aica_wave_mem *wm);
 void aica_wave_mem_cleanup(struct aica_wave_mem *wm);
 
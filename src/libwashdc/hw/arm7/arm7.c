@@ -240,6 +240,9 @@ void arm7_init(struct arm7 *arm7,
     arm7->inst_mem = inst_mem;
     arm7->reg[ARM7_REG_CPSR] = ARM7_MODE_SVC;
 
+    arm7->icache_oob.inst = ~0;
+    arm7->icache_oob.handler = arm7_decode(arm7, arm7->icache_oob.inst);
+
     arm7_error_callback.arg = arm7;
     arm7_error_callback.callback_fn = arm7_error_set_regs;
     error_add_callback(&arm7_error_callback);
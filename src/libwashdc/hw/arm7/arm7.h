@@ -143,6 +143,12 @@ struct arm7 {
 
     enum arm7_excp excp;
 
+    /*
+     * arm7_icache_fetch returns this for instructions fetched from outside of
+     * wave memory.
+     */
+    struct arm7_icache_ent icache_oob;
+
     bool enabled;
 
     bool fiq_line;
@@ -230,6 +236,35 @@ static inline arm7_inst arm7_fetch_inst(struct arm7 *arm7, int *extra_cycles) {
     return ret;
 }
 
+/*
+ * this is an alternative to arm7_fetch_inst which returns the next instruction
+ * from wave memory's predecoded instruction cache, decoding it first if
+ * necessary.  The simulated pipeline doesn't get filled, so an instruction
+ * which is overwritten after it would have been prefetched will be executed
+ * in its new form.
+ */
+static inline struct arm7_icache_ent const *
+arm7_icache_fetch(struct arm7 *arm7, int *extra_cycles) {
+    uint32_t pc = arm7->reg[ARM7_REG_PC] - 8;
+
+    // this is where arm7_fetch_inst would have left it
+    arm7->pipeline_pc[1] = pc + 4;
+
+    *extra_cycles = arm7->extra_cycles;
+    arm7->extra_cycles = 0;
+
+    if (pc > 0x007fffff)
+        return &arm7->icache_oob;
+
+    struct arm7_icache_ent *ent =
+        arm7->inst_mem->arm7_icache + ((pc & AICA_WAVE_MEM_MASK) >> 2);
+    if (!ent->handler) {
+        ent->inst = aica_wave_mem_read_32(pc, arm7->inst_mem);
+        ent->handler = arm7_decode(arm7, ent->inst);
+    }
+    return ent;
+}
+
 static inline bool arm7_cond_eq(struct arm7 const *arm7) {
     return (bool)(arm7->reg[ARM7_REG_CPSR] & ARM7_CPSR_Z_MASK);
 }
@@ -0,0 +1,466 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+#include "washdc/error.h"
+#include "hw/aica/aica_wave_mem.h"
+#include "jit/code_block.h"
+#include "jit/jit_il.h"
+#include "jit/jit_intp/code_block_intp.h"
+
+#include "arm7.h"
+#include "arm7_jit.h"
+
+// maximum number of ARM7 instructions in a single block
+#define ARM7_JIT_MAX_INSTS 64
+
+#define ARM7_JIT_HASH_BITS 12
+#define ARM7_JIT_HASH_SIZE (1 << ARM7_JIT_HASH_BITS)
+#define ARM7_JIT_HASH_MASK (ARM7_JIT_HASH_SIZE - 1)
+
+#define ARM7_COND_AL 0xe
+
+struct arm7_jit_block {
+    struct arm7_jit_block *next_in_bucket, *next_in_page;
+
+    // address of the block's first instruction
+    uint32_t pc;
+
+    struct code_block_intp intp;
+};
+
+static struct arm7_jit_block *block_tbl[ARM7_JIT_HASH_SIZE];
+
+// every block compiled from each page of wave memory
+static struct arm7_jit_block *page_blocks[AICA_WAVE_MEM_N_PAGES];
+
+/*
+ * cycles spent in instruction handlers which were called from the block that's
+ * currently executing.
+ */
+static unsigned fallback_cycles;
+
+static unsigned long n_compiled, n_invalidated;
+
+static unsigned arm7_jit_compile(struct arm7 *arm7,
+                                 struct il_code_block *block, uint32_t pc);
+static void arm7_jit_invalidate_dirty(struct aica_wave_mem *wm);
+static void arm7_jit_block_free(struct arm7_jit_block *blk);
+
+static inline unsigned arm7_jit_hash(uint32_t pc) {
+    return (pc >> 2) & ARM7_JIT_HASH_MASK;
+}
+
+static inline unsigned arm7_jit_page(uint32_t pc) {
+    return (pc & AICA_WAVE_MEM_MASK) >> AICA_WAVE_MEM_PAGE_SHIFT;
+}
+
+void arm7_jit_init(void) {
+    memset(block_tbl, 0, sizeof(block_tbl));
+    memset(page_blocks, 0, sizeof(page_blocks));
+    n_compiled = n_invalidated = 0;
+}
+
+void arm7_jit_cleanup(void) {
+    unsigned page_no;
+    for (page_no = 0; page_no < AICA_WAVE_MEM_N_PAGES; page_no++) {
+        struct arm7_jit_block *blk = page_blocks[page_no];
+        while (blk) {
+            struct arm7_jit_block *next = blk->next_in_page;
+            arm7_jit_block_free(blk);
+            blk = next;
+        }
+        page_blocks[page_no] = NULL;
+    }
+    memset(block_tbl, 0, sizeof(block_tbl));
+
+    LOG_INFO("ARM7 JIT: %lu blocks compiled, %lu invalidated\n",
+             n_compiled, n_invalidated);
+}
+
+static struct arm7_jit_block *arm7_jit_find(struct arm7 *arm7, uint32_t pc) {
+    struct arm7_jit_block **bucket = block_tbl + arm7_jit_hash(pc);
+    struct arm7_jit_block *blk;
+    for (blk = *bucket; blk; blk = blk->next_in_bucket)
+        if (blk->pc == pc)
+            return blk;
+
+    blk = (struct arm7_jit_block*)calloc(1, sizeof(struct arm7_jit_block));
+    if (!blk)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    struct il_code_block il_blk;
+    il_code_block_init(&il_blk);
+    unsigned cycle_count = arm7_jit_compile(arm7, &il_blk, pc);
+    code_block_intp_compile(arm7, &blk->intp, &il_blk, cycle_count);
+    il_code_block_cleanup(&il_blk);
+
+    blk->pc = pc;
+    blk->next_in_bucket = *bucket;
+    *bucket = blk;
+
+    unsigned page_no = arm7_jit_page(pc);
+    blk->next_in_page = page_blocks[page_no];
+    page_blocks[page_no] = blk;
+    arm7->inst_mem->page_flags[page_no] |= AICA_WAVE_MEM_PAGE_CODE;
+
+    n_compiled++;
+    return blk;
+}
+
+unsigned arm7_jit_run_block(struct arm7 *arm7) {
+    if (arm7->inst_mem->n_dirty_pages)
+        arm7_jit_invalidate_dirty(arm7->inst_mem);
+
+    struct arm7_jit_block *blk =
+        arm7_jit_find(arm7, arm7->reg[ARM7_REG_PC] - 8);
+
+    fallback_cycles = 0;
+    uint32_t newpc = code_block_intp_exec(arm7, &blk->intp);
+
+    /*
+     * put the PC back where the interpreter expects it to be between
+     * instructions.  The pipeline's contents don't matter because only the
+     * interpreter reads them, but arm7_excp_refresh uses pipeline_pc[1] to
+     * figure out the return address.
+     */
+    arm7->reg[ARM7_REG_PC] = newpc + 8;
+    arm7->pipeline_pc[1] = newpc;
+
+    unsigned n_cycles =
+        blk->intp.cycle_count + fallback_cycles + arm7->extra_cycles;
+    arm7->extra_cycles = 0;
+    return n_cycles;
+}
+
+static void arm7_jit_invalidate_dirty(struct aica_wave_mem *wm) {
+    unsigned page_no;
+    for (page_no = 0; page_no < AICA_WAVE_MEM_N_PAGES; page_no++) {
+        if (!(wm->page_flags[page_no] & AICA_WAVE_MEM_PAGE_DIRTY))
+            continue;
+
+        struct arm7_jit_block *blk = page_blocks[page_no];
+        while (blk) {
+            struct arm7_jit_block *next = blk->next_in_page;
+            struct arm7_jit_block **bucket = block_tbl + arm7_jit_hash(blk->pc);
+            while (*bucket != blk)
+                bucket = &(*bucket)->next_in_bucket;
+            *bucket = blk->next_in_bucket;
+
+            arm7_jit_block_free(blk);
+            n_invalidated++;
+            blk = next;
+        }
+
+        page_blocks[page_no] = NULL;
+        wm->page_flags[page_no] = 0;
+    }
+
+    wm->n_dirty_pages = 0;
+}
+
+static void arm7_jit_block_free(struct arm7_jit_block *blk) {
+    code_block_intp_cleanup(&blk->intp);
+    free(blk);
+}
+
+/*
+ * calls the interpreter's handler for an instruction that couldn't be compiled.
+ * The PC is expected to already be pointing two instructions past inst.
+ */
+static void arm7_jit_fallback(void *cpu, cpu_inst_param inst) {
+    struct arm7 *arm7 = (struct arm7*)cpu;
+
+    // this is where arm7_fetch_inst would have left it
+    arm7->pipeline_pc[1] = arm7->reg[ARM7_REG_PC] - 4;
+
+    fallback_cycles += arm7_decode(arm7, inst)(arm7, inst);
+}
+
+/*
+ * returns true if the block has to end after calling the interpreter's
+ * handler for inst.  That's the case for anything that might write to the PC,
+ * change the CPU mode or write to memory (which can raise a FIQ or overwrite
+ * the code that's being executed).
+ */
+static bool arm7_jit_fallback_ends_block(arm7_inst inst) {
+    unsigned rn = (inst >> 16) & 0xf;
+    unsigned rd = (inst >> 12) & 0xf;
+
+    if ((inst & 0x0fc000f0) == 0x00000090) {
+        // MUL, MLA.  The destination register is in the rn field.
+        return rn == 15;
+    }
+
+    if ((inst & 0x0fbf0fff) == 0x010f0000) {
+        // MRS
+        return rd == 15;
+    }
+
+    if ((inst & 0x0c000000) == 0x00000000) {
+        // SWP and whatever else lives in the multiply encoding space
+        if ((inst & 0x0e000090) == 0x00000090)
+            return true;
+
+        // MSR
+        unsigned opcode = (inst >> 21) & 0xf;
+        if (opcode >= 0x8 && opcode <= 0xb && !(inst & (1 << 20)))
+            return true;
+
+        // data processing
+        return rd == 15;
+    }
+
+    if ((inst & 0x0c000000) == 0x04000000) {
+        // LDR, STR
+        if (!(inst & (1 << 20)))
+            return true;
+        bool writeback = (inst & (1 << 21)) || !(inst & (1 << 24));
+        return rd == 15 || (writeback && rn == 15);
+    }
+
+    // LDM, STM, B, BL, SWI and coprocessor instructions
+    return true;
+}
+
+/*
+ * load the value of general-purpose register reg_no into slot_no.  pc is the
+ * address of the instruction being compiled.
+ */
+static void arm7_jit_load_gen_reg(struct il_code_block *block,
+                                  unsigned regbase_slot, unsigned reg_no,
+                                  unsigned slot_no, uint32_t pc) {
+    if (reg_no == 15)
+        jit_set_slot(block, slot_no, pc + 8);
+    else
+        jit_load_slot_offset(block, regbase_slot, ARM7_REG_R0 + reg_no,
+                             slot_no);
+}
+
+/*
+ * try to translate a data-processing instruction into IL.  Only
+ * unconditional instructions which don't set flags, don't write to the PC and
+ * don't need the carry flag are supported, and the second operand has to be
+ * either an immediate value or a register shifted by a constant.  Returns false
+ * if inst wasn't translated.
+ */
+static bool arm7_jit_data_op(struct il_code_block *block,
+                             unsigned regbase_slot,
+                             arm7_inst inst, uint32_t pc) {
+    if ((inst >> 28) != ARM7_COND_AL || (inst & 0x0c100000))
+        return false;
+
+    unsigned opcode = (inst >> 21) & 0xf;
+    unsigned rn = (inst >> 16) & 0xf;
+    unsigned rd = (inst >> 12) & 0xf;
+
+    switch (opcode) {
+    case 0x0: // AND
+    case 0x1: // EOR
+    case 0x2: // SUB
+    case 0x3: // RSB
+    case 0x4: // ADD
+    case 0xc: // ORR
+    case 0xd: // MOV
+    case 0xe: // BIC
+    case 0xf: // MVN
+        break;
+    default:
+        return false;
+    }
+
+    if (rd == 15)
+        return false;
+
+    unsigned op2_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+
+    if (inst & (1 << 25)) {
+        uint32_t imm = inst & 0xff;
+        unsigned n_bits = 2 * ((inst >> 8) & 0xf);
+        if (n_bits)
+            imm = (imm >> n_bits) | (imm << (32 - n_bits));
+        jit_set_slot(block, op2_slot, imm);
+    } else {
+        if (inst & (1 << 4)) {
+            // shift by register
+            free_slot(block, op2_slot);
+            return false;
+        }
+
+        unsigned shift_fn = (inst >> 5) & 3;
+        unsigned shift_amt = (inst >> 7) & 0x1f;
+        unsigned rm = inst & 0xf;
+
+        // LSR #32, ASR #32, ROR and RRX don't get compiled
+        if ((shift_fn != 0 && !shift_amt) || shift_fn == 3) {
+            free_slot(block, op2_slot);
+            return false;
+        }
+
+        arm7_jit_load_gen_reg(block, regbase_slot, rm, op2_slot, pc);
+        if (shift_amt) {
+            if (shift_fn == 0)
+                jit_shll(block, op2_slot, shift_amt);
+            else if (shift_fn == 1)
+                jit_shlr(block, op2_slot, shift_amt);
+            else
+                jit_shar(block, op2_slot, shift_amt);
+        }
+    }
+
+    unsigned res_slot = op2_slot, rn_slot = 0;
+    if (opcode == 0xf) {
+        // MVN
+        jit_not(block, op2_slot);
+    } else if (opcode != 0xd) {
+        rn_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+        arm7_jit_load_gen_reg(block, regbase_slot, rn, rn_slot, pc);
+        res_slot = rn_slot;
+
+        switch (opcode) {
+        case 0x0:
+            jit_and(block, op2_slot, rn_slot);
+            break;
+        case 0x1:
+            jit_xor(block, op2_slot, rn_slot);
+            break;
+        case 0x2:
+            jit_sub(block, op2_slot, rn_slot);
+            break;
+        case 0x3:
+            jit_sub(block, rn_slot, op2_slot);
+            res_slot = op2_slot;
+            break;
+        case 0x4:
+            jit_add(block, op2_slot, rn_slot);
+            break;
+        case 0xc:
+            jit_or(block, op2_slot, rn_slot);
+            break;
+        case 0xe:
+            jit_not(block, op2_slot);
+            jit_and(block, op2_slot, rn_slot);
+            break;
+        }
+    }
+
+    jit_store_slot_offset(block, res_slot, regbase_slot, ARM7_REG_R0 + rd);
+
+    if (opcode != 0xd && opcode != 0xf)
+        free_slot(block, rn_slot);
+    free_slot(block, op2_slot);
+    return true;
+}
+
+// end the block with a jump to a constant address
+static void arm7_jit_jump_const(struct il_code_block *block, uint32_t addr) {
+    unsigned addr_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+    jit_set_slot(block, addr_slot, addr);
+    jit_jump(block, addr_slot, addr_slot);
+    free_slot(block, addr_slot);
+}
+
+/*
+ * translate the block at pc into IL and return the number of cycles taken by
+ * the instructions in it which don't fall back to the interpreter.
+ */
+static unsigned arm7_jit_compile(struct arm7 *arm7,
+                                 struct il_code_block *block, uint32_t pc) {
+    unsigned regbase_slot = alloc_slot(block, WASHDC_JIT_SLOT_HOST_PTR);
+    jit_set_slot_host_ptr(block, regbase_slot, arm7->reg);
+
+    unsigned page_no = arm7_jit_page(pc);
+    unsigned n_insts = 0;
+
+    /*
+     * compiled instructions don't advance the PC in the register file, so it
+     * needs to be brought up to date before calling into the interpreter.
+     */
+    bool pc_synced = true;
+
+    /*
+     * cycle counts for compiled instructions match what the interpreter's
+     * handlers return.  Cycles spent in fallbacks get counted at runtime by
+     * arm7_jit_fallback.
+     */
+    unsigned cycle_count = 0;
+
+    for (;;) {
+        arm7_inst inst = arm7_do_fetch_inst(arm7, pc);
+
+        if (arm7_jit_data_op(block, regbase_slot, inst, pc)) {
+            cycle_count += 3;
+            pc_synced = false;
+        } else if ((inst >> 28) == ARM7_COND_AL &&
+                   (inst & 0x0e000000) == 0x0a000000) {
+            // B, BL
+            uint32_t offs = inst & ((1 << 24) - 1);
+            if (offs & (1 << 23))
+                offs |= 0xff000000;
+            offs <<= 2;
+
+            if (inst & (1 << 24)) {
+                unsigned lr_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+                jit_set_slot(block, lr_slot, pc + 4);
+                jit_store_slot_offset(block, lr_slot, regbase_slot,
+                                      ARM7_REG_R0 + 14);
+                free_slot(block, lr_slot);
+            }
+
+            // two extra cycles to refill the pipeline
+            cycle_count += 3 + 2;
+            arm7_jit_jump_const(block, pc + 8 + offs);
+            return cycle_count;
+        } else {
+            if (!pc_synced) {
+                unsigned pc_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+                jit_set_slot(block, pc_slot, pc + 8);
+                jit_store_slot_offset(block, pc_slot, regbase_slot,
+                                      ARM7_REG_PC);
+                free_slot(block, pc_slot);
+                pc_synced = true;
+            }
+
+            jit_fallback(block, arm7_jit_fallback, inst);
+
+            if (arm7_jit_fallback_ends_block(inst)) {
+                unsigned addr_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+                jit_load_slot_offset(block, regbase_slot, ARM7_REG_PC,
+                                     addr_slot);
+                jit_add_const32(block, addr_slot, (uint32_t)-8);
+                jit_jump(block, addr_slot, addr_slot);
+                free_slot(block, addr_slot);
+                return cycle_count;
+            }
+        }
+
+        pc += 4;
+        if (++n_insts >= ARM7_JIT_MAX_INSTS || arm7_jit_page(pc) != page_no) {
+            arm7_jit_jump_const(block, pc);
+            return cycle_count;
+        }
+    }
+}
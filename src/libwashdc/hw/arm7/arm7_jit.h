@@ -0,0 +1,54 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#ifndef ARM7_JIT_H_
+#define ARM7_JIT_H_
+
+/*
+ * Dynamic recompiler for the AICA's ARM7.
+ *
+ * Blocks of ARM7 code are translated into jit_il and executed by the IL
+ * interpreter.  Simple data-processing instructions and unconditional branches
+ * get translated directly into IL; everything else falls back to the
+ * interpreter's instruction handlers.
+ *
+ * Compiled blocks are cached based on the address of their first instruction.
+ * Blocks never span more than one page of wave memory, and every page that has
+ * code compiled from it is flagged in the aica_wave_mem's page_flags so that
+ * writes to it (whether they come from the SH4, from DMA or from the ARM7
+ * itself) mark it as dirty.  Blocks compiled from dirty pages get thrown away
+ * before the next block is executed.
+ */
+
+struct arm7;
+
+void arm7_jit_init(void);
+void arm7_jit_cleanup(void);
+
+/*
+ * execute one block of ARM7 code at the ARM7's current PC, compiling it first
+ * if necessary.  The return value is the number of ARM7 cycles the block took.
+ */
+unsigned arm7_jit_run_block(struct arm7 *arm7);
+
+#endif
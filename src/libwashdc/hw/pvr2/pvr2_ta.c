@@ -261,6 +261,21 @@ void pvr2_ta_fifo_poly_write_8(addr32_t addr, uint8_t val, void *ctxt) {
     RAISE_ERROR(ERROR_UNIMPLEMENTED);
 }
 
+void pvr2_ta_fifo_poly_write_block(addr32_t addr, void const *src,
+                                   unsigned n_bytes, void *ctxt) {
+    struct pvr2 *pvr2 = (struct pvr2*)ctxt;
+
+    if (n_bytes % 4) {
+        error_set_address(addr);
+        error_set_length(n_bytes);
+        error_set_feature("partial-word block writes to the PVR2 TA FIFO");
+        RAISE_ERROR(ERROR_UNIMPLEMENTED);
+    }
+
+    PVR2_TRACE("writing %u bytes to TA polygon FIFO\n", n_bytes);
+    pvr2_tafifo_input_words(pvr2, src, n_bytes / 4);
+}
+
 float pvr2_ta_fifo_poly_read_float(addr32_t addr, void *ctxt) {
     uint32_t tmp = pvr2_ta_fifo_poly_read_32(addr, ctxt);
     float ret;
@@ -963,6 +978,29 @@ void pvr2_tafifo_input(struct pvr2 *pvr2, uint32_t dword) {
         handle_packet(pvr2);
 }
 
+void pvr2_tafifo_input_words(struct pvr2 *pvr2, void const *dat,
+                             unsigned n_words) {
+    struct pvr2_ta *ta = &pvr2->ta;
+    uint8_t const *dat8 = (uint8_t const*)dat;
+
+    while (n_words) {
+        // fill up to the end of the current 32-byte chunk
+        unsigned word_count = ta->fifo_state.ta_fifo_word_count;
+        unsigned n_copy = 8 - word_count % 8;
+        if (n_copy > n_words)
+            n_copy = n_words;
+
+        memcpy(ta->fifo_state.ta_fifo32 + word_count, dat8,
+               n_copy * sizeof(uint32_t));
+        ta->fifo_state.ta_fifo_word_count = word_count + n_copy;
+        dat8 += n_copy * sizeof(uint32_t);
+        n_words -= n_copy;
+
+        if (!(ta->fifo_state.ta_fifo_word_count % 8))
+            handle_packet(pvr2);
+    }
+}
+
 static void dump_fifo(struct pvr2 *pvr2) {
 #ifdef ENABLE_LOG_DEBUG
     unsigned idx;
@@ -1598,7 +1636,9 @@ struct memory_interface pvr2_ta_fifo_intf = {
     .writefloat = pvr2_ta_fifo_poly_write_float,
     .write32 = pvr2_ta_fifo_poly_write_32,
     .write16 = pvr2_ta_fifo_poly_write_16,
-    .write8 = pvr2_ta_fifo_poly_write_8
+    .write8 = pvr2_ta_fifo_poly_write_8,
+
+    .write_block = pvr2_ta_fifo_poly_write_block
 };
 
 unsigned pvr2_ta_fifo_rem_bytes(void) {
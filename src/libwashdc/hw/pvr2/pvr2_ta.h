@@ -59,6 +59,9 @@ void pvr2_ta_fifo_poly_write_16(addr32_t addr, uint16_t val, void *ctxt);
 uint8_t pvr2_ta_fifo_poly_read_8(addr32_t addr, void *ctxt);
 void pvr2_ta_fifo_poly_write_8(addr32_t addr, uint8_t val, void *ctxt);
 
+void pvr2_ta_fifo_poly_write_block(addr32_t addr, void const *src,
+                                   unsigned n_bytes, void *ctxt);
+
 extern struct memory_interface pvr2_ta_fifo_intf;
 
 void pvr2_ta_startrender(struct pvr2 *pvr2);
@@ -560,6 +563,13 @@ struct pvr2_ta_param_dims pvr2_ta_get_param_dims(unsigned control_word);
  */
 void pvr2_tafifo_input(struct pvr2 *pvr2, uint32_t dword);
 
+/*
+ * same as calling pvr2_tafifo_input on each of the n_words 32-bit ints at dat,
+ * except that they get copied into the FIFO a packet at a time.
+ */
+void pvr2_tafifo_input_words(struct pvr2 *pvr2, void const *dat,
+                             unsigned n_words);
+
 void pvr2_ta_list_continue(struct pvr2 *pvr2);
 
 #endif
@@ -630,6 +630,90 @@ static void pvr2_tex_mem_area64_write_double(addr32_t addr, double val, void *ct
     pvr2_tex_mem_64bit_write_double(pvr2, addr & PVR2_TEX_MEM_MASK, val);
 }
 
+/*
+ * block transfers wrap around at the end of texture memory the same way that
+ * the PVR2_TEX_MEM_MASK does for the single accesses above.
+ */
+static void pvr2_tex_mem_area32_read_block(addr32_t addr, void *dst,
+                                           unsigned n_bytes, void *ctxt) {
+    struct pvr2 *pvr2 = (struct pvr2*)ctxt;
+    uint8_t *dst8 = (uint8_t*)dst;
+
+    addr &= PVR2_TEX_MEM_MASK;
+    while (n_bytes) {
+        unsigned chunk = PVR2_TEX32_MEM_LEN - addr;
+        if (chunk > n_bytes)
+            chunk = n_bytes;
+        pvr2_tex_mem_32bit_read_raw(pvr2, dst8, addr, chunk);
+        dst8 += chunk;
+        n_bytes -= chunk;
+        addr = 0;
+    }
+}
+
+static void pvr2_tex_mem_area32_write_block(addr32_t addr, void const *src,
+                                            unsigned n_bytes, void *ctxt) {
+    struct pvr2 *pvr2 = (struct pvr2*)ctxt;
+    uint8_t const *src8 = (uint8_t const*)src;
+
+    addr &= PVR2_TEX_MEM_MASK;
+    while (n_bytes) {
+        unsigned chunk = PVR2_TEX32_MEM_LEN - addr;
+        if (chunk > n_bytes)
+            chunk = n_bytes;
+        pvr2_tex_mem_32bit_write_raw(pvr2, addr, src8, chunk);
+        src8 += chunk;
+        n_bytes -= chunk;
+        addr = 0;
+    }
+}
+
+/*
+ * the 64-bit area interleaves the two banks every 4 bytes, so whole dwords
+ * use the dword functions and anything else goes a byte at a time.
+ */
+static void pvr2_tex_mem_area64_read_block(addr32_t addr, void *dst,
+                                           unsigned n_bytes, void *ctxt) {
+    struct pvr2 *pvr2 = (struct pvr2*)ctxt;
+    uint8_t *dst8 = (uint8_t*)dst;
+
+    addr &= PVR2_TEX_MEM_MASK;
+    while (n_bytes) {
+        unsigned chunk = PVR2_TEX64_MEM_LEN - addr;
+        if (chunk > n_bytes)
+            chunk = n_bytes;
+        if (addr % 4 == 0 && chunk % 4 == 0)
+            pvr2_tex_mem_64bit_read_dwords(pvr2, (uint32_t*)dst8,
+                                           addr, chunk / 4);
+        else
+            pvr2_tex_mem_64bit_read_raw(pvr2, dst8, addr, chunk);
+        dst8 += chunk;
+        n_bytes -= chunk;
+        addr = 0;
+    }
+}
+
+static void pvr2_tex_mem_area64_write_block(addr32_t addr, void const *src,
+                                            unsigned n_bytes, void *ctxt) {
+    struct pvr2 *pvr2 = (struct pvr2*)ctxt;
+    uint8_t const *src8 = (uint8_t const*)src;
+
+    addr &= PVR2_TEX_MEM_MASK;
+    while (n_bytes) {
+        unsigned chunk = PVR2_TEX64_MEM_LEN - addr;
+        if (chunk > n_bytes)
+            chunk = n_bytes;
+        if (addr % 4 == 0 && chunk % 4 == 0)
+            pvr2_tex_mem_64bit_write_dwords(pvr2, addr,
+                                            (uint32_t const*)src8, chunk / 4);
+        else
+            pvr2_tex_mem_64bit_write_raw(pvr2, addr, src8, chunk);
+        src8 += chunk;
+        n_bytes -= chunk;
+        addr = 0;
+    }
+}
+
 static uint8_t pvr2_tex_mem_unused_read_8(addr32_t addr, void *ctxt) {
     return ~0;
 }
@@ -676,7 +760,10 @@ struct memory_interface pvr2_tex_mem_area32_intf = {
     .writefloat = pvr2_tex_mem_area32_write_float,
     .write32 = pvr2_tex_mem_area32_write_32,
     .write16 = pvr2_tex_mem_area32_write_16,
-    .write8 = pvr2_tex_mem_area32_write_8
+    .write8 = pvr2_tex_mem_area32_write_8,
+
+    .read_block = pvr2_tex_mem_area32_read_block,
+    .write_block = pvr2_tex_mem_area32_write_block
 };
 
 struct memory_interface pvr2_tex_mem_area64_intf = {
@@ -690,7 +777,10 @@ struct memory_interface pvr2_tex_mem_area64_intf = {
     .writefloat = pvr2_tex_mem_area64_write_float,
     .write32 = pvr2_tex_mem_area64_write_32,
     .write16 = pvr2_tex_mem_area64_write_16,
-    .write8 = pvr2_tex_mem_area64_write_8
+    .write8 = pvr2_tex_mem_area64_write_8,
+
+    .read_block = pvr2_tex_mem_area64_read_block,
+    .write_block = pvr2_tex_mem_area64_write_block
 };
 
 struct memory_interface pvr2_tex_mem_unused_intf = {
@@ -215,6 +215,23 @@ static DEF_ERROR_INT_ATTR(macroblock_count_y)
 static DEF_ERROR_INT_ATTR(cur_macroblock_x)
 static DEF_ERROR_INT_ATTR(cur_macroblock_y)
 
+static void pvr2_yuv_macroblock_done(struct pvr2 *pvr2) {
+    struct pvr2_yuv *yuv = &pvr2->yuv;
+
+    yuv->macroblock_offset = 0;
+
+    if (yuv->cur_macroblock_x >= yuv->macroblock_count_x ||
+        yuv->cur_macroblock_y >= yuv->macroblock_count_y) {
+        error_set_cur_macroblock_x(yuv->cur_macroblock_x);
+        error_set_cur_macroblock_y(yuv->cur_macroblock_y);
+        error_set_macroblock_count_x(yuv->macroblock_count_x);
+        error_set_macroblock_count_y(yuv->macroblock_count_y);
+        RAISE_ERROR(ERROR_INTEGRITY);
+    }
+
+    pvr2_yuv_macroblock(pvr2);
+}
+
 static void pvr2_yuv_input_byte(struct pvr2 *pvr2, unsigned dat) {
     struct pvr2_yuv *yuv = &pvr2->yuv;
     if (yuv->fmt != PVR2_YUV_FMT_420)
@@ -230,19 +247,49 @@ static void pvr2_yuv_input_byte(struct pvr2 *pvr2, unsigned dat) {
         RAISE_ERROR(ERROR_INTEGRITY);
     }
 
-    if (yuv->macroblock_offset == 384) {
-        yuv->macroblock_offset = 0;
+    if (yuv->macroblock_offset == 384)
+        pvr2_yuv_macroblock_done(pvr2);
+}
 
-        if (yuv->cur_macroblock_x >= yuv->macroblock_count_x ||
-            yuv->cur_macroblock_y >= yuv->macroblock_count_y) {
-            error_set_cur_macroblock_x(yuv->cur_macroblock_x);
-            error_set_cur_macroblock_y(yuv->cur_macroblock_y);
-            error_set_macroblock_count_x(yuv->macroblock_count_x);
-            error_set_macroblock_count_y(yuv->macroblock_count_y);
+/*
+ * same as calling pvr2_yuv_input_byte for each byte, but this copies as much
+ * as it can into the U, V and Y buffers at a time.
+ */
+static void
+pvr2_yuv_input_bytes(struct pvr2 *pvr2, uint8_t const *dat, unsigned n_bytes) {
+    struct pvr2_yuv *yuv = &pvr2->yuv;
+    if (yuv->fmt != PVR2_YUV_FMT_420)
+        RAISE_ERROR(ERROR_UNIMPLEMENTED);
+
+    while (n_bytes) {
+        unsigned offs = yuv->macroblock_offset;
+        uint8_t *dst;
+        unsigned seg_end;
+
+        if (offs < 64) {
+            dst = yuv->u_buf + offs;
+            seg_end = 64;
+        } else if (offs < 128) {
+            dst = yuv->v_buf + (offs - 64);
+            seg_end = 128;
+        } else if (offs < 384) {
+            dst = yuv->y_buf + (offs - 128);
+            seg_end = 384;
+        } else {
             RAISE_ERROR(ERROR_INTEGRITY);
         }
 
-        pvr2_yuv_macroblock(pvr2);
+        unsigned chunk = seg_end - offs;
+        if (chunk > n_bytes)
+            chunk = n_bytes;
+
+        memcpy(dst, dat, chunk);
+        yuv->macroblock_offset += chunk;
+        dat += chunk;
+        n_bytes -= chunk;
+
+        if (yuv->macroblock_offset == 384)
+            pvr2_yuv_macroblock_done(pvr2);
     }
 }
 
@@ -308,6 +355,11 @@ pvr2_ta_fifo_yuv_write_double(addr32_t addr, double val, void *ctxt) {
     RAISE_ERROR(ERROR_UNIMPLEMENTED);
 }
 
+static void pvr2_ta_fifo_yuv_write_block(addr32_t addr, void const *src,
+                                         unsigned n_bytes, void *ctxt) {
+    pvr2_yuv_input_bytes((struct pvr2*)ctxt, (uint8_t const*)src, n_bytes);
+}
+
 struct memory_interface pvr2_ta_yuv_fifo_intf = {
     .readdouble = pvr2_ta_fifo_yuv_read_double,
     .readfloat = pvr2_ta_fifo_yuv_read_float,
@@ -319,5 +371,7 @@ struct memory_interface pvr2_ta_yuv_fifo_intf = {
     .writefloat = pvr2_ta_fifo_yuv_write_float,
     .write32 = pvr2_ta_fifo_yuv_write_32,
     .write16 = pvr2_ta_fifo_yuv_write_16,
-    .write8 = pvr2_ta_fifo_yuv_write_8
+    .write8 = pvr2_ta_fifo_yuv_write_8,
+
+    .write_block = pvr2_ta_fifo_yuv_write_block
 };
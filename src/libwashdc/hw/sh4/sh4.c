@@ -118,6 +118,14 @@ void sh4_on_hard_reset(Sh4 *sh4) {
     sh4_ocache_clear(&sh4->ocache);
 
     sh4->exec_state = SH4_EXEC_STATE_NORM;
+
+    /*
+     * the registers the TMU, DMAC and SCIF use to decide whether their irq
+     * lines are active just got reset, so the pending bitmask needs to follow.
+     * This also puts the IRL bus back to 15 (nothing), which is what it is
+     * while it's idle since it's active-low.
+     */
+    sh4_intc_rebuild_pending(sh4);
 }
 
 reg32_t sh4_get_pc(Sh4 *sh4) {
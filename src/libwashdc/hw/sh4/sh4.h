@@ -38,6 +38,7 @@
 #include "sh4_excp.h"
 #include "sh4_scif.h"
 #include "sh4_dmac.h"
+#include "sh4_predecode.h"
 #include "dc_sched.h"
 #include "atomics.h"
 
@@ -133,6 +134,9 @@ struct Sh4 {
 
     struct sh4_mem mem;
 
+    // the interpreter's predecoded instructions
+    struct sh4_predecode predecode;
+
 #ifdef JIT_PROFILE
     struct jit_profile_ctxt jit_profile;
 #endif
@@ -329,22 +333,22 @@ static inline InstOpcode const *sh4_decode_inst(cpu_inst_param inst) {
  * as the instruction's issue cycles due to the dual-issue pipeline of the sh4.
  */
 static inline unsigned
-sh4_count_inst_cycles(InstOpcode const *op, unsigned *last_inst_type_p) {
+sh4_count_cycles(unsigned group, unsigned issue, unsigned *last_inst_type_p) {
     unsigned last_inst_type = *last_inst_type_p;
     unsigned n_cycles;
     if ((last_inst_type == SH4_GROUP_NONE) ||
-        ((op->group == SH4_GROUP_CO) ||
+        ((group == SH4_GROUP_CO) ||
          (last_inst_type == SH4_GROUP_CO) ||
-         ((last_inst_type == op->group) && (op->group != SH4_GROUP_MT)))) {
+         ((last_inst_type == group) && (group != SH4_GROUP_MT)))) {
         // This instruction was not free
-        n_cycles = op->issue;
+        n_cycles = issue;
 
         /*
          * no need to check for SH4_GROUP_CO here because we'll do that when we
          * check for last_inst_type==SH4_GROUP_CO next time we're in this if
          * statement
          */
-        last_inst_type = op->group;
+        last_inst_type = group;
     } else {
         /*
          * cash in on the dual-issue pipeline's "free" instruction and set
@@ -358,6 +362,11 @@ sh4_count_inst_cycles(InstOpcode const *op, unsigned *last_inst_type_p) {
     return n_cycles;
 }
 
+static inline unsigned
+sh4_count_inst_cycles(InstOpcode const *op, unsigned *last_inst_type_p) {
+    return sh4_count_cycles(op->group, op->issue, last_inst_type_p);
+}
+
 /*
  * In Little-Endian mode, the SH-4 swaps the upper and lower quads of
  * double-precision floating point.  The two quads are themselves still
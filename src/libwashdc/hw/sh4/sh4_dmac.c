@@ -46,6 +46,7 @@ struct SchedEvent raise_ch2_dma_int_event = {
 static bool ch2_dma_scheduled;
 
 static int sh4_dmac_irq_line(Sh4ExceptionCode *code, void *ctx);
+static void sh4_dmac_update_irq(Sh4 *sh4);
 
 void sh4_dmac_init(Sh4 *sh4) {
     sh4_register_irq_line(sh4, SH4_IRQ_DMAC, sh4_dmac_irq_line, sh4);
@@ -296,6 +297,7 @@ void sh4_dmac_chcr_reg_write_handler(Sh4 *sh4,
     }
 
     sh4->dmac.chcr[chan] = val;
+    sh4_dmac_update_irq(sh4);
 
     /*
      * TODO: I can't print here because KallistiOS programs seem to be
@@ -328,86 +330,24 @@ void sh4_dmac_dmaor_reg_write_handler(Sh4 *sh4,
 
 void sh4_dmac_transfer_to_mem(Sh4 *sh4, addr32_t transfer_dst, size_t unit_sz,
                               size_t n_units, void const *dat) {
-    size_t total_len = unit_sz * n_units;
-    struct memory_map_region *region =
-        memory_map_get_region(sh4->mem.map,
-                              transfer_dst & ~0xe0000000, total_len);
-    void *ctx = region->ctxt;
-
-    if (total_len % 4 == 0) {
-        memory_map_write32_func write32 = region->intf->write32;
-        total_len /= 4;
-        uint32_t const *dat32 = (uint32_t const*)dat;
-        while (total_len) {
-            write32(transfer_dst, *dat32, ctx);
-            transfer_dst += 4;
-            dat32++;
-            total_len--;
-        }
-    } else if (total_len % 2 == 0) {
-        memory_map_write16_func write16 = region->intf->write16;
-        total_len /= 2;
-        uint16_t const *dat16 = (uint16_t const*)dat;
-        while (total_len) {
-            write16(transfer_dst, *dat16, ctx);
-            transfer_dst += 2;
-            dat16++;
-            total_len--;
-        }
-    } else {
-        memory_map_write8_func write8 = region->intf->write8;
-        uint8_t const *dat8 = (uint8_t const*)dat;
-        while (total_len) {
-            write8(transfer_dst, *dat8, ctx);
-            transfer_dst++;
-            dat8++;
-            total_len--;
-        }
-    }
+    memory_map_write_block(sh4->mem.map, transfer_dst & ~0xe0000000,
+                           dat, unit_sz * n_units);
 }
 
 void sh4_dmac_transfer_from_mem(Sh4 *sh4, addr32_t transfer_src, size_t unit_sz,
                                 size_t n_units, void *dat) {
-    size_t total_len = unit_sz * n_units;
-    if (total_len % 4 == 0) {
-        total_len /= 4;
-        uint32_t *dat32 = (uint32_t*)dat;
-        while (total_len) {
-            *dat32 = memory_map_read_32(sh4->mem.map,
-                                        transfer_src & ~0xe0000000);
-            dat32++;
-            total_len--;
-            transfer_src += 4;
-        }
-    } else if (total_len % 2 == 0) {
-        total_len /= 2;
-        uint16_t *dat16 = (uint16_t*)dat;
-        while (total_len) {
-            *dat16 = memory_map_read_16(sh4->mem.map,
-                                        transfer_src & ~0xe0000000);
-            dat16++;
-            total_len--;
-            transfer_src += 2;
-        }
-    } else {
-        uint8_t *dat8 = (uint8_t*)dat;
-        while (total_len) {
-            *dat8 = memory_map_read_8(sh4->mem.map,
-                                      transfer_src & ~0xe0000000);
-            dat8++;
-            total_len--;
-            transfer_src++;
-        }
-    }
+    memory_map_read_block(sh4->mem.map, transfer_src & ~0xe0000000,
+                          dat, unit_sz * n_units);
 }
 
 static DEF_ERROR_U32_ATTR(dma_xfer_src)
 static DEF_ERROR_U32_ATTR(dma_xfer_dst)
 
+#define SH4_DMAC_BOUNCE_LEN 4096
+
 void sh4_dmac_transfer_words(Sh4 *sh4, addr32_t transfer_src,
                              addr32_t transfer_dst, size_t n_words) {
     struct memory_map *map = sh4->mem.map;
-    size_t counter;
 
     struct memory_map_region *src_region = memory_map_get_region(map, transfer_src,
                                                                  n_words * sizeof(uint32_t));
@@ -421,20 +361,22 @@ void sh4_dmac_transfer_words(Sh4 *sh4, addr32_t transfer_src,
         RAISE_ERROR(ERROR_UNIMPLEMENTED);
     }
 
-    memory_map_read32_func read32 = src_region->intf->read32;
-    memory_map_write32_func write32 = dst_region->intf->write32;
-    void *src_ctx = src_region->ctxt;
-    void *dst_ctx = dst_region->ctxt;
-
-    for (counter = 0; counter < n_words; counter++) {
-        CHECK_R_WATCHPOINT(transfer_src, uint32_t);
-        CHECK_W_WATCHPOINT(transfer_dst, uint32_t);
-
-        uint32_t word = read32(transfer_src, src_ctx);
-        write32(transfer_dst, word, dst_ctx);
-
-        transfer_src += sizeof(uint32_t);
-        transfer_dst += sizeof(uint32_t);
+    /*
+     * go through a bounce buffer so that both ends of the transfer can use
+     * their regions' block handlers.
+     */
+    uint8_t buf[SH4_DMAC_BOUNCE_LEN];
+    size_t n_bytes = n_words * sizeof(uint32_t);
+    while (n_bytes) {
+        unsigned chunk = n_bytes < SH4_DMAC_BOUNCE_LEN ?
+            n_bytes : SH4_DMAC_BOUNCE_LEN;
+
+        memory_map_read_block(map, transfer_src, buf, chunk);
+        memory_map_write_block(map, transfer_dst, buf, chunk);
+
+        transfer_src += chunk;
+        transfer_dst += chunk;
+        n_bytes -= chunk;
     }
 }
 
@@ -549,6 +491,7 @@ static void raise_ch2_dma_int_event_handler(struct SchedEvent *event) {
     // raise the interrupt
     sh4->dmac.chcr[2] |= SH4_DMAC_CHCR_TE_MASK;
     sh4->dmac.dma_ack[2] = false;
+    sh4_dmac_update_irq(sh4);
     sh4_refresh_intc(sh4);
 
     ch2_dma_scheduled = false;
@@ -563,3 +506,8 @@ static int sh4_dmac_irq_line(Sh4ExceptionCode *code, void *ctx) {
     }
     return 0;
 }
+
+static void sh4_dmac_update_irq(Sh4 *sh4) {
+    Sh4ExceptionCode code;
+    sh4_set_irq_pending(sh4, SH4_IRQ_DMAC, sh4_dmac_irq_line(&code, sh4));
+}
@@ -257,6 +257,10 @@ int sh4_get_next_irq_line(Sh4 const *sh4, struct sh4_irq_meta *irq_meta) {
 
     /* TODO - NMIs */
 
+    if (!sh4_intc_any_pending(&sh4->intc))
+        return -1;
+
+    uint32_t pending = sh4->intc.pending;
     int max_prio = -1;
     unsigned max_prio_line = -1;
     Sh4ExceptionCode max_prio_code;
@@ -271,6 +275,9 @@ int sh4_get_next_irq_line(Sh4 const *sh4, struct sh4_irq_meta *irq_meta) {
 
     unsigned line;
     for (line = 0; line <= last_line; line++) {
+        if (!(pending & (1 << line)))
+            continue;
+
         int prio;
         /*
          * irl priorities are fixed.  Some versions of the SH4 let you
@@ -313,12 +320,7 @@ int sh4_get_next_irq_line(Sh4 const *sh4, struct sh4_irq_meta *irq_meta) {
 
     // Now handle the four-bit IRL interrupt as a special case if it's enabled
     if (!(sh4->reg[SH4_REG_ICR] & SH4_ICR_IRLM_MASK)) {
-        unsigned irl_val;
-
-        if (sh4->intc.irl_line)
-            irl_val = sh4->intc.irl_line(sh4->intc.irl_line_arg) & 0xf;
-        else
-            irl_val = 0xf;
+        unsigned irl_val = sh4->intc.irl & 0xf;
 
         // since it's active-low, 0xf == no interrupt
         if (irl_val != 0xf) {
@@ -457,7 +459,26 @@ sh4_register_irq_line(Sh4 *sh4, int irq_line, sh4_irq_line_fn fn, void *argp) {
     sh4->intc.irq_line_args[irq_line] = argp;
 }
 
-void sh4_register_irl_line(Sh4 *sh4, sh4_irl_line_fn fn, void *argp) {
-    sh4->intc.irl_line = fn;
-    sh4->intc.irl_line_arg = argp;
+void sh4_set_irq_pending(Sh4 *sh4, int irq_line, bool pending) {
+    if (pending)
+        sh4->intc.pending |= 1 << irq_line;
+    else
+        sh4->intc.pending &= ~(1 << irq_line);
+}
+
+void sh4_intc_rebuild_pending(Sh4 *sh4) {
+    Sh4ExceptionCode code;
+    int line;
+
+    sh4->intc.pending = 0;
+    for (line = 0; line < SH4_IRQ_COUNT; line++)
+        if (sh4_irq_line(sh4, line, &code))
+            sh4->intc.pending |= 1 << line;
+
+    // whoever is driving the IRL bus will set it again next time it changes
+    sh4->intc.irl = 0xf;
+}
+
+void sh4_set_irl(Sh4 *sh4, unsigned irl) {
+    sh4->intc.irl = irl & 0xf;
 }
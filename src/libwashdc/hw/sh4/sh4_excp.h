@@ -23,6 +23,7 @@
 #ifndef SH4_EXCP_H_
 #define SH4_EXCP_H_
 
+#include <stdint.h>
 #include <stdbool.h>
 
 #include "sh4_reg.h"
@@ -140,10 +141,6 @@ enum {
  */
 typedef int(*sh4_irq_line_fn)(Sh4ExceptionCode *code, void *ctx);
 
-// returns the irl value, or 15 for nothing
-typedef int(*sh4_irl_line_fn)(void *ctx);
-
-
 // structure containing all data necessary to activate a pending IRQ
 struct sh4_irq_meta {
     int code;
@@ -153,14 +150,43 @@ struct sh4_intc {
     sh4_irq_line_fn irq_lines[SH4_IRQ_COUNT];
     void *irq_line_args[SH4_IRQ_COUNT];
 
-    sh4_irl_line_fn irl_line;
-    void *irl_line_arg;
+    /*
+     * one bit for each irq line (1 << SH4_IRQ_*) which is currently active.
+     * IRQ sources keep this up to date with sh4_set_irq_pending whenever their
+     * state changes so that checking for interrupts doesn't need to call every
+     * irq_lines function.  The irq_lines functions are only used to get the
+     * exception code for lines which are pending.
+     */
+    uint32_t pending;
+
+    // the value on the 4-bit IRL bus, or 15 for nothing
+    unsigned irl;
 };
 
 void
 sh4_register_irq_line(Sh4 *sh4, int irq_line,
                       sh4_irq_line_fn fn, void *argp);
-void sh4_register_irl_line(Sh4 *sh4, sh4_irl_line_fn fn, void *argp);
+
+/*
+ * These only update the intc's state, they don't check for interrupts.
+ * Callers are still responsible for calling sh4_refresh_intc or
+ * sh4_refresh_intc_deferred afterwards.
+ */
+void sh4_set_irq_pending(Sh4 *sh4, int irq_line, bool pending);
+void sh4_set_irl(Sh4 *sh4, unsigned irl);
+
+/*
+ * throw away the pending bitmask and recompute it by polling every registered
+ * irq_lines function.  The IRL bus goes back to 15 (nothing), so whatever
+ * drives it needs to set it again.  This gets called on reset so that nothing
+ * which was pending before the reset sticks around afterwards.
+ */
+void sh4_intc_rebuild_pending(Sh4 *sh4);
+
+// returns true if any irq line is active, regardless of priority
+static inline bool sh4_intc_any_pending(struct sh4_intc const *intc) {
+    return intc->pending || intc->irl != 0xf;
+}
 
 typedef struct sh4_intc sh4_intc;
 
@@ -65,15 +65,13 @@ SH4_ICACHE_READ_ADDR_ARRAY_TMPL(uint8_t, 8)
         /* according to SH4 hardware manual, programs can write to */   \
         /* the IC address array to invalidate specific cache */         \
         /* entries. */                                                  \
-        /* TODO: only invalidate the parts that need to be */           \
-        /* invalidated instead of the entire cache.  Also, check the */ \
-        /* v-bit in the value being written.  I think the invalidate */ \
-        /* is only if the v-bit being written is zero, but then that */ \
-        /* makes me wonder why they even let you specify a non-zero */  \
-        /* V bit if that does nothing. */                               \
+        /* TODO: check the v-bit in the value being written.  I */      \
+        /* think the invalidate is only if the v-bit being written */   \
+        /* is zero, but then that makes me wonder why they even let */  \
+        /* you specify a non-zero V bit if that does nothing. */        \
                                                                         \
         if (config_get_jit())                                           \
-            code_cache_invalidate_all();                                \
+            code_cache_invalidate_dirty();                              \
     }
 
 SH4_ICACHE_WRITE_ADDR_ARRAY_TMPL(float, float)
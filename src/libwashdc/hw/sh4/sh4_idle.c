@@ -0,0 +1,324 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#include <stdint.h>
+
+#include "washdc/MemoryMap.h"
+#include "config.h"
+#include "memory.h"
+#include "intmath.h"
+#include "sh4.h"
+#include "sh4_predecode.h"
+#include "sh4_idle.h"
+
+// register sets for the dataflow check in sh4_idle_loop_check
+#define IDLE_REG_GEN(reg_no) (1 << (reg_no))
+#define IDLE_REG_GBR (1 << 16)
+#define IDLE_REG_T (1 << 17)
+
+static inline unsigned idle_rn(uint16_t inst) {
+    return IDLE_REG_GEN((inst >> 8) & 0xf);
+}
+
+static inline unsigned idle_rm(uint16_t inst) {
+    return IDLE_REG_GEN((inst >> 4) & 0xf);
+}
+
+/*
+ * figure out which registers the given instruction reads and writes.  This
+ * returns false for anything that isn't allowed in an idle loop, which
+ * includes every instruction that writes to memory or has any side-effects
+ * other than setting registers.
+ */
+static bool idle_inst_regs(uint16_t inst, unsigned *rd, unsigned *wr) {
+    *rd = *wr = 0;
+
+    switch (inst >> 12) {
+    case 0x0:
+        if (inst == 0x0009) {
+            // NOP
+            return true;
+        } else if ((inst & 0xf00f) >= 0x000c && (inst & 0xf00f) <= 0x000e) {
+            // MOV.B, MOV.W, MOV.L @(R0, Rm), Rn
+            *rd = IDLE_REG_GEN(0) | idle_rm(inst);
+            *wr = idle_rn(inst);
+            return true;
+        } else if ((inst & 0xf0ff) == 0x0029) {
+            // MOVT Rn
+            *rd = IDLE_REG_T;
+            *wr = idle_rn(inst);
+            return true;
+        }
+        return false;
+    case 0x2:
+        switch (inst & 0xf) {
+        case 0x8:
+        case 0xc:
+            // TST Rm, Rn and CMP/STR Rm, Rn
+            *rd = idle_rm(inst) | idle_rn(inst);
+            *wr = IDLE_REG_T;
+            return true;
+        case 0x9:
+        case 0xa:
+        case 0xb:
+            // AND, XOR, OR Rm, Rn
+            *rd = idle_rm(inst) | idle_rn(inst);
+            *wr = idle_rn(inst);
+            return true;
+        }
+        return false;
+    case 0x3:
+        switch (inst & 0xf) {
+        case 0x0:
+        case 0x2:
+        case 0x3:
+        case 0x6:
+        case 0x7:
+            // CMP/EQ, CMP/HS, CMP/GE, CMP/HI, CMP/GT Rm, Rn
+            *rd = idle_rm(inst) | idle_rn(inst);
+            *wr = IDLE_REG_T;
+            return true;
+        }
+        return false;
+    case 0x4:
+        if ((inst & 0xf0ff) == 0x4011 || (inst & 0xf0ff) == 0x4015) {
+            // CMP/PZ Rn and CMP/PL Rn
+            *rd = idle_rn(inst);
+            *wr = IDLE_REG_T;
+            return true;
+        }
+        return false;
+    case 0x5:
+        // MOV.L @(disp, Rm), Rn
+        *rd = idle_rm(inst);
+        *wr = idle_rn(inst);
+        return true;
+    case 0x6:
+        switch (inst & 0xf) {
+        case 0x0:
+        case 0x1:
+        case 0x2:
+            // MOV.B, MOV.W, MOV.L @Rm, Rn
+        case 0x3:
+            // MOV Rm, Rn
+        case 0x7:
+            // NOT Rm, Rn
+        case 0xc:
+        case 0xd:
+        case 0xe:
+        case 0xf:
+            // EXTU.B, EXTU.W, EXTS.B, EXTS.W Rm, Rn
+            *rd = idle_rm(inst);
+            *wr = idle_rn(inst);
+            return true;
+        }
+        return false;
+    case 0x8:
+        switch ((inst >> 8) & 0xf) {
+        case 0x4:
+        case 0x5:
+            // MOV.B, MOV.W @(disp, Rm), R0
+            *rd = idle_rm(inst);
+            *wr = IDLE_REG_GEN(0);
+            return true;
+        case 0x8:
+            // CMP/EQ #imm, R0
+            *rd = IDLE_REG_GEN(0);
+            *wr = IDLE_REG_T;
+            return true;
+        }
+        return false;
+    case 0x9:
+    case 0xd:
+        // MOV.W, MOV.L @(disp, PC), Rn
+    case 0xe:
+        // MOV #imm, Rn
+        *wr = idle_rn(inst);
+        return true;
+    case 0xc:
+        switch ((inst >> 8) & 0xf) {
+        case 0x4:
+        case 0x5:
+        case 0x6:
+            // MOV.B, MOV.W, MOV.L @(disp, GBR), R0
+            *rd = IDLE_REG_GBR;
+            *wr = IDLE_REG_GEN(0);
+            return true;
+        case 0x8:
+            // TST #imm, R0
+            *rd = IDLE_REG_GEN(0);
+            *wr = IDLE_REG_T;
+            return true;
+        case 0x9:
+            // AND #imm, R0
+            *rd = IDLE_REG_GEN(0);
+            *wr = IDLE_REG_GEN(0);
+            return true;
+        case 0xc:
+            // TST.B #imm, @(R0, GBR)
+            *rd = IDLE_REG_GEN(0) | IDLE_REG_GBR;
+            *wr = IDLE_REG_T;
+            return true;
+        }
+        return false;
+    default:
+        return false;
+    }
+}
+
+/*
+ * figure out where the given branch instruction goes if it's taken.  Returns
+ * false if it isn't a branch that could close an idle loop.
+ */
+static bool idle_branch_decode(uint16_t branch, addr32_t branch_pc,
+                               addr32_t *head, bool *delay_slot,
+                               unsigned *rd) {
+    int32_t disp;
+
+    switch (branch >> 8) {
+    case 0x89:
+    case 0x8b:
+        // BT, BF
+        disp = (int8_t)(branch & 0xff);
+        *delay_slot = false;
+        *rd = IDLE_REG_T;
+        break;
+    case 0x8d:
+    case 0x8f:
+        // BT/S, BF/S
+        disp = (int8_t)(branch & 0xff);
+        *delay_slot = true;
+        *rd = IDLE_REG_T;
+        break;
+    default:
+        if ((branch & 0xf000) != 0xa000)
+            return false;
+        // BRA
+        disp = branch & 0x0fff;
+        if (disp & 0x0800)
+            disp |= 0xfffff000;
+        *delay_slot = true;
+        *rd = 0;
+    }
+
+    *head = branch_pc + 4 + disp * 2;
+    return true;
+}
+
+bool sh4_idle_loop_check(Sh4 *sh4, addr32_t branch_pc, addr32_t *head_out) {
+    if (!config_get_idle_skip())
+        return false;
+
+#ifdef ENABLE_MMU
+    // the address translation isn't worth the trouble here
+    if (sh4_mmu_at(sh4))
+        return false;
+#endif
+
+    uint16_t branch =
+        memory_map_read_16(sh4->mem.map, branch_pc & BIT_RANGE(0, 28));
+
+    addr32_t head;
+    bool delay_slot;
+    unsigned branch_rd;
+    if (!idle_branch_decode(branch, branch_pc, &head, &delay_slot, &branch_rd))
+        return false;
+
+    if (head > branch_pc ||
+        (branch_pc - head) / 2 >= SH4_IDLE_LOOP_MAX_INSTS)
+        return false;
+
+    /*
+     * loops that cross a page boundary are rejected because the interpreter
+     * caches this verdict in the branch's predecode entry, which only gets
+     * thrown out when the branch's own page is written to.  If the loop's head
+     * or delay slot were on a neighbouring page, self-modifying code could
+     * rewrite them and the stale "idle" verdict would stick around.
+     */
+    addr32_t loop_end = delay_slot ? branch_pc + 2 : branch_pc;
+    if ((head & ~(MEMORY_PAGE_SIZE - 1)) !=
+        (loop_end & ~(MEMORY_PAGE_SIZE - 1)))
+        return false;
+
+    /*
+     * live_in is every register that gets read before the loop writes to it,
+     * written is every register the loop writes to.  If those have anything
+     * in common then the loop depends on what happened in its last iteration.
+     */
+    unsigned live_in = 0, written = 0, rd, wr;
+    addr32_t pc;
+    for (pc = head; pc < branch_pc; pc += 2) {
+        uint16_t inst = memory_map_read_16(sh4->mem.map, pc & BIT_RANGE(0, 28));
+        if (!idle_inst_regs(inst, &rd, &wr))
+            return false;
+        live_in |= rd & ~written;
+        written |= wr;
+    }
+
+    live_in |= branch_rd & ~written;
+
+    if (delay_slot) {
+        uint16_t inst =
+            memory_map_read_16(sh4->mem.map, (branch_pc + 2) & BIT_RANGE(0, 28));
+        if (!idle_inst_regs(inst, &rd, &wr))
+            return false;
+        live_in |= rd & ~written;
+        written |= wr;
+    }
+
+    if (live_in & written)
+        return false;
+
+    if (head_out)
+        *head_out = head;
+    return true;
+}
+
+void sh4_idle_loop_notify(Sh4 *sh4, struct sh4_predecode_ent *ent,
+                          addr32_t pc) {
+    addr32_t head;
+
+    if (ent == &sh4->predecode.scratch) {
+        /*
+         * the scratch entry may have been reused for the delay slot by now,
+         * and it doesn't stick around anyways, so don't bother caching.
+         */
+        if (!sh4_idle_loop_check(sh4, pc, &head))
+            return;
+    } else {
+        if (ent->idle == SH4_PREDECODE_IDLE_UNKNOWN) {
+            ent->idle = sh4_idle_loop_check(sh4, pc, NULL) ?
+                SH4_PREDECODE_IDLE_YES : SH4_PREDECODE_IDLE_NO;
+        }
+        if (ent->idle != SH4_PREDECODE_IDLE_YES)
+            return;
+
+        bool delay_slot;
+        unsigned rd;
+        idle_branch_decode(ent->inst, pc, &head, &delay_slot, &rd);
+    }
+
+    // the loop only gets skipped when the branch is taken
+    if (sh4->reg[SH4_REG_PC] == head)
+        sh4_idle_fast_forward(sh4);
+}
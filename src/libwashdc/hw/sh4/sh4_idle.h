@@ -0,0 +1,93 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#ifndef SH4_IDLE_H_
+#define SH4_IDLE_H_
+
+#include <stdbool.h>
+
+#include "washdc/types.h"
+#include "dc_sched.h"
+#include "sh4.h"
+
+/*
+ * idle-loop detection.
+ *
+ * A lot of games spend most of their time spinning in a little loop that waits
+ * for an interrupt handler or some piece of hardware to change a value, e.g.:
+ *
+ *     wait_vblank:
+ *         mov.l @r1, r0
+ *         tst r0, r0
+ *         bt wait_vblank
+ *
+ * Every trip through a loop like that does exactly the same thing as the last
+ * one until something other than the SH4 changes what it's reading, and that
+ * can only happen when the scheduler runs an event.  So once the SH4 takes the
+ * branch back to the top of one of these loops, it can skip straight to its
+ * next event instead of burning host time getting there one iteration at a
+ * time.
+ *
+ * A loop qualifies if it ends with a branch back to its own beginning, it's no
+ * longer than SH4_IDLE_LOOP_MAX_INSTS, it fits within a single page of memory
+ * (including the delay slot), it doesn't write to memory and every
+ * register it reads is either left alone by the loop or written by the loop
+ * before it gets read, so that nothing carries over from one iteration to the
+ * next.  Only a handful of loads, compares and simple ALU ops are recognized.
+ *
+ * This isn't cycle-accurate: a loop that polls a free-running counter like
+ * TCNT will leave the loop at the first event after the counter reaches its
+ * target rather than right when it gets there.
+ */
+
+#define SH4_IDLE_LOOP_MAX_INSTS 8
+
+/*
+ * returns true if the branch instruction at branch_pc closes an idle loop, in
+ * which case the address of the top of the loop is written to head (unless
+ * it's NULL).  This always returns false if the idle_skip config option is
+ * off.
+ */
+bool sh4_idle_loop_check(Sh4 *sh4, addr32_t branch_pc, addr32_t *head);
+
+/*
+ * called by the interpreter after it executes a branch from the predecode
+ * cache which might close an idle loop.  pc is the address of the branch.
+ */
+void sh4_idle_loop_notify(Sh4 *sh4, struct sh4_predecode_ent *ent,
+                          addr32_t pc);
+
+/*
+ * use up the rest of the SH4's cycles until its next event.  This is also how
+ * the SLEEP instruction gets out of the way until an interrupt wakes it back
+ * up.
+ */
+static inline void sh4_idle_fast_forward(Sh4 *sh4) {
+    clock_set_cycle_stamp(sh4->clk, clock_target_stamp(sh4->clk));
+}
+
+static inline bool sh4_idle_sleeping(Sh4 const *sh4) {
+    return sh4->exec_state != SH4_EXEC_STATE_NORM;
+}
+
+#endif
@@ -35,6 +35,7 @@
 #include "sh4_mem.h"
 #include "sh4_tbl.h"
 #include "sh4_excp.h"
+#include "sh4_idle.h"
 #include "sh4_jit.h"
 #include "log.h"
 #include "intmath.h"
@@ -588,7 +589,7 @@ static struct InstOpcode opcode_list[] = {
       SH4_GROUP_MT, 1, 0xffff, 0x0018 },
 
     // SLEEP
-    { &sh4_inst_sleep, sh4_jit_fallback, false,
+    { &sh4_inst_sleep, sh4_jit_sleep, false,
       SH4_GROUP_CO, 4, 0xffff, 0x001b },
 
     // FRCHG
@@ -616,19 +617,19 @@ static struct InstOpcode opcode_list[] = {
       SH4_GROUP_EX, 1, 0xf0ff, 0x4010 },
 
     // ROTL Rn
-    { &sh4_inst_unary_rotl_gen, sh4_jit_fallback, false,
+    { &sh4_inst_unary_rotl_gen, sh4_jit_rotl_rn, false,
       SH4_GROUP_EX, 1, 0xf0ff, 0x4004 },
 
     // ROTR Rn
-    { &sh4_inst_unary_rotr_gen, sh4_jit_fallback, false,
+    { &sh4_inst_unary_rotr_gen, sh4_jit_rotr_rn, false,
       SH4_GROUP_EX, 1, 0xf0ff, 0x4005 },
 
     // ROTCL Rn
-    { &sh4_inst_unary_rotcl_gen, sh4_jit_fallback, false,
+    { &sh4_inst_unary_rotcl_gen, sh4_jit_rotcl_rn, false,
       SH4_GROUP_EX, 1, 0xf0ff, 0x4024 },
 
     // ROTCR Rn
-    { &sh4_inst_unary_rotcr_gen, sh4_jit_fallback, false,
+    { &sh4_inst_unary_rotcr_gen, sh4_jit_rotcr_rn, false,
       SH4_GROUP_EX, 1, 0xf0ff, 0x4025 },
 
     // SHAL Rn
@@ -682,7 +683,7 @@ static struct InstOpcode opcode_list[] = {
       SH4_GROUP_MT, 1, 0xff00, 0x8800 },
 
     // AND.B #imm, @(R0, GBR)
-    { &sh4_inst_binary_andb_imm_r0_gbr, sh4_jit_fallback, false,
+    { &sh4_inst_binary_andb_imm_r0_gbr, sh4_jit_andb_imm_r0_gbr, false,
       SH4_GROUP_CO, 4, 0xff00, 0xcd00 },
 
     // AND #imm, R0
@@ -690,7 +691,7 @@ static struct InstOpcode opcode_list[] = {
       SH4_GROUP_EX, 1, 0xff00, 0xc900 },
 
     // OR.B #imm, @(R0, GBR)
-    { &sh4_inst_binary_orb_imm_r0_gbr, sh4_jit_fallback, false,
+    { &sh4_inst_binary_orb_imm_r0_gbr, sh4_jit_orb_imm_r0_gbr, false,
       SH4_GROUP_CO, 4, 0xff00, 0xcf00 },
 
     // OR #imm, R0
@@ -702,7 +703,7 @@ static struct InstOpcode opcode_list[] = {
       SH4_GROUP_MT, 1, 0xff00, 0xc800 },
 
     // TST.B #imm, @(R0, GBR)
-    { &sh4_inst_binary_tstb_imm_r0_gbr, sh4_jit_fallback, false,
+    { &sh4_inst_binary_tstb_imm_r0_gbr, sh4_jit_tstb_imm_r0_gbr, false,
       SH4_GROUP_CO, 3, 0xff00, 0xcc00 },
 
     // XOR #imm, R0
@@ -710,7 +711,7 @@ static struct InstOpcode opcode_list[] = {
       SH4_GROUP_EX, 1, 0xff00, 0xca00 },
 
     // XOR.B #imm, @(R0, GBR)
-    { &sh4_inst_binary_xorb_imm_r0_gbr, sh4_jit_fallback, false,
+    { &sh4_inst_binary_xorb_imm_r0_gbr, sh4_jit_xorb_imm_r0_gbr, false,
       SH4_GROUP_CO, 4, 0xff00, 0xce00 },
 
     // BF label
@@ -758,7 +759,7 @@ static struct InstOpcode opcode_list[] = {
       SH4_GROUP_LS, 1, 0xf0ff, 0x00b3 },
 
     // PREF @Rn
-    { &sh4_inst_unary_pref_indgen, sh4_jit_fallback, false,
+    { &sh4_inst_unary_pref_indgen, sh4_jit_pref_arn, false,
       SH4_GROUP_LS, 1, 0xf0ff, 0x0083 },
 
     // JMP @Rn
@@ -901,7 +902,7 @@ static struct InstOpcode opcode_list[] = {
       SH4_GROUP_EX, 1, 0xf00f, 0x6009 },
 
     // XTRCT Rm, Rn
-    { &sh4_inst_binary_xtrct_gen_gen, sh4_jit_fallback, false,
+    { &sh4_inst_binary_xtrct_gen_gen, sh4_jit_xtrct_rm_rn, false,
       SH4_GROUP_EX, 1, 0xf00f, 0x200d },
 
     // ADD Rm, Rn
@@ -909,7 +910,7 @@ static struct InstOpcode opcode_list[] = {
       SH4_GROUP_EX, 1, 0xf00f, 0x300c },
 
     // ADDC Rm, Rn
-    { &sh4_inst_binary_addc_gen_gen, sh4_jit_fallback, false,
+    { &sh4_inst_binary_addc_gen_gen, sh4_jit_addc_rm_rn, false,
       SH4_GROUP_EX, 1, 0xf00f, 0x300e },
 
     // ADDV Rm, Rn
@@ -941,23 +942,23 @@ static struct InstOpcode opcode_list[] = {
       SH4_GROUP_MT, 1, 0xf00f, 0x200c },
 
     // DIV1 Rm, Rn
-    { &sh4_inst_binary_div1_gen_gen, sh4_jit_fallback, false,
+    { &sh4_inst_binary_div1_gen_gen, sh4_jit_div1_rm_rn, false,
       SH4_GROUP_EX, 1, 0xf00f, 0x3004 },
 
     // DIV0S Rm, Rn
-    { &sh4_inst_binary_div0s_gen_gen, sh4_jit_fallback, false,
+    { &sh4_inst_binary_div0s_gen_gen, sh4_jit_div0s_rm_rn, false,
       SH4_GROUP_EX, 1, 0xf00f, 0x2007 },
 
     // DIV0U
-    { &sh4_inst_noarg_div0u, sh4_jit_fallback, false,
+    { &sh4_inst_noarg_div0u, sh4_jit_div0u, false,
       SH4_GROUP_EX, 1, 0xffff, 0x0019 },
 
     // DMULS.L Rm, Rn
-    { &sh4_inst_binary_dmulsl_gen_gen, sh4_jit_fallback, false,
+    { &sh4_inst_binary_dmulsl_gen_gen, sh4_jit_dmulsl_rm_rn, false,
       SH4_GROUP_CO, 2, 0xf00f, 0x300d },
 
     // DMULU.L Rm, Rn
-    { &sh4_inst_binary_dmulul_gen_gen, sh4_jit_fallback, false,
+    { &sh4_inst_binary_dmulul_gen_gen, sh4_jit_dmulul_rm_rn, false,
       SH4_GROUP_CO, 2, 0xf00f, 0x3005 },
 
     // EXTS.B Rm, Rn
@@ -977,7 +978,7 @@ static struct InstOpcode opcode_list[] = {
       SH4_GROUP_EX, 1, 0xf00f, 0x600d },
 
     // MUL.L Rm, Rn
-    { &sh4_inst_binary_mull_gen_gen, sh4_jit_fallback, false,
+    { &sh4_inst_binary_mull_gen_gen, sh4_jit_mull_rm_rn, false,
       SH4_GROUP_CO, 2, 0xf00f, 0x0007 },
 
     // MULS.W Rm, Rn
@@ -993,7 +994,7 @@ static struct InstOpcode opcode_list[] = {
       SH4_GROUP_EX, 1, 0xf00f, 0x600b },
 
     // NEGC Rm, Rn
-    { &sh4_inst_binary_negc_gen_gen, sh4_jit_fallback, false,
+    { &sh4_inst_binary_negc_gen_gen, sh4_jit_negc_rm_rn, false,
       SH4_GROUP_EX, 1, 0xf00f, 0x600a },
 
     // SUB Rm, Rn
@@ -1001,7 +1002,7 @@ static struct InstOpcode opcode_list[] = {
       SH4_GROUP_EX, 1, 0xf00f, 0x3008 },
 
     // SUBC Rm, Rn
-    { &sh4_inst_binary_subc_gen_gen, sh4_jit_fallback, false,
+    { &sh4_inst_binary_subc_gen_gen, sh4_jit_subc_rm_rn, false,
       SH4_GROUP_EX, 1, 0xf00f, 0x300a },
 
     // SUBV Rm, Rn
@@ -1149,11 +1150,11 @@ static struct InstOpcode opcode_list[] = {
       SH4_GROUP_LS, 1, 0xf00f, 0x6006 },
 
     // MAC.L @Rm+, @Rn+
-    { &sh4_inst_binary_macl_indgeninc_indgeninc, sh4_jit_fallback,
+    { &sh4_inst_binary_macl_indgeninc_indgeninc, sh4_jit_macl_armp_arnp,
       false, SH4_GROUP_CO, 2, 0xf00f, 0x000f },
 
     // MAC.W @Rm+, @Rn+
-    { &sh4_inst_binary_macw_indgeninc_indgeninc, sh4_jit_fallback,
+    { &sh4_inst_binary_macw_indgeninc_indgeninc, sh4_jit_macw_armp_arnp,
       false, SH4_GROUP_CO, 2, 0xf00f, 0x400f },
 
     // MOV.B R0, @(disp, Rn)
@@ -1353,7 +1354,7 @@ static struct InstOpcode opcode_list[] = {
     // 1111nnnnmmmm0011
     // FDIV DRm, DRn
     // 1111nnn0mmm00011
-    { FPU_HANDLER(fdiv_fpu), sh4_jit_fallback, false,
+    { FPU_HANDLER(fdiv_fpu), sh4_jit_fdiv_frm_frn, false,
       SH4_GROUP_FE, 1, 0xf00f, 0xf003 },
 
     // FLOAT FPUL, FRn
@@ -1365,7 +1366,7 @@ static struct InstOpcode opcode_list[] = {
 
     // FMAC FR0, FRm, FRn
     // 1111nnnnmmmm1110
-    { FPU_HANDLER(fmac_fpu), sh4_jit_fallback, false,
+    { FPU_HANDLER(fmac_fpu), sh4_jit_fmac_fr0_frm_frn, false,
       SH4_GROUP_FE, 1, 0xf00f, 0xf00e },
 
     // FMUL FRm, FRn
@@ -1386,7 +1387,7 @@ static struct InstOpcode opcode_list[] = {
     // 1111nnnn01101101
     // FSQRT DRn
     // 1111nnn001101101
-    { FPU_HANDLER(fsqrt_fpu), sh4_jit_fallback, false,
+    { FPU_HANDLER(fsqrt_fpu), sh4_jit_fsqrt_frn, false,
       SH4_GROUP_FE, 1, 0xf0ff, 0xf06d },
 
     // FSUB FRm, FRn
@@ -1446,23 +1447,23 @@ static struct InstOpcode opcode_list[] = {
       SH4_GROUP_CO, 1, 0xf0ff, 0x4052 },
 
     // FIPR FVm, FVn - vector dot product
-    { &sh4_inst_binary_fipr_fv_fv, sh4_jit_fallback, false,
+    { &sh4_inst_binary_fipr_fv_fv, sh4_jit_fipr_fvm_fvn, false,
       SH4_GROUP_FE, 1, 0xf0ff, 0xf0ed },
 
     // FTRV XMTRX, FVn - multiple vector by matrix
-    { &sh4_inst_binary_fitrv_mxtrx_fv, sh4_jit_fallback, false,
+    { &sh4_inst_binary_fitrv_mxtrx_fv, sh4_jit_ftrv_xmtrx_fvn, false,
       SH4_GROUP_FE, 1, 0xf3ff, 0xf1fd },
 
     // FSCA FPUL, DRn - sine/cosine table lookup
     // TODO: the issue cycle count here might be wrong, I couldn't find that
     //       value for this instruction
-    { FPU_HANDLER(fsca_fpu), sh4_jit_fallback, false,
+    { FPU_HANDLER(fsca_fpu), sh4_jit_fsca_fpul_drn, false,
       SH4_GROUP_FE, 1, 0xf1ff, 0xf0fd },
 
     // FSRRA FRn
     // 1111nnnn01111101
     // TODO: the issue cycle for this opcode might be wrong as well
-    { FPU_HANDLER(fsrra_fpu), sh4_jit_fallback, false,
+    { FPU_HANDLER(fsrra_fpu), sh4_jit_fsrra_frn, false,
       SH4_GROUP_FE, 1, 0xf0ff, 0xf07d },
 
     { NULL }
@@ -1728,6 +1729,13 @@ void sh4_inst_sleep(void *cpu, cpu_inst_param inst) {
             sh4->exec_state = SH4_EXEC_STATE_STANDBY;
         else
             sh4->exec_state = SH4_EXEC_STATE_SLEEP;
+
+        /*
+         * nothing happens until the next interrupt, and that can only come
+         * from an event.  The run loops won't execute anything while
+         * exec_state is not SH4_EXEC_STATE_NORM.
+         */
+        sh4_idle_fast_forward(sh4);
     }
 }
 
@@ -3914,7 +3922,8 @@ void sh4_inst_binary_negc_gen_gen(void *cpu, cpu_inst_param inst) {
     uint32_t dst = tmp - flag_t_in;
     reg32_t flag_t_out = (tmp || dst > tmp);
 
-    sh4->reg[SH4_REG_SR] |= (flag_t_out << SH4_SR_FLAG_T_SHIFT);
+    sh4->reg[SH4_REG_SR] = (sh4->reg[SH4_REG_SR] & ~SH4_SR_FLAG_T_MASK) |
+        (flag_t_out << SH4_SR_FLAG_T_SHIFT);
     *sh4_gen_reg(sh4, (inst >> 8) & 0xf) = dst;
 }
 
@@ -4713,8 +4722,6 @@ void sh4_inst_binary_macl_indgeninc_indgeninc(void *cpu, cpu_inst_param inst) {
 
     struct Sh4 *sh4 = (struct Sh4*)cpu;
 
-    static const int64_t MAX48 = 0x7fffffffffff;
-    static const int64_t MIN48 = 0xffff800000000000;
     reg32_t *dst_addrp = sh4_gen_reg(sh4, (inst >> 8) & 0xf);
     reg32_t *src_addrp = sh4_gen_reg(sh4, (inst >> 4) & 0xf);
 
@@ -4723,6 +4730,18 @@ void sh4_inst_binary_macl_indgeninc_indgeninc(void *cpu, cpu_inst_param inst) {
         sh4_read32(sh4, *src_addrp, &rhs) != 0)
         return;
 
+    sh4_inst_macl_accumulate(sh4, lhs, rhs);
+
+    (*dst_addrp) += 4;
+    (*src_addrp) += 4;
+}
+
+void sh4_inst_macl_accumulate(void *cpu, uint32_t lhs, uint32_t rhs) {
+    struct Sh4 *sh4 = (struct Sh4*)cpu;
+
+    static const int64_t MAX48 = 0x7fffffffffff;
+    static const int64_t MIN48 = 0xffff800000000000;
+
     int64_t product = (int64_t)((int32_t)lhs) * (int64_t)((int32_t)rhs);
     int64_t sum;
 
@@ -4752,9 +4771,6 @@ void sh4_inst_binary_macl_indgeninc_indgeninc(void *cpu, cpu_inst_param inst) {
 
     sh4->reg[SH4_REG_MACL] = ((uint64_t)sum) & 0xffffffff;
     sh4->reg[SH4_REG_MACH] = ((uint64_t)sum) >> 32;
-
-    (*dst_addrp) += 4;
-    (*src_addrp) += 4;
 }
 
 #define INST_MASK_0100nnnnmmmm1111 0xf00f
@@ -4768,8 +4784,6 @@ void sh4_inst_binary_macw_indgeninc_indgeninc(void *cpu, cpu_inst_param inst) {
 
     struct Sh4 *sh4 = (struct Sh4*)cpu;
 
-    static const int32_t MAX32 = 0x7fffffff;
-    static const int32_t MIN32 = 0x80000000;
     reg32_t *dst_addrp = sh4_gen_reg(sh4, (inst >> 8) & 0xf);
     reg32_t *src_addrp = sh4_gen_reg(sh4, (inst >> 4) & 0xf);
 
@@ -4778,6 +4792,18 @@ void sh4_inst_binary_macw_indgeninc_indgeninc(void *cpu, cpu_inst_param inst) {
         sh4_read16(sh4, *src_addrp, &rhs) != 0)
         return;
 
+    sh4_inst_macw_accumulate(sh4, lhs, rhs);
+
+    (*dst_addrp) += 2;
+    (*src_addrp) += 2;
+}
+
+void sh4_inst_macw_accumulate(void *cpu, uint32_t lhs, uint32_t rhs) {
+    struct Sh4 *sh4 = (struct Sh4*)cpu;
+
+    static const int32_t MAX32 = 0x7fffffff;
+    static const int32_t MIN32 = 0x80000000;
+
     int64_t result = (int64_t)(int16_t)lhs * (int64_t)(int16_t)rhs;
 
     if (sh4->reg[SH4_REG_SR] & SH4_SR_FLAG_S_MASK) {
@@ -4819,9 +4845,6 @@ void sh4_inst_binary_macw_indgeninc_indgeninc(void *cpu, cpu_inst_param inst) {
         sh4->reg[SH4_REG_MACL] = ((uint64_t)result) & 0xffffffff;
         sh4->reg[SH4_REG_MACH] = ((uint64_t)result) >> 32;
     }
-
-    (*dst_addrp) += 2;
-    (*src_addrp) += 2;
 }
 
 #define INST_MASK_10000000nnnndddd 0xff00
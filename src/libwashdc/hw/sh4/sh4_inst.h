@@ -745,6 +745,13 @@ void sh4_inst_binary_macl_indgeninc_indgeninc(void *cpu, cpu_inst_param inst);
 // 0100nnnnmmmm1111
 void sh4_inst_binary_macw_indgeninc_indgeninc(void *cpu, cpu_inst_param inst);
 
+/*
+ * the multiply-accumulate half of MAC.L and MAC.W, after the operands have
+ * been read from memory.  These are shared with the jit.
+ */
+void sh4_inst_macl_accumulate(void *cpu, uint32_t lhs, uint32_t rhs);
+void sh4_inst_macw_accumulate(void *cpu, uint32_t lhs, uint32_t rhs);
+
 // MOV.B R0, @(disp, Rn)
 // 10000000nnnndddd
 void sh4_inst_binary_movb_r0_binind_disp_gen(void *cpu, cpu_inst_param inst);
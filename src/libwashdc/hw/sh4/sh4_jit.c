@@ -20,6 +20,8 @@
  *
  ******************************************************************************/
 
+#include <stdlib.h>
+
 #include "sh4asm_core/disas.h"
 
 #include "jit/jit_il.h"
@@ -34,9 +36,12 @@
 #include "sh4.h"
 #include "sh4_read_inst.h"
 #include "sh4_jit.h"
+#include "sh4_tbl.h"
+#include "sh4_idle.h"
 
 #ifdef ENABLE_JIT_X86_64
 #include "jit/x86_64/native_dispatch.h"
+#include "jit/x86_64/compile_thread.h"
 #endif
 
 #include "washdc/hostfile.h"
@@ -49,8 +54,25 @@ void sh4_jit_set_native_dispatch_meta(struct native_dispatch_meta *meta) {
     meta->profile_notify = sh4_jit_profile_notify;
 #endif
     meta->on_compile = sh4_jit_compile_native;
+    meta->build_il = sh4_jit_build_il;
     meta->hash_func = sh4_jit_hash_wrapper;
 }
+
+/*
+ * R0 is the implicit operand of a lot of instructions (MOV.L @(disp, GBR),
+ * CMP/EQ #imm, the indexed addressing modes...), R15 is the stack pointer and
+ * R14 is what GCC uses as a frame pointer, so these are the registers that get
+ * used by nearly every block.
+ */
+static unsigned const sh4_jit_pinned_regs[] = {
+    SH4_REG_R0, SH4_REG_R14, SH4_REG_R15
+};
+
+void sh4_jit_pin_regs(struct Sh4 *sh4) {
+    jit_x86_64_pin_regs(sh4->reg, sh4_jit_pinned_regs,
+                        sizeof(sh4_jit_pinned_regs) /
+                        sizeof(sh4_jit_pinned_regs[0]));
+}
 #endif
 
 enum reg_status {
@@ -125,6 +147,17 @@ static unsigned reg_slot_noload(Sh4 *sh4, struct il_code_block *block,
 #ifdef JIT_PROFILE
 static void sh4_jit_profile_disas(washdc_hostfile out, uint32_t addr, void const *instp);
 static void sh4_jit_profile_emit_fn(char ch);
+
+/*
+ * number of times each instruction has been executed through
+ * sh4_jit_fallback, indexed by the instruction itself.  This gets printed by
+ * sh4_jit_cleanup so that it's easy to see which instructions are most in need
+ * of a proper jit implementation.
+ */
+static unsigned long long fallback_count[1 << 16];
+
+static void sh4_jit_count_fallback(void *cpu, uint32_t inst);
+static void sh4_jit_print_fallbacks(washdc_hostfile out);
 #endif
 
 /*
@@ -176,11 +209,22 @@ void sh4_jit_cleanup(struct Sh4 *sh4) {
         washdc_hostfile_open("sh4_profile.txt",
                              WASHDC_HOSTFILE_WRITE | WASHDC_HOSTFILE_TEXT);
     if (outfile != WASHDC_HOSTFILE_INVALID) {
+        jit_optimize_print_stats(outfile);
         jit_profile_print(&sh4->jit_profile, outfile);
         washdc_hostfile_close(outfile);
     } else {
         LOG_ERROR("Failure to open sh4_profile.txt for writing\n");
     }
+
+    outfile = washdc_hostfile_open("sh4_fallback.txt",
+                                   WASHDC_HOSTFILE_WRITE | WASHDC_HOSTFILE_TEXT);
+    if (outfile != WASHDC_HOSTFILE_INVALID) {
+        sh4_jit_print_fallbacks(outfile);
+        washdc_hostfile_close(outfile);
+    } else {
+        LOG_ERROR("Failure to open sh4_fallback.txt for writing\n");
+    }
+
     jit_profile_ctxt_cleanup(&sh4->jit_profile);
 #endif
 }
@@ -201,6 +245,69 @@ sh4_jit_profile_disas(washdc_hostfile out, uint32_t addr, void const *instp) {
 static void sh4_jit_profile_emit_fn(char ch) {
     washdc_hostfile_putc(jit_profile_out, ch);
 }
+
+static void sh4_jit_count_fallback(void *cpu, uint32_t inst) {
+    fallback_count[inst & 0xffff]++;
+}
+
+struct fallback_op_count {
+    struct InstOpcode const *op;
+    unsigned long long count;
+    uint16_t example;
+};
+
+static int fallback_op_count_cmp(void const *lhs, void const *rhs) {
+    unsigned long long count_lhs =
+        ((struct fallback_op_count const*)lhs)->count;
+    unsigned long long count_rhs =
+        ((struct fallback_op_count const*)rhs)->count;
+    if (count_lhs > count_rhs)
+        return -1;
+    else if (count_lhs < count_rhs)
+        return 1;
+    return 0;
+}
+
+/*
+ * print the number of times each opcode went through sh4_jit_fallback, in
+ * descending order.  Every instruction which maps to the same InstOpcode gets
+ * lumped together, and one of them is disassembled as an example.
+ */
+static void sh4_jit_print_fallbacks(washdc_hostfile out) {
+    static struct fallback_op_count ops[1 << 16];
+    unsigned n_ops = 0;
+    unsigned long long total = 0;
+    unsigned inst, idx;
+
+    for (inst = 0; inst < (1 << 16); inst++) {
+        if (!fallback_count[inst])
+            continue;
+        struct InstOpcode const *op = sh4_decode_inst(inst);
+        for (idx = 0; idx < n_ops; idx++)
+            if (ops[idx].op == op)
+                break;
+        if (idx == n_ops) {
+            ops[n_ops].op = op;
+            ops[n_ops].count = 0;
+            ops[n_ops].example = inst;
+            n_ops++;
+        }
+        ops[idx].count += fallback_count[inst];
+        total += fallback_count[inst];
+    }
+
+    qsort(ops, n_ops, sizeof(ops[0]), fallback_op_count_cmp);
+
+    washdc_hostfile_printf(out, "%llu total fallback instructions executed\n",
+                           total);
+    for (idx = 0; idx < n_ops; idx++) {
+        washdc_hostfile_printf(out, "%llu\t", ops[idx].count);
+        jit_profile_out = out;
+        sh4asm_disas_inst(ops[idx].example, sh4_jit_profile_emit_fn, 0);
+        jit_profile_out = NULL;
+        washdc_hostfile_puts(out, "\n");
+    }
+}
 #endif
 
 static void
@@ -341,6 +448,10 @@ sh4_jit_fallback(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     res_drain_all_regs(sh4, ctx, block);
     res_invalidate_all_regs(block);
 
+#ifdef JIT_PROFILE
+    jit_call_func_imm32(block, sh4_jit_count_fallback, inst);
+#endif
+
     il_inst.op = JIT_OP_FALLBACK;
     il_inst.immed.fallback.fallback_fn = op->func;
     il_inst.immed.fallback.inst = inst;
@@ -350,6 +461,73 @@ sh4_jit_fallback(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     return true;
 }
 
+bool
+sh4_jit_sleep(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+              struct il_code_block *block, unsigned pc,
+              struct InstOpcode const *op, cpu_inst_param inst) {
+    sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    /*
+     * sh4_inst_sleep uses up the rest of the timeslice, so the block has to
+     * stop here to keep the instructions after the SLEEP from running before
+     * the interrupt that wakes the CPU back up.
+     */
+    unsigned addr_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+    jit_set_slot(block, addr_slot, pc + 2);
+
+    unsigned hash_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+    if (ctx->dirty_fpscr) {
+        unsigned fpscr_slot = reg_slot(sh4, ctx, block, SH4_REG_FPSCR,
+                                       WASHDC_JIT_SLOT_GEN);
+        sh4_jit_hash_slot(sh4, block, addr_slot, hash_slot, fpscr_slot);
+        free_slot(block, fpscr_slot);
+    } else {
+        sh4_jit_hash_slot_known_fpscr(sh4, ctx, block, addr_slot, hash_slot);
+    }
+
+    res_drain_all_regs(sh4, ctx, block);
+    jit_jump(block, addr_slot, hash_slot);
+
+    free_slot(block, hash_slot);
+    free_slot(block, addr_slot);
+
+    return false;
+}
+
+/*
+ * called from jit code when a block that was compiled as an idle loop (see
+ * sh4_jit_idle_loop) is about to jump.  If it's jumping back to the top of the
+ * loop, then there's nothing left to do until the next event.
+ */
+static void sh4_jit_idle_loop_fn(void *cpu, uint32_t jmp_addr, uint32_t head) {
+    if (jmp_addr == head)
+        sh4_idle_fast_forward((Sh4*)cpu);
+}
+
+/*
+ * returns true if the branch at pc closes an idle loop which begins at the
+ * start of the block.  The branch's implementation needs to call
+ * sh4_jit_emit_idle_loop once the jump address is known.
+ *
+ * This only applies if the block hasn't gone past any other branches; a loop
+ * that contains a side exit can't be idle anyways.
+ */
+static bool
+sh4_jit_idle_loop(Sh4 *sh4, struct sh4_jit_compile_ctx *ctx, addr32_t pc) {
+    addr32_t head;
+    return ctx->n_side_exits == 0 && sh4_idle_loop_check(sh4, pc, &head) &&
+        head == ctx->trace_head;
+}
+
+static void
+sh4_jit_emit_idle_loop(Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
+                       struct il_code_block *block, unsigned jmp_addr_slot) {
+    unsigned head_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+    jit_set_slot(block, head_slot, ctx->trace_head);
+    jit_call_func_2(block, sh4_jit_idle_loop_fn, jmp_addr_slot, head_slot);
+    free_slot(block, head_slot);
+}
+
 bool sh4_jit_rts(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                  struct il_code_block *block, unsigned pc,
                  struct InstOpcode const *op, cpu_inst_param inst) {
@@ -486,6 +664,64 @@ bool sh4_jit_bsrf_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     return false;
 }
 
+/*
+ * try to keep the block going past a conditional branch instead of ending it
+ * there.  flag_slot holds SR, and the branch is taken if SR's T bit is
+ * t_taken.  If this returns true then the branch was compiled as a side exit
+ * and the block continues at ctx->next_pc.  Otherwise the caller needs to end
+ * the block like it normally would.
+ *
+ * By default the block continues at the fall-through and the side exit goes
+ * to the branch target.  If the branch target is a little ways ahead and
+ * the tier 0 profile says the branch is usually taken, it's the other way
+ * around.  Blocks never continue backwards, so a branch back to the start of
+ * the block is a loop; its side exit jumps straight back to the top of the
+ * block if there are cycles left.
+ */
+static bool
+sh4_jit_extend_trace(Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
+                     struct il_code_block *block, unsigned flag_slot,
+                     unsigned t_taken, addr32_t pc, addr32_t target,
+                     addr32_t fallthrough) {
+    /*
+     * the hash of the side exit's destination has to be known at
+     * compile-time.
+     */
+    if (!ctx->superblock || ctx->dirty_fpscr ||
+        ctx->n_side_exits >= JIT_MAX_SIDE_EXITS ||
+        ctx->n_insts >= SH4_JIT_SUPERBLOCK_MAX_INSTS)
+        return false;
+
+    addr32_t next_pc = fallthrough, exit_pc = target;
+    unsigned t_exit = t_taken;
+
+#ifdef ENABLE_JIT_X86_64
+    if (target > pc && target - pc <= SH4_JIT_SUPERBLOCK_MAX_SKIP) {
+        jit_hash segment_hash =
+            sh4_jit_hash(sh4, ctx->segment_head, ctx->pr_bit, ctx->sz_bit);
+        unsigned n_taken =
+            compile_thread_tier0_exit_count(segment_hash, target);
+        unsigned n_not_taken =
+            compile_thread_tier0_exit_count(segment_hash, fallthrough);
+        if (n_taken > n_not_taken) {
+            next_pc = target;
+            exit_pc = fallthrough;
+            t_exit = !t_taken;
+        }
+    }
+#endif
+
+    res_drain_all_regs(sh4, ctx, block);
+    jit_exit_cond(block, flag_slot, t_exit, exit_pc,
+                  sh4_jit_hash(sh4, exit_pc, ctx->pr_bit, ctx->sz_bit),
+                  ctx->cycle_count * SH4_CLOCK_SCALE,
+                  exit_pc == ctx->trace_head);
+
+    ctx->n_side_exits++;
+    ctx->next_pc = ctx->segment_head = next_pc;
+    return true;
+}
+
 bool sh4_jit_bf(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                 struct il_code_block *block, unsigned pc,
                 struct InstOpcode const *op, cpu_inst_param inst) {
@@ -495,10 +731,19 @@ bool sh4_jit_bf(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                                   WASHDC_JIT_SLOT_GEN);
     res_disassociate_reg(sh4, ctx, block, SH4_REG_SR);
 
+    bool idle = sh4_jit_idle_loop(sh4, ctx, pc);
+    if (!idle && sh4_jit_extend_trace(sh4, ctx, block, flag_slot, 0, pc,
+                                      pc + jump_offs, pc + 2)) {
+        free_slot(block, flag_slot);
+        return true;
+    }
+
     unsigned jmp_addr_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
     jit_set_slot(block, jmp_addr_slot, pc + jump_offs);
 
     jit_cset(block, flag_slot, 1, pc+2, jmp_addr_slot);
+    if (idle)
+        sh4_jit_emit_idle_loop(sh4, ctx, block, jmp_addr_slot);
     unsigned hash_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
     if (ctx->dirty_fpscr) {
         unsigned fpscr_slot = reg_slot(sh4, ctx, block, SH4_REG_FPSCR,
@@ -528,10 +773,19 @@ bool sh4_jit_bt(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
         reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
     res_disassociate_reg(sh4, ctx, block, SH4_REG_SR);
 
+    bool idle = sh4_jit_idle_loop(sh4, ctx, pc);
+    if (!idle && sh4_jit_extend_trace(sh4, ctx, block, flag_slot, 1, pc,
+                                      pc + jump_offs, pc + 2)) {
+        free_slot(block, flag_slot);
+        return true;
+    }
+
     unsigned jmp_addr_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
     jit_set_slot(block, jmp_addr_slot, pc + jump_offs);
 
     jit_cset(block, flag_slot, 0, pc + 2, jmp_addr_slot);
+    if (idle)
+        sh4_jit_emit_idle_loop(sh4, ctx, block, jmp_addr_slot);
     unsigned hash_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
     if (ctx->dirty_fpscr) {
         unsigned fpscr_slot = reg_slot(sh4, ctx, block, SH4_REG_FPSCR,
@@ -563,10 +817,19 @@ bool sh4_jit_bfs(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
 
     sh4_jit_delay_slot(sh4, ctx, block, pc + 2);
 
+    bool idle = sh4_jit_idle_loop(sh4, ctx, pc);
+    if (!idle && sh4_jit_extend_trace(sh4, ctx, block, flag_slot, 0, pc,
+                                      pc + jump_offs, pc + 4)) {
+        free_slot(block, flag_slot);
+        return true;
+    }
+
     unsigned jmp_addr_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
     jit_set_slot(block, jmp_addr_slot, pc + jump_offs);
 
     jit_cset(block, flag_slot, 1, pc + 4, jmp_addr_slot);
+    if (idle)
+        sh4_jit_emit_idle_loop(sh4, ctx, block, jmp_addr_slot);
     unsigned hash_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
     if (ctx->dirty_fpscr) {
         unsigned fpscr_slot = reg_slot(sh4, ctx, block, SH4_REG_FPSCR,
@@ -598,10 +861,19 @@ bool sh4_jit_bts(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
 
     sh4_jit_delay_slot(sh4, ctx, block, pc + 2);
 
+    bool idle = sh4_jit_idle_loop(sh4, ctx, pc);
+    if (!idle && sh4_jit_extend_trace(sh4, ctx, block, flag_slot, 1, pc,
+                                      pc + jump_offs, pc + 4)) {
+        free_slot(block, flag_slot);
+        return true;
+    }
+
     unsigned jmp_addr_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
     jit_set_slot(block, jmp_addr_slot, pc + jump_offs);
 
     jit_cset(block, flag_slot, 0, pc + 4, jmp_addr_slot);
+    if (idle)
+        sh4_jit_emit_idle_loop(sh4, ctx, block, jmp_addr_slot);
     unsigned hash_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
     if (ctx->dirty_fpscr) {
         unsigned fpscr_slot = reg_slot(sh4, ctx, block, SH4_REG_FPSCR,
@@ -634,6 +906,8 @@ bool sh4_jit_bra(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
 
     unsigned addr_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
     jit_set_slot(block, addr_slot, pc + disp);
+    if (sh4_jit_idle_loop(sh4, ctx, pc))
+        sh4_jit_emit_idle_loop(sh4, ctx, block, addr_slot);
 
     unsigned hash_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
     if (ctx->dirty_fpscr) {
@@ -828,6 +1102,36 @@ bool sh4_jit_ocbwb_arn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     return true;
 }
 
+#ifndef ENABLE_MMU
+/*
+ * PREF is only a cache hint unless it points into the store-queue area, and
+ * that can't be known until runtime.
+ */
+static void sh4_jit_pref_fn(void *cpu, uint32_t addr) {
+    if (sh4_addr_in_sq_area(addr))
+        sh4_sq_pref((Sh4*)cpu, addr);
+}
+#endif
+
+// PREF @Rn
+// 0000nnnn10000011
+bool sh4_jit_pref_arn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                      struct il_code_block *block, unsigned pc,
+                      struct InstOpcode const *op, cpu_inst_param inst) {
+#ifdef ENABLE_MMU
+    // the store queue can raise TLB exceptions when the MMU is enabled
+    return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+#else
+    unsigned reg_addr = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
+    unsigned slot_addr = reg_slot(sh4, ctx, block, reg_addr,
+                                  WASHDC_JIT_SLOT_GEN);
+
+    jit_call_func(block, sh4_jit_pref_fn, slot_addr);
+
+    return true;
+#endif
+}
+
 // ADD Rm, Rn
 // 0011nnnnmmmm1100
 bool sh4_jit_add_rm_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
@@ -1948,121 +2252,732 @@ sh4_jit_extub_rm_rn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     return true;
 }
 
-// proxy-wrapper for sh4_set_exception that can be used for jit_call_func_imm32
-static void sh4_set_exception_proxy(void *sh4, unsigned excp_code) {
-    sh4_set_exception((Sh4*)sh4, excp_code);
-}
+// ADDC Rm, Rn
+// 0011nnnnmmmm1110
+bool sh4_jit_addc_rm_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                        struct il_code_block *block, unsigned pc,
+                        struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned reg_src = ((inst & 0x00f0) >> 4) + SH4_REG_R0;
+    unsigned reg_dst = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
 
-// TRAPA #immed
-// 11000011iiiiiiii
-bool sh4_jit_trapa_imm(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
-                       struct il_code_block *block, unsigned pc,
-                       struct InstOpcode const *op, cpu_inst_param inst) {
-    unsigned tra_slot = reg_slot(sh4, ctx, block,
-                                 SH4_REG_TRA, WASHDC_JIT_SLOT_GEN);
-    jit_set_slot(block, tra_slot, (inst & BIT_RANGE(0, 7)) << 2);
-    reg_map[SH4_REG_TRA].stat = REG_STATUS_SLOT;
+    unsigned slot_src = reg_slot(sh4, ctx, block, reg_src, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_dst = reg_slot(sh4, ctx, block, reg_dst, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_sr = reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_carry = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
 
-    /*
-     * set SH4_REG_PC to point to the next instruction after this.
-     *
-     * sh4_set_exception will use this to initialize SPC so it has to be
-     * the correct value.
-     */
-    unsigned pc_slot = reg_slot(sh4, ctx, block,
-                                SH4_REG_PC, WASHDC_JIT_SLOT_GEN);
-    jit_set_slot(block, pc_slot, pc + 2);
-    reg_map[SH4_REG_PC].stat = REG_STATUS_SLOT;
+    // T-bit is the carry-in, the carry-out goes back into the T-bit
+    jit_mov(block, slot_sr, slot_carry);
+    jit_add_carry(block, slot_src, slot_dst, slot_carry);
+    jit_and_const32(block, slot_sr, ~1);
+    jit_or(block, slot_carry, slot_sr);
 
-    /* calling sh4_set_exception will change the sr */
-    res_drain_all_regs(sh4, ctx, block);
-    res_invalidate_all_regs(block);
-    jit_call_func_imm32(block, sh4_set_exception_proxy,
-                        SH4_EXCP_UNCONDITIONAL_TRAP);
+    reg_map[reg_dst].stat = REG_STATUS_SLOT;
+    reg_map[SH4_REG_SR].stat = REG_STATUS_SLOT;
 
-    // jump to new PC which was set by sh4_set_exception
-    unsigned hash_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
-    pc_slot = reg_slot(sh4, ctx, block,
-                       SH4_REG_PC, WASHDC_JIT_SLOT_GEN);
-    unsigned fpscr_slot = reg_slot(sh4, ctx, block, SH4_REG_FPSCR,
-                                   WASHDC_JIT_SLOT_GEN);
+    free_slot(block, slot_carry);
 
-    sh4_jit_hash_slot(sh4, block, pc_slot, hash_slot, fpscr_slot);
-    free_slot(block, fpscr_slot);
+    return true;
+}
 
-    res_drain_all_regs(sh4, ctx, block);
-    jit_jump(block, pc_slot, hash_slot);
+// SUBC Rm, Rn
+// 0011nnnnmmmm1010
+bool sh4_jit_subc_rm_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                        struct il_code_block *block, unsigned pc,
+                        struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned reg_src = ((inst & 0x00f0) >> 4) + SH4_REG_R0;
+    unsigned reg_dst = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
 
-    free_slot(block, hash_slot);
-    free_slot(block, pc_slot);
+    unsigned slot_src = reg_slot(sh4, ctx, block, reg_src, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_dst = reg_slot(sh4, ctx, block, reg_dst, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_sr = reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_carry = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
 
-    return false;
+    // T-bit is the borrow-in, the borrow-out goes back into the T-bit
+    jit_mov(block, slot_sr, slot_carry);
+    jit_sub_carry(block, slot_src, slot_dst, slot_carry);
+    jit_and_const32(block, slot_sr, ~1);
+    jit_or(block, slot_carry, slot_sr);
+
+    reg_map[reg_dst].stat = REG_STATUS_SLOT;
+    reg_map[SH4_REG_SR].stat = REG_STATUS_SLOT;
+
+    free_slot(block, slot_carry);
+
+    return true;
 }
 
-// LDS Rm, FPSCR
-// 0100mmmm01101010
-bool sh4_jit_lds_rm_fpscr(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
-                          struct il_code_block *block, unsigned pc,
-                          struct InstOpcode const *op, cpu_inst_param inst) {
-    unsigned reg_src = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
+// NEGC Rm, Rn
+// 0110nnnnmmmm1010
+bool sh4_jit_negc_rm_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                        struct il_code_block *block, unsigned pc,
+                        struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned reg_src = ((inst & 0x00f0) >> 4) + SH4_REG_R0;
+    unsigned reg_dst = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
+
     unsigned slot_src = reg_slot(sh4, ctx, block, reg_src, WASHDC_JIT_SLOT_GEN);
-    res_disassociate_reg(sh4, ctx, block, reg_src);
+    unsigned slot_sr = reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_tmp = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_carry = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
 
-    /*
-     * there are a few different ways editing the FPSCR can cause side-effects (for
-     * example by initiating a bank-switch) so we need to make sure everything
-     * is committed to the reg array and we also need to make sure we reload any
-     * registers referenced after the jit_restore_sr operation.
-     */
-    res_drain_all_regs(sh4, ctx, block);
-    res_invalidate_all_regs(block);
+    // Rn = 0 - Rm - T, and the borrow-out goes into the T-bit
+    jit_set_slot(block, slot_tmp, 0);
+    jit_mov(block, slot_sr, slot_carry);
+    jit_sub_carry(block, slot_src, slot_tmp, slot_carry);
 
-    jit_call_func(block, sh4_set_fpscr, slot_src);
+    unsigned slot_dst = reg_slot_noload(sh4, block, reg_dst,
+                                        WASHDC_JIT_SLOT_GEN);
+    jit_mov(block, slot_tmp, slot_dst);
 
-    free_slot(block, slot_src);
+    jit_and_const32(block, slot_sr, ~1);
+    jit_or(block, slot_carry, slot_sr);
 
-    ctx->dirty_fpscr = true;
-    if (!ctx->in_delay_slot) {
-        /*
-         * since the code hash (which includes SZ and PR) just changed, we need to
-         * handle this like a jmp instruction.
-         */
-        unsigned jmp_addr_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
-        jit_set_slot(block, jmp_addr_slot, pc + 2);
+    reg_map[reg_dst].stat = REG_STATUS_SLOT;
+    reg_map[SH4_REG_SR].stat = REG_STATUS_SLOT;
 
-        unsigned hash_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
-        unsigned fpscr_slot = reg_slot(sh4, ctx, block, SH4_REG_FPSCR,
-                                       WASHDC_JIT_SLOT_GEN);
-        sh4_jit_hash_slot(sh4, block, jmp_addr_slot, hash_slot, fpscr_slot);
+    free_slot(block, slot_carry);
+    free_slot(block, slot_tmp);
 
-        res_drain_all_regs(sh4, ctx, block);
-        jit_jump(block, jmp_addr_slot, hash_slot);
+    return true;
+}
 
-        free_slot(block, hash_slot);
-        free_slot(block, jmp_addr_slot);
+// DIV0U
+// 0000000000011001
+bool sh4_jit_div0u(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                   struct il_code_block *block, unsigned pc,
+                   struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned slot_sr = reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
 
-        return false;
-    }
+    jit_and_const32(block, slot_sr,
+                    ~(SH4_SR_M_MASK | SH4_SR_Q_MASK | SH4_SR_FLAG_T_MASK));
+
+    reg_map[SH4_REG_SR].stat = REG_STATUS_SLOT;
 
     return true;
 }
 
-// LDS.L @Rm+, FPSCR
-// 0100mmmm01100110
-bool sh4_jit_ldsl_armp_fpscr(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
-                             struct il_code_block *block, unsigned pc,
-                             struct InstOpcode const *op, cpu_inst_param inst) {
-    unsigned addr_reg = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
-    unsigned addr_slot = reg_slot(sh4, ctx, block, addr_reg, WASHDC_JIT_SLOT_GEN);
-    unsigned new_val_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+// DIV0S Rm, Rn
+// 0010nnnnmmmm0111
+bool sh4_jit_div0s_rm_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                         struct il_code_block *block, unsigned pc,
+                         struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned reg_m = ((inst & 0x00f0) >> 4) + SH4_REG_R0;
+    unsigned reg_q = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
 
-    jit_read_32_slot(block, sh4->mem.map, addr_slot, new_val_slot);
-    jit_add_const32(block, addr_slot, 4);
-    reg_map[addr_reg].stat = REG_STATUS_SLOT;
+    unsigned slot_m = reg_slot(sh4, ctx, block, reg_m, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_q = reg_slot(sh4, ctx, block, reg_q, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_sr = reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_tmp = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
 
-    /*
-     * there are a few different ways editing the FPSCR can cause side-effects (for
-     * example by initiating a bank-switch) so we need to make sure everything
+    jit_and_const32(block, slot_sr,
+                    ~(SH4_SR_M_MASK | SH4_SR_Q_MASK | SH4_SR_FLAG_T_MASK));
+
+    // M is the sign of Rm
+    jit_mov(block, slot_m, slot_tmp);
+    jit_shlr(block, slot_tmp, 31);
+    jit_shll(block, slot_tmp, SH4_SR_M_SHIFT);
+    jit_or(block, slot_tmp, slot_sr);
+
+    // Q is the sign of Rn
+    jit_mov(block, slot_q, slot_tmp);
+    jit_shlr(block, slot_tmp, 31);
+    jit_shll(block, slot_tmp, SH4_SR_Q_SHIFT);
+    jit_or(block, slot_tmp, slot_sr);
+
+    // T is Q ^ M
+    jit_mov(block, slot_m, slot_tmp);
+    jit_xor(block, slot_q, slot_tmp);
+    jit_shlr(block, slot_tmp, 31);
+    jit_or(block, slot_tmp, slot_sr);
+
+    reg_map[SH4_REG_SR].stat = REG_STATUS_SLOT;
+
+    free_slot(block, slot_tmp);
+
+    return true;
+}
+
+/*
+ * DIV1 Rm, Rn
+ * 0011nnnnmmmm0100
+ *
+ * The interpreter's implementation of this instruction has four different
+ * cases depending on Q and M.  They all boil down to adding the divisor to the
+ * shifted dividend when Q != M and subtracting it when Q == M, so here that's
+ * expressed as a single ADD_CARRY of either the divisor or its one's
+ * complement (with a carry-in of 1 in the latter case).  The interpreter's
+ * carry flag is then the carry-out of that addition, inverted for
+ * subtraction, and the new Q and T follow from it.
+ */
+bool sh4_jit_div1_rm_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                        struct il_code_block *block, unsigned pc,
+                        struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned reg_src = ((inst & 0x00f0) >> 4) + SH4_REG_R0;
+    unsigned reg_dst = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
+
+    unsigned slot_src = reg_slot(sh4, ctx, block, reg_src, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_dst = reg_slot(sh4, ctx, block, reg_dst, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_sr = reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
+
+    unsigned slot_msb = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_m = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_sub = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_operand = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_carry = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+
+    // the bit which will get shifted out of the dividend
+    jit_mov(block, slot_dst, slot_msb);
+    jit_shlr(block, slot_msb, 31);
+
+    jit_mov(block, slot_sr, slot_m);
+    jit_shlr(block, slot_m, SH4_SR_M_SHIFT);
+    jit_and_const32(block, slot_m, 1);
+
+    // slot_sub = 1 if Q == M (subtract), else 0 (add)
+    jit_mov(block, slot_sr, slot_sub);
+    jit_shlr(block, slot_sub, SH4_SR_Q_SHIFT);
+    jit_xor(block, slot_m, slot_sub);
+    jit_and_const32(block, slot_sub, 1);
+    jit_xor_const32(block, slot_sub, 1);
+
+    /*
+     * slot_operand = divisor ^ (0 - slot_sub).  This has to happen before the
+     * dividend gets shifted in case Rm and Rn are the same register.
+     */
+    jit_set_slot(block, slot_operand, 0);
+    jit_sub(block, slot_sub, slot_operand);
+    jit_xor(block, slot_src, slot_operand);
+
+    // shift T into the dividend
+    jit_mov(block, slot_sr, slot_carry);
+    jit_and_const32(block, slot_carry, 1);
+    jit_shll(block, slot_dst, 1);
+    jit_or(block, slot_carry, slot_dst);
+
+    jit_mov(block, slot_sub, slot_carry);
+    jit_add_carry(block, slot_operand, slot_dst, slot_carry);
+
+    // slot_carry = msb ^ carry, where carry is the interpreter's carry flag
+    jit_xor(block, slot_sub, slot_carry);
+    jit_xor(block, slot_msb, slot_carry);
+
+    jit_and_const32(block, slot_sr, ~(SH4_SR_Q_MASK | SH4_SR_FLAG_T_MASK));
+
+    // T = !(msb ^ carry)
+    jit_mov(block, slot_carry, slot_operand);
+    jit_xor_const32(block, slot_operand, 1);
+    jit_or(block, slot_operand, slot_sr);
+
+    // Q = msb ^ carry ^ M
+    jit_xor(block, slot_m, slot_carry);
+    jit_shll(block, slot_carry, SH4_SR_Q_SHIFT);
+    jit_or(block, slot_carry, slot_sr);
+
+    reg_map[reg_dst].stat = REG_STATUS_SLOT;
+    reg_map[SH4_REG_SR].stat = REG_STATUS_SLOT;
+
+    free_slot(block, slot_carry);
+    free_slot(block, slot_operand);
+    free_slot(block, slot_sub);
+    free_slot(block, slot_m);
+    free_slot(block, slot_msb);
+
+    return true;
+}
+
+// DMULS.L Rm, Rn
+// 0011nnnnmmmm1101
+bool sh4_jit_dmulsl_rm_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                          struct il_code_block *block, unsigned pc,
+                          struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned reg_lhs = ((inst & 0x00f0) >> 4) + SH4_REG_R0;
+    unsigned reg_rhs = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
+
+    unsigned slot_lhs = reg_slot(sh4, ctx, block, reg_lhs, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_rhs = reg_slot(sh4, ctx, block, reg_rhs, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_macl = reg_slot_noload(sh4, block, SH4_REG_MACL,
+                                         WASHDC_JIT_SLOT_GEN);
+    unsigned slot_mach = reg_slot_noload(sh4, block, SH4_REG_MACH,
+                                         WASHDC_JIT_SLOT_GEN);
+
+    jit_mul_s64(block, slot_lhs, slot_rhs, slot_macl, slot_mach);
+
+    reg_map[SH4_REG_MACL].stat = REG_STATUS_SLOT;
+    reg_map[SH4_REG_MACH].stat = REG_STATUS_SLOT;
+
+    return true;
+}
+
+// DMULU.L Rm, Rn
+// 0011nnnnmmmm0101
+bool sh4_jit_dmulul_rm_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                          struct il_code_block *block, unsigned pc,
+                          struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned reg_lhs = ((inst & 0x00f0) >> 4) + SH4_REG_R0;
+    unsigned reg_rhs = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
+
+    unsigned slot_lhs = reg_slot(sh4, ctx, block, reg_lhs, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_rhs = reg_slot(sh4, ctx, block, reg_rhs, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_macl = reg_slot_noload(sh4, block, SH4_REG_MACL,
+                                         WASHDC_JIT_SLOT_GEN);
+    unsigned slot_mach = reg_slot_noload(sh4, block, SH4_REG_MACH,
+                                         WASHDC_JIT_SLOT_GEN);
+
+    jit_mul_u64(block, slot_lhs, slot_rhs, slot_macl, slot_mach);
+
+    reg_map[SH4_REG_MACL].stat = REG_STATUS_SLOT;
+    reg_map[SH4_REG_MACH].stat = REG_STATUS_SLOT;
+
+    return true;
+}
+
+// MUL.L Rm, Rn
+// 0000nnnnmmmm0111
+bool sh4_jit_mull_rm_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                        struct il_code_block *block, unsigned pc,
+                        struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned reg_lhs = ((inst & 0x00f0) >> 4) + SH4_REG_R0;
+    unsigned reg_rhs = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
+
+    unsigned slot_lhs = reg_slot(sh4, ctx, block, reg_lhs, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_rhs = reg_slot(sh4, ctx, block, reg_rhs, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_macl = reg_slot_noload(sh4, block, SH4_REG_MACL,
+                                         WASHDC_JIT_SLOT_GEN);
+
+    jit_mul_u32(block, slot_lhs, slot_rhs, slot_macl);
+
+    reg_map[SH4_REG_MACL].stat = REG_STATUS_SLOT;
+
+    return true;
+}
+
+/*
+ * MAC.L @Rm+, @Rn+
+ * 0000nnnnmmmm1111
+ *
+ * The operand fetches and address increments are compiled, but the
+ * accumulation itself goes through the interpreter's helper because whether
+ * it saturates depends on the S-bit, which is not known at compile-time.
+ */
+bool sh4_jit_macl_armp_arnp(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                            struct il_code_block *block, unsigned pc,
+                            struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned reg_src = ((inst & 0x00f0) >> 4) + SH4_REG_R0;
+    unsigned reg_dst = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
+
+    unsigned slot_src = reg_slot(sh4, ctx, block, reg_src, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_dst = reg_slot(sh4, ctx, block, reg_dst, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_lhs = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_rhs = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+
+    jit_read_32_slot(block, sh4->mem.map, slot_dst, slot_lhs);
+    jit_read_32_slot(block, sh4->mem.map, slot_src, slot_rhs);
+    jit_add_const32(block, slot_dst, 4);
+    jit_add_const32(block, slot_src, 4);
+
+    reg_map[reg_dst].stat = REG_STATUS_SLOT;
+    reg_map[reg_src].stat = REG_STATUS_SLOT;
+
+    res_drain_reg(sh4, ctx, block, SH4_REG_SR);
+    res_drain_reg(sh4, ctx, block, SH4_REG_MACL);
+    res_drain_reg(sh4, ctx, block, SH4_REG_MACH);
+    res_invalidate_reg(block, SH4_REG_MACL);
+    res_invalidate_reg(block, SH4_REG_MACH);
+
+    jit_call_func_2(block, sh4_inst_macl_accumulate, slot_lhs, slot_rhs);
+
+    free_slot(block, slot_rhs);
+    free_slot(block, slot_lhs);
+
+    return true;
+}
+
+// MAC.W @Rm+, @Rn+
+// 0100nnnnmmmm1111
+bool sh4_jit_macw_armp_arnp(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                            struct il_code_block *block, unsigned pc,
+                            struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned reg_src = ((inst & 0x00f0) >> 4) + SH4_REG_R0;
+    unsigned reg_dst = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
+
+    unsigned slot_src = reg_slot(sh4, ctx, block, reg_src, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_dst = reg_slot(sh4, ctx, block, reg_dst, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_lhs = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_rhs = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+
+    jit_read_16_slot(block, sh4->mem.map, slot_dst, slot_lhs);
+    jit_read_16_slot(block, sh4->mem.map, slot_src, slot_rhs);
+    jit_add_const32(block, slot_dst, 2);
+    jit_add_const32(block, slot_src, 2);
+
+    reg_map[reg_dst].stat = REG_STATUS_SLOT;
+    reg_map[reg_src].stat = REG_STATUS_SLOT;
+
+    res_drain_reg(sh4, ctx, block, SH4_REG_SR);
+    res_drain_reg(sh4, ctx, block, SH4_REG_MACL);
+    res_drain_reg(sh4, ctx, block, SH4_REG_MACH);
+    res_invalidate_reg(block, SH4_REG_MACL);
+    res_invalidate_reg(block, SH4_REG_MACH);
+
+    jit_call_func_2(block, sh4_inst_macw_accumulate, slot_lhs, slot_rhs);
+
+    free_slot(block, slot_rhs);
+    free_slot(block, slot_lhs);
+
+    return true;
+}
+
+// ROTL Rn
+// 0100nnnn00000100
+bool sh4_jit_rotl_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                     struct il_code_block *block, unsigned pc,
+                     struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned reg_no = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
+    unsigned slot_no = reg_slot(sh4, ctx, block, reg_no, WASHDC_JIT_SLOT_GEN);
+    unsigned sr_slot = reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
+    unsigned tmp_cpy = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+
+    jit_mov(block, slot_no, tmp_cpy);
+    jit_shlr(block, tmp_cpy, 31);
+    jit_shll(block, slot_no, 1);
+    jit_or(block, tmp_cpy, slot_no);
+
+    jit_and_const32(block, sr_slot, ~1);
+    jit_or(block, tmp_cpy, sr_slot);
+
+    reg_map[reg_no].stat = REG_STATUS_SLOT;
+    reg_map[SH4_REG_SR].stat = REG_STATUS_SLOT;
+
+    free_slot(block, tmp_cpy);
+
+    return true;
+}
+
+// ROTR Rn
+// 0100nnnn00000101
+bool sh4_jit_rotr_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                     struct il_code_block *block, unsigned pc,
+                     struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned reg_no = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
+    unsigned slot_no = reg_slot(sh4, ctx, block, reg_no, WASHDC_JIT_SLOT_GEN);
+    unsigned sr_slot = reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
+    unsigned tmp_cpy = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+
+    jit_mov(block, slot_no, tmp_cpy);
+    jit_and_const32(block, tmp_cpy, 1);
+
+    jit_and_const32(block, sr_slot, ~1);
+    jit_or(block, tmp_cpy, sr_slot);
+
+    jit_shll(block, tmp_cpy, 31);
+    jit_shlr(block, slot_no, 1);
+    jit_or(block, tmp_cpy, slot_no);
+
+    reg_map[reg_no].stat = REG_STATUS_SLOT;
+    reg_map[SH4_REG_SR].stat = REG_STATUS_SLOT;
+
+    free_slot(block, tmp_cpy);
+
+    return true;
+}
+
+// ROTCL Rn
+// 0100nnnn00100100
+bool sh4_jit_rotcl_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                      struct il_code_block *block, unsigned pc,
+                      struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned reg_no = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
+    unsigned slot_no = reg_slot(sh4, ctx, block, reg_no, WASHDC_JIT_SLOT_GEN);
+    unsigned sr_slot = reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
+    unsigned shift_out = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+    unsigned shift_in = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+
+    jit_mov(block, slot_no, shift_out);
+    jit_shlr(block, shift_out, 31);
+    jit_mov(block, sr_slot, shift_in);
+    jit_and_const32(block, shift_in, 1);
+
+    jit_shll(block, slot_no, 1);
+    jit_or(block, shift_in, slot_no);
+
+    jit_and_const32(block, sr_slot, ~1);
+    jit_or(block, shift_out, sr_slot);
+
+    reg_map[reg_no].stat = REG_STATUS_SLOT;
+    reg_map[SH4_REG_SR].stat = REG_STATUS_SLOT;
+
+    free_slot(block, shift_in);
+    free_slot(block, shift_out);
+
+    return true;
+}
+
+// ROTCR Rn
+// 0100nnnn00100101
+bool sh4_jit_rotcr_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                      struct il_code_block *block, unsigned pc,
+                      struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned reg_no = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
+    unsigned slot_no = reg_slot(sh4, ctx, block, reg_no, WASHDC_JIT_SLOT_GEN);
+    unsigned sr_slot = reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
+    unsigned shift_out = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+    unsigned shift_in = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+
+    jit_mov(block, slot_no, shift_out);
+    jit_and_const32(block, shift_out, 1);
+    jit_mov(block, sr_slot, shift_in);
+    jit_and_const32(block, shift_in, 1);
+    jit_shll(block, shift_in, 31);
+
+    jit_shlr(block, slot_no, 1);
+    jit_or(block, shift_in, slot_no);
+
+    jit_and_const32(block, sr_slot, ~1);
+    jit_or(block, shift_out, sr_slot);
+
+    reg_map[reg_no].stat = REG_STATUS_SLOT;
+    reg_map[SH4_REG_SR].stat = REG_STATUS_SLOT;
+
+    free_slot(block, shift_in);
+    free_slot(block, shift_out);
+
+    return true;
+}
+
+// XTRCT Rm, Rn
+// 0010nnnnmmmm1101
+bool sh4_jit_xtrct_rm_rn(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                         struct il_code_block *block, unsigned pc,
+                         struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned reg_src = ((inst & 0x00f0) >> 4) + SH4_REG_R0;
+    unsigned reg_dst = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
+
+    unsigned slot_src = reg_slot(sh4, ctx, block, reg_src, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_dst = reg_slot(sh4, ctx, block, reg_dst, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_tmp = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+
+    jit_mov(block, slot_src, slot_tmp);
+    jit_shll(block, slot_tmp, 16);
+    jit_shlr(block, slot_dst, 16);
+    jit_or(block, slot_tmp, slot_dst);
+
+    reg_map[reg_dst].stat = REG_STATUS_SLOT;
+
+    free_slot(block, slot_tmp);
+
+    return true;
+}
+
+/*
+ * emit il ops to compute R0 + GBR into a newly-allocated slot and then read the
+ * byte at that address into another newly-allocated slot.  This is the common
+ * part of all the (R0, GBR) byte instructions.
+ */
+static void
+sh4_jit_read_r0_gbr_byte(Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
+                         struct il_code_block *block,
+                         unsigned *addr_slot_out, unsigned *val_slot_out) {
+    unsigned slot_r0 = reg_slot(sh4, ctx, block, SH4_REG_R0, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_gbr = reg_slot(sh4, ctx, block, SH4_REG_GBR,
+                                 WASHDC_JIT_SLOT_GEN);
+    unsigned slot_addr = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+    unsigned slot_val = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+
+    jit_mov(block, slot_r0, slot_addr);
+    jit_add(block, slot_gbr, slot_addr);
+    jit_read_8_slot(block, sh4->mem.map, slot_addr, slot_val);
+
+    *addr_slot_out = slot_addr;
+    *val_slot_out = slot_val;
+}
+
+// AND.B #imm, @(R0, GBR)
+// 11001101iiiiiiii
+bool sh4_jit_andb_imm_r0_gbr(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                             struct il_code_block *block, unsigned pc,
+                             struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned slot_addr, slot_val;
+    sh4_jit_read_r0_gbr_byte(sh4, ctx, block, &slot_addr, &slot_val);
+
+    jit_and_const32(block, slot_val, inst & 0xff);
+    jit_write_8_slot(block, sh4->mem.map, slot_val, slot_addr);
+
+    free_slot(block, slot_val);
+    free_slot(block, slot_addr);
+
+    return true;
+}
+
+// OR.B #imm, @(R0, GBR)
+// 11001111iiiiiiii
+bool sh4_jit_orb_imm_r0_gbr(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                            struct il_code_block *block, unsigned pc,
+                            struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned slot_addr, slot_val;
+    sh4_jit_read_r0_gbr_byte(sh4, ctx, block, &slot_addr, &slot_val);
+
+    jit_or_const32(block, slot_val, inst & 0xff);
+    jit_write_8_slot(block, sh4->mem.map, slot_val, slot_addr);
+
+    free_slot(block, slot_val);
+    free_slot(block, slot_addr);
+
+    return true;
+}
+
+// XOR.B #imm, @(R0, GBR)
+// 11001110iiiiiiii
+bool sh4_jit_xorb_imm_r0_gbr(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                             struct il_code_block *block, unsigned pc,
+                             struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned slot_addr, slot_val;
+    sh4_jit_read_r0_gbr_byte(sh4, ctx, block, &slot_addr, &slot_val);
+
+    jit_xor_const32(block, slot_val, inst & 0xff);
+    jit_write_8_slot(block, sh4->mem.map, slot_val, slot_addr);
+
+    free_slot(block, slot_val);
+    free_slot(block, slot_addr);
+
+    return true;
+}
+
+// TST.B #imm, @(R0, GBR)
+// 11001100iiiiiiii
+bool sh4_jit_tstb_imm_r0_gbr(Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                             struct il_code_block *block, unsigned pc,
+                             struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned slot_addr, slot_val;
+    sh4_jit_read_r0_gbr_byte(sh4, ctx, block, &slot_addr, &slot_val);
+    unsigned slot_sr = reg_slot(sh4, ctx, block, SH4_REG_SR, WASHDC_JIT_SLOT_GEN);
+
+    jit_and_const32(block, slot_val, inst & 0xff);
+    jit_slot_to_bool_inv(block, slot_val);
+    jit_and_const32(block, slot_sr, ~1);
+    jit_or(block, slot_val, slot_sr);
+
+    reg_map[SH4_REG_SR].stat = REG_STATUS_SLOT;
+
+    free_slot(block, slot_val);
+    free_slot(block, slot_addr);
+
+    return true;
+}
+
+// proxy-wrapper for sh4_set_exception that can be used for jit_call_func_imm32
+static void sh4_set_exception_proxy(void *sh4, unsigned excp_code) {
+    sh4_set_exception((Sh4*)sh4, excp_code);
+}
+
+// TRAPA #immed
+// 11000011iiiiiiii
+bool sh4_jit_trapa_imm(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                       struct il_code_block *block, unsigned pc,
+                       struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned tra_slot = reg_slot(sh4, ctx, block,
+                                 SH4_REG_TRA, WASHDC_JIT_SLOT_GEN);
+    jit_set_slot(block, tra_slot, (inst & BIT_RANGE(0, 7)) << 2);
+    reg_map[SH4_REG_TRA].stat = REG_STATUS_SLOT;
+
+    /*
+     * set SH4_REG_PC to point to the next instruction after this.
+     *
+     * sh4_set_exception will use this to initialize SPC so it has to be
+     * the correct value.
+     */
+    unsigned pc_slot = reg_slot(sh4, ctx, block,
+                                SH4_REG_PC, WASHDC_JIT_SLOT_GEN);
+    jit_set_slot(block, pc_slot, pc + 2);
+    reg_map[SH4_REG_PC].stat = REG_STATUS_SLOT;
+
+    /* calling sh4_set_exception will change the sr */
+    res_drain_all_regs(sh4, ctx, block);
+    res_invalidate_all_regs(block);
+    jit_call_func_imm32(block, sh4_set_exception_proxy,
+                        SH4_EXCP_UNCONDITIONAL_TRAP);
+
+    // jump to new PC which was set by sh4_set_exception
+    unsigned hash_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+    pc_slot = reg_slot(sh4, ctx, block,
+                       SH4_REG_PC, WASHDC_JIT_SLOT_GEN);
+    unsigned fpscr_slot = reg_slot(sh4, ctx, block, SH4_REG_FPSCR,
+                                   WASHDC_JIT_SLOT_GEN);
+
+    sh4_jit_hash_slot(sh4, block, pc_slot, hash_slot, fpscr_slot);
+    free_slot(block, fpscr_slot);
+
+    res_drain_all_regs(sh4, ctx, block);
+    jit_jump(block, pc_slot, hash_slot);
+
+    free_slot(block, hash_slot);
+    free_slot(block, pc_slot);
+
+    return false;
+}
+
+// LDS Rm, FPSCR
+// 0100mmmm01101010
+bool sh4_jit_lds_rm_fpscr(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                          struct il_code_block *block, unsigned pc,
+                          struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned reg_src = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
+    unsigned slot_src = reg_slot(sh4, ctx, block, reg_src, WASHDC_JIT_SLOT_GEN);
+    res_disassociate_reg(sh4, ctx, block, reg_src);
+
+    /*
+     * there are a few different ways editing the FPSCR can cause side-effects (for
+     * example by initiating a bank-switch) so we need to make sure everything
+     * is committed to the reg array and we also need to make sure we reload any
+     * registers referenced after the jit_restore_sr operation.
+     */
+    res_drain_all_regs(sh4, ctx, block);
+    res_invalidate_all_regs(block);
+
+    jit_call_func(block, sh4_set_fpscr, slot_src);
+
+    free_slot(block, slot_src);
+
+    ctx->dirty_fpscr = true;
+    if (!ctx->in_delay_slot) {
+        /*
+         * since the code hash (which includes SZ and PR) just changed, we need to
+         * handle this like a jmp instruction.
+         */
+        unsigned jmp_addr_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+        jit_set_slot(block, jmp_addr_slot, pc + 2);
+
+        unsigned hash_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+        unsigned fpscr_slot = reg_slot(sh4, ctx, block, SH4_REG_FPSCR,
+                                       WASHDC_JIT_SLOT_GEN);
+        sh4_jit_hash_slot(sh4, block, jmp_addr_slot, hash_slot, fpscr_slot);
+
+        res_drain_all_regs(sh4, ctx, block);
+        jit_jump(block, jmp_addr_slot, hash_slot);
+
+        free_slot(block, hash_slot);
+        free_slot(block, jmp_addr_slot);
+
+        return false;
+    }
+
+    return true;
+}
+
+// LDS.L @Rm+, FPSCR
+// 0100mmmm01100110
+bool sh4_jit_ldsl_armp_fpscr(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                             struct il_code_block *block, unsigned pc,
+                             struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned addr_reg = ((inst & 0x0f00) >> 8) + SH4_REG_R0;
+    unsigned addr_slot = reg_slot(sh4, ctx, block, addr_reg, WASHDC_JIT_SLOT_GEN);
+    unsigned new_val_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+
+    jit_read_32_slot(block, sh4->mem.map, addr_slot, new_val_slot);
+    jit_add_const32(block, addr_slot, 4);
+    reg_map[addr_reg].stat = REG_STATUS_SLOT;
+
+    /*
+     * there are a few different ways editing the FPSCR can cause side-effects (for
+     * example by initiating a bank-switch) so we need to make sure everything
      * is committed to the reg array and we also need to make sure we reload any
      * registers referenced after the jit_restore_sr operation.
      */
@@ -2177,6 +3092,10 @@ bool sh4_jit_fmov_fpu_a_r0_rn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     res_drain_all_regs(sh4, ctx, block);
     res_invalidate_all_regs(block);
 
+#ifdef JIT_PROFILE
+    jit_call_func_imm32(block, sh4_jit_count_fallback, inst);
+#endif
+
     il_inst.op = JIT_OP_FALLBACK;
     il_inst.immed.fallback.fallback_fn = handler;
     il_inst.immed.fallback.inst = inst;
@@ -2224,6 +3143,10 @@ bool sh4_jit_fmov_fpu_armp_fpu(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     res_drain_all_regs(sh4, ctx, block);
     res_invalidate_all_regs(block);
 
+#ifdef JIT_PROFILE
+    jit_call_func_imm32(block, sh4_jit_count_fallback, inst);
+#endif
+
     il_inst.op = JIT_OP_FALLBACK;
     il_inst.immed.fallback.fallback_fn = handler;
     il_inst.immed.fallback.inst = inst;
@@ -2268,6 +3191,10 @@ bool sh4_jit_fmov_arm_fpu(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     res_drain_all_regs(sh4, ctx, block);
     res_invalidate_all_regs(block);
 
+#ifdef JIT_PROFILE
+    jit_call_func_imm32(block, sh4_jit_count_fallback, inst);
+#endif
+
     il_inst.op = JIT_OP_FALLBACK;
     il_inst.immed.fallback.fallback_fn = handler;
     il_inst.immed.fallback.inst = inst;
@@ -2313,6 +3240,10 @@ bool sh4_jit_fmov_fpu_amrn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     res_drain_all_regs(sh4, ctx, block);
     res_invalidate_all_regs(block);
 
+#ifdef JIT_PROFILE
+    jit_call_func_imm32(block, sh4_jit_count_fallback, inst);
+#endif
+
     il_inst.op = JIT_OP_FALLBACK;
     il_inst.immed.fallback.fallback_fn = handler;
     il_inst.immed.fallback.inst = inst;
@@ -2488,6 +3419,10 @@ bool sh4_jit_ftrc_frm_fpul(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     res_drain_all_regs(sh4, ctx, block);
     res_invalidate_all_regs(block);
 
+#ifdef JIT_PROFILE
+    jit_call_func_imm32(block, sh4_jit_count_fallback, inst);
+#endif
+
     il_inst.op = JIT_OP_FALLBACK;
     il_inst.immed.fallback.fallback_fn = handler;
     il_inst.immed.fallback.inst = inst;
@@ -2541,6 +3476,10 @@ bool sh4_jit_fmovs_a_r0_rm_fpu(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     res_drain_all_regs(sh4, ctx, block);
     res_invalidate_all_regs(block);
 
+#ifdef JIT_PROFILE
+    jit_call_func_imm32(block, sh4_jit_count_fallback, inst);
+#endif
+
     il_inst.op = JIT_OP_FALLBACK;
     il_inst.immed.fallback.fallback_fn = handler;
     il_inst.immed.fallback.inst = inst;
@@ -2603,6 +3542,10 @@ bool sh4_jit_fmov_frm_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     res_drain_all_regs(sh4, ctx, block);
     res_invalidate_all_regs(block);
 
+#ifdef JIT_PROFILE
+    jit_call_func_imm32(block, sh4_jit_count_fallback, inst);
+#endif
+
     il_inst.op = JIT_OP_FALLBACK;
     il_inst.immed.fallback.fallback_fn = handler;
     il_inst.immed.fallback.inst = inst;
@@ -2635,6 +3578,200 @@ bool sh4_jit_fldi0_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
     return true;
 }
 
+// FDIV FRm, FRn
+// 1111nnnnmmmm0011
+// FDIV DRm, DRn
+// 1111nnn0mmm00011
+bool sh4_jit_fdiv_frm_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                          struct il_code_block *block, unsigned pc,
+                          struct InstOpcode const *op, cpu_inst_param inst) {
+    if (ctx->pr_bit)
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned fr_src_reg = ((inst >> 4) & 0xf) + SH4_REG_FR0;
+    unsigned fr_dst_reg = ((inst >> 8) & 0xf) + SH4_REG_FR0;
+
+    unsigned fr_src_slot =
+        reg_slot(sh4, ctx, block, fr_src_reg, WASHDC_JIT_SLOT_FLOAT);
+    unsigned fr_dst_slot =
+        reg_slot(sh4, ctx, block, fr_dst_reg, WASHDC_JIT_SLOT_FLOAT);
+
+    jit_div_float(block, fr_src_slot, fr_dst_slot);
+
+    reg_map[fr_dst_reg].stat = REG_STATUS_SLOT;
+
+    return true;
+}
+
+// FMAC FR0, FRm, FRn
+// 1111nnnnmmmm1110
+bool sh4_jit_fmac_fr0_frm_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                              struct il_code_block *block, unsigned pc,
+                              struct InstOpcode const *op,
+                              cpu_inst_param inst) {
+    if (ctx->pr_bit)
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned fr_src_reg = ((inst >> 4) & 0xf) + SH4_REG_FR0;
+    unsigned fr_dst_reg = ((inst >> 8) & 0xf) + SH4_REG_FR0;
+
+    unsigned fr0_slot =
+        reg_slot(sh4, ctx, block, SH4_REG_FR0, WASHDC_JIT_SLOT_FLOAT);
+    unsigned fr_src_slot =
+        reg_slot(sh4, ctx, block, fr_src_reg, WASHDC_JIT_SLOT_FLOAT);
+    unsigned fr_dst_slot =
+        reg_slot(sh4, ctx, block, fr_dst_reg, WASHDC_JIT_SLOT_FLOAT);
+
+    /*
+     * the product is rounded before it gets added, same as in the
+     * interpreter.  Don't replace this with a fused multiply-add.
+     */
+    unsigned prod_slot = alloc_slot(block, WASHDC_JIT_SLOT_FLOAT);
+    jit_mov_float(block, fr0_slot, prod_slot);
+    jit_mul_float(block, fr_src_slot, prod_slot);
+    jit_add_float(block, fr_dst_slot, prod_slot);
+    jit_mov_float(block, prod_slot, fr_dst_slot);
+    free_slot(block, prod_slot);
+
+    reg_map[fr_dst_reg].stat = REG_STATUS_SLOT;
+
+    return true;
+}
+
+// FSQRT FRn
+// 1111nnnn01101101
+// FSQRT DRn
+// 1111nnn001101101
+bool sh4_jit_fsqrt_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                       struct il_code_block *block, unsigned pc,
+                       struct InstOpcode const *op, cpu_inst_param inst) {
+    if (ctx->pr_bit)
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned fr_reg = ((inst >> 8) & 0xf) + SH4_REG_FR0;
+
+    unsigned fr_slot = reg_slot(sh4, ctx, block, fr_reg, WASHDC_JIT_SLOT_FLOAT);
+    unsigned fpscr_slot = reg_slot(sh4, ctx, block, SH4_REG_FPSCR,
+                                   WASHDC_JIT_SLOT_GEN);
+
+    /*
+     * negative inputs set the V flag and produce the same NaN as the
+     * interpreter.  Unlike the interpreter, this does not check whether the
+     * V exception is enabled (the interpreter doesn't implement that exception
+     * either, it just raises an error).
+     */
+    jit_sqrt_float(block, fr_slot, fpscr_slot, 0x7fbfffff,
+                   SH4_FPSCR_FLAG_V_MASK | SH4_FPSCR_CAUSE_V_MASK);
+
+    reg_map[fr_reg].stat = REG_STATUS_SLOT;
+    reg_map[SH4_REG_FPSCR].stat = REG_STATUS_SLOT;
+
+    return true;
+}
+
+// FSRRA FRn
+// 1111nnnn01111101
+bool sh4_jit_fsrra_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                       struct il_code_block *block, unsigned pc,
+                       struct InstOpcode const *op, cpu_inst_param inst) {
+    if (ctx->pr_bit)
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned fr_reg = ((inst >> 8) & 0xf) + SH4_REG_FR0;
+    unsigned fr_slot = reg_slot(sh4, ctx, block, fr_reg, WASHDC_JIT_SLOT_FLOAT);
+
+    jit_rsqrt_float(block, fr_slot);
+
+    reg_map[fr_reg].stat = REG_STATUS_SLOT;
+
+    return true;
+}
+
+// FSCA FPUL, DRn
+// 1111nnn011111101
+bool sh4_jit_fsca_fpul_drn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                           struct il_code_block *block, unsigned pc,
+                           struct InstOpcode const *op, cpu_inst_param inst) {
+    if (ctx->pr_bit)
+        return sh4_jit_fallback(sh4, ctx, block, pc, op, inst);
+
+    unsigned sin_reg = ((inst >> 9) & 0x7) * 2 + SH4_REG_FR0;
+    unsigned cos_reg = sin_reg + 1;
+
+    unsigned fpul_slot = reg_slot(sh4, ctx, block, SH4_REG_FPUL,
+                                  WASHDC_JIT_SLOT_GEN);
+    unsigned angle_slot = alloc_slot(block, WASHDC_JIT_SLOT_GEN);
+    jit_mov(block, fpul_slot, angle_slot);
+    jit_and_const32(block, angle_slot, FSCA_TBL_LEN - 1);
+
+    unsigned sin_slot = reg_slot_noload(sh4, block, sin_reg,
+                                        WASHDC_JIT_SLOT_FLOAT);
+    unsigned cos_slot = reg_slot_noload(sh4, block, cos_reg,
+                                        WASHDC_JIT_SLOT_FLOAT);
+
+    jit_load_float_slot_indexed(block, (float const*)sh4_fsca_sin_tbl,
+                                angle_slot, sin_slot);
+    jit_load_float_slot_indexed(block, (float const*)sh4_fsca_cos_tbl,
+                                angle_slot, cos_slot);
+
+    free_slot(block, angle_slot);
+
+    reg_map[sin_reg].stat = REG_STATUS_SLOT;
+    reg_map[cos_reg].stat = REG_STATUS_SLOT;
+
+    return true;
+}
+
+/*
+ * FIPR and FTRV operate directly on the reg array instead of on slots, so
+ * their inputs need to be written back to the reg array beforehand and their
+ * outputs need to be reloaded from it afterwards.
+ */
+
+// FIPR FVm, FVn
+// 1111nnmm11101101
+bool sh4_jit_fipr_fvm_fvn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                          struct il_code_block *block, unsigned pc,
+                          struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned fv_src_reg = ((inst >> 8) & 0x3) * 4 + SH4_REG_FR0;
+    unsigned fv_dst_reg = ((inst >> 10) & 0x3) * 4 + SH4_REG_FR0;
+    unsigned idx;
+
+    for (idx = 0; idx < 4; idx++) {
+        res_drain_reg(sh4, ctx, block, fv_src_reg + idx);
+        res_drain_reg(sh4, ctx, block, fv_dst_reg + idx);
+    }
+
+    jit_dot4_float(block, get_regbase_slot(sh4, ctx, block),
+                   fv_src_reg, fv_dst_reg, fv_dst_reg + 3);
+
+    res_invalidate_reg(block, fv_dst_reg + 3);
+
+    return true;
+}
+
+// FTRV XMTRX, FVn
+// 1111nn0111111101
+bool sh4_jit_ftrv_xmtrx_fvn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                            struct il_code_block *block, unsigned pc,
+                            struct InstOpcode const *op, cpu_inst_param inst) {
+    unsigned fv_reg = ((inst >> 10) & 0x3) * 4 + SH4_REG_FR0;
+    unsigned idx;
+
+    for (idx = 0; idx < 16; idx++)
+        res_drain_reg(sh4, ctx, block, SH4_REG_XF0 + idx);
+    for (idx = 0; idx < 4; idx++)
+        res_drain_reg(sh4, ctx, block, fv_reg + idx);
+
+    jit_xform4_float(block, get_regbase_slot(sh4, ctx, block),
+                     SH4_REG_XF0, fv_reg);
+
+    for (idx = 0; idx < 4; idx++)
+        res_invalidate_reg(block, fv_reg + idx);
+
+    return true;
+}
+
 static unsigned reg_slot(Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
                          struct il_code_block *block, unsigned reg_no,
                          enum washdc_jit_slot_tp tp) {
@@ -27,12 +27,14 @@
 
 #include "washdc/cpu.h"
 #include "washdc/types.h"
+#include "mem_areas.h"
 #include "sh4_inst.h"
 #include "sh4_read_inst.h"
 #include "jit/jit_il.h"
 #include "jit/code_block.h"
 #include "jit/optimize.h"
 #include "jit/code_cache.h"
+#include "config.h"
 
 #ifdef JIT_PROFILE
 #include "jit/jit_profile.h"
@@ -59,13 +61,34 @@ struct sh4_jit_compile_ctx {
     // only valid if have_reg_slot is true
     unsigned reg_slot;
 
+    /*
+     * superblock state (see sh4_jit_extend_trace).  trace_head is the PC the
+     * block starts at, and segment_head is the PC the block was at after it
+     * went past its most recent conditional branch.  next_pc is where the
+     * block continues after the current instruction.
+     */
+    addr32_t trace_head, segment_head, next_pc;
+    unsigned n_side_exits, n_insts;
+
     bool sz_bit : 1;
     bool pr_bit : 1;
     bool in_delay_slot : 1;
     bool dirty_fpscr : 1;
     bool have_reg_slot : 1;
+
+    // if set, conditional branches may be compiled as side exits
+    bool superblock : 1;
 };
 
+// maximum number of instructions in a superblock
+#define SH4_JIT_SUPERBLOCK_MAX_INSTS 256
+
+/*
+ * superblocks only follow a taken branch if it's no further than this many
+ * bytes forward, since everything in between gets watched for writes.
+ */
+#define SH4_JIT_SUPERBLOCK_MAX_SKIP 256
+
 #define SH4_JIT_HASH_MASK 0x1fffffff
 #define SH4_JIT_HASH_PR_SHIFT 29
 #define SH4_JIT_HASH_SZ_SHIFT 30
@@ -91,14 +114,24 @@ sh4_jit_compile_inst(struct Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
                      struct il_code_block *block, cpu_inst_param inst,
                      unsigned pc);
 
+/*
+ * if watch_ram is set, then jit_blk gets invalidated whenever the RAM that the
+ * block was compiled from is written to.  This should only be clear if the
+ * RAM is already being watched on behalf of jit_blk.
+ */
 static inline void
 sh4_jit_il_code_block_compile(struct Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
                               struct jit_code_block *jit_blk,
-                              struct il_code_block *block, addr32_t addr) {
+                              struct il_code_block *block, addr32_t addr,
+                              bool watch_ram) {
     bool do_continue;
+    addr32_t addr_first = addr & BIT_RANGE(0, 28);
 
     sh4_jit_new_block();
 
+    ctx->trace_head = ctx->segment_head = addr;
+    ctx->n_side_exits = ctx->n_insts = 0;
+
     do {
         cpu_inst_param inst =
             memory_map_read_16(sh4->mem.map, addr & BIT_RANGE(0, 28));
@@ -108,9 +141,26 @@ sh4_jit_il_code_block_compile(struct Sh4 *sh4, struct sh4_jit_compile_ctx *ctx,
         jit_profile_push_inst(&sh4->jit_profile, jit_blk->profile, &inst16);
 #endif
 
+        ctx->next_pc = addr + 2;
+        ctx->n_insts++;
         do_continue = sh4_jit_compile_inst(sh4, ctx, block, inst, addr);
-        addr += 2;
+        addr = ctx->next_pc;
     } while (do_continue);
+
+    /*
+     * If the last instruction had a delay slot, then addr points to the delay
+     * slot now.  Otherwise this includes one instruction too many, which is
+     * harmless.
+     *
+     * Superblocks only ever continue forwards, so this covers every segment
+     * of the block (along with anything that got skipped over in between).
+     */
+    addr32_t addr_last = (addr + 1) & BIT_RANGE(0, 28);
+    if (watch_ram && addr_first >= ADDR_AREA3_FIRST && addr_last <= ADDR_AREA3_LAST &&
+        (addr_first & ADDR_AREA3_MASK) <= (addr_last & ADDR_AREA3_MASK)) {
+        code_cache_watch_ram(jit_blk, addr_first & ADDR_AREA3_MASK,
+                             addr_last & ADDR_AREA3_MASK);
+    }
 }
 
 #ifdef ENABLE_JIT_X86_64
@@ -135,7 +185,8 @@ sh4_jit_compile_native(void *cpu, struct native_dispatch_meta const *meta,
         .pr_bit = sh4_fpscr_pr(sh4),
         .in_delay_slot = false,
         .dirty_fpscr = false,
-        .have_reg_slot = false
+        .have_reg_slot = false,
+        .superblock = config_get_jit_superblocks()
     };
 
     il_code_block_init(&il_blk);
@@ -143,8 +194,9 @@ sh4_jit_compile_native(void *cpu, struct native_dispatch_meta const *meta,
 #ifdef JIT_PROFILE
     il_blk.profile = jit_blk->profile;
 #endif
+    il_blk.prof = jit_blk->prof;
 
-    sh4_jit_il_code_block_compile(cpu, &ctx, jit_blk, &il_blk, pc);
+    sh4_jit_il_code_block_compile(cpu, &ctx, jit_blk, &il_blk, pc, true);
 
     jit_optimize(&il_blk);
 
@@ -161,6 +213,7 @@ sh4_jit_compile_native(void *cpu, struct native_dispatch_meta const *meta,
 #endif
     code_block_x86_64_compile(cpu, blk, &il_blk, meta,
                               ctx.cycle_count * SH4_CLOCK_SCALE);
+    jit_block_prof_set_code(jit_blk->prof, il_blk.inst_count, blk->bytes_used);
 
 #ifdef JIT_PROFILE
     ptrdiff_t wasted_bytes = 0;
@@ -172,6 +225,31 @@ sh4_jit_compile_native(void *cpu, struct native_dispatch_meta const *meta,
 
     il_code_block_cleanup(&il_blk);
 }
+
+/*
+ * build the IL for the block at pc without compiling it, for tiered
+ * compilation.  This returns the block's cycle count.
+ */
+static inline unsigned
+sh4_jit_build_il(void *cpu, struct jit_code_block *jit_blk,
+                 struct il_code_block *il_blk, addr32_t pc, bool watch_ram,
+                 bool superblock) {
+    struct Sh4 *sh4 = (struct Sh4*)cpu;
+    struct sh4_jit_compile_ctx ctx = {
+        .last_inst_type = SH4_GROUP_NONE,
+        .cycle_count = 0,
+        .sz_bit = sh4_fpscr_sz(sh4),
+        .pr_bit = sh4_fpscr_pr(sh4),
+        .in_delay_slot = false,
+        .dirty_fpscr = false,
+        .have_reg_slot = false,
+        .superblock = superblock
+    };
+
+    sh4_jit_il_code_block_compile(sh4, &ctx, jit_blk, il_blk, pc, watch_ram);
+
+    return ctx.cycle_count * SH4_CLOCK_SCALE;
+}
 #endif
 
 static inline void
@@ -195,8 +273,9 @@ sh4_jit_compile_intp(void *cpu, void *blk_ptr, uint32_t pc) {
 #ifdef JIT_PROFILE
     il_blk.profile = jit_blk->profile;
 #endif
+    il_blk.prof = jit_blk->prof;
 
-    sh4_jit_il_code_block_compile(cpu, &ctx, jit_blk, &il_blk, pc);
+    sh4_jit_il_code_block_compile(cpu, &ctx, jit_blk, &il_blk, pc, true);
 
     jit_optimize(&il_blk);
 
@@ -213,6 +292,7 @@ sh4_jit_compile_intp(void *cpu, void *blk_ptr, uint32_t pc) {
 #endif
 
     code_block_intp_compile(cpu, blk, &il_blk, ctx.cycle_count * SH4_CLOCK_SCALE);
+    jit_block_prof_set_code(jit_blk->prof, il_blk.inst_count, 0);
     il_code_block_cleanup(&il_blk);
 }
 
@@ -227,6 +307,13 @@ void sh4_jit_cleanup(struct Sh4 *sh4);
 
 #ifdef ENABLE_JIT_X86_64
 void sh4_jit_set_native_dispatch_meta(struct native_dispatch_meta *meta);
+
+/*
+ * keep the SH4's most-used general-purpose registers in host registers while
+ * native code runs.  This must be called between jit_x86_64_backend_init and
+ * native_dispatch_init.
+ */
+void sh4_jit_pin_regs(struct Sh4 *sh4);
 #endif
 
 /*
@@ -237,6 +324,14 @@ bool sh4_jit_fallback(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                       struct il_code_block *block, unsigned pc,
                       struct InstOpcode const *op, cpu_inst_param inst);
 
+/*
+ * disassemble the sleep instruction.  This goes through the interpreter like
+ * sh4_jit_fallback, but it also ends the block.
+ */
+bool sh4_jit_sleep(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                   struct il_code_block *block, unsigned pc,
+                   struct InstOpcode const *op, cpu_inst_param inst);
+
 // disassemble the rts instruction
 bool sh4_jit_rts(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                  struct il_code_block *block, unsigned pc,
@@ -325,6 +420,9 @@ bool sh4_jit_ocbp_arn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
 bool sh4_jit_ocbwb_arn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                        struct il_code_block *block, unsigned pc,
                        struct InstOpcode const *op, cpu_inst_param inst);
+bool sh4_jit_pref_arn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                      struct il_code_block *block, unsigned pc,
+                      struct InstOpcode const *op, cpu_inst_param inst);
 
 // ADD Rm, Rn
 // 0011nnnnmmmm1100
@@ -679,6 +777,146 @@ sh4_jit_extub_rm_rn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                     struct il_code_block *block, unsigned pc,
                     struct InstOpcode const *op, cpu_inst_param inst);
 
+// ADDC Rm, Rn
+// 0011nnnnmmmm1110
+bool
+sh4_jit_addc_rm_rn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                   struct il_code_block *block, unsigned pc,
+                   struct InstOpcode const *op, cpu_inst_param inst);
+
+// SUBC Rm, Rn
+// 0011nnnnmmmm1010
+bool
+sh4_jit_subc_rm_rn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                   struct il_code_block *block, unsigned pc,
+                   struct InstOpcode const *op, cpu_inst_param inst);
+
+// NEGC Rm, Rn
+// 0110nnnnmmmm1010
+bool
+sh4_jit_negc_rm_rn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                   struct il_code_block *block, unsigned pc,
+                   struct InstOpcode const *op, cpu_inst_param inst);
+
+// DIV0U
+// 0000000000011001
+bool
+sh4_jit_div0u(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+              struct il_code_block *block, unsigned pc,
+              struct InstOpcode const *op, cpu_inst_param inst);
+
+// DIV0S Rm, Rn
+// 0010nnnnmmmm0111
+bool
+sh4_jit_div0s_rm_rn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                    struct il_code_block *block, unsigned pc,
+                    struct InstOpcode const *op, cpu_inst_param inst);
+
+// DIV1 Rm, Rn
+// 0011nnnnmmmm0100
+bool
+sh4_jit_div1_rm_rn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                   struct il_code_block *block, unsigned pc,
+                   struct InstOpcode const *op, cpu_inst_param inst);
+
+// DMULS.L Rm, Rn
+// 0011nnnnmmmm1101
+bool
+sh4_jit_dmulsl_rm_rn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                     struct il_code_block *block, unsigned pc,
+                     struct InstOpcode const *op, cpu_inst_param inst);
+
+// DMULU.L Rm, Rn
+// 0011nnnnmmmm0101
+bool
+sh4_jit_dmulul_rm_rn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                     struct il_code_block *block, unsigned pc,
+                     struct InstOpcode const *op, cpu_inst_param inst);
+
+// MUL.L Rm, Rn
+// 0000nnnnmmmm0111
+bool
+sh4_jit_mull_rm_rn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                   struct il_code_block *block, unsigned pc,
+                   struct InstOpcode const *op, cpu_inst_param inst);
+
+// MAC.L @Rm+, @Rn+
+// 0000nnnnmmmm1111
+bool
+sh4_jit_macl_armp_arnp(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                       struct il_code_block *block, unsigned pc,
+                       struct InstOpcode const *op, cpu_inst_param inst);
+
+// MAC.W @Rm+, @Rn+
+// 0100nnnnmmmm1111
+bool
+sh4_jit_macw_armp_arnp(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                       struct il_code_block *block, unsigned pc,
+                       struct InstOpcode const *op, cpu_inst_param inst);
+
+// ROTL Rn
+// 0100nnnn00000100
+bool
+sh4_jit_rotl_rn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                struct il_code_block *block, unsigned pc,
+                struct InstOpcode const *op, cpu_inst_param inst);
+
+// ROTR Rn
+// 0100nnnn00000101
+bool
+sh4_jit_rotr_rn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                struct il_code_block *block, unsigned pc,
+                struct InstOpcode const *op, cpu_inst_param inst);
+
+// ROTCL Rn
+// 0100nnnn00100100
+bool
+sh4_jit_rotcl_rn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                 struct il_code_block *block, unsigned pc,
+                 struct InstOpcode const *op, cpu_inst_param inst);
+
+// ROTCR Rn
+// 0100nnnn00100101
+bool
+sh4_jit_rotcr_rn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                 struct il_code_block *block, unsigned pc,
+                 struct InstOpcode const *op, cpu_inst_param inst);
+
+// XTRCT Rm, Rn
+// 0010nnnnmmmm1101
+bool
+sh4_jit_xtrct_rm_rn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                    struct il_code_block *block, unsigned pc,
+                    struct InstOpcode const *op, cpu_inst_param inst);
+
+// AND.B #imm, @(R0, GBR)
+// 11001101iiiiiiii
+bool
+sh4_jit_andb_imm_r0_gbr(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                        struct il_code_block *block, unsigned pc,
+                        struct InstOpcode const *op, cpu_inst_param inst);
+
+// OR.B #imm, @(R0, GBR)
+// 11001111iiiiiiii
+bool
+sh4_jit_orb_imm_r0_gbr(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                       struct il_code_block *block, unsigned pc,
+                       struct InstOpcode const *op, cpu_inst_param inst);
+
+// XOR.B #imm, @(R0, GBR)
+// 11001110iiiiiiii
+bool
+sh4_jit_xorb_imm_r0_gbr(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                        struct il_code_block *block, unsigned pc,
+                        struct InstOpcode const *op, cpu_inst_param inst);
+
+// TST.B #imm, @(R0, GBR)
+// 11001100iiiiiiii
+bool
+sh4_jit_tstb_imm_r0_gbr(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                        struct il_code_block *block, unsigned pc,
+                        struct InstOpcode const *op, cpu_inst_param inst);
+
 // LDS Rm, FPSCR
 // 0100mmmm01101010
 bool sh4_jit_lds_rm_fpscr(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
@@ -819,4 +1057,46 @@ bool sh4_jit_trapa_imm(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
 bool sh4_jit_fldi0_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
                        struct il_code_block *block, unsigned pc,
                        struct InstOpcode const *op, cpu_inst_param inst);
+
+// FDIV FRm, FRn
+// 1111nnnnmmmm0011
+bool sh4_jit_fdiv_frm_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                          struct il_code_block *block, unsigned pc,
+                          struct InstOpcode const *op, cpu_inst_param inst);
+
+// FMAC FR0, FRm, FRn
+// 1111nnnnmmmm1110
+bool sh4_jit_fmac_fr0_frm_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                              struct il_code_block *block, unsigned pc,
+                              struct InstOpcode const *op, cpu_inst_param inst);
+
+// FSQRT FRn
+// 1111nnnn01101101
+bool sh4_jit_fsqrt_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                       struct il_code_block *block, unsigned pc,
+                       struct InstOpcode const *op, cpu_inst_param inst);
+
+// FSRRA FRn
+// 1111nnnn01111101
+bool sh4_jit_fsrra_frn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                       struct il_code_block *block, unsigned pc,
+                       struct InstOpcode const *op, cpu_inst_param inst);
+
+// FSCA FPUL, DRn
+// 1111nnn011111101
+bool sh4_jit_fsca_fpul_drn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                           struct il_code_block *block, unsigned pc,
+                           struct InstOpcode const *op, cpu_inst_param inst);
+
+// FIPR FVm, FVn
+// 1111nnmm11101101
+bool sh4_jit_fipr_fvm_fvn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                          struct il_code_block *block, unsigned pc,
+                          struct InstOpcode const *op, cpu_inst_param inst);
+
+// FTRV XMTRX, FVn
+// 1111nn0111111101
+bool sh4_jit_ftrv_xmtrx_fvn(struct Sh4 *sh4, struct sh4_jit_compile_ctx* ctx,
+                            struct il_code_block *block, unsigned pc,
+                            struct InstOpcode const *op, cpu_inst_param inst);
 #endif
@@ -21,6 +21,7 @@
  ******************************************************************************/
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "sh4.h"
 #include "washdc/MemoryMap.h"
@@ -440,6 +441,42 @@ sh4_utlb_find_ent_associative(struct Sh4 *sh4, uint32_t vpn) {
     return ent;
 }
 
+#ifdef ENABLE_MMU
+static inline uint32_t sh4_utlb_cache_tag(struct Sh4 *sh4, uint32_t vpn) {
+    uint32_t tag = (vpn & BIT_RANGE(10, 31)) | SH4_UTLB_CACHE_TAG_VALID;
+
+    // this needs to agree with asid_check
+    if ((sh4->reg[SH4_REG_MMUCR] & SH4_MMUCR_SV_MASK) &&
+        (sh4->reg[SH4_REG_SR] & SH4_SR_MD_MASK))
+        tag |= SH4_UTLB_CACHE_TAG_NO_ASID;
+    else
+        tag |= sh4->reg[SH4_REG_PTEH] & SH4_UTLB_CACHE_TAG_ASID_MASK;
+
+    return tag;
+}
+
+struct sh4_utlb_ent *sh4_utlb_find_ent_cached(struct Sh4 *sh4, uint32_t vpn) {
+    struct sh4_utlb_cache_ent *cache_ent =
+        sh4->mem.utlb_cache + ((vpn >> 10) & (SH4_UTLB_CACHE_LEN - 1));
+    uint32_t tag = sh4_utlb_cache_tag(sh4, vpn);
+
+    if (cache_ent->tag == tag)
+        return cache_ent->ent;
+
+    // misses don't get cached since they're going to raise an exception anyways
+    struct sh4_utlb_ent *ent = sh4_utlb_find_ent_associative(sh4, vpn);
+    if (ent) {
+        cache_ent->tag = tag;
+        cache_ent->ent = ent;
+    }
+    return ent;
+}
+
+void sh4_utlb_cache_flush(struct Sh4 *sh4) {
+    memset(sh4->mem.utlb_cache, 0, sizeof(sh4->mem.utlb_cache));
+}
+#endif
+
 // vpn should be shifted such that the MSB is at bit 31
 struct sh4_itlb_ent *
 sh4_itlb_find_ent_associative(struct Sh4 *sh4, uint32_t vpn) {
@@ -478,6 +515,8 @@ static void sh4_utlb_addr_array_write(struct Sh4 *sh4, addr32_t addr, uint32_t v
     uint32_t vpn = (val & BIT_RANGE(10, 31));
     uint32_t asid = val & BIT_RANGE(0, 7);
 
+    sh4_utlb_cache_flush(sh4);
+
     if (associative)
         SH4_MEM_TRACE("UTLB ADDRESS ARRAY ASSOCIATIVE WRITE %08X TO %08X\n",
                       (unsigned)val, (unsigned)addr);
@@ -574,6 +613,8 @@ sh4_utlb_data_array_1_write(struct Sh4 *sh4, addr32_t addr, uint32_t val) {
         RAISE_ERROR(ERROR_UNIMPLEMENTED);
     }
 
+    sh4_utlb_cache_flush(sh4);
+
     unsigned ppn = (val & BIT_RANGE(10, 28));
     enum sh4_tlb_page_sz sz =
         (enum sh4_tlb_page_sz)(((val >> 4) & 1) | ((val >> 6) & 2));
@@ -768,7 +809,7 @@ sh4_utlb_translate_address(struct Sh4 *sh4, uint32_t *addrp, bool write) {
     unsigned area = (addr >> 29) & 7;
     if (sh4_mmu_at(sh4) && (sh4_addr_in_sq_area(addr) ||
                             (area != 4 && area != 5 && area != 7))) {
-        struct sh4_utlb_ent *ent = sh4_utlb_find_ent_associative(sh4, addr);
+        struct sh4_utlb_ent *ent = sh4_utlb_find_ent_cached(sh4, addr);
         sh4_utlb_increment_urc(sh4);
         if (!ent)
             return SH4_UTLB_MISS;
@@ -866,7 +907,7 @@ sh4_itlb_translate_address(struct Sh4 *sh4, uint32_t *addr_p) {
 
             itlb_ent = sh4->mem.itlb + idx;
 
-            struct sh4_utlb_ent *utlb_ent = sh4_utlb_find_ent_associative(sh4, addr);
+            struct sh4_utlb_ent *utlb_ent = sh4_utlb_find_ent_cached(sh4, addr);
             if (!utlb_ent) {
                 SH4_MEM_TRACE("ITLB PAGE FAULT SEARCHING FOR %08X\n", (unsigned)addr);
                 return SH4_ITLB_MISS; // ITLB miss exception gets raised
@@ -945,6 +986,8 @@ void sh4_mmu_invalidate_tlb(struct Sh4 *sh4) {
         sh4->mem.utlb[idx].valid = false;
     for (idx = 0; idx < SH4_ITLB_LEN; idx++)
         sh4->mem.itlb[idx].valid = false;
+
+    sh4_utlb_cache_flush(sh4);
 }
 
 void sh4_mmu_do_ldtlb(struct Sh4 *sh4) {
@@ -954,6 +997,8 @@ void sh4_mmu_do_ldtlb(struct Sh4 *sh4) {
     uint32_t ptel = sh4->reg[SH4_REG_PTEL];
     uint32_t ptea = sh4->reg[SH4_REG_PTEA];
 
+    sh4_utlb_cache_flush(sh4);
+
     ent->asid = pteh & BIT_RANGE(0, 7);
     ent->vpn = pteh & BIT_RANGE(10,31);
     ent->ppn = ptel & BIT_RANGE(10, 28);
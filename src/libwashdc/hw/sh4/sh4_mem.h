@@ -160,11 +160,42 @@ struct sh4_itlb_ent {
     bool tc; // i sincerely hope i never need to understand what this is.
 };
 
+#ifdef ENABLE_MMU
+/*
+ * Direct-mapped cache of UTLB lookups so that the common case doesn't have to
+ * search all 64 UTLB entries.  It's indexed by 1KB virtual page (the smallest
+ * page size), and the tag holds the page's VPN in bits 10-31 alongside the
+ * ASID that was current when it was looked up.  That way a lookup is a single
+ * compare, and changing the ASID doesn't require a flush.
+ *
+ * Anything that changes the UTLB has to call sh4_utlb_cache_flush.
+ */
+#define SH4_UTLB_CACHE_LEN 256
+
+// bits 0-7 of the tag are the ASID
+#define SH4_UTLB_CACHE_TAG_ASID_MASK 0xff
+
+// set if the lookup ignored ASIDs (MMUCR.SV is set and we're in privileged mode)
+#define SH4_UTLB_CACHE_TAG_NO_ASID (1 << 8)
+
+// set if the cache entry is in use
+#define SH4_UTLB_CACHE_TAG_VALID (1 << 9)
+
+struct sh4_utlb_cache_ent {
+    uint32_t tag;
+    struct sh4_utlb_ent *ent;
+};
+#endif
+
 struct sh4_mem {
     struct memory_map *map;
 
     struct sh4_utlb_ent utlb[SH4_UTLB_LEN];
     struct sh4_itlb_ent itlb[SH4_ITLB_LEN];
+
+#ifdef ENABLE_MMU
+    struct sh4_utlb_cache_ent utlb_cache[SH4_UTLB_CACHE_LEN];
+#endif
 };
 
 void sh4_set_mem_map(struct Sh4 *sh4, struct memory_map *map);
@@ -212,6 +243,15 @@ sh4_utlb_find_ent_associative(struct Sh4 *sh4, uint32_t vpn);
 struct sh4_itlb_ent *
 sh4_itlb_find_ent_associative(struct Sh4 *sh4, uint32_t vpn);
 
+/*
+ * same as sh4_utlb_find_ent_associative, but this checks the UTLB cache
+ * before searching the UTLB, and it fills in the cache on a hit.
+ */
+struct sh4_utlb_ent *sh4_utlb_find_ent_cached(struct Sh4 *sh4, uint32_t vpn);
+
+// throw out everything in the UTLB cache
+void sh4_utlb_cache_flush(struct Sh4 *sh4);
+
 /*
  * translate the given address based on the given tlb entry.
  * No error checking is performed; it is assumed that the caller
@@ -220,6 +260,11 @@ sh4_itlb_find_ent_associative(struct Sh4 *sh4, uint32_t vpn);
 uint32_t sh4_itlb_ent_translate_addr(struct sh4_itlb_ent const *ent, uint32_t vpn);
 uint32_t sh4_utlb_ent_translate_addr(struct sh4_utlb_ent const *ent, uint32_t vpn);
 
+#else
+
+static inline void sh4_utlb_cache_flush(struct Sh4 *sh4) {
+}
+
 #endif
 
 // invalidate the entirety of both the ITLB and the UTLB
@@ -304,9 +304,17 @@ int sh4_sq_pref(Sh4 *sh4, addr32_t addr) {
     if (region) {
         struct memory_interface const *intf = region->intf;
         void *ctxt = region->ctxt;
-        memory_map_write32_func write32 = intf->write32;
         uint32_t *sq = sh4->ocache.sq + sq_idx;
 
+        if (intf->write_block) {
+            // hand the whole 32-byte burst to the destination at once
+            CHECK_W_WATCHPOINT_BLOCK(addr_actual, 8 * sizeof(uint32_t));
+            intf->write_block(addr_actual, sq, 8 * sizeof(uint32_t), ctxt);
+            return MEM_ACCESS_SUCCESS;
+        }
+
+        memory_map_write32_func write32 = intf->write32;
+
         CHECK_W_WATCHPOINT(addr_actual + 0, uint32_t);
         write32(addr_actual + 0, sq[0], ctxt);
         CHECK_W_WATCHPOINT(addr_actual + 4, uint32_t);
@@ -0,0 +1,93 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "washdc/error.h"
+#include "sh4.h"
+#include "sh4_inst.h"
+#include "sh4_predecode.h"
+
+void sh4_predecode_init(struct sh4_predecode *pd, struct Memory *ram) {
+    memset(pd->pages, 0, sizeof(pd->pages));
+    memset(&pd->scratch, 0, sizeof(pd->scratch));
+    pd->ram = ram;
+}
+
+void sh4_predecode_cleanup(struct sh4_predecode *pd) {
+    unsigned page_no;
+    for (page_no = 0; page_no < MEMORY_N_PAGES; page_no++) {
+        free(pd->pages[page_no]);
+        pd->pages[page_no] = NULL;
+    }
+    pd->ram = NULL;
+}
+
+struct sh4_predecode_page *
+sh4_predecode_refresh_page(struct sh4_predecode *pd, unsigned page_no) {
+    struct sh4_predecode_page *page = pd->pages[page_no];
+
+    if (!page) {
+        page = (struct sh4_predecode_page*)
+            calloc(1, sizeof(struct sh4_predecode_page));
+        if (!page)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        page->gen = 1;
+        pd->pages[page_no] = page;
+    } else if (++page->gen == 0) {
+        // every entry has gen 0 after this, so none of them are valid
+        memset(page->ents, 0, sizeof(page->ents));
+        page->gen = 1;
+    }
+
+    /*
+     * if the page was dirty then n_dirty_pages will be one higher than it
+     * should be.  That's harmless; code_cache_invalidate_dirty only uses it to
+     * decide whether to look for dirty pages.
+     */
+    pd->ram->page_flags[page_no] = MEMORY_PAGE_CODE;
+
+    return page;
+}
+
+void sh4_predecode_fill(struct sh4_predecode_ent *ent, cpu_inst_param inst) {
+    InstOpcode const *op = sh4_decode_inst(inst);
+    ent->op = op;
+    ent->inst = inst;
+    ent->group = op->group;
+    ent->issue = op->issue;
+
+    /*
+     * BT, BF, BT/S and BF/S with a negative displacement, or BRA with a
+     * negative displacement.  Anything else can't be the end of an idle loop.
+     */
+    unsigned hi_byte = (inst >> 8) & 0xff;
+    if ((hi_byte == 0x89 || hi_byte == 0x8b || hi_byte == 0x8d ||
+         hi_byte == 0x8f) && (inst & 0x80))
+        ent->idle = SH4_PREDECODE_IDLE_UNKNOWN;
+    else if ((inst & 0xf800) == 0xa800)
+        ent->idle = SH4_PREDECODE_IDLE_UNKNOWN;
+    else
+        ent->idle = SH4_PREDECODE_IDLE_NO;
+}
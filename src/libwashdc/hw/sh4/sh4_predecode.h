@@ -0,0 +1,107 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#ifndef SH4_PREDECODE_H_
+#define SH4_PREDECODE_H_
+
+#include <stdint.h>
+
+#include "washdc/types.h"
+#include "washdc/cpu.h"
+#include "memory.h"
+
+/*
+ * predecoded instructions for the interpreter.
+ *
+ * Instructions fetched from main system memory are decoded once and then kept
+ * around (along with the opcode's issue cycles and execution group) so that
+ * the interpreter doesn't need to go through the memory map and the decoder
+ * every time it executes them.  Entries are allocated one page of RAM (see
+ * MEMORY_PAGE_SHIFT) at a time the first time code from that page executes.
+ *
+ * A page's entries stay valid as long as its page_flags in the struct Memory
+ * are exactly MEMORY_PAGE_CODE.  Writes to the page mark it as dirty just like
+ * they do for the JIT, and the next fetch from that page throws away all of its
+ * entries by incrementing the page's generation.
+ */
+
+struct InstOpcode;
+
+struct sh4_predecode_ent {
+    struct InstOpcode const *op;
+
+    // this entry is only valid if this matches its page's gen
+    uint32_t gen;
+
+    uint16_t inst;
+
+    /*
+     * op->group and op->issue.  group is packed in with idle to keep the
+     * entry down to 16 bytes.
+     */
+    uint8_t group : 4;
+
+    /*
+     * one of the SH4_PREDECODE_IDLE_* values below.  Backwards branches start
+     * out as SH4_PREDECODE_IDLE_UNKNOWN and get checked for idle loops (see
+     * sh4_idle.h) the first time they run.
+     */
+    uint8_t idle : 2;
+
+    uint8_t issue;
+};
+
+#define SH4_PREDECODE_IDLE_NO      0
+#define SH4_PREDECODE_IDLE_UNKNOWN 1
+#define SH4_PREDECODE_IDLE_YES     2
+
+#define SH4_PREDECODE_PAGE_LEN (MEMORY_PAGE_SIZE / 2)
+
+struct sh4_predecode_page {
+    uint32_t gen;
+    struct sh4_predecode_ent ents[SH4_PREDECODE_PAGE_LEN];
+};
+
+struct sh4_predecode {
+    // NULL if predecoding is disabled
+    struct Memory *ram;
+
+    struct sh4_predecode_page *pages[MEMORY_N_PAGES];
+
+    // holds instructions fetched from anywhere other than main memory
+    struct sh4_predecode_ent scratch;
+};
+
+void sh4_predecode_init(struct sh4_predecode *pd, struct Memory *ram);
+void sh4_predecode_cleanup(struct sh4_predecode *pd);
+
+/*
+ * allocate the given page if it doesn't exist yet, otherwise invalidate all of
+ * its entries.  Either way, the page gets flagged as MEMORY_PAGE_CODE.
+ */
+struct sh4_predecode_page *
+sh4_predecode_refresh_page(struct sh4_predecode *pd, unsigned page_no);
+
+void sh4_predecode_fill(struct sh4_predecode_ent *ent, cpu_inst_param inst);
+
+#endif
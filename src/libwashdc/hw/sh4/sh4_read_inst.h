@@ -37,6 +37,9 @@
 #include "intmath.h"
 #include "log.h"
 #include "sh4_mem.h"
+#include "sh4_predecode.h"
+#include "sh4_idle.h"
+#include "memory.h"
 
 #ifdef DEEP_SYSCALL_TRACE
 #include "deep_syscall_trace.h"
@@ -64,7 +67,8 @@ sh4_enter_irq_from_meta(Sh4 *sh4, struct sh4_irq_meta *irq_meta) {
 /* check IRQ lines and enter interrupt state if necessary */
 static inline void sh4_check_interrupts_no_delay_branch_check(Sh4 *sh4) {
     struct sh4_irq_meta irq_meta;
-    if (sh4_get_next_irq_line(sh4, &irq_meta) >= 0)
+    if (sh4_intc_any_pending(&sh4->intc) &&
+        sh4_get_next_irq_line(sh4, &irq_meta) >= 0)
         sh4_enter_irq_from_meta(sh4, &irq_meta);
 }
 
@@ -192,6 +196,45 @@ static inline int sh4_read_inst(Sh4 *sh4, cpu_inst_param *inst_p, uint32_t pc) {
     return sh4_do_read_inst(sh4, pc, inst_p);
 }
 
+/*
+ * return the predecoded instruction at pc, or NULL if it couldn't be fetched
+ * (in which case an exception will have been raised).  Instructions from
+ * outside of main system memory aren't cached; they get decoded into the
+ * predecoder's scratch entry, which is only valid until the next fetch.
+ */
+static inline struct sh4_predecode_ent *
+sh4_fetch_predecoded(Sh4 *sh4, addr32_t pc) {
+    struct sh4_predecode *pd = &sh4->predecode;
+
+#ifndef ENABLE_MMU
+    addr32_t addr = pc & 0x1fffffff;
+    if (pd->ram && addr >= ADDR_AREA3_FIRST && addr <= ADDR_AREA3_LAST &&
+        !(addr & 1)) {
+        addr &= MEMORY_MASK;
+        unsigned page_no = addr >> MEMORY_PAGE_SHIFT;
+        struct sh4_predecode_page *page = pd->pages[page_no];
+        if (!page || pd->ram->page_flags[page_no] != MEMORY_PAGE_CODE)
+            page = sh4_predecode_refresh_page(pd, page_no);
+
+        struct sh4_predecode_ent *ent =
+            page->ents + ((addr & (MEMORY_PAGE_SIZE - 1)) >> 1);
+        if (ent->gen != page->gen) {
+            uint16_t inst;
+            memcpy(&inst, pd->ram->mem + addr, sizeof(inst));
+            sh4_predecode_fill(ent, inst);
+            ent->gen = page->gen;
+        }
+        return ent;
+    }
+#endif
+
+    cpu_inst_param inst;
+    if (sh4_read_inst(sh4, &inst, pc) != 0)
+        return NULL;
+    sh4_predecode_fill(&pd->scratch, inst);
+    return &pd->scratch;
+}
+
 static inline unsigned
 sh4_do_exec_inst(Sh4 *sh4) {
 #ifdef INVARIANTS
@@ -203,12 +246,17 @@ sh4_do_exec_inst(Sh4 *sh4) {
     deep_syscall_notify_jump(sh4->reg[SH4_REG_PC]);
 #endif
 
-    cpu_inst_param inst;
-    if (sh4_read_inst(sh4, &inst, sh4->reg[SH4_REG_PC]) != 0)
+    addr32_t pc = sh4->reg[SH4_REG_PC];
+    struct sh4_predecode_ent *ent = sh4_fetch_predecoded(sh4, pc);
+    if (!ent)
         return 0;
-    InstOpcode const *op = sh4_decode_inst(inst);
+    struct sh4_predecode_ent *branch_ent = ent;
+    bool maybe_idle = ent->idle != SH4_PREDECODE_IDLE_NO;
+    cpu_inst_param inst = ent->inst;
+    InstOpcode const *op = ent->op;
 
-    unsigned n_cycles = sh4_count_inst_cycles(op, &sh4->last_inst_type);
+    unsigned n_cycles =
+        sh4_count_cycles(ent->group, ent->issue, &sh4->last_inst_type);
     op->func(sh4, inst);
 
     if (sh4->dont_increment_pc) {
@@ -218,12 +266,15 @@ sh4_do_exec_inst(Sh4 *sh4) {
     }
 
     if (sh4->delayed_branch) {
-        if (sh4_read_inst(sh4, &inst, sh4->reg[SH4_REG_PC] + 2) != 0) {
+        ent = sh4_fetch_predecoded(sh4, sh4->reg[SH4_REG_PC] + 2);
+        if (!ent) {
             sh4->dont_increment_pc = false;
             goto the_end;
         }
-        op = sh4_decode_inst(inst);
-        n_cycles += sh4_count_inst_cycles(op, &sh4->last_inst_type);
+        inst = ent->inst;
+        op = ent->op;
+        n_cycles +=
+            sh4_count_cycles(ent->group, ent->issue, &sh4->last_inst_type);
 
         if (op->pc_relative) {
             // raise exception for illegal slot instruction
@@ -258,6 +309,8 @@ sh4_do_exec_inst(Sh4 *sh4) {
     }
  the_end:
     sh4->delayed_branch = false;
+    if (maybe_idle)
+        sh4_idle_loop_notify(sh4, branch_ent, pc);
     return n_cycles;
 }
 
@@ -35,14 +35,27 @@
 #include "sh4_mem.h"
 #include "compiler_bullshit.h"
 
-static struct avl_tree sh4_reg_tree;
-
-struct sh4_avl_node {
-    struct avl_node node;
-
-    // TODO: remove pointer indirection
-    struct Sh4MemMappedReg *reg_info;
-};
+/*
+ * The on-chip registers are spread out across P4 in modules which all start on
+ * a 512KB boundary (bits 19-23 of the address), and none of them extend past
+ * the first 256 bytes of their module.  That means a register can be found
+ * with a direct lookup on those address bits instead of having to search for
+ * it.  The register's address still needs to be compared against the one that
+ * was accessed because other addresses can alias onto the same index.
+ */
+#define SH4_REG_TBL_MODULE_SHIFT 19
+#define SH4_REG_TBL_MODULE_BITS 5
+#define SH4_REG_TBL_OFFS_BITS 8
+#define SH4_REG_TBL_LEN (1 << (SH4_REG_TBL_MODULE_BITS + SH4_REG_TBL_OFFS_BITS))
+
+static struct Sh4MemMappedReg *sh4_reg_tbl[SH4_REG_TBL_LEN];
+
+static inline unsigned sh4_reg_tbl_idx(addr32_t addr) {
+    unsigned module = (addr >> SH4_REG_TBL_MODULE_SHIFT) &
+        ((1 << SH4_REG_TBL_MODULE_BITS) - 1);
+    unsigned offs = addr & ((1 << SH4_REG_TBL_OFFS_BITS) - 1);
+    return (module << SH4_REG_TBL_OFFS_BITS) | offs;
+}
 
 static sh4_reg_val
 sh4_default_read_handler(Sh4 *sh4, struct Sh4MemMappedReg const *reg_info);
@@ -487,32 +500,22 @@ static struct Sh4MemMappedReg mem_mapped_regs[] = {
     { NULL }
 };
 
-static struct avl_node *sh4_reg_avl_ctor(avl_key_type key) {
-    struct sh4_avl_node *node =
-        (struct sh4_avl_node*)calloc(1, sizeof(struct sh4_avl_node));
-
-    if (!node)
-        RAISE_ERROR(ERROR_FAILED_ALLOC);
-    return &node->node;
-}
-
-static void sh4_reg_avl_dtor(struct avl_node *node) {
-    struct sh4_avl_node *avl_node = &AVL_DEREF(node, struct sh4_avl_node, node);
-    free(avl_node);
-}
-
 void sh4_init_regs(Sh4 *sh4) {
     sh4_poweron_reset_regs(sh4);
 
-    avl_init(&sh4_reg_tree, sh4_reg_avl_ctor, sh4_reg_avl_dtor);
+    memset(sh4_reg_tbl, 0, sizeof(sh4_reg_tbl));
 
     Sh4MemMappedReg *curs = mem_mapped_regs;
     while (curs->reg_name) {
-        struct avl_node *avl_node = avl_find(&sh4_reg_tree, curs->addr);
-        struct sh4_avl_node *sh4_reg_node = &AVL_DEREF(avl_node,
-                                                       struct sh4_avl_node,
-                                                       node);
-        sh4_reg_node->reg_info = curs;
+        unsigned idx = sh4_reg_tbl_idx(curs->addr);
+        if (sh4_reg_tbl[idx] ||
+            (curs->addr & BIT_RANGE(SH4_REG_TBL_OFFS_BITS,
+                                    SH4_REG_TBL_MODULE_SHIFT - 1))) {
+            // the table's layout can't accommodate this register
+            error_set_address(curs->addr);
+            RAISE_ERROR(ERROR_INTEGRITY);
+        }
+        sh4_reg_tbl[idx] = curs;
         curs++;
     }
 }
@@ -569,9 +572,9 @@ void sh4_poweron_reset_regs(Sh4 *sh4) {
 }
 
 static struct Sh4MemMappedReg *find_reg_by_addr(addr32_t addr) {
-    struct avl_node *node = avl_find_noinsert(&sh4_reg_tree, addr);
-    if (node)
-        return AVL_DEREF(node, struct sh4_avl_node, node).reg_info;
+    struct Sh4MemMappedReg *reg = sh4_reg_tbl[sh4_reg_tbl_idx(addr)];
+    if (reg && reg->addr == addr)
+        return reg;
 
     if ((addr & SH4_REG_SDMR2_MASK) == SH4_REG_SDMR2_ADDR)
         return &sh4_sdmr2_reg;
@@ -710,6 +713,12 @@ static void sh4_mmucr_write_handler(Sh4 *sh4,
             (unsigned)val, (unsigned)sh4->reg[SH4_REG_PC]);
     sh4->reg[SH4_REG_MMUCR] = val;
 
+    /*
+     * the UTLB cache's tags depend on MMUCR.SV, so it can't be trusted after
+     * this.
+     */
+    sh4_utlb_cache_flush(sh4);
+
     if (val & SH4_MMUCR_TI_MASK)
         sh4_mmu_invalidate_tlb(sh4);
 
@@ -738,8 +747,13 @@ static void
 sh4_ccr_write_handler(Sh4 *sh4,
                       struct Sh4MemMappedReg const *reg_info,
                       sh4_reg_val val) {
+    /*
+     * Programs write to CCR to invalidate the instruction cache after they
+     * overwrite code.  Only blocks compiled from pages of RAM which have been
+     * written to since they were compiled need to go.
+     */
     if (config_get_jit())
-        code_cache_invalidate_all();
+        code_cache_invalidate_dirty();
     sh4->reg[SH4_REG_CCR] = val;
 }
 
@@ -42,6 +42,7 @@
 #include "sh4_scif.h"
 
 static int sh4_scif_irq_line(Sh4ExceptionCode *code, void *ctx);
+static void sh4_scif_update_irq(Sh4 *sh4);
 
 static void sh4_scif_rxi_int_handler(struct SchedEvent *event);
 static void sh4_scif_txi_int_handler(struct SchedEvent *event);
@@ -308,6 +309,7 @@ static void check_rx_trig(Sh4 *sh4) {
         }
     } else {
         sh4->scif.irq_state &= ~SH4_EXCP_SCIF_RXI;
+        sh4_scif_update_irq(sh4);
     }
 }
 
@@ -327,6 +329,7 @@ static void check_tx_trig(Sh4 *sh4) {
         }
     } else {
         sh4->scif.irq_state &= ~SH4_EXCP_SCIF_TXI;
+        sh4_scif_update_irq(sh4);
     }
 }
 
@@ -510,6 +513,7 @@ static void sh4_scif_rxi_int_handler(struct SchedEvent *event) {
     sh4_scif_rxi_int_event_scheduled = false;
 
     sh4->scif.irq_state |= SH4_EXCP_SCIF_RXI;
+    sh4_scif_update_irq(sh4);
     sh4_refresh_intc(sh4);
 }
 
@@ -518,6 +522,7 @@ static void sh4_scif_txi_int_handler(struct SchedEvent *event) {
     sh4_scif_txi_int_event_scheduled = false;
 
     sh4->scif.irq_state |= SH4_EXCP_SCIF_TXI;
+    sh4_scif_update_irq(sh4);
     sh4_refresh_intc(sh4);
 }
 
@@ -536,3 +541,8 @@ static int sh4_scif_irq_line(Sh4ExceptionCode *code, void *ctx) {
 
     return 0;
 }
+
+static void sh4_scif_update_irq(Sh4 *sh4) {
+    Sh4ExceptionCode code;
+    sh4_set_irq_pending(sh4, SH4_IRQ_SCIF, sh4_scif_irq_line(&code, sh4));
+}
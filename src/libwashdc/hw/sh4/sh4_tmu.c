@@ -53,6 +53,8 @@ static void tmu_chan_event_handler(SchedEvent *ev);
 static tmu_cycle_t next_chan_event(Sh4 *sh4, unsigned chan);
 static void chan_event_sched_next(Sh4 *sh4, unsigned chan);
 
+static void chan_update_irq(Sh4 *sh4, unsigned chan);
+
 static int sh4_tmu0_irq_line(Sh4ExceptionCode *code, void *ctx);
 static int sh4_tmu1_irq_line(Sh4ExceptionCode *code, void *ctx);
 static int sh4_tmu2_irq_line(Sh4ExceptionCode *code, void *ctx);
@@ -166,6 +168,7 @@ static void tmu_chan_sync(Sh4 *sh4, unsigned chan) {
         if (chan_cycles == (1 + chan_get_tcnt(sh4, chan))) {
             chan_set_tcnt(sh4, chan, sh4->reg[chan_tcor[chan]]);
             sh4->reg[chan_tcr[chan]] |= SH4_TCR_UNF_MASK;
+            chan_update_irq(sh4, chan);
             sh4_refresh_intc(sh4);
         } else if (chan_cycles < (1 + chan_get_tcnt(sh4, chan))) {
             chan_set_tcnt(sh4, chan, chan_get_tcnt(sh4, chan) - chan_cycles);
@@ -414,6 +417,7 @@ void sh4_tmu_tcr_write_handler(Sh4 *sh4,
     }
 
     sh4->reg[reg_idx] = new_val;
+    chan_update_irq(sh4, chan);
 
     // raise interrupt if it was just enabled while the underflow flag was set
     if ((new_val & SH4_TCR_UNIE_MASK) &&
@@ -478,6 +482,16 @@ void sh4_tmu_tcnt_write_handler(Sh4 *sh4,
     chan_event_sched_next(sh4, chan);
 }
 
+static void chan_update_irq(Sh4 *sh4, unsigned chan) {
+    static int const chan_irq_line[3] = {
+        SH4_IRQ_TMU0, SH4_IRQ_TMU1, SH4_IRQ_TMU2
+    };
+
+    sh4_set_irq_pending(sh4, chan_irq_line[chan],
+                        chan_int_enabled(sh4, chan) &&
+                        (sh4->reg[chan_tcr[chan]] & SH4_TCR_UNF_MASK));
+}
+
 static int sh4_tmu0_irq_line(Sh4ExceptionCode *code, void *ctx) {
     Sh4 *sh4 = (Sh4*)ctx;
     if (chan_int_enabled(sh4, 0) &&
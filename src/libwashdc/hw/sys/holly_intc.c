@@ -117,6 +117,7 @@ void holly_raise_nrm_int(HollyNrmInt int_type) {
     reg32_t mask = nrm_intp_tbl[int_type].mask;
 
     reg_istnrm |= mask;
+    holly_intc_update_irl();
 
     sh4_refresh_intc(dreamcast_get_cpu());
 }
@@ -124,6 +125,7 @@ void holly_raise_nrm_int(HollyNrmInt int_type) {
 void holly_clear_nrm_int(HollyNrmInt int_type) {
     reg32_t mask = nrm_intp_tbl[int_type].mask;
     reg_istnrm &= ~mask;
+    holly_intc_update_irl();
 }
 
 // TODO: what happens if another lower priority interrupt overwrites the IRL
@@ -132,6 +134,7 @@ void holly_raise_ext_int(HollyExtInt int_type) {
     reg32_t mask = ext_intp_tbl[int_type].mask;
 
     reg_istext |= mask;
+    holly_intc_update_irl();
 
     sh4_refresh_intc(dreamcast_get_cpu());
 }
@@ -139,9 +142,10 @@ void holly_raise_ext_int(HollyExtInt int_type) {
 void holly_clear_ext_int(HollyExtInt int_type) {
     reg32_t mask = ext_intp_tbl[int_type].mask;
     reg_istext &= ~mask;
+    holly_intc_update_irl();
 }
 
-int holly_intc_irl_line_fn(void *ctx) {
+static int holly_intc_irl(void) {
     if ((reg_iml6ext & reg_istext) || (reg_iml6nrm & reg_istnrm))
         return 9;
     else if ((reg_iml4ext & reg_istext) || (reg_iml4nrm & reg_istnrm))
@@ -152,6 +156,16 @@ int holly_intc_irl_line_fn(void *ctx) {
         return 0xf;
 }
 
+/*
+ * The IRL value depends on both the status registers and the mask registers,
+ * so this gets called whenever any of them change.  It only updates the SH4's
+ * view of the IRL bus; the interrupt doesn't actually get taken until the
+ * next time the SH4 checks for interrupts.
+ */
+void holly_intc_update_irl(void) {
+    sh4_set_irl(dreamcast_get_cpu(), holly_intc_irl());
+}
+
 uint32_t holly_reg_istnrm_mmio_read(struct mmio_region_sys_block *region,
                                     unsigned idx, void *ctxt) {
     reg32_t istnrm_out = reg_istnrm & 0x3fffff;
@@ -165,6 +179,7 @@ uint32_t holly_reg_istnrm_mmio_read(struct mmio_region_sys_block *region,
 void holly_reg_istnrm_mmio_write(struct mmio_region_sys_block *region,
                                  unsigned idx, uint32_t val, void *ctxt) {
     reg_istnrm &= ~val;
+    holly_intc_update_irl();
 }
 
 uint32_t holly_reg_istext_mmio_read(struct mmio_region_sys_block *region,
@@ -202,6 +217,7 @@ uint32_t holly_reg_iml2nrm_mmio_read(struct mmio_region_sys_block *region,
 void holly_reg_iml2nrm_mmio_write(struct mmio_region_sys_block *region,
                                   unsigned idx, uint32_t val, void *ctxt) {
     reg_iml2nrm = val & 0x3fffff;
+    holly_intc_update_irl();
 }
 
 uint32_t holly_reg_iml2err_mmio_read(struct mmio_region_sys_block *region,
@@ -222,6 +238,7 @@ uint32_t holly_reg_iml2ext_mmio_read(struct mmio_region_sys_block *region,
 void holly_reg_iml2ext_mmio_write(struct mmio_region_sys_block *region,
                                   unsigned idx, uint32_t val, void *ctxt) {
     reg_iml2ext = val & 0xf;
+    holly_intc_update_irl();
 }
 
 uint32_t holly_reg_iml4nrm_mmio_read(struct mmio_region_sys_block *region,
@@ -232,6 +249,7 @@ uint32_t holly_reg_iml4nrm_mmio_read(struct mmio_region_sys_block *region,
 void holly_reg_iml4nrm_mmio_write(struct mmio_region_sys_block *region,
                                   unsigned idx, uint32_t val, void *ctxt) {
     reg_iml4nrm = val & 0x3fffff;
+    holly_intc_update_irl();
 }
 
 uint32_t holly_reg_iml4err_mmio_read(struct mmio_region_sys_block *region,
@@ -252,6 +270,7 @@ uint32_t holly_reg_iml4ext_mmio_read(struct mmio_region_sys_block *region,
 void holly_reg_iml4ext_mmio_write(struct mmio_region_sys_block *region,
                                   unsigned idx, uint32_t val, void *ctxt) {
     reg_iml4ext = val & 0xf;
+    holly_intc_update_irl();
 }
 
 uint32_t holly_reg_iml6nrm_mmio_read(struct mmio_region_sys_block *region,
@@ -262,6 +281,7 @@ uint32_t holly_reg_iml6nrm_mmio_read(struct mmio_region_sys_block *region,
 void holly_reg_iml6nrm_mmio_write(struct mmio_region_sys_block *region,
                                   unsigned idx, uint32_t val, void *ctxt) {
     reg_iml6nrm = val & 0x3fffff;
+    holly_intc_update_irl();
 }
 
 uint32_t holly_reg_iml6err_mmio_read(struct mmio_region_sys_block *region,
@@ -282,4 +302,5 @@ uint32_t holly_reg_iml6ext_mmio_read(struct mmio_region_sys_block *region,
 void holly_reg_iml6ext_mmio_write(struct mmio_region_sys_block *region,
                                   unsigned idx, uint32_t val, void *ctxt) {
     reg_iml6ext = val & 0xf;
+    holly_intc_update_irl();
 }
@@ -63,9 +63,6 @@ enum HollyNrmInt {
 };
 typedef enum HollyNrmInt HollyNrmInt;
 
-// should be hooked up to the sh4 intc's irl line function
-int holly_intc_irl_line_fn(void *ctx);
-
 // when the punch-through polygon list has been successfully input
 #define HOLLY_REG_ISTNRM_PVR_PUNCH_THROUGH_COMPLETE_SHIFT 21
 #define HOLLY_REG_ISTNRM_PVR_PUNCH_THROUGH_COMPLETE_MASK \
@@ -145,6 +142,13 @@ void holly_raise_nrm_int(HollyNrmInt int_type);
 void holly_clear_ext_int(HollyExtInt int_type);
 void holly_clear_nrm_int(HollyNrmInt int_type);
 
+/*
+ * push holly's current IRL value out to the SH4.  This only needs to be called
+ * from outside of holly_intc.c when the SH4 gets reset, since that leaves the
+ * IRL bus idle regardless of what holly has pending.
+ */
+void holly_intc_update_irl(void);
+
 uint32_t holly_reg_istnrm_mmio_read(struct mmio_region_sys_block *region,
                                     unsigned idx, void *ctxt);
 void holly_reg_istnrm_mmio_write(struct mmio_region_sys_block *region,
@@ -374,6 +374,16 @@ static uint32_t sort_dma_process_link(struct sys_block_ctxt *ctxt, uint32_t link
                     dims.hdr_len * 4, cur_ptr);
         }
 
+        uint32_t pkt_addr = cur_ptr & MEMORY_MASK;
+        if (pkt_addr + this_pkt_dwords * 4 <= MEMORY_SIZE) {
+            // common case: the whole packet is contiguous in main memory
+            pvr2_tafifo_input_words(ctxt->pvr2, main_memory->mem + pkt_addr,
+                                    this_pkt_dwords);
+            cur_ptr += this_pkt_dwords * 4;
+            n_bytes -= this_pkt_dwords * 4;
+            continue;
+        }
+
         while (this_pkt_dwords) {
             uint32_t dword = memory_read_32(cur_ptr & MEMORY_MASK,
                                             main_memory);
@@ -35,9 +35,13 @@ extern "C" {
 #ifdef ENABLE_WATCHPOINTS
 #define CHECK_R_WATCHPOINT(addr, type) debug_is_r_watch(addr, sizeof(type))
 #define CHECK_W_WATCHPOINT(addr, type) debug_is_w_watch(addr, sizeof(type))
+#define CHECK_R_WATCHPOINT_BLOCK(addr, len) debug_is_r_watch(addr, len)
+#define CHECK_W_WATCHPOINT_BLOCK(addr, len) debug_is_w_watch(addr, len)
 #else
 #define CHECK_R_WATCHPOINT(addr, type)
 #define CHECK_W_WATCHPOINT(addr, type)
+#define CHECK_R_WATCHPOINT_BLOCK(addr, len)
+#define CHECK_W_WATCHPOINT_BLOCK(addr, len)
 #endif
 
 typedef
@@ -95,6 +99,18 @@ int(*memory_map_try_write16_func)(uint32_t addr, uint16_t val, void *ctxt);
 typedef
 int(*memory_map_try_write8_func)(uint32_t addr, uint8_t val, void *ctxt);
 
+/*
+ * read/write n_bytes at once.  These are optional; they're meant for DMA
+ * engines, which use them when a single region covers the whole transfer.
+ * Regions which don't implement them get accessed one word at a time instead.
+ */
+typedef
+void(*memory_map_read_block_func)(uint32_t addr, void *dst,
+                                  unsigned n_bytes, void *ctxt);
+typedef
+void(*memory_map_write_block_func)(uint32_t addr, void const *src,
+                                   unsigned n_bytes, void *ctxt);
+
 enum memory_map_region_id {
     MEMORY_MAP_REGION_UNKNOWN,
     MEMORY_MAP_REGION_RAM
@@ -129,6 +145,9 @@ struct memory_interface {
     memory_map_try_write32_func try_write32;
     memory_map_try_write16_func try_write16;
     memory_map_try_write8_func try_write8;
+
+    memory_map_read_block_func read_block;
+    memory_map_write_block_func write_block;
 };
 
 struct memory_map_region {
@@ -141,14 +160,47 @@ struct memory_map_region {
     enum memory_map_region_id id;
 
     struct memory_interface const *intf;
+
+    /*
+     * If this is non-NULL, then the region is plain host memory and
+     * memory_map_read_* and memory_map_write_* will access
+     * host_ptr[addr & host_mask] directly instead of going through intf.
+     */
+    void *host_ptr;
+    uint32_t host_mask;
+
+    /*
+     * If this is non-NULL, it has one byte for every
+     * (1 << host_watch_shift) bytes of host_ptr.  Writes which land on a
+     * page whose byte is nonzero go through intf even if host_ptr is set so
+     * that the owner of the memory can see them.
+     */
+    uint8_t const *host_watch;
+    unsigned host_watch_shift;
 };
 
 #define MAX_MEM_MAP_REGIONS 64
 
+/*
+ * The memory map keeps a lookup table which has one entry for every 64KB page
+ * in the 32-bit address space.  If a page is entirely covered by a single
+ * region then the table entry holds that region's index plus one and lookups
+ * which don't cross a page boundary resolve in O(1).  Otherwise the entry
+ * is MEMORY_MAP_PAGE_UNMAPPED or MEMORY_MAP_PAGE_MIXED, and the lookup falls
+ * back to a linear scan of the regions array.
+ */
+#define MEMORY_MAP_PAGE_SHIFT 16
+#define MEMORY_MAP_N_PAGES (1 << (32 - MEMORY_MAP_PAGE_SHIFT))
+
+#define MEMORY_MAP_PAGE_UNMAPPED 0
+#define MEMORY_MAP_PAGE_MIXED 0xff
+
 struct memory_map {
     struct memory_map_region regions[MAX_MEM_MAP_REGIONS];
     unsigned n_regions;
 
+    uint8_t page_tbl[MEMORY_MAP_N_PAGES];
+
     /*
      * Called when software tries to read/write to an address that is not in
      * any of the regions.
@@ -173,6 +225,29 @@ memory_map_add(struct memory_map *map,
                enum memory_map_region_id id,
                struct memory_interface const *intf, void *ctxt);
 
+/*
+ * same as memory_map_add, except the region is backed by host memory which
+ * can be accessed directly.  host_mask is applied to guest addresses to get
+ * the offset into host_ptr.  intf is still used by anything that goes through
+ * the region's memory_interface instead of the memory_map_read/write
+ * functions.
+ */
+void
+memory_map_add_host_mem(struct memory_map *map,
+                        uint32_t addr_first,
+                        uint32_t addr_last,
+                        uint32_t range_mask,
+                        enum memory_map_region_id id,
+                        struct memory_interface const *intf, void *ctxt,
+                        void *host_ptr, uint32_t host_mask);
+
+/*
+ * set the write-watch table for every region which is backed by host_ptr.
+ * See the host_watch member of struct memory_map_region.
+ */
+void memory_map_watch_host_mem(struct memory_map *map, void const *host_ptr,
+                               uint8_t const *watch, unsigned watch_shift);
+
 uint8_t
 memory_map_read_8(struct memory_map *map, uint32_t addr);
 uint16_t
@@ -235,9 +310,23 @@ memory_map_try_read_float(struct memory_map *map, uint32_t addr, float *val);
 int
 memory_map_try_read_double(struct memory_map *map, uint32_t addr, double *val);
 
+/*
+ * move n_bytes between host memory and the guest address space.  These go
+ * through the region's read_block/write_block handler if one region covers
+ * the whole transfer and it has one, otherwise they fall back to
+ * memory_map_read_* and memory_map_write_* one word at a time.
+ *
+ * The fallback uses 32-bit accesses if n_bytes is a multiple of 4, 16-bit
+ * accesses if it's a multiple of 2 and 8-bit accesses otherwise.
+ */
+void memory_map_read_block(struct memory_map *map, uint32_t addr,
+                           void *dst, unsigned n_bytes);
+void memory_map_write_block(struct memory_map *map, uint32_t addr,
+                            void const *src, unsigned n_bytes);
+
 static inline struct memory_map_region *
-memory_map_get_region(struct memory_map *map,
-                      uint32_t first_addr, unsigned n_bytes) {
+memory_map_scan_region(struct memory_map *map,
+                       uint32_t first_addr, unsigned n_bytes) {
     uint32_t last_addr = first_addr + (n_bytes - 1);
     unsigned region_no;
     for (region_no = 0; region_no < map->n_regions; region_no++) {
@@ -251,6 +340,21 @@ memory_map_get_region(struct memory_map *map,
     return NULL;
 }
 
+static inline struct memory_map_region *
+memory_map_get_region(struct memory_map *map,
+                      uint32_t first_addr, unsigned n_bytes) {
+    uint32_t last_addr = first_addr + (n_bytes - 1);
+    unsigned page_no = first_addr >> MEMORY_MAP_PAGE_SHIFT;
+    if (page_no == (last_addr >> MEMORY_MAP_PAGE_SHIFT)) {
+        unsigned ent = map->page_tbl[page_no];
+        if (ent == MEMORY_MAP_PAGE_UNMAPPED)
+            return NULL;
+        else if (ent != MEMORY_MAP_PAGE_MIXED)
+            return map->regions + (ent - 1);
+    }
+    return memory_map_scan_region(map, first_addr, n_bytes);
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -156,6 +156,9 @@ void washdc_gameconsole_inject_irq(struct washdc_gameconsole const *cons,
 void washdc_dump_main_memory(char const *path);
 void washdc_dump_aica_memory(char const *path);
 
+// write the JIT block profile (see wash.jit.block_prof) to path as CSV
+void washdc_dump_jit_profile(char const *path);
+
 
 #ifdef __cplusplus
 }
@@ -124,6 +124,59 @@ struct washdc_launch_settings {
     /* #ifdef ENABLE_JIT_X86_64 */
     bool enable_native_jit;
     /* #endif */
+
+    /*
+     * memory budget for the jit's code cache in megabytes, or zero to use the
+     * default.
+     */
+    int jit_cache_budget_mb;
+
+    /*
+     * number of times a block runs in the IL interpreter before it gets
+     * compiled to native code on a background thread, or zero to compile
+     * blocks right away.  This only applies to the native jit.
+     */
+    int jit_tier_threshold;
+
+    /*
+     * if true, the native jit compiles past conditional branches so that
+     * blocks can span several of them.
+     */
+    bool jit_superblocks;
+
+    // if true, the ARM7 runs through the JIT instead of the interpreter.
+    bool jit_arm7;
+
+    /*
+     * 0 to disable, 1 to write native jit blocks to /tmp/perf-<pid>.map, or
+     * 2 to write them to a jitdump file for perf inject.
+     */
+    int jit_perf;
+
+    /*
+     * if true, the jit profiles every block it runs.  The profile gets written
+     * to sh4_block_prof.csv on exit, or on demand with washdc_dump_jit_profile.
+     */
+    bool jit_block_prof;
+
+    /*
+     * if true, the native jit keeps the SH4's R0, R14 and R15 in host
+     * registers across blocks.
+     */
+    bool jit_pin_regs;
+
+    /*
+     * if true, the SH4 fast-forwards to its next scheduled event when it's
+     * busy-waiting in a loop that can't end until that event happens.
+     */
+    bool idle_skip;
+
+    /*
+     * if true, the ARM7 and AICA run on a separate host thread.  arm7_skew is
+     * how many timeslices the two threads are allowed to drift apart.
+     */
+    bool arm7_thread;
+    int arm7_skew;
     bool cmd_session;
     bool enable_serial;
 
@@ -38,6 +38,7 @@
 #endif
 
 #include "jit_intp/code_block_intp.h"
+#include "jit_block_prof.h"
 
 enum washdc_jit_slot_tp {
     // general-purpose slot
@@ -70,6 +71,9 @@ struct il_code_block {
 #ifdef JIT_PROFILE
     struct jit_profile_per_block *profile;
 #endif
+
+    // if this isn't NULL, native code gets instrumented for jit_block_prof
+    struct jit_block_prof *prof;
 };
 
 static inline void
@@ -92,6 +96,9 @@ struct jit_code_block {
 #ifdef JIT_PROFILE
     struct jit_profile_per_block *profile;
 #endif
+
+    // NULL unless the block profiler is enabled
+    struct jit_block_prof *prof;
 };
 
 void il_code_block_init(struct il_code_block *block);
@@ -116,6 +123,7 @@ jit_code_block_init(struct jit_code_block *blk, uint32_t addr_first,
 #ifdef JIT_PROFILE
     blk->profile = jit_profile_create_block(addr_first);
 #endif
+    blk->prof = jit_block_prof_get(addr_first);
 }
 
 static inline void
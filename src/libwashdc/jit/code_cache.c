@@ -19,7 +19,6 @@
  *
  *
  ******************************************************************************/
-
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
@@ -29,109 +28,338 @@
 #include "code_block.h"
 #include "log.h"
 #include "config.h"
-#include "avl.h"
+
+#include "memory.h"
 
 #ifdef ENABLE_JIT_X86_64
 #include "x86_64/exec_mem.h"
+#include "x86_64/native_dispatch.h"
+#include "x86_64/compile_thread.h"
+#include "x86_64/jit_perf.h"
+#endif
+
+#ifdef ENABLE_FASTMEM
+#include "x86_64/fastmem.h"
 #endif
 
 #include "code_cache.h"
 
-#define CODE_CACHE_HASH_TBL_SHIFT 16
-#define CODE_CACHE_HASH_TBL_LEN (1 << CODE_CACHE_HASH_TBL_SHIFT)
-#define CODE_CACHE_HASH_TBL_MASK (CODE_CACHE_HASH_TBL_LEN - 1)
+/*
+ * The code cache is a single open-addressed hash table (code_cache_tbl) that
+ * uses linear probing.  Every block lives in the table somewhere between its
+ * home slot and CODE_CACHE_MAX_PROBE - 1 slots after it, and there are never
+ * any empty slots between a block and its home slot.  Removing a block shifts
+ * the blocks after it backwards to preserve that, so there are no tombstones.
+ *
+ * When all of a new block's slots are taken, one of the blocks in them gets
+ * evicted to make room.  Every block is also on an LRU list, and whenever the
+ * cache goes over its memory budget code_cache_gc evicts blocks from the
+ * least-recently-used end of the list until it's comfortably under budget.
+ *
+ * The native dispatcher finds blocks without calling into C, so it sets the
+ * referenced flag instead of moving blocks to the front of the LRU list.
+ * Eviction gives referenced blocks a second chance.
+ */
 
 /*
- * This is a two-level cache.  The lower level is a binary search tree balanced
- * using the AVL algorithm.  The upper level is a hash-table.  Everything that
- * exists in the hash also exists in the tree, but not everything in the tree
- * exists in the hash.  When there is a collision in the hash, we discard
- * outdated values instead of trying to implement probing or chaining.
+ * blocks can't be freed from within CPU context because one of them might be
+ * the block which is currently executing.  Blocks which get evicted or
+ * invalidated from within CPU context are put on this list instead, and they
+ * get freed the next time code_cache_gc is called.  The list is singly-linked
+ * through lru_next.
  */
+static struct cache_entry *dead_entries;
 
 /*
- * oldroot points to a list of trees invalid nodes.
- *
- * When code_cache_invalidate_all gets called from within CPU context
- * (typically due to a write to the SH4 CCR), all nodes need to be deleted.
- * This is not possible to due within CPU context because that would delete the
- * node which is currently executed.  As a workaround, the entire tree is
- * relocated to the oldroot pointer so that its nodes can be freed later when
- * the emulator exits CPU context.
+ * cache_entries are allocated in slabs of this many entries.  Entries which
+ * get freed go back on free_entries to be reused; slabs are only freed when
+ * the code cache is cleaned up.
  */
-struct oldroot_node {
-    struct avl_tree tree;
-    struct oldroot_node *next;
+#define CACHE_SLAB_LEN 1024
+
+struct cache_slab {
+    struct cache_slab *next;
+    struct cache_entry ents[CACHE_SLAB_LEN];
 };
-static struct oldroot_node *oldroot;
 
-static struct avl_tree tree;
+static struct cache_slab *slabs;
+static struct cache_entry *free_entries;
 
-struct cache_entry* code_cache_tbl[CODE_CACHE_HASH_TBL_LEN];
-static void *dflt_entry;
+// lru_head is the most recently used entry, lru_tail is the least
+static struct cache_entry *lru_head, *lru_tail;
+
+static unsigned n_entries;
 
 /*
- * the maximum number of code-cache entries that can be created before the
- * cache assumes something is wrong.  This is completely arbitrary, and it may
- * need to be raised, lowered or removed entirely in the future.
- *
- * The reason it is here is that my laptop doesn't have much memory, and when
- * the cache gets too big then my latop will thrash and become unresponsive.
- *
- * Under normal operation, I don't think the cache should get this big.  This
- * typically only happens when there's a bug in the cache that causes it to
- * keep making more and more cache entries because it is unable to find the
- * ones it has already created.  Dreamcast only has 16MB of memory, so it's
- * very unlikely (albeit not impossible) that this cache would hit 16-million
- * different jump-in points without getting reset via a write to the SH4's CCR
- * register.
+ * total size of all live entries (including their compiled code) in bytes,
+ * and the most that's allowed before code_cache_gc starts evicting blocks.
  */
-#define MAX_ENTRIES (1024*1024)
-static unsigned n_entries;
+static size_t bytes_used, budget;
+
+/*
+ * number of blocks that have been evicted to make room for other blocks, and
+ * the number of times a recently-referenced block got a second chance
+ * instead.
+ */
+static uint64_t n_evicted_total, n_spared_total;
+
+/*
+ * every page of RAM has a list of all the cache_entries that were compiled
+ * from it.
+ */
+struct code_page {
+    struct cache_entry **ents;
+    unsigned n_ents, n_alloc;
+};
+static struct code_page code_pages[MEMORY_N_PAGES];
+
+static struct Memory *ram;
+
+struct cache_entry* code_cache_tbl[CODE_CACHE_HASH_TBL_LEN];
+static void *dflt_entry;
 
 #ifdef ENABLE_JIT_X86_64
 static bool native_mode = true;
 #endif
 
-static struct avl_node*
-cache_entry_ctor(avl_key_type key) {
-    struct cache_entry *ent = calloc(1, sizeof(struct cache_entry));
+#define ENTRY_FROM_BLK(blkp)                                            \
+    ((struct cache_entry*)(((char*)(blkp)) - offsetof(struct cache_entry, blk)))
+
+static bool slot_empty(struct cache_entry const *ent) {
+    return ent == dflt_entry;
+}
+
+static void lru_unlink(struct cache_entry *ent) {
+    if (ent->lru_prev)
+        ent->lru_prev->lru_next = ent->lru_next;
+    else
+        lru_head = ent->lru_next;
+
+    if (ent->lru_next)
+        ent->lru_next->lru_prev = ent->lru_prev;
+    else
+        lru_tail = ent->lru_prev;
+
+    ent->lru_prev = ent->lru_next = NULL;
+}
+
+static void lru_push_front(struct cache_entry *ent) {
+    ent->lru_prev = NULL;
+    ent->lru_next = lru_head;
+    if (lru_head)
+        lru_head->lru_prev = ent;
+    else
+        lru_tail = ent;
+    lru_head = ent;
+}
+
+static void lru_touch(struct cache_entry *ent) {
+    if (lru_head != ent) {
+        lru_unlink(ent);
+        lru_push_front(ent);
+    }
+}
+
+static struct cache_entry *alloc_entry(jit_hash hash) {
+    if (!free_entries) {
+        struct cache_slab *slab =
+            (struct cache_slab*)malloc(sizeof(struct cache_slab));
+        if (!slab)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        slab->next = slabs;
+        slabs = slab;
+
+        unsigned idx;
+        for (idx = 0; idx < CACHE_SLAB_LEN; idx++) {
+            slab->ents[idx].lru_next = free_entries;
+            free_entries = slab->ents + idx;
+        }
+    }
+
+    struct cache_entry *ent = free_entries;
+    free_entries = ent->lru_next;
+
+    memset(ent, 0, sizeof(*ent));
+    ent->key = hash;
 
 #ifdef ENABLE_JIT_X86_64
-    jit_code_block_init(&ent->blk, key, native_mode);
+    jit_code_block_init(&ent->blk, hash, native_mode);
 #else
-    jit_code_block_init(&ent->blk, key, false);
+    jit_code_block_init(&ent->blk, hash, false);
 #endif
 
+    ent->n_bytes = sizeof(struct cache_entry);
+    bytes_used += ent->n_bytes;
     n_entries++;
-    if (n_entries >= MAX_ENTRIES)
-        RAISE_ERROR(ERROR_INTEGRITY);
-    return &ent->node;
-}
+    lru_push_front(ent);
 
-static void
-cache_entry_dtor(struct avl_node *node) {
-    struct cache_entry *ent = &AVL_DEREF(node, struct cache_entry, node);
+    return ent;
+}
 
+static void free_entry(struct cache_entry *ent) {
 #ifdef ENABLE_JIT_X86_64
+    if (ent->tier0) {
+        compile_thread_tier0_free(ent->tier0);
+        ent->tier0 = NULL;
+    } else if (native_mode && ent->valid) {
+        jit_perf_block_unloaded(ent->key, &ent->blk.x86_64);
+    }
     jit_code_block_cleanup(&ent->blk, native_mode);
 #else
     jit_code_block_cleanup(&ent->blk, false);
 #endif
 
-    free(ent);
+    ent->lru_next = free_entries;
+    free_entries = ent;
 }
 
-static void reinit_tree(void) {
-    avl_init(&tree, cache_entry_ctor, cache_entry_dtor);
+static void set_page_watch(unsigned page_no, bool watch) {
+#ifdef ENABLE_FASTMEM
+    /*
+     * fastmem writes go straight to host memory without checking the page
+     * flags, so code pages need to be write-protected in the fastmem window.
+     */
+    if (native_mode)
+        fastmem_watch_ram_page(page_no, watch);
+#endif
 }
 
-void code_cache_init(void) {
-    reinit_tree();
+static void reset_pages(void) {
+    if (!ram)
+        return;
+
+    unsigned page_no;
+    for (page_no = 0; page_no < MEMORY_N_PAGES; page_no++) {
+        code_pages[page_no].n_ents = 0;
+        if (ram->page_flags[page_no]) {
+            ram->page_flags[page_no] = 0;
+            set_page_watch(page_no, false);
+        }
+    }
+    ram->n_dirty_pages = 0;
+}
 
+static void reset_tbl(void) {
     unsigned idx;
     for (idx = 0; idx < CODE_CACHE_HASH_TBL_LEN; idx++)
         code_cache_tbl[idx] = dflt_entry;
+}
+
+static void unwatch_entry(struct cache_entry *ent) {
+    if (!ent->watching_ram)
+        return;
+
+    unsigned page_no;
+    for (page_no = ent->ram_page_first; page_no <= ent->ram_page_last;
+         page_no++) {
+        struct code_page *page = code_pages + page_no;
+        unsigned idx = page->n_ents;
+        while (idx--) {
+            if (page->ents[idx] == ent) {
+                page->ents[idx] = page->ents[--page->n_ents];
+                break;
+            }
+        }
+    }
+
+    ent->watching_ram = false;
+}
+
+// return the index of the code_cache_tbl slot which holds ent
+static unsigned tbl_find_slot(struct cache_entry const *ent) {
+    unsigned home = CODE_CACHE_HASH_IDX(ent->key);
+    unsigned probe;
+    for (probe = 0; probe < CODE_CACHE_MAX_PROBE; probe++) {
+        unsigned idx = (home + probe) & CODE_CACHE_HASH_TBL_MASK;
+        if (code_cache_tbl[idx] == ent)
+            return idx;
+    }
+    RAISE_ERROR(ERROR_INTEGRITY);
+}
+
+/*
+ * empty out the given slot, and then shift back any entries after it which
+ * would otherwise become unreachable.  Entries only ever get moved closer to
+ * their home slot, so they all stay within CODE_CACHE_MAX_PROBE of it.
+ */
+static void tbl_remove(unsigned hole) {
+    unsigned next = hole, n_checked;
+    for (n_checked = 1; n_checked < CODE_CACHE_HASH_TBL_LEN; n_checked++) {
+        next = (next + 1) & CODE_CACHE_HASH_TBL_MASK;
+        struct cache_entry *ent = code_cache_tbl[next];
+        if (slot_empty(ent))
+            break;
+
+        // ent can fill the hole if the hole is between its home and next
+        unsigned home = CODE_CACHE_HASH_IDX(ent->key);
+        if (((next - home) & CODE_CACHE_HASH_TBL_MASK) >=
+            ((next - hole) & CODE_CACHE_HASH_TBL_MASK)) {
+            code_cache_tbl[hole] = ent;
+            hole = next;
+        }
+    }
+    code_cache_tbl[hole] = dflt_entry;
+}
+
+/*
+ * take ent out of the LRU list and the RAM page lists and throw it onto the
+ * dead_entries list.  ent itself is left alone because it might be the block
+ * which is currently executing.  This does not remove ent from code_cache_tbl;
+ * that's up to the caller.
+ */
+static void kill_entry(struct cache_entry *ent) {
+    unwatch_entry(ent);
+    lru_unlink(ent);
+
+    bytes_used -= ent->n_bytes;
+    n_entries--;
+
+    ent->lru_next = dead_entries;
+    dead_entries = ent;
+}
+
+static void invalidate_entry(struct cache_entry *ent) {
+    tbl_remove(tbl_find_slot(ent));
+    kill_entry(ent);
+}
+
+/*
+ * evict least-recently-used entries until the cache is using no more than
+ * target bytes.
+ */
+static void evict_lru(size_t target) {
+    unsigned n_evicted = 0, n_spared = 0, max_spared = n_entries;
+
+    while (bytes_used > target && lru_tail) {
+        struct cache_entry *ent = lru_tail;
+        if (ent->referenced && n_spared < max_spared) {
+            ent->referenced = 0;
+            lru_touch(ent);
+            n_spared++;
+            continue;
+        }
+
+        invalidate_entry(ent);
+        n_evicted++;
+    }
+
+    n_evicted_total += n_evicted;
+    n_spared_total += n_spared;
+
+    LOG_DBG("%s - evicted %u blocks, %u remain (%u bytes)\n", __func__,
+            n_evicted, n_entries, (unsigned)bytes_used);
+}
+
+void code_cache_init(struct Memory *ram_ptr) {
+    ram = ram_ptr;
+    reset_pages();
+    reset_tbl();
+
+    int budget_mb = config_get_jit_cache_budget_mb();
+    if (budget_mb <= 0)
+        budget_mb = CODE_CACHE_DEFAULT_BUDGET_MB;
+    budget = (size_t)budget_mb * 1024 * 1024;
+    n_evicted_total = n_spared_total = 0;
 
 #ifdef ENABLE_JIT_X86_64
     native_mode = config_get_native_jit();
@@ -141,53 +369,163 @@ void code_cache_init(void) {
 void code_cache_cleanup(void) {
     code_cache_invalidate_all();
     code_cache_gc();
+
+    while (slabs) {
+        struct cache_slab *next = slabs->next;
+        free(slabs);
+        slabs = next;
+    }
+    free_entries = NULL;
+
+    unsigned page_no;
+    for (page_no = 0; page_no < MEMORY_N_PAGES; page_no++) {
+        free(code_pages[page_no].ents);
+        code_pages[page_no].ents = NULL;
+        code_pages[page_no].n_ents = code_pages[page_no].n_alloc = 0;
+    }
+    ram = NULL;
 }
 
 void code_cache_set_default(void *dflt) {
-    dflt_entry = dflt;
     unsigned idx;
     for (idx = 0; idx < CODE_CACHE_HASH_TBL_LEN; idx++)
-        code_cache_tbl[idx] = dflt_entry;
+        if (code_cache_tbl[idx] == dflt_entry)
+            code_cache_tbl[idx] = dflt;
+    dflt_entry = dflt;
 }
 
 void code_cache_invalidate_all(void) {
     /*
      * this function gets called whenever something writes to the sh4 CCR.
-     * Since we don't want to trash the block currently executing, we instead
-     * set a flag to be set next time code_cache_find is called.
+     * Since we don't want to trash the block currently executing, every entry
+     * gets moved onto the dead_entries list to be freed later.  Also keep in
+     * mind that the current code block might already be on that list if this
+     * function got called more than once by the current code block.
      */
     LOG_DBG("%s called - nuking cache\n", __func__);
 
+    if (lru_tail) {
+        lru_tail->lru_next = dead_entries;
+        dead_entries = lru_head;
+        lru_head = lru_tail = NULL;
+    }
+
+    reset_tbl();
+    reset_pages();
+
+#ifdef ENABLE_JIT_X86_64
     /*
-     * Throw root onto the oldroot list to be cleared later.  It's not safe to
-     * clear out oldroot now because the current code block might be part of it.
-     * Also keep in mind that the current code block might be part of a
-     * pre-existing oldroot if this function got called more than once by the
-     * current code block.
+     * native blocks might have been linked directly to each other, so those
+     * links need to be undone before the old blocks can be freed.
+     *
+     * Starting a new exec_mem generation keeps the blocks compiled from here
+     * on out of the arenas that the old blocks live in, so those arenas can
+     * be reclaimed in one piece once the old blocks are gone.
      */
-    struct oldroot_node *list_node =
-        (struct oldroot_node*)malloc(sizeof(struct oldroot_node));
-    if (!list_node)
-        RAISE_ERROR(ERROR_FAILED_ALLOC);
-    list_node->next = oldroot;
-    list_node->tree = tree;
-    oldroot = list_node;
+    if (native_mode) {
+        native_dispatch_unlink_all();
+        exec_mem_new_generation();
+    }
+#endif
 
-    reinit_tree();
+    n_entries = 0;
+    bytes_used = 0;
+}
 
-    unsigned idx;
-    for (idx = 0; idx < CODE_CACHE_HASH_TBL_LEN; idx++)
-        code_cache_tbl[idx] = dflt_entry;
+void code_cache_invalidate_dirty(void) {
+    if (!ram || !ram->n_dirty_pages)
+        return;
 
-    n_entries = 0;
+    unsigned page_no, n_invalidated = 0;
+    for (page_no = 0; page_no < MEMORY_N_PAGES; page_no++) {
+        if (!(ram->page_flags[page_no] & MEMORY_PAGE_DIRTY))
+            continue;
+
+        // invalidate_entry removes the entry from this page's list
+        struct code_page *page = code_pages + page_no;
+        while (page->n_ents) {
+            invalidate_entry(page->ents[page->n_ents - 1]);
+            n_invalidated++;
+        }
+
+        ram->page_flags[page_no] = 0;
+        set_page_watch(page_no, false);
+    }
+
+    LOG_DBG("%s - %u dirty pages, %u blocks invalidated\n", __func__,
+            ram->n_dirty_pages, n_invalidated);
+    ram->n_dirty_pages = 0;
+
+#ifdef ENABLE_JIT_X86_64
+    // other blocks might still be linked to the ones that were invalidated
+    if (native_mode && n_invalidated)
+        native_dispatch_unlink_all();
+#endif
+}
+
+void code_cache_watch_ram(struct jit_code_block *blk,
+                          unsigned offs_first, unsigned offs_last) {
+    struct cache_entry *ent = ENTRY_FROM_BLK(blk);
+
+    if (!ram || offs_last < offs_first || offs_last > MEMORY_MASK)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    unwatch_entry(ent);
+
+    ent->watching_ram = true;
+    ent->ram_page_first = offs_first >> MEMORY_PAGE_SHIFT;
+    ent->ram_page_last = offs_last >> MEMORY_PAGE_SHIFT;
+
+    unsigned page_no;
+    for (page_no = ent->ram_page_first; page_no <= ent->ram_page_last;
+         page_no++) {
+        struct code_page *page = code_pages + page_no;
+        if (page->n_ents >= page->n_alloc) {
+            unsigned new_alloc = page->n_alloc ? page->n_alloc * 2 : 8;
+            struct cache_entry **new_ents = (struct cache_entry**)
+                realloc(page->ents, new_alloc * sizeof(struct cache_entry*));
+            if (!new_ents)
+                RAISE_ERROR(ERROR_FAILED_ALLOC);
+            page->ents = new_ents;
+            page->n_alloc = new_alloc;
+        }
+        page->ents[page->n_ents++] = ent;
+
+        if (!(ram->page_flags[page_no] & MEMORY_PAGE_CODE)) {
+            ram->page_flags[page_no] |= MEMORY_PAGE_CODE;
+            set_page_watch(page_no, true);
+        }
+    }
 }
 
 void code_cache_gc(void) {
-    while (oldroot) {
-        struct oldroot_node *next = oldroot->next;
-        avl_cleanup(&oldroot->tree);
-        free(oldroot);
-        oldroot = next;
+    if (bytes_used > budget)
+        evict_lru(budget - budget / 8);
+
+    if (dead_entries) {
+#ifdef ENABLE_JIT_X86_64
+        /*
+         * blocks which were evicted from within CPU context might still be
+         * linked to from other blocks.  Unlinking throws out every link in
+         * the cache, so don't do it unless one of the dead blocks actually
+         * is a link target.
+         */
+        if (native_mode) {
+            struct cache_entry *ent;
+            for (ent = dead_entries; ent; ent = ent->lru_next) {
+                if (ent->link_target) {
+                    native_dispatch_unlink_all();
+                    break;
+                }
+            }
+        }
+#endif
+
+        while (dead_entries) {
+            struct cache_entry *next = dead_entries->lru_next;
+            free_entry(dead_entries);
+            dead_entries = next;
+        }
     }
 
 #ifdef INVARIANTS
@@ -199,17 +537,109 @@ void code_cache_gc(void) {
 }
 
 struct cache_entry *code_cache_find(jit_hash hash) {
-    unsigned hash_idx = hash & CODE_CACHE_HASH_TBL_MASK;
-    struct cache_entry *maybe = code_cache_tbl[hash_idx];
-    if (maybe && maybe->node.key == hash)
-        return maybe;
+    unsigned home = CODE_CACHE_HASH_IDX(hash);
+    unsigned probe;
+
+    for (probe = 0; probe < CODE_CACHE_MAX_PROBE; probe++) {
+        unsigned idx = (home + probe) & CODE_CACHE_HASH_TBL_MASK;
+        struct cache_entry *ent = code_cache_tbl[idx];
+
+        if (slot_empty(ent)) {
+            ent = alloc_entry(hash);
+            code_cache_tbl[idx] = ent;
+            return ent;
+        }
+
+        if (ent->key == hash) {
+            ent->referenced = 1;
+            lru_touch(ent);
+            return ent;
+        }
+    }
 
-    struct cache_entry *ret = code_cache_find_slow(hash);
-    code_cache_tbl[hash_idx] = ret;
-    return ret;
+    /*
+     * every slot this block could go in is taken, so replace the first one
+     * which hasn't been referenced recently.  If they've all been referenced
+     * then they've all lost their second chance now, so replace the first one.
+     */
+    unsigned victim_idx = home;
+    for (probe = 0; probe < CODE_CACHE_MAX_PROBE; probe++) {
+        unsigned idx = (home + probe) & CODE_CACHE_HASH_TBL_MASK;
+        struct cache_entry *ent = code_cache_tbl[idx];
+        if (!ent->referenced) {
+            victim_idx = idx;
+            break;
+        }
+        ent->referenced = 0;
+    }
+
+    /*
+     * the new entry takes the victim's slot directly, so there's no need to
+     * shift anything around.
+     */
+    kill_entry(code_cache_tbl[victim_idx]);
+    n_evicted_total++;
+    struct cache_entry *ent = alloc_entry(hash);
+    code_cache_tbl[victim_idx] = ent;
+    return ent;
 }
 
-struct cache_entry *code_cache_find_slow(jit_hash hash) {
-    struct avl_node *node = avl_find(&tree, hash);
-    return &AVL_DEREF(node, struct cache_entry, node);
+struct cache_entry *code_cache_lookup(jit_hash hash) {
+    unsigned home = CODE_CACHE_HASH_IDX(hash);
+    unsigned probe;
+
+    for (probe = 0; probe < CODE_CACHE_MAX_PROBE; probe++) {
+        struct cache_entry *ent =
+            code_cache_tbl[(home + probe) & CODE_CACHE_HASH_TBL_MASK];
+        if (slot_empty(ent))
+            return NULL;
+        if (ent->key == hash)
+            return ent;
+    }
+
+    return NULL;
+}
+
+void code_cache_set_valid(struct cache_entry *ent) {
+    unsigned code_bytes;
+
+#ifdef ENABLE_JIT_X86_64
+    if (native_mode) {
+        code_bytes = ent->blk.x86_64.bytes_used;
+    } else {
+#endif
+        code_bytes = ent->blk.intp.inst_count * sizeof(struct jit_inst) +
+            ent->blk.intp.n_slots * sizeof(union slot_val);
+#ifdef ENABLE_JIT_X86_64
+    }
+#endif
+
+    ent->valid = 1;
+    ent->n_bytes += code_bytes;
+    bytes_used += code_bytes;
+}
+
+void code_cache_set_code_bytes(struct cache_entry *ent, unsigned code_bytes) {
+    unsigned n_bytes = sizeof(struct cache_entry) + code_bytes;
+    bytes_used = bytes_used - ent->n_bytes + n_bytes;
+    ent->n_bytes = n_bytes;
+}
+
+void code_cache_get_evict_stats(uint64_t *n_evicted, uint64_t *n_spared) {
+    *n_evicted = n_evicted_total;
+    *n_spared = n_spared_total;
+}
+
+bool code_cache_is_live(struct cache_entry const *ent) {
+    unsigned home = CODE_CACHE_HASH_IDX(ent->key);
+    unsigned probe;
+    for (probe = 0; probe < CODE_CACHE_MAX_PROBE; probe++) {
+        struct cache_entry const *slot =
+            code_cache_tbl[(home + probe) & CODE_CACHE_HASH_TBL_MASK];
+        if (slot == ent)
+            return true;
+        if (slot_empty(slot))
+            return false;
+    }
+    return false;
 }
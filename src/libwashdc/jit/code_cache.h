@@ -23,7 +23,9 @@
 #ifndef CODE_CACHE_H_
 #define CODE_CACHE_H_
 
-#include "avl.h"
+#include <stdint.h>
+#include <stdbool.h>
+
 #include "code_block.h"
 
 #ifdef ENABLE_JIT_X86_64
@@ -40,48 +42,161 @@
  * between single-precision and double-precision floating-point.
  */
 struct cache_entry {
-    struct avl_node node;
+    /*
+     * key, referenced and blk.x86_64.native are read by the native dispatcher,
+     * so they need to stay within 256 bytes of the start of the struct.
+     */
+    jit_hash key;
 
     uint8_t valid;
+
+    /*
+     * set whenever the block gets looked up.  Eviction clears this and gives
+     * the block a second chance instead of evicting it if it's set.
+     */
+    uint8_t referenced;
+
     struct jit_code_block blk;
+
+    /*
+     * position in the LRU list (or the list of dead entries, or the slab free
+     * list if the entry isn't in use).
+     */
+    struct cache_entry *lru_prev, *lru_next;
+
+    // how many bytes this entry counts against the cache's memory budget
+    unsigned n_bytes;
+
+    /*
+     * range of RAM pages which this block was compiled from.  These are only
+     * meaningful if watching_ram is set.
+     */
+    bool watching_ram;
+    unsigned ram_page_first, ram_page_last;
+
+#ifdef ENABLE_JIT_X86_64
+    /*
+     * if tiered compilation is enabled, this is the interpreted version of the
+     * block which runs until the compile thread is done with the native
+     * version.  It's NULL for blocks which are native code.
+     */
+    struct tier0_block *tier0;
+
+    /*
+     * set when another block's exit gets linked directly to this one.  Those
+     * links have to be undone before this entry can be freed.
+     */
+    bool link_target;
+#endif
 };
 
+struct Memory;
+struct tier0_block;
+
 /*
  * this might return a pointer to an invalid cache_entry.  If so, that means
- * the cache entry needs to be filled in by the callee.  This function will
- * allocate a new invalid cache entry if there is no entry for addr.
+ * the cache entry needs to be filled in by the callee and then passed to
+ * code_cache_set_valid.  This function will allocate a new invalid cache entry
+ * if there is no entry for addr.
  *
  * That said, blk will already be init'd no matter what, even if valid is
  * false.
+ *
+ * If every slot that hash could go in is already taken, the least-recently
+ * used block among them gets evicted to make room.
  */
 struct cache_entry *code_cache_find(jit_hash hash);
 
 /*
- * This is like code_cache_find, but it skips the second-level hash table.
- * This function is intended for JIT code which handles that itself
+ * returns the entry for hash, or NULL if there isn't one.  Unlike
+ * code_cache_find, this never allocates or evicts anything and it doesn't
+ * count as a use of the entry.
+ */
+struct cache_entry *code_cache_lookup(jit_hash hash);
+
+/*
+ * mark ent as valid once its block has been compiled, and charge the block's
+ * size against the cache's memory budget.
  */
-struct cache_entry *code_cache_find_slow(jit_hash hash);
+void code_cache_set_valid(struct cache_entry *ent);
+
+/*
+ * change how many bytes of code ent is charged for.  This is for entries
+ * whose code gets replaced after they've been marked valid.
+ */
+void code_cache_set_code_bytes(struct cache_entry *ent, unsigned code_bytes);
+
+/*
+ * returns true if ent is in the code_cache_tbl.  Entries which have been
+ * evicted or invalidated but not freed yet are not live.
+ */
+bool code_cache_is_live(struct cache_entry const *ent);
+
+/*
+ * n_evicted is the number of blocks which have been thrown out to make room for
+ * other blocks since code_cache_init.  n_spared is the number of times
+ * code_cache_gc found a block which had been referenced since the last time it
+ * looked and gave it a second chance instead of evicting it.
+ */
+void code_cache_get_evict_stats(uint64_t *n_evicted, uint64_t *n_spared);
 
 void code_cache_invalidate_all(void);
 
-void code_cache_init(void);
+/*
+ * invalidate every block that was compiled from a page of RAM which has been
+ * written to since it was compiled.  This does nothing if no such pages have
+ * been written to.
+ */
+void code_cache_invalidate_dirty(void);
+
+/*
+ * record that blk was compiled from the given range of RAM (offs_first and
+ * offs_last are both inclusive offsets into system memory).  blk must belong
+ * to a cache_entry.  If any of those pages are written to, then the next call
+ * to code_cache_invalidate_dirty will invalidate blk.
+ *
+ * If blk was already watching some RAM, the new range replaces the old one.
+ */
+void code_cache_watch_ram(struct jit_code_block *blk,
+                          unsigned offs_first, unsigned offs_last);
+
+void code_cache_init(struct Memory *ram);
 void code_cache_cleanup(void);
 
 /*
  * call this periodically from outside of CPU context to clear
- * out old cache entries.
+ * out old cache entries.  This is also where blocks get evicted if the cache
+ * has gone over its memory budget.
  */
 void code_cache_gc(void);
 
 /*
  * set the value that the code_cache_tbl gets overwritten with whenever there's
- * a nuke
+ * a nuke.  Slots which hold this value are considered empty.
  */
 void code_cache_set_default(void *dflt);
 
-#define CODE_CACHE_HASH_TBL_SHIFT 16
+/*
+ * The code_cache_tbl is an open-addressed hash table.  A block's home slot is
+ * CODE_CACHE_HASH_IDX(hash), and if that's taken then it goes in the first
+ * empty slot after it.  No block is ever more than CODE_CACHE_MAX_PROBE - 1
+ * slots away from its home, so lookups can give up after that many slots or as
+ * soon as they see an empty slot, whichever comes first.
+ *
+ * The hash is shifted right by one because SH4 instructions are always 2-byte
+ * aligned, so the lowest bit is always zero.
+ */
+#define CODE_CACHE_HASH_TBL_SHIFT 18
 #define CODE_CACHE_HASH_TBL_LEN (1 << CODE_CACHE_HASH_TBL_SHIFT)
 #define CODE_CACHE_HASH_TBL_MASK (CODE_CACHE_HASH_TBL_LEN - 1)
+#define CODE_CACHE_HASH_IDX(hash) (((hash) >> 1) & CODE_CACHE_HASH_TBL_MASK)
+#define CODE_CACHE_MAX_PROBE 8
 extern struct cache_entry* code_cache_tbl[CODE_CACHE_HASH_TBL_LEN];
 
+/*
+ * default memory budget, in megabytes, for the code cache if one isn't
+ * specified in the config.
+ */
+#define CODE_CACHE_DEFAULT_BUDGET_MB 128
+
 #endif
@@ -24,8 +24,8 @@
 
 #include "jit.h"
 
-void jit_init(struct dc_clock *clk) {
-    code_cache_init();
+void jit_init(struct dc_clock *clk, struct Memory *ram) {
+    code_cache_init(ram);
 }
 
 void jit_cleanup(void) {
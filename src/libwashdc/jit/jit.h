@@ -27,7 +27,9 @@
 
 #include "dc_sched.h"
 
-void jit_init(struct dc_clock *clk);
+struct Memory;
+
+void jit_init(struct dc_clock *clk, struct Memory *ram);
 void jit_cleanup(void);
 
 #endif
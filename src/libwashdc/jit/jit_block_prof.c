@@ -0,0 +1,190 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "threading.h"
+#include "washdc/error.h"
+#include "washdc/hostfile.h"
+#include "log.h"
+#include "hw/sh4/sh4_jit.h"
+
+#include "jit_block_prof.h"
+
+#define JIT_BLOCK_PROF_N_BUCKETS 4096
+#define JIT_BLOCK_PROF_BUCKET_MASK (JIT_BLOCK_PROF_N_BUCKETS - 1)
+
+struct jit_block_prof_state jit_block_prof_state;
+
+static struct jit_block_prof *buckets[JIT_BLOCK_PROF_N_BUCKETS];
+static unsigned n_blocks;
+
+/*
+ * records are only ever created on the emulation thread, but washdbg can ask
+ * for a dump from the io thread.
+ */
+static washdc_mutex prof_lock = WASHDC_MUTEX_STATIC_INIT;
+
+static unsigned jit_block_prof_bucket(jit_hash hash) {
+    return (hash ^ (hash >> 12)) & JIT_BLOCK_PROF_BUCKET_MASK;
+}
+
+void jit_block_prof_init(bool enable) {
+    memset(&jit_block_prof_state, 0, sizeof(jit_block_prof_state));
+    jit_block_prof_state.cur = &jit_block_prof_state.outside;
+    jit_block_prof_state.last_tick = jit_block_prof_tick();
+    jit_block_prof_state.enabled = enable;
+
+    memset(buckets, 0, sizeof(buckets));
+    n_blocks = 0;
+
+    if (enable)
+        LOG_INFO("JIT block profiler enabled\n");
+}
+
+void jit_block_prof_cleanup(void) {
+    unsigned idx;
+    for (idx = 0; idx < JIT_BLOCK_PROF_N_BUCKETS; idx++) {
+        struct jit_block_prof *prof = buckets[idx];
+        while (prof) {
+            struct jit_block_prof *next = prof->next;
+            free(prof);
+            prof = next;
+        }
+        buckets[idx] = NULL;
+    }
+    n_blocks = 0;
+    jit_block_prof_state.enabled = false;
+}
+
+struct jit_block_prof *jit_block_prof_get(jit_hash hash) {
+    if (!jit_block_prof_state.enabled)
+        return NULL;
+
+    struct jit_block_prof **bucket = buckets + jit_block_prof_bucket(hash);
+    struct jit_block_prof *prof;
+    for (prof = *bucket; prof; prof = prof->next)
+        if (prof->hash == hash)
+            return prof;
+
+    prof = (struct jit_block_prof*)calloc(1, sizeof(struct jit_block_prof));
+    if (!prof)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    prof->hash = hash;
+
+    washdc_mutex_lock(&prof_lock);
+    prof->next = *bucket;
+    *bucket = prof;
+    n_blocks++;
+    washdc_mutex_unlock(&prof_lock);
+
+    return prof;
+}
+
+void jit_block_prof_set_code(struct jit_block_prof *prof,
+                             unsigned il_insts, unsigned native_bytes) {
+    if (prof) {
+        prof->il_insts = il_insts;
+        prof->native_bytes = native_bytes;
+    }
+}
+
+static int jit_block_prof_cmp(void const *lhs_ptr, void const *rhs_ptr) {
+    struct jit_block_prof const *lhs =
+        *(struct jit_block_prof const * const*)lhs_ptr;
+    struct jit_block_prof const *rhs =
+        *(struct jit_block_prof const * const*)rhs_ptr;
+
+    if (lhs->ticks > rhs->ticks)
+        return -1;
+    else if (lhs->ticks < rhs->ticks)
+        return 1;
+    return 0;
+}
+
+void jit_block_prof_dump(char const *path) {
+    if (!jit_block_prof_state.enabled) {
+        LOG_ERROR("%s - the JIT block profiler is not enabled\n", __func__);
+        return;
+    }
+
+    washdc_hostfile outfile =
+        washdc_hostfile_open(path, WASHDC_HOSTFILE_WRITE |
+                             WASHDC_HOSTFILE_TEXT);
+    if (outfile == WASHDC_HOSTFILE_INVALID) {
+        LOG_ERROR("Failure to open %s for writing\n", path);
+        return;
+    }
+
+    washdc_mutex_lock(&prof_lock);
+
+    /*
+     * the counters keep changing underneath us if the emulation thread is
+     * running, which is fine since they're only ever added to.
+     */
+    struct jit_block_prof **sorted = NULL;
+    if (n_blocks) {
+        sorted = (struct jit_block_prof**)calloc(n_blocks, sizeof(*sorted));
+        if (!sorted)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+    }
+
+    unsigned n_sorted = 0, idx;
+    for (idx = 0; idx < JIT_BLOCK_PROF_N_BUCKETS; idx++) {
+        struct jit_block_prof *prof;
+        for (prof = buckets[idx]; prof; prof = prof->next)
+            sorted[n_sorted++] = prof;
+    }
+
+    washdc_mutex_unlock(&prof_lock);
+
+    qsort(sorted, n_sorted, sizeof(*sorted), jit_block_prof_cmp);
+
+    washdc_hostfile_puts(outfile, "pc,pr,sz,hits,host_ticks,guest_cycles,"
+                         "ticks_per_hit,il_insts,native_bytes\n");
+    for (idx = 0; idx < n_sorted; idx++) {
+        struct jit_block_prof const *prof = sorted[idx];
+        uint64_t hits = prof->hits;
+        uint64_t ticks = prof->ticks;
+        washdc_hostfile_printf(outfile, "0x%08x,%u,%u,%llu,%llu,%llu,%llu,"
+                               "%u,%u\n",
+                               (unsigned)(prof->hash & SH4_JIT_HASH_MASK),
+                               (unsigned)((prof->hash >>
+                                           SH4_JIT_HASH_PR_SHIFT) & 1),
+                               (unsigned)((prof->hash >>
+                                           SH4_JIT_HASH_SZ_SHIFT) & 1),
+                               (unsigned long long)hits,
+                               (unsigned long long)ticks,
+                               (unsigned long long)prof->guest_cycles,
+                               (unsigned long long)(hits ? ticks / hits : 0),
+                               prof->il_insts, prof->native_bytes);
+    }
+
+    washdc_hostfile_close(outfile);
+    free(sorted);
+
+    LOG_INFO("JIT block profile: %u blocks written to %s, %llu ticks spent "
+             "outside of blocks\n", n_sorted, path,
+             (unsigned long long)jit_block_prof_state.outside.ticks);
+}
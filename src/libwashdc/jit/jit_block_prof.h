@@ -0,0 +1,136 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#ifndef JIT_BLOCK_PROF_H_
+#define JIT_BLOCK_PROF_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#else
+#include <time.h>
+#endif
+
+#include "defs.h"
+
+/*
+ * Per-block profiler for the SH4 JIT.  Unlike jit_profile (which only exists in
+ * -DJIT_PROFILE builds and only ranks blocks by hit count), this is always
+ * built in and gets turned on at runtime.  It keeps a record for every block
+ * the code cache ever sees, keyed on the block's jit_hash, so recompiled blocks
+ * keep accumulating into the same record.
+ *
+ * Host time is measured in timestamp-counter ticks.  Whenever a block is
+ * entered, the ticks since the last block was entered get charged to that last
+ * block, so a block's time includes any fallbacks and memory accesses it
+ * calls out to.  Time spent in the dispatcher and the compiler is charged to
+ * jit_block_prof_state.outside instead of to a block.
+ */
+
+struct jit_block_prof {
+    /*
+     * ticks and hits need to stay at the beginning, native code generated by
+     * code_block_x86_64 updates them directly.
+     */
+    uint64_t ticks;
+    uint64_t hits;
+    uint64_t guest_cycles;
+
+    jit_hash hash;
+
+    // size of the most recent compilation of this block
+    unsigned il_insts;
+    unsigned native_bytes;
+
+    struct jit_block_prof *next;
+};
+
+struct jit_block_prof_state {
+    uint64_t last_tick;
+
+    // the block time is currently being charged to, never NULL
+    struct jit_block_prof *cur;
+
+    struct jit_block_prof outside;
+
+    bool enabled;
+};
+
+extern struct jit_block_prof_state jit_block_prof_state;
+
+void jit_block_prof_init(bool enable);
+void jit_block_prof_cleanup(void);
+
+static inline bool jit_block_prof_enabled(void) {
+    return jit_block_prof_state.enabled;
+}
+
+// returns NULL if the profiler is disabled.
+struct jit_block_prof *jit_block_prof_get(jit_hash hash);
+
+void jit_block_prof_set_code(struct jit_block_prof *prof,
+                             unsigned il_insts, unsigned native_bytes);
+
+static inline uint64_t jit_block_prof_tick(void) {
+#if defined(__x86_64__) || defined(_M_X64)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+/*
+ * charge the time since the last switch to the current block, and start
+ * charging time to prof.  If prof is NULL, time gets charged to
+ * jit_block_prof_state.outside until the next switch.
+ */
+static inline void jit_block_prof_switch(struct jit_block_prof *prof) {
+    struct jit_block_prof_state *state = &jit_block_prof_state;
+    uint64_t now = jit_block_prof_tick();
+
+    state->cur->ticks += now - state->last_tick;
+    state->last_tick = now;
+
+    if (prof) {
+        prof->hits++;
+        state->cur = prof;
+    } else {
+        state->cur = &state->outside;
+    }
+}
+
+/*
+ * write every block's stats to path as CSV, sorted so that the blocks with the
+ * most host time come first.
+ */
+void jit_block_prof_dump(char const *path);
+
+#endif
@@ -45,6 +45,17 @@ void jit_disas_il(washdc_hostfile out, struct jit_inst const *inst, int idx) {
                                immed->cset.dst_slot, immed->cset.flag_slot,
                                immed->cset.t_flag);
         break;
+    case JIT_OP_EXIT_COND:
+        washdc_hostfile_printf(out,
+                               "%02X: EXIT_COND %08X (hash %08X), %u cycles%s "
+                               "IF (<SLOT %02X> & 1) == %u\n", idx,
+                               (unsigned)immed->exit_cond.jmp_addr,
+                               (unsigned)immed->exit_cond.jmp_hash,
+                               immed->exit_cond.cycle_count,
+                               immed->exit_cond.loop ? " (loop)" : "",
+                               immed->exit_cond.flag_slot,
+                               immed->exit_cond.t_flag);
+        break;
     case JIT_SET_SLOT:
         washdc_hostfile_printf(out, "%02X: SET %08X, <SLOT %02X>\n", idx,
                                (unsigned)immed->set_slot.new_val,
@@ -65,6 +76,13 @@ void jit_disas_il(washdc_hostfile out, struct jit_inst const *inst, int idx) {
                                idx, immed->call_func_imm32.func,
                                (unsigned)immed->call_func_imm32.imm32);
         break;
+    case JIT_OP_CALL_FUNC_2:
+        washdc_hostfile_printf(out, "%02X: CALL %p(<CPU CTXT>, <SLOT %02X>, "
+                               "<SLOT %02X>)\n",
+                               idx, immed->call_func_2.func,
+                               immed->call_func_2.slot_arg0,
+                               immed->call_func_2.slot_arg1);
+        break;
     case JIT_OP_READ_16_CONSTADDR:
         washdc_hostfile_printf(out,
                                "%02X: READ_16_CONSTADDR *(U16*)%08X, "
@@ -192,6 +210,20 @@ void jit_disas_il(washdc_hostfile out, struct jit_inst const *inst, int idx) {
         washdc_hostfile_printf(out, "%02X: SUB <SLOT %02X>, <SLOT %02X>\n",
                                idx, immed->sub.slot_src, immed->sub.slot_dst);
         break;
+    case JIT_OP_ADD_CARRY:
+        washdc_hostfile_printf(out, "%02X: ADD_CARRY <SLOT %02X>, <SLOT %02X>, "
+                               "<SLOT %02X>\n",
+                               idx, immed->add_carry.slot_src,
+                               immed->add_carry.slot_dst,
+                               immed->add_carry.slot_carry);
+        break;
+    case JIT_OP_SUB_CARRY:
+        washdc_hostfile_printf(out, "%02X: SUB_CARRY <SLOT %02X>, <SLOT %02X>, "
+                               "<SLOT %02X>\n",
+                               idx, immed->sub_carry.slot_src,
+                               immed->sub_carry.slot_dst,
+                               immed->sub_carry.slot_carry);
+        break;
     case JIT_OP_SUB_FLOAT:
         washdc_hostfile_printf(out, "%02X: SUB_FLOAT <SLOT %02X>, <SLOT %02X>\n",
                                idx, immed->sub_float.slot_src, immed->sub_float.slot_dst);
@@ -328,6 +360,22 @@ void jit_disas_il(washdc_hostfile out, struct jit_inst const *inst, int idx) {
                                immed->mul_u32.slot_rhs,
                                immed->mul_u32.slot_dst);
         break;
+    case JIT_OP_MUL_U64:
+        washdc_hostfile_printf(out, "%02X: MUL_U64 <SLOT %02X>, <SLOT %02X>, "
+                               "<SLOT %02X>:<SLOT %02X>\n",
+                               idx, immed->mul_u64.slot_lhs,
+                               immed->mul_u64.slot_rhs,
+                               immed->mul_u64.slot_dst_hi,
+                               immed->mul_u64.slot_dst_lo);
+        break;
+    case JIT_OP_MUL_S64:
+        washdc_hostfile_printf(out, "%02X: MUL_S64 <SLOT %02X>, <SLOT %02X>, "
+                               "<SLOT %02X>:<SLOT %02X>\n",
+                               idx, immed->mul_s64.slot_lhs,
+                               immed->mul_s64.slot_rhs,
+                               immed->mul_s64.slot_dst_hi,
+                               immed->mul_s64.slot_dst_lo);
+        break;
     case JIT_OP_MUL_FLOAT:
         washdc_hostfile_printf(out,
                                "%02X: MUL_FLOAT <SLOT %02X>, <SLOT %02X>\n",
@@ -339,6 +387,48 @@ void jit_disas_il(washdc_hostfile out, struct jit_inst const *inst, int idx) {
                                "%02X: CLEAR_FLOAT <SLOT %02X>\n",
                                idx, immed->clear_float.slot_dst);
         break;
+    case JIT_OP_DIV_FLOAT:
+        washdc_hostfile_printf(out,
+                               "%02X: DIV_FLOAT <SLOT %02X>, <SLOT %02X>\n",
+                               idx, immed->div_float.slot_src,
+                               immed->div_float.slot_dst);
+        break;
+    case JIT_OP_SQRT_FLOAT:
+        washdc_hostfile_printf(out,
+                               "%02X: SQRT_FLOAT <SLOT %02X>, <SLOT %02X>, "
+                               "0x%08x, 0x%08x\n",
+                               idx, immed->sqrt_float.slot_dst,
+                               immed->sqrt_float.slot_flags,
+                               (unsigned)immed->sqrt_float.neg_result,
+                               (unsigned)immed->sqrt_float.neg_flags);
+        break;
+    case JIT_OP_RSQRT_FLOAT:
+        washdc_hostfile_printf(out,
+                               "%02X: RSQRT_FLOAT <SLOT %02X>\n",
+                               idx, immed->rsqrt_float.slot_dst);
+        break;
+    case JIT_OP_LOAD_FLOAT_SLOT_INDEXED:
+        washdc_hostfile_printf(out, "%02X: LOAD_FLOAT_SLOT_INDEXED ((FLOAT*)%p)[<SLOT %02X>], <SLOT %02X>\n",
+                               idx, immed->load_float_slot_indexed.tbl,
+                               immed->load_float_slot_indexed.slot_index,
+                               immed->load_float_slot_indexed.slot_dst);
+        break;
+    case JIT_OP_DOT4_FLOAT:
+        washdc_hostfile_printf(out, "%02X: DOT4_FLOAT (<SLOT %02X> + %u * 4), (<SLOT %02X> + %u * 4), (<SLOT %02X> + %u * 4)\n",
+                               idx, immed->dot4_float.slot_base,
+                               immed->dot4_float.index_lhs,
+                               immed->dot4_float.slot_base,
+                               immed->dot4_float.index_rhs,
+                               immed->dot4_float.slot_base,
+                               immed->dot4_float.index_dst);
+        break;
+    case JIT_OP_XFORM4_FLOAT:
+        washdc_hostfile_printf(out, "%02X: XFORM4_FLOAT (<SLOT %02X> + %u * 4), (<SLOT %02X> + %u * 4)\n",
+                               idx, immed->xform4_float.slot_base,
+                               immed->xform4_float.index_mat,
+                               immed->xform4_float.slot_base,
+                               immed->xform4_float.index_vec);
+        break;
     case JIT_OP_DISCARD_SLOT:
         washdc_hostfile_printf(out, "%02X: DISCARD_SLOT <SLOT %02X>\n", idx,
                                immed->discard_slot.slot_no);
@@ -72,6 +72,24 @@ void jit_cset(struct il_code_block *block, unsigned flag_slot,
     il_code_block_push_inst(block, &op);
 }
 
+void jit_exit_cond(struct il_code_block *block, unsigned flag_slot,
+                   unsigned t_flag, uint32_t jmp_addr, uint32_t jmp_hash,
+                   unsigned cycle_count, bool loop) {
+    struct jit_inst op;
+
+    check_slot(block, flag_slot, WASHDC_JIT_SLOT_GEN);
+
+    op.op = JIT_OP_EXIT_COND;
+    op.immed.exit_cond.flag_slot = flag_slot;
+    op.immed.exit_cond.t_flag = t_flag;
+    op.immed.exit_cond.jmp_addr = jmp_addr;
+    op.immed.exit_cond.jmp_hash = jmp_hash;
+    op.immed.exit_cond.cycle_count = cycle_count;
+    op.immed.exit_cond.loop = loop;
+
+    il_code_block_push_inst(block, &op);
+}
+
 void jit_set_slot(struct il_code_block *block, unsigned slot_idx,
                   uint32_t new_val) {
     struct jit_inst op;
@@ -122,6 +140,22 @@ void jit_call_func_imm32(struct il_code_block *block,
     il_code_block_push_inst(block, &op);
 }
 
+void jit_call_func_2(struct il_code_block *block,
+                     void(*func)(void*,uint32_t,uint32_t),
+                     unsigned slot_arg0, unsigned slot_arg1) {
+    struct jit_inst op;
+
+    check_slot(block, slot_arg0, WASHDC_JIT_SLOT_GEN);
+    check_slot(block, slot_arg1, WASHDC_JIT_SLOT_GEN);
+
+    op.op = JIT_OP_CALL_FUNC_2;
+    op.immed.call_func_2.func = func;
+    op.immed.call_func_2.slot_arg0 = slot_arg0;
+    op.immed.call_func_2.slot_arg1 = slot_arg1;
+
+    il_code_block_push_inst(block, &op);
+}
+
 void jit_read_16_constaddr(struct il_code_block *block, struct memory_map *map,
                            addr32_t addr, unsigned slot_no) {
     struct jit_inst op;
@@ -447,6 +481,38 @@ void jit_sub(struct il_code_block *block, unsigned slot_src,
     il_code_block_push_inst(block, &op);
 }
 
+void jit_add_carry(struct il_code_block *block, unsigned slot_src,
+                   unsigned slot_dst, unsigned slot_carry) {
+    struct jit_inst op;
+
+    check_slot(block, slot_src, WASHDC_JIT_SLOT_GEN);
+    check_slot(block, slot_dst, WASHDC_JIT_SLOT_GEN);
+    check_slot(block, slot_carry, WASHDC_JIT_SLOT_GEN);
+
+    op.op = JIT_OP_ADD_CARRY;
+    op.immed.add_carry.slot_src = slot_src;
+    op.immed.add_carry.slot_dst = slot_dst;
+    op.immed.add_carry.slot_carry = slot_carry;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_sub_carry(struct il_code_block *block, unsigned slot_src,
+                   unsigned slot_dst, unsigned slot_carry) {
+    struct jit_inst op;
+
+    check_slot(block, slot_src, WASHDC_JIT_SLOT_GEN);
+    check_slot(block, slot_dst, WASHDC_JIT_SLOT_GEN);
+    check_slot(block, slot_carry, WASHDC_JIT_SLOT_GEN);
+
+    op.op = JIT_OP_SUB_CARRY;
+    op.immed.sub_carry.slot_src = slot_src;
+    op.immed.sub_carry.slot_dst = slot_dst;
+    op.immed.sub_carry.slot_carry = slot_carry;
+
+    il_code_block_push_inst(block, &op);
+}
+
 void jit_sub_float(struct il_code_block *block, unsigned slot_src,
                    unsigned slot_dst) {
     struct jit_inst op;
@@ -813,6 +879,44 @@ void jit_mul_u32(struct il_code_block *block, unsigned slot_lhs,
     il_code_block_push_inst(block, &op);
 }
 
+void jit_mul_u64(struct il_code_block *block, unsigned slot_lhs,
+                 unsigned slot_rhs, unsigned slot_dst_lo,
+                 unsigned slot_dst_hi) {
+    struct jit_inst op;
+
+    check_slot(block, slot_lhs, WASHDC_JIT_SLOT_GEN);
+    check_slot(block, slot_rhs, WASHDC_JIT_SLOT_GEN);
+    check_slot(block, slot_dst_lo, WASHDC_JIT_SLOT_GEN);
+    check_slot(block, slot_dst_hi, WASHDC_JIT_SLOT_GEN);
+
+    op.op = JIT_OP_MUL_U64;
+    op.immed.mul_u64.slot_lhs = slot_lhs;
+    op.immed.mul_u64.slot_rhs = slot_rhs;
+    op.immed.mul_u64.slot_dst_lo = slot_dst_lo;
+    op.immed.mul_u64.slot_dst_hi = slot_dst_hi;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_mul_s64(struct il_code_block *block, unsigned slot_lhs,
+                 unsigned slot_rhs, unsigned slot_dst_lo,
+                 unsigned slot_dst_hi) {
+    struct jit_inst op;
+
+    check_slot(block, slot_lhs, WASHDC_JIT_SLOT_GEN);
+    check_slot(block, slot_rhs, WASHDC_JIT_SLOT_GEN);
+    check_slot(block, slot_dst_lo, WASHDC_JIT_SLOT_GEN);
+    check_slot(block, slot_dst_hi, WASHDC_JIT_SLOT_GEN);
+
+    op.op = JIT_OP_MUL_S64;
+    op.immed.mul_s64.slot_lhs = slot_lhs;
+    op.immed.mul_s64.slot_rhs = slot_rhs;
+    op.immed.mul_s64.slot_dst_lo = slot_dst_lo;
+    op.immed.mul_s64.slot_dst_hi = slot_dst_hi;
+
+    il_code_block_push_inst(block, &op);
+}
+
 void jit_mul_float(struct il_code_block *block, unsigned slot_lhs,
                    unsigned slot_dst) {
     struct jit_inst op;
@@ -852,6 +956,94 @@ void jit_clear_float(struct il_code_block *block, unsigned slot_dst) {
     il_code_block_push_inst(block, &op);
 }
 
+void jit_div_float(struct il_code_block *block, unsigned slot_src,
+                   unsigned slot_dst) {
+    struct jit_inst op;
+
+    check_slot(block, slot_src, WASHDC_JIT_SLOT_FLOAT);
+    check_slot(block, slot_dst, WASHDC_JIT_SLOT_FLOAT);
+
+    op.op = JIT_OP_DIV_FLOAT;
+    op.immed.div_float.slot_src = slot_src;
+    op.immed.div_float.slot_dst = slot_dst;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_sqrt_float(struct il_code_block *block, unsigned slot_dst,
+                    unsigned slot_flags, uint32_t neg_result,
+                    uint32_t neg_flags) {
+    struct jit_inst op;
+
+    check_slot(block, slot_dst, WASHDC_JIT_SLOT_FLOAT);
+    check_slot(block, slot_flags, WASHDC_JIT_SLOT_GEN);
+
+    op.op = JIT_OP_SQRT_FLOAT;
+    op.immed.sqrt_float.slot_dst = slot_dst;
+    op.immed.sqrt_float.slot_flags = slot_flags;
+    op.immed.sqrt_float.neg_result = neg_result;
+    op.immed.sqrt_float.neg_flags = neg_flags;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_rsqrt_float(struct il_code_block *block, unsigned slot_dst) {
+    struct jit_inst op;
+
+    check_slot(block, slot_dst, WASHDC_JIT_SLOT_FLOAT);
+
+    op.op = JIT_OP_RSQRT_FLOAT;
+    op.immed.rsqrt_float.slot_dst = slot_dst;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_load_float_slot_indexed(struct il_code_block *block,
+                                 float const *tbl, unsigned slot_index,
+                                 unsigned slot_dst) {
+    struct jit_inst op;
+
+    check_slot(block, slot_index, WASHDC_JIT_SLOT_GEN);
+    check_slot(block, slot_dst, WASHDC_JIT_SLOT_FLOAT);
+
+    op.op = JIT_OP_LOAD_FLOAT_SLOT_INDEXED;
+    op.immed.load_float_slot_indexed.tbl = tbl;
+    op.immed.load_float_slot_indexed.slot_index = slot_index;
+    op.immed.load_float_slot_indexed.slot_dst = slot_dst;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_dot4_float(struct il_code_block *block, unsigned slot_base,
+                    unsigned index_lhs, unsigned index_rhs,
+                    unsigned index_dst) {
+    struct jit_inst op;
+
+    check_slot(block, slot_base, WASHDC_JIT_SLOT_HOST_PTR);
+
+    op.op = JIT_OP_DOT4_FLOAT;
+    op.immed.dot4_float.slot_base = slot_base;
+    op.immed.dot4_float.index_lhs = index_lhs;
+    op.immed.dot4_float.index_rhs = index_rhs;
+    op.immed.dot4_float.index_dst = index_dst;
+
+    il_code_block_push_inst(block, &op);
+}
+
+void jit_xform4_float(struct il_code_block *block, unsigned slot_base,
+                      unsigned index_mat, unsigned index_vec) {
+    struct jit_inst op;
+
+    check_slot(block, slot_base, WASHDC_JIT_SLOT_HOST_PTR);
+
+    op.op = JIT_OP_XFORM4_FLOAT;
+    op.immed.xform4_float.slot_base = slot_base;
+    op.immed.xform4_float.index_mat = index_mat;
+    op.immed.xform4_float.index_vec = index_vec;
+
+    il_code_block_push_inst(block, &op);
+}
+
 void jit_inst_get_read_slots(struct jit_inst const *inst,
                              int read_slots[JIT_IL_MAX_READ_SLOTS]) {
     for (int idx = 0; idx < JIT_IL_MAX_READ_SLOTS; idx++)
@@ -869,6 +1061,9 @@ void jit_inst_get_read_slots(struct jit_inst const *inst,
         read_slots[0] = immed->cset.flag_slot;
         read_slots[1] = immed->cset.dst_slot;
         break;
+    case JIT_OP_EXIT_COND:
+        read_slots[0] = immed->exit_cond.flag_slot;
+        break;
     case JIT_SET_SLOT:
         break;
     case JIT_SET_SLOT_HOST_PTR:
@@ -876,6 +1071,10 @@ void jit_inst_get_read_slots(struct jit_inst const *inst,
     case JIT_OP_CALL_FUNC:
         read_slots[0] = immed->call_func.slot_no;
         break;
+    case JIT_OP_CALL_FUNC_2:
+        read_slots[0] = immed->call_func_2.slot_arg0;
+        read_slots[1] = immed->call_func_2.slot_arg1;
+        break;
     case JIT_OP_CALL_FUNC_IMM32:
         break;
     case JIT_OP_READ_16_CONSTADDR:
@@ -950,6 +1149,16 @@ void jit_inst_get_read_slots(struct jit_inst const *inst,
         read_slots[0] = immed->sub.slot_src;
         read_slots[1] = immed->sub.slot_dst;
         break;
+    case JIT_OP_ADD_CARRY:
+        read_slots[0] = immed->add_carry.slot_src;
+        read_slots[1] = immed->add_carry.slot_dst;
+        read_slots[2] = immed->add_carry.slot_carry;
+        break;
+    case JIT_OP_SUB_CARRY:
+        read_slots[0] = immed->sub_carry.slot_src;
+        read_slots[1] = immed->sub_carry.slot_dst;
+        read_slots[2] = immed->sub_carry.slot_carry;
+        break;
     case JIT_OP_SUB_FLOAT:
         read_slots[0] = immed->sub_float.slot_src;
         read_slots[1] = immed->sub_float.slot_dst;
@@ -1051,12 +1260,40 @@ void jit_inst_get_read_slots(struct jit_inst const *inst,
         read_slots[0] = immed->mul_u32.slot_lhs;
         read_slots[1] = immed->mul_u32.slot_rhs;
         break;
+    case JIT_OP_MUL_U64:
+        read_slots[0] = immed->mul_u64.slot_lhs;
+        read_slots[1] = immed->mul_u64.slot_rhs;
+        break;
+    case JIT_OP_MUL_S64:
+        read_slots[0] = immed->mul_s64.slot_lhs;
+        read_slots[1] = immed->mul_s64.slot_rhs;
+        break;
     case JIT_OP_MUL_FLOAT:
         read_slots[0] = immed->mul_float.slot_lhs;
         read_slots[1] = immed->mul_float.slot_dst;
         break;
     case JIT_OP_CLEAR_FLOAT:
         break;
+    case JIT_OP_DIV_FLOAT:
+        read_slots[0] = immed->div_float.slot_src;
+        read_slots[1] = immed->div_float.slot_dst;
+        break;
+    case JIT_OP_SQRT_FLOAT:
+        read_slots[0] = immed->sqrt_float.slot_dst;
+        read_slots[1] = immed->sqrt_float.slot_flags;
+        break;
+    case JIT_OP_RSQRT_FLOAT:
+        read_slots[0] = immed->rsqrt_float.slot_dst;
+        break;
+    case JIT_OP_LOAD_FLOAT_SLOT_INDEXED:
+        read_slots[0] = immed->load_float_slot_indexed.slot_index;
+        break;
+    case JIT_OP_DOT4_FLOAT:
+        read_slots[0] = immed->dot4_float.slot_base;
+        break;
+    case JIT_OP_XFORM4_FLOAT:
+        read_slots[0] = immed->xform4_float.slot_base;
+        break;
     default:
         RAISE_ERROR(ERROR_UNIMPLEMENTED);
     }
@@ -1087,6 +1324,8 @@ void jit_inst_get_write_slots(struct jit_inst const *inst,
     case JIT_CSET:
         write_slots[0] = immed->cset.dst_slot;
         break;
+    case JIT_OP_EXIT_COND:
+        break;
     case JIT_SET_SLOT:
         write_slots[0] = immed->set_slot.slot_idx;
         break;
@@ -1097,6 +1336,8 @@ void jit_inst_get_write_slots(struct jit_inst const *inst,
         break;
     case JIT_OP_CALL_FUNC_IMM32:
         break;
+    case JIT_OP_CALL_FUNC_2:
+        break;
     case JIT_OP_READ_16_CONSTADDR:
         write_slots[0] = immed->read_16_constaddr.slot_no;
         break;
@@ -1158,6 +1399,14 @@ void jit_inst_get_write_slots(struct jit_inst const *inst,
     case JIT_OP_SUB:
         write_slots[0] = immed->sub.slot_dst;
         break;
+    case JIT_OP_ADD_CARRY:
+        write_slots[0] = immed->add_carry.slot_dst;
+        write_slots[1] = immed->add_carry.slot_carry;
+        break;
+    case JIT_OP_SUB_CARRY:
+        write_slots[0] = immed->sub_carry.slot_dst;
+        write_slots[1] = immed->sub_carry.slot_carry;
+        break;
     case JIT_OP_SUB_FLOAT:
         write_slots[0] = immed->sub_float.slot_dst;
         break;
@@ -1238,12 +1487,37 @@ void jit_inst_get_write_slots(struct jit_inst const *inst,
     case JIT_OP_MUL_U32:
         write_slots[0] = immed->mul_u32.slot_dst;
         break;
+    case JIT_OP_MUL_U64:
+        write_slots[0] = immed->mul_u64.slot_dst_lo;
+        write_slots[1] = immed->mul_u64.slot_dst_hi;
+        break;
+    case JIT_OP_MUL_S64:
+        write_slots[0] = immed->mul_s64.slot_dst_lo;
+        write_slots[1] = immed->mul_s64.slot_dst_hi;
+        break;
     case JIT_OP_MUL_FLOAT:
         write_slots[0] = immed->mul_float.slot_dst;
         break;
     case JIT_OP_CLEAR_FLOAT:
         write_slots[0] = immed->clear_float.slot_dst;
         break;
+    case JIT_OP_DIV_FLOAT:
+        write_slots[0] = immed->div_float.slot_dst;
+        break;
+    case JIT_OP_SQRT_FLOAT:
+        write_slots[0] = immed->sqrt_float.slot_dst;
+        write_slots[1] = immed->sqrt_float.slot_flags;
+        break;
+    case JIT_OP_RSQRT_FLOAT:
+        write_slots[0] = immed->rsqrt_float.slot_dst;
+        break;
+    case JIT_OP_LOAD_FLOAT_SLOT_INDEXED:
+        write_slots[0] = immed->load_float_slot_indexed.slot_dst;
+        break;
+    case JIT_OP_DOT4_FLOAT:
+        break;
+    case JIT_OP_XFORM4_FLOAT:
+        break;
     default:
         RAISE_ERROR(ERROR_UNIMPLEMENTED);
     }
@@ -46,6 +46,14 @@ enum jit_opcode {
     // conditionally set based on flag
     JIT_CSET,
 
+    /*
+     * leave the block early if a flag slot's lowest bit is set to the given
+     * value.  The jump address, hash and the number of cycles consumed up to
+     * this point are all immediate values.  This is only used by superblocks,
+     * and only the native backend implements it.
+     */
+    JIT_OP_EXIT_COND,
+
     // this will set a register to the given constant value
     JIT_SET_SLOT,
 
@@ -66,6 +74,14 @@ enum jit_opcode {
      */
     JIT_OP_CALL_FUNC_IMM32,
 
+    /*
+     * this will call a function which accepts two 32-bit ints as its
+     * arguments.
+     *
+     * both arguments will be read from slots.
+     */
+    JIT_OP_CALL_FUNC_2,
+
     // read 16 bits from a constant address and store them in a given slot
     JIT_OP_READ_16_CONSTADDR,
 
@@ -157,6 +173,19 @@ enum jit_opcode {
     // subtract one slot from another
     JIT_OP_SUB,
 
+    /*
+     * add one slot plus the lowest bit of a carry slot into another slot.
+     * The carry slot is then set to 1 if the addition carried out of bit 31,
+     * else 0.
+     */
+    JIT_OP_ADD_CARRY,
+
+    /*
+     * subtract one slot plus the lowest bit of a carry slot from another slot.
+     * The carry slot is then set to 1 if the subtraction borrowed, else 0.
+     */
+    JIT_OP_SUB_CARRY,
+
     // subtract one 32-bit floating point slot from another
     JIT_OP_SUB_FLOAT,
 
@@ -234,12 +263,60 @@ enum jit_opcode {
      */
     JIT_OP_MUL_U32,
 
+    /*
+     * multiply two 32-bit slots together and place the 64-bit product in a
+     * pair of slots (one for the lower 32 bits, one for the upper 32 bits).
+     */
+    JIT_OP_MUL_U64,
+    JIT_OP_MUL_S64,
+
     // it's like JIT_OP_MUL_U32, but for 32-bit floating points
     JIT_OP_MUL_FLOAT,
 
     // set a floating-point slot to 0.0f
     JIT_OP_CLEAR_FLOAT,
 
+    // divide one 32-bit floating point slot by another
+    JIT_OP_DIV_FLOAT,
+
+    /*
+     * replace a 32-bit floating point slot with its square root.
+     *
+     * If the slot holds a negative number, then it is instead set to a
+     * constant bit-pattern and a general-purpose slot is ORed with a constant.
+     * This lets the frontend supply its own invalid-operation result and
+     * flags.
+     */
+    JIT_OP_SQRT_FLOAT,
+
+    /*
+     * replace a 32-bit floating point slot with the reciprocal of its square
+     * root.  The intermediate values are calculated in double-precision.
+     */
+    JIT_OP_RSQRT_FLOAT,
+
+    /*
+     * load a 32-bit float from a table in host memory into a slot, using the
+     * value of a general-purpose slot as the index into the table.
+     */
+    JIT_OP_LOAD_FLOAT_SLOT_INDEXED,
+
+    /*
+     * calculate the dot-product of two 4-element float vectors in host memory
+     * (addressed via address in a slot + index) and store the result in host
+     * memory.  The products are summed in order from first to last.
+     */
+    JIT_OP_DOT4_FLOAT,
+
+    /*
+     * multiply a 4-element float vector in host memory by a 4x4 float matrix
+     * in host memory (both addressed via address in a slot + index) and
+     * overwrite the vector with the result.  The matrix is stored in
+     * column-major order, and each element of the result is summed in order
+     * from the first column to the last.
+     */
+    JIT_OP_XFORM4_FLOAT,
+
     /*
      * This tells the backend that a given slot is no longer needed and its
      * value does not need to be preserved.
@@ -267,6 +344,22 @@ struct cset_immed {
     unsigned dst_slot;
 };
 
+struct exit_cond_immed {
+    // the exit is taken if (flag_slot & 1) == t_flag
+    unsigned flag_slot, t_flag;
+
+    uint32_t jmp_addr, jmp_hash;
+
+    // cycles consumed by the block if this exit is taken
+    unsigned cycle_count;
+
+    // true if jmp_addr is the beginning of the block this exit belongs to
+    bool loop;
+};
+
+// maximum number of JIT_OP_EXIT_COND instructions in one block
+#define JIT_MAX_SIDE_EXITS 8
+
 struct set_slot_immed {
     unsigned slot_idx;
     uint32_t new_val;
@@ -287,6 +380,11 @@ struct call_func_imm32_immed {
     uint32_t imm32;
 };
 
+struct call_func_2_immed {
+    void(*func)(void*,uint32_t,uint32_t);
+    unsigned slot_arg0, slot_arg1;
+};
+
 struct read_16_constaddr_immed {
     struct memory_map *map;
     addr32_t addr;
@@ -412,6 +510,11 @@ struct sub_immed {
     unsigned slot_src, slot_dst;
 };
 
+struct add_carry_immed {
+    unsigned slot_src, slot_dst;
+    unsigned slot_carry;
+};
+
 struct sub_float_immed {
     unsigned slot_src, slot_dst;
 };
@@ -552,6 +655,11 @@ struct mul_u32_immed {
     unsigned slot_dst;
 };
 
+struct mul_64_immed {
+    unsigned slot_lhs, slot_rhs;
+    unsigned slot_dst_lo, slot_dst_hi;
+};
+
 struct mul_float_immed {
     unsigned slot_lhs, slot_dst;
 };
@@ -560,14 +668,52 @@ struct clear_float_immed {
     unsigned slot_dst;
 };
 
+struct div_float_immed {
+    // dst = dst / src
+    unsigned slot_src, slot_dst;
+};
+
+struct sqrt_float_immed {
+    unsigned slot_dst;
+
+    // if dst < 0, then dst = neg_result and flags |= neg_flags
+    unsigned slot_flags;
+    uint32_t neg_result;
+    uint32_t neg_flags;
+};
+
+struct rsqrt_float_immed {
+    unsigned slot_dst;
+};
+
+struct load_float_slot_indexed_immed {
+    float const *tbl;
+    unsigned slot_index;
+    unsigned slot_dst;
+};
+
+struct dot4_float_immed {
+    unsigned slot_base;
+    unsigned index_lhs, index_rhs;
+    unsigned index_dst;
+};
+
+struct xform4_float_immed {
+    unsigned slot_base;
+    unsigned index_mat;
+    unsigned index_vec;
+};
+
 union jit_immed {
     struct jit_fallback_immed fallback;
     struct jump_immed jump;
     struct cset_immed cset;
+    struct exit_cond_immed exit_cond;
     struct set_slot_immed set_slot;
     struct set_slot_host_ptr_immed set_slot_host_ptr;
     struct call_func_immed call_func;
     struct call_func_imm32_immed call_func_imm32;
+    struct call_func_2_immed call_func_2;
     struct read_16_constaddr_immed read_16_constaddr;
     struct sign_extend_16_immed sign_extend_8;
     struct sign_extend_16_immed sign_extend_16;
@@ -591,6 +737,8 @@ union jit_immed {
     struct store_float_slot_offset_immed store_float_slot_offset;
     struct add_immed add;
     struct sub_immed sub;
+    struct add_carry_immed add_carry;
+    struct add_carry_immed sub_carry;
     struct sub_float_immed sub_float;
     struct add_float_immed add_float;
     struct add_const32_immed add_const32;
@@ -618,8 +766,16 @@ union jit_immed {
     struct set_ge_signed_const_immed set_ge_signed_const;
     struct set_gt_float_immed set_gt_float;
     struct mul_u32_immed mul_u32;
+    struct mul_64_immed mul_u64;
+    struct mul_64_immed mul_s64;
     struct mul_float_immed mul_float;
     struct clear_float_immed clear_float;
+    struct div_float_immed div_float;
+    struct sqrt_float_immed sqrt_float;
+    struct rsqrt_float_immed rsqrt_float;
+    struct load_float_slot_indexed_immed load_float_slot_indexed;
+    struct dot4_float_immed dot4_float;
+    struct xform4_float_immed xform4_float;
 };
 
 struct jit_inst {
@@ -651,12 +807,18 @@ void jit_fallback(struct il_code_block *block,
 void jit_jump(struct il_code_block *block, unsigned jmp_addr_slot, unsigned jmp_hash_slot);
 void jit_cset(struct il_code_block *block, unsigned flag_slot,
               unsigned t_flag, uint32_t src_val, unsigned dst_slot);
+void jit_exit_cond(struct il_code_block *block, unsigned flag_slot,
+                   unsigned t_flag, uint32_t jmp_addr, uint32_t jmp_hash,
+                   unsigned cycle_count, bool loop);
 void jit_set_slot(struct il_code_block *block, unsigned slot_idx,
                   uint32_t new_val);
 void jit_set_slot_host_ptr(struct il_code_block *block, unsigned slot_idx,
                            void *ptr);
 void jit_call_func(struct il_code_block *block,
                    void(*func)(void*,uint32_t), unsigned slot_no);
+void jit_call_func_2(struct il_code_block *block,
+                     void(*func)(void*,uint32_t,uint32_t),
+                     unsigned slot_arg0, unsigned slot_arg1);
 void jit_call_func_imm32(struct il_code_block *block,
                          void(*func)(void*,uint32_t), uint32_t imm32);
 void jit_read_16_constaddr(struct il_code_block *block, struct memory_map *map,
@@ -704,6 +866,10 @@ void jit_add(struct il_code_block *block, unsigned slot_src,
              unsigned slot_dst);
 void jit_sub(struct il_code_block *block, unsigned slot_src,
              unsigned slot_dst);
+void jit_add_carry(struct il_code_block *block, unsigned slot_src,
+                   unsigned slot_dst, unsigned slot_carry);
+void jit_sub_carry(struct il_code_block *block, unsigned slot_src,
+                   unsigned slot_dst, unsigned slot_carry);
 void jit_sub_float(struct il_code_block *block, unsigned slot_src,
                    unsigned slot_dst);
 void jit_add_float(struct il_code_block *block, unsigned slot_src,
@@ -755,8 +921,28 @@ void jit_set_gt_float(struct il_code_block *block, unsigned slot_lhs,
                       unsigned slot_rhs, unsigned slot_dst);
 void jit_mul_u32(struct il_code_block *block, unsigned slot_lhs,
                  unsigned slot_rhs, unsigned slot_dst);
+void jit_mul_u64(struct il_code_block *block, unsigned slot_lhs,
+                 unsigned slot_rhs, unsigned slot_dst_lo,
+                 unsigned slot_dst_hi);
+void jit_mul_s64(struct il_code_block *block, unsigned slot_lhs,
+                 unsigned slot_rhs, unsigned slot_dst_lo,
+                 unsigned slot_dst_hi);
 void jit_mul_float(struct il_code_block *block, unsigned slot_lhs,
                    unsigned slot_dst);
 void jit_clear_float(struct il_code_block *block, unsigned slot_dst);
+void jit_div_float(struct il_code_block *block, unsigned slot_src,
+                   unsigned slot_dst);
+void jit_sqrt_float(struct il_code_block *block, unsigned slot_dst,
+                    unsigned slot_flags, uint32_t neg_result,
+                    uint32_t neg_flags);
+void jit_rsqrt_float(struct il_code_block *block, unsigned slot_dst);
+void jit_load_float_slot_indexed(struct il_code_block *block,
+                                 float const *tbl, unsigned slot_index,
+                                 unsigned slot_dst);
+void jit_dot4_float(struct il_code_block *block, unsigned slot_base,
+                    unsigned index_lhs, unsigned index_rhs,
+                    unsigned index_dst);
+void jit_xform4_float(struct il_code_block *block, unsigned slot_base,
+                      unsigned index_mat, unsigned index_vec);
 
 #endif
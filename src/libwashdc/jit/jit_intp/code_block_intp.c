@@ -20,6 +20,7 @@
  *
  ******************************************************************************/
 
+#include <math.h>
 #include <string.h>
 #include <stdlib.h>
 
@@ -81,6 +82,9 @@ reg32_t code_block_intp_exec(void *cpu, struct code_block_intp const *block) {
             }
             inst++;
             break;
+        case JIT_OP_EXIT_COND:
+            // superblocks are only ever built for the native backend
+            RAISE_ERROR(ERROR_UNIMPLEMENTED);
         case JIT_SET_SLOT:
             block->slots[inst->immed.set_slot.slot_idx].as_u32 =
                 inst->immed.set_slot.new_val;
@@ -98,6 +102,16 @@ reg32_t code_block_intp_exec(void *cpu, struct code_block_intp const *block) {
                                            ].as_u32);
             inst++;
             break;
+        case JIT_OP_CALL_FUNC_2:
+            inst->immed.call_func_2.func(cpu,
+                                         block->slots[
+                                             inst->immed.call_func_2.slot_arg0
+                                             ].as_u32,
+                                         block->slots[
+                                             inst->immed.call_func_2.slot_arg1
+                                             ].as_u32);
+            inst++;
+            break;
         case JIT_OP_CALL_FUNC_IMM32:
             inst->immed.call_func_imm32.func(cpu,
                                              inst->immed.call_func_imm32.imm32);
@@ -246,6 +260,29 @@ reg32_t code_block_intp_exec(void *cpu, struct code_block_intp const *block) {
                 block->slots[inst->immed.sub.slot_src].as_u32;
             inst++;
             break;
+        case JIT_OP_ADD_CARRY:
+            {
+                uint64_t sum =
+                    (uint64_t)block->slots[inst->immed.add_carry.slot_dst].as_u32 +
+                    (uint64_t)block->slots[inst->immed.add_carry.slot_src].as_u32 +
+                    (block->slots[inst->immed.add_carry.slot_carry].as_u32 & 1);
+                block->slots[inst->immed.add_carry.slot_dst].as_u32 = sum;
+                block->slots[inst->immed.add_carry.slot_carry].as_u32 = sum >> 32;
+            }
+            inst++;
+            break;
+        case JIT_OP_SUB_CARRY:
+            {
+                uint64_t diff =
+                    (uint64_t)block->slots[inst->immed.sub_carry.slot_dst].as_u32 -
+                    (uint64_t)block->slots[inst->immed.sub_carry.slot_src].as_u32 -
+                    (block->slots[inst->immed.sub_carry.slot_carry].as_u32 & 1);
+                block->slots[inst->immed.sub_carry.slot_dst].as_u32 = diff;
+                block->slots[inst->immed.sub_carry.slot_carry].as_u32 =
+                    (diff >> 32) & 1;
+            }
+            inst++;
+            break;
         case JIT_OP_SUB_FLOAT:
             block->slots[inst->immed.sub_float.slot_dst].as_float -=
                 block->slots[inst->immed.sub_float.slot_src].as_float;
@@ -386,6 +423,27 @@ reg32_t code_block_intp_exec(void *cpu, struct code_block_intp const *block) {
                 block->slots[inst->immed.mul_u32.slot_rhs].as_u32;
             inst++;
             break;
+        case JIT_OP_MUL_U64:
+            {
+                uint64_t prod =
+                    (uint64_t)block->slots[inst->immed.mul_u64.slot_lhs].as_u32 *
+                    (uint64_t)block->slots[inst->immed.mul_u64.slot_rhs].as_u32;
+                block->slots[inst->immed.mul_u64.slot_dst_lo].as_u32 = prod;
+                block->slots[inst->immed.mul_u64.slot_dst_hi].as_u32 = prod >> 32;
+            }
+            inst++;
+            break;
+        case JIT_OP_MUL_S64:
+            {
+                int64_t prod =
+                    (int64_t)(int32_t)block->slots[inst->immed.mul_s64.slot_lhs].as_u32 *
+                    (int64_t)(int32_t)block->slots[inst->immed.mul_s64.slot_rhs].as_u32;
+                block->slots[inst->immed.mul_s64.slot_dst_lo].as_u32 = prod;
+                block->slots[inst->immed.mul_s64.slot_dst_hi].as_u32 =
+                    ((uint64_t)prod) >> 32;
+            }
+            inst++;
+            break;
         case JIT_OP_MUL_FLOAT:
             block->slots[inst->immed.mul_float.slot_dst].as_float =
                 block->slots[inst->immed.mul_float.slot_lhs].as_float *
@@ -396,6 +454,68 @@ reg32_t code_block_intp_exec(void *cpu, struct code_block_intp const *block) {
             block->slots[inst->immed.clear_float.slot_dst].as_float = 0.0f;
             inst++;
             break;
+        case JIT_OP_DIV_FLOAT:
+            block->slots[inst->immed.div_float.slot_dst].as_float /=
+                block->slots[inst->immed.div_float.slot_src].as_float;
+            inst++;
+            break;
+        case JIT_OP_SQRT_FLOAT:
+            if (block->slots[inst->immed.sqrt_float.slot_dst].as_float < 0.0f) {
+                block->slots[inst->immed.sqrt_float.slot_dst].as_u32 =
+                    inst->immed.sqrt_float.neg_result;
+                block->slots[inst->immed.sqrt_float.slot_flags].as_u32 |=
+                    inst->immed.sqrt_float.neg_flags;
+            } else {
+                block->slots[inst->immed.sqrt_float.slot_dst].as_float =
+                    sqrt(block->slots[inst->immed.sqrt_float.slot_dst].as_float);
+            }
+            inst++;
+            break;
+        case JIT_OP_RSQRT_FLOAT:
+            block->slots[inst->immed.rsqrt_float.slot_dst].as_float =
+                1.0 / sqrt(block->slots[inst->immed.rsqrt_float.slot_dst].as_float);
+            inst++;
+            break;
+        case JIT_OP_LOAD_FLOAT_SLOT_INDEXED:
+            memcpy(&block->slots[inst->immed.load_float_slot_indexed.slot_dst].as_float,
+                   inst->immed.load_float_slot_indexed.tbl +
+                   block->slots[inst->immed.load_float_slot_indexed.slot_index].as_u32,
+                   sizeof(float));
+            inst++;
+            break;
+        case JIT_OP_DOT4_FLOAT:
+            {
+                char *base = (char*)block->slots[inst->immed.dot4_float.slot_base].as_host_ptr;
+                float lhs[4], rhs[4], dst;
+                memcpy(lhs, base + sizeof(float) * inst->immed.dot4_float.index_lhs,
+                       sizeof(lhs));
+                memcpy(rhs, base + sizeof(float) * inst->immed.dot4_float.index_rhs,
+                       sizeof(rhs));
+                dst = lhs[0] * rhs[0] + lhs[1] * rhs[1] +
+                    lhs[2] * rhs[2] + lhs[3] * rhs[3];
+                memcpy(base + sizeof(float) * inst->immed.dot4_float.index_dst,
+                       &dst, sizeof(dst));
+            }
+            inst++;
+            break;
+        case JIT_OP_XFORM4_FLOAT:
+            {
+                char *base = (char*)block->slots[inst->immed.xform4_float.slot_base].as_host_ptr;
+                float mat[16], vec[4], out[4];
+                memcpy(mat, base + sizeof(float) * inst->immed.xform4_float.index_mat,
+                       sizeof(mat));
+                memcpy(vec, base + sizeof(float) * inst->immed.xform4_float.index_vec,
+                       sizeof(vec));
+                unsigned row;
+                for (row = 0; row < 4; row++) {
+                    out[row] = vec[0] * mat[row] + vec[1] * mat[4 + row] +
+                        vec[2] * mat[8 + row] + vec[3] * mat[12 + row];
+                }
+                memcpy(base + sizeof(float) * inst->immed.xform4_float.index_vec,
+                       out, sizeof(out));
+            }
+            inst++;
+            break;
         case JIT_OP_SHAD:
             if ((int32_t)block->slots[inst->immed.shad.slot_shift_amt].as_u32 >= 0) {
                 block->slots[inst->immed.shad.slot_val].as_u32 <<=
@@ -21,30 +21,106 @@
  ******************************************************************************/
 
 #include <string.h>
+#include <stdlib.h>
 #include <stdbool.h>
 
 #include "code_block.h"
+#include "optimize.h"
 
-static void jit_optimize_nop(struct il_code_block *blk);
-static void jit_optimize_dead_write(struct il_code_block *blk);
+static unsigned jit_optimize_nop(struct il_code_block *blk);
+static unsigned jit_optimize_const_prop(struct il_code_block *blk);
+static unsigned jit_optimize_redundant_load(struct il_code_block *blk);
+static unsigned jit_optimize_copy_prop(struct il_code_block *blk);
+static unsigned jit_optimize_dead_write(struct il_code_block *blk);
 static void jit_optimize_discard(struct il_code_block *blk);
 
 static bool
 check_for_reads_after(struct il_code_block *blk, unsigned inst_idx);
 
+/*
+ * Each pass returns the number of IL instructions it rewrote in-place.  The
+ * number of instructions it removed is inferred from the block's inst_count.
+ *
+ * The order matters: constant propagation turns moves of known values into
+ * JIT_SET_SLOT, redundant load elimination turns loads into moves, copy
+ * propagation makes those moves unnecessary, and then dead-write elimination
+ * cleans up all the instructions whose results are no longer being read.
+ */
+static struct jit_optimize_pass {
+    char const *name;
+    unsigned(*func)(struct il_code_block*);
+} const passes[] = {
+    { "nop", jit_optimize_nop },
+    { "constant propagation", jit_optimize_const_prop },
+    { "redundant load elimination", jit_optimize_redundant_load },
+    { "copy propagation", jit_optimize_copy_prop },
+    { "dead write elimination", jit_optimize_dead_write }
+};
+
+#define N_PASSES (sizeof(passes) / sizeof(passes[0]))
+
+#ifdef JIT_PROFILE
+static struct jit_optimize_pass_stats {
+    unsigned long long n_removed, n_rewritten;
+} pass_stats[N_PASSES];
+
+static unsigned long long n_blocks_optimized;
+static unsigned long long n_insts_in, n_insts_out;
+#endif
+
 void jit_optimize(struct il_code_block *blk) {
-    jit_optimize_nop(blk);
-    jit_optimize_dead_write(blk);
+    unsigned pass_no;
+
+#ifdef JIT_PROFILE
+    n_blocks_optimized++;
+    n_insts_in += blk->inst_count;
+#endif
+
+    for (pass_no = 0; pass_no < N_PASSES; pass_no++) {
+#ifdef JIT_PROFILE
+        unsigned n_insts_before = blk->inst_count;
+        pass_stats[pass_no].n_rewritten += passes[pass_no].func(blk);
+        pass_stats[pass_no].n_removed += n_insts_before - blk->inst_count;
+#else
+        passes[pass_no].func(blk);
+#endif
+    }
+
+#ifdef JIT_PROFILE
+    n_insts_out += blk->inst_count;
+#endif
+
     jit_optimize_discard(blk);
 }
 
+#ifdef JIT_PROFILE
+void jit_optimize_print_stats(washdc_hostfile out) {
+    unsigned pass_no;
+
+    washdc_hostfile_printf(out, "IL optimizer statistics:\n");
+    washdc_hostfile_printf(out, "\t%llu blocks optimized\n",
+                           n_blocks_optimized);
+    washdc_hostfile_printf(out, "\t%llu IL instructions in, %llu out\n",
+                           n_insts_in, n_insts_out);
+    for (pass_no = 0; pass_no < N_PASSES; pass_no++) {
+        washdc_hostfile_printf(out, "\t%s: %llu removed, %llu rewritten\n",
+                               passes[pass_no].name,
+                               pass_stats[pass_no].n_removed,
+                               pass_stats[pass_no].n_rewritten);
+    }
+    washdc_hostfile_puts(out, "\n");
+}
+#endif
+
 // remove IL instructions which don't actually do anything.
-static void jit_optimize_nop(struct il_code_block *blk) {
+static unsigned jit_optimize_nop(struct il_code_block *blk) {
     unsigned inst_no = 0;
     while (inst_no < blk->inst_count) {
         struct jit_inst *inst = blk->inst_list + inst_no;
-        if (inst->op == JIT_OP_AND &&
-            inst->immed.and.slot_src == inst->immed.and.slot_dst) {
+        bool nop;
+
+        switch (inst->op) {
+        case JIT_OP_AND:
             /*
              * ANDing a slot with itself.
              *
@@ -55,15 +131,777 @@ static void jit_optimize_nop(struct il_code_block *blk) {
              * instruction in the IL is separate from the SLOT_TO_BOOL
              * operation.
              */
+            nop = inst->immed.and.slot_src == inst->immed.and.slot_dst;
+            break;
+        case JIT_OP_MOV:
+            nop = inst->immed.mov.slot_src == inst->immed.mov.slot_dst;
+            break;
+        case JIT_OP_MOV_FLOAT:
+            nop = inst->immed.mov_float.slot_src ==
+                inst->immed.mov_float.slot_dst;
+            break;
+        case JIT_OP_ADD_CONST32:
+            nop = inst->immed.add_const32.const32 == 0;
+            break;
+        case JIT_OP_XOR_CONST32:
+            nop = inst->immed.xor_const32.const32 == 0;
+            break;
+        case JIT_OP_OR_CONST32:
+            nop = inst->immed.or_const32.const32 == 0;
+            break;
+        case JIT_OP_AND_CONST32:
+            nop = inst->immed.and_const32.const32 == 0xffffffff;
+            break;
+        case JIT_OP_SHLL:
+            nop = inst->immed.shll.shift_amt == 0;
+            break;
+        case JIT_OP_SHLR:
+            nop = inst->immed.shlr.shift_amt == 0;
+            break;
+        case JIT_OP_SHAR:
+            nop = inst->immed.shar.shift_amt == 0;
+            break;
+        default:
+            nop = false;
+        }
+
+        if (nop) {
             il_code_block_strike_inst(blk, inst_no);
             continue;
         }
         inst_no++;
     }
+    return 0;
+}
+
+/*
+ * constant propagation.
+ *
+ * This tracks which general-purpose slots hold a value that is known at
+ * compile-time (because it came from JIT_SET_SLOT or from an operation whose
+ * inputs were all known) and uses that to fold operations into JIT_SET_SLOT or
+ * into their immediate-operand forms.
+ */
+static bool const_known[MAX_SLOTS];
+static uint32_t const_val[MAX_SLOTS];
+
+static void
+const_prop_set_slot(struct jit_inst *inst, unsigned slot_no, uint32_t val) {
+    inst->op = JIT_SET_SLOT;
+    inst->immed.set_slot.slot_idx = slot_no;
+    inst->immed.set_slot.new_val = val;
+}
+
+// returns true if the instruction was rewritten
+static bool const_prop_fold(struct jit_inst *inst) {
+    union jit_immed *immed = &inst->immed;
+    unsigned slot_src, slot_dst;
+    uint32_t val;
+    bool converted = true;
+
+    /*
+     * first turn two-slot operations whose source is known into their
+     * immediate forms.
+     */
+    switch (inst->op) {
+    case JIT_OP_MOV:
+        slot_src = immed->mov.slot_src;
+        if (!const_known[slot_src])
+            return false;
+        const_prop_set_slot(inst, immed->mov.slot_dst, const_val[slot_src]);
+        return true;
+    case JIT_OP_ADD:
+    case JIT_OP_SUB:
+        if (inst->op == JIT_OP_SUB) {
+            slot_src = immed->sub.slot_src;
+            slot_dst = immed->sub.slot_dst;
+        } else {
+            slot_src = immed->add.slot_src;
+            slot_dst = immed->add.slot_dst;
+        }
+        if (!const_known[slot_src])
+            return false;
+        val = const_val[slot_src];
+        if (inst->op == JIT_OP_SUB)
+            val = -val;
+        inst->op = JIT_OP_ADD_CONST32;
+        immed->add_const32.slot_dst = slot_dst;
+        immed->add_const32.const32 = val;
+        break;
+    case JIT_OP_XOR:
+        slot_src = immed->xor.slot_src;
+        slot_dst = immed->xor.slot_dst;
+        if (!const_known[slot_src])
+            return false;
+        inst->op = JIT_OP_XOR_CONST32;
+        immed->xor_const32.slot_no = slot_dst;
+        immed->xor_const32.const32 = const_val[slot_src];
+        break;
+    case JIT_OP_AND:
+        slot_src = immed->and.slot_src;
+        slot_dst = immed->and.slot_dst;
+        if (!const_known[slot_src])
+            return false;
+        inst->op = JIT_OP_AND_CONST32;
+        immed->and_const32.slot_no = slot_dst;
+        immed->and_const32.const32 = const_val[slot_src];
+        break;
+    case JIT_OP_OR:
+        slot_src = immed->or.slot_src;
+        slot_dst = immed->or.slot_dst;
+        if (!const_known[slot_src])
+            return false;
+        inst->op = JIT_OP_OR_CONST32;
+        immed->or_const32.slot_no = slot_dst;
+        immed->or_const32.const32 = const_val[slot_src];
+        break;
+    case JIT_OP_MUL_U32:
+        if (!const_known[immed->mul_u32.slot_lhs] ||
+            !const_known[immed->mul_u32.slot_rhs])
+            return false;
+        const_prop_set_slot(inst, immed->mul_u32.slot_dst,
+                            const_val[immed->mul_u32.slot_lhs] *
+                            const_val[immed->mul_u32.slot_rhs]);
+        return true;
+    case JIT_OP_READ_32_SLOT:
+        slot_src = immed->read_32_slot.addr_slot;
+        if (!const_known[slot_src])
+            return false;
+        slot_dst = immed->read_32_slot.dst_slot;
+        inst->op = JIT_OP_READ_32_CONSTADDR;
+        immed->read_32_constaddr.map = immed->read_32_slot.map;
+        immed->read_32_constaddr.addr = const_val[slot_src];
+        immed->read_32_constaddr.slot_no = slot_dst;
+        return true;
+    case JIT_OP_READ_16_SLOT:
+        slot_src = immed->read_16_slot.addr_slot;
+        if (!const_known[slot_src])
+            return false;
+        slot_dst = immed->read_16_slot.dst_slot;
+        inst->op = JIT_OP_READ_16_CONSTADDR;
+        immed->read_16_constaddr.map = immed->read_16_slot.map;
+        immed->read_16_constaddr.addr = const_val[slot_src];
+        immed->read_16_constaddr.slot_no = slot_dst;
+        return true;
+    case JIT_OP_CALL_FUNC:
+        slot_src = immed->call_func.slot_no;
+        if (!const_known[slot_src])
+            return false;
+        inst->op = JIT_OP_CALL_FUNC_IMM32;
+        immed->call_func_imm32.func = immed->call_func.func;
+        immed->call_func_imm32.imm32 = const_val[slot_src];
+        return true;
+    default:
+        converted = false;
+        break;
+    }
+
+    // now fold single-slot operations on known values into JIT_SET_SLOT
+    switch (inst->op) {
+    case JIT_OP_ADD_CONST32:
+        slot_dst = immed->add_const32.slot_dst;
+        if (!const_known[slot_dst])
+            return converted;
+        val = const_val[slot_dst] + immed->add_const32.const32;
+        break;
+    case JIT_OP_XOR_CONST32:
+        slot_dst = immed->xor_const32.slot_no;
+        if (!const_known[slot_dst])
+            return converted;
+        val = const_val[slot_dst] ^ immed->xor_const32.const32;
+        break;
+    case JIT_OP_AND_CONST32:
+        slot_dst = immed->and_const32.slot_no;
+        if (!const_known[slot_dst])
+            return converted;
+        val = const_val[slot_dst] & immed->and_const32.const32;
+        break;
+    case JIT_OP_OR_CONST32:
+        slot_dst = immed->or_const32.slot_no;
+        if (!const_known[slot_dst])
+            return converted;
+        val = const_val[slot_dst] | immed->or_const32.const32;
+        break;
+    case JIT_OP_NOT:
+        slot_dst = immed->not.slot_no;
+        if (!const_known[slot_dst])
+            return false;
+        val = ~const_val[slot_dst];
+        break;
+    case JIT_OP_SLOT_TO_BOOL_INV:
+        slot_dst = immed->slot_to_bool_inv.slot_no;
+        if (!const_known[slot_dst])
+            return false;
+        val = const_val[slot_dst] ? 0 : 1;
+        break;
+    case JIT_OP_SIGN_EXTEND_8:
+        slot_dst = immed->sign_extend_8.slot_no;
+        if (!const_known[slot_dst])
+            return false;
+        val = (int32_t)(int8_t)const_val[slot_dst];
+        break;
+    case JIT_OP_SIGN_EXTEND_16:
+        slot_dst = immed->sign_extend_16.slot_no;
+        if (!const_known[slot_dst])
+            return false;
+        val = (int32_t)(int16_t)const_val[slot_dst];
+        break;
+    case JIT_OP_SHLL:
+        slot_dst = immed->shll.slot_no;
+        if (!const_known[slot_dst] || immed->shll.shift_amt >= 32)
+            return false;
+        val = const_val[slot_dst] << immed->shll.shift_amt;
+        break;
+    case JIT_OP_SHLR:
+        slot_dst = immed->shlr.slot_no;
+        if (!const_known[slot_dst] || immed->shlr.shift_amt >= 32)
+            return false;
+        val = const_val[slot_dst] >> immed->shlr.shift_amt;
+        break;
+    case JIT_OP_SHAR:
+        slot_dst = immed->shar.slot_no;
+        if (!const_known[slot_dst] || immed->shar.shift_amt >= 32)
+            return false;
+        val = ((int32_t)const_val[slot_dst]) >> immed->shar.shift_amt;
+        break;
+    default:
+        return false;
+    }
+
+    const_prop_set_slot(inst, slot_dst, val);
+    return true;
+}
+
+static unsigned jit_optimize_const_prop(struct il_code_block *blk) {
+    unsigned n_rewritten = 0;
+    unsigned inst_no;
+
+    memset(const_known, 0, sizeof(const_known[0]) * blk->n_slots);
+
+    for (inst_no = 0; inst_no < blk->inst_count; inst_no++) {
+        struct jit_inst *inst = blk->inst_list + inst_no;
+
+        if (const_prop_fold(inst))
+            n_rewritten++;
+
+        if (inst->op == JIT_SET_SLOT) {
+            unsigned slot_no = inst->immed.set_slot.slot_idx;
+            const_known[slot_no] = true;
+            const_val[slot_no] = inst->immed.set_slot.new_val;
+        } else {
+            int write_slots[JIT_IL_MAX_WRITE_SLOTS];
+            unsigned idx;
+            jit_inst_get_write_slots(inst, write_slots);
+            for (idx = 0; idx < JIT_IL_MAX_WRITE_SLOTS; idx++)
+                if (write_slots[idx] != -1)
+                    const_known[write_slots[idx]] = false;
+        }
+    }
+
+    return n_rewritten;
+}
+
+/*
+ * returns true if the given instruction might read or write the guest
+ * registers (or anything else in host memory) other than through
+ * JIT_OP_LOAD_SLOT_OFFSET, JIT_OP_STORE_SLOT_OFFSET and their floating-point
+ * equivalents.
+ *
+ * Memory accesses count because they can end up in a memory-mapped register's
+ * handler, and there's no telling what that will do to the CPU.
+ */
+static bool inst_is_memory_barrier(struct jit_inst const *inst) {
+    switch (inst->op) {
+    case JIT_OP_FALLBACK:
+    case JIT_OP_JUMP:
+    case JIT_OP_EXIT_COND:
+    case JIT_OP_CALL_FUNC:
+    case JIT_OP_CALL_FUNC_IMM32:
+    case JIT_OP_CALL_FUNC_2:
+    case JIT_OP_READ_16_CONSTADDR:
+    case JIT_OP_READ_32_CONSTADDR:
+    case JIT_OP_READ_8_SLOT:
+    case JIT_OP_READ_16_SLOT:
+    case JIT_OP_READ_32_SLOT:
+    case JIT_OP_READ_FLOAT_SLOT:
+    case JIT_OP_WRITE_8_SLOT:
+    case JIT_OP_WRITE_16_SLOT:
+    case JIT_OP_WRITE_32_SLOT:
+    case JIT_OP_WRITE_FLOAT_SLOT:
+    case JIT_OP_LOAD_SLOT16:
+    case JIT_OP_LOAD_SLOT:
+    case JIT_OP_LOAD_FLOAT_SLOT:
+    case JIT_OP_STORE_SLOT:
+    case JIT_OP_STORE_FLOAT_SLOT:
+    case JIT_OP_LOAD_FLOAT_SLOT_INDEXED:
+    case JIT_OP_DOT4_FLOAT:
+    case JIT_OP_XFORM4_FLOAT:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/*
+ * redundant load elimination.
+ *
+ * This tracks which slot currently holds the value of each guest register
+ * (that is, each base slot + index accessed via JIT_OP_LOAD_SLOT_OFFSET or
+ * JIT_OP_STORE_SLOT_OFFSET and their float equivalents).  A load from a
+ * register whose value is already in a slot becomes a move, a store of a
+ * value the register already holds is removed, and a store which is
+ * overwritten by another store before anything could have seen it is also
+ * removed.
+ *
+ * The tracking is reset at every instruction which might touch the guest
+ * registers some other way (see inst_is_memory_barrier).
+ */
+#define REG_CACHE_LEN 64
+
+static struct reg_cache_ent {
+    unsigned slot_base, index;
+    unsigned slot_val;
+    bool is_float;
+
+    /*
+     * index of the store instruction which put slot_val in the register, or
+     * -1 if that store may have been observed (or if there was no store).
+     */
+    int store_inst;
+} reg_cache[REG_CACHE_LEN];
+static unsigned reg_cache_len;
+
+static struct reg_cache_ent *reg_cache_find(unsigned slot_base, unsigned index) {
+    unsigned idx;
+    for (idx = 0; idx < reg_cache_len; idx++)
+        if (reg_cache[idx].slot_base == slot_base &&
+            reg_cache[idx].index == index)
+            return reg_cache + idx;
+    return NULL;
+}
+
+static void reg_cache_remove(struct reg_cache_ent *ent) {
+    *ent = reg_cache[--reg_cache_len];
+}
+
+static void
+reg_cache_put(unsigned slot_base, unsigned index, unsigned slot_val,
+              bool is_float, int store_inst) {
+    struct reg_cache_ent *ent = reg_cache_find(slot_base, index);
+    if (!ent) {
+        if (reg_cache_len >= REG_CACHE_LEN)
+            return;
+        ent = reg_cache + reg_cache_len++;
+    }
+    ent->slot_base = slot_base;
+    ent->index = index;
+    ent->slot_val = slot_val;
+    ent->is_float = is_float;
+    ent->store_inst = store_inst;
+}
+
+// forget about any cached registers which are in (or based on) the given slot
+static void reg_cache_invalidate_slot(unsigned slot_no) {
+    unsigned idx = 0;
+    while (idx < reg_cache_len) {
+        if (reg_cache[idx].slot_val == slot_no ||
+            reg_cache[idx].slot_base == slot_no)
+            reg_cache_remove(reg_cache + idx);
+        else
+            idx++;
+    }
+}
+
+static unsigned jit_optimize_redundant_load(struct il_code_block *blk) {
+    unsigned n_rewritten = 0;
+    unsigned inst_no;
+    bool any_strikes = false;
+
+    if (!blk->inst_count)
+        return 0;
+
+    // instructions which will be removed after the scan is finished
+    bool *strike_list = (bool*)calloc(blk->inst_count, sizeof(bool));
+    if (!strike_list)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    reg_cache_len = 0;
+
+    for (inst_no = 0; inst_no < blk->inst_count; inst_no++) {
+        struct jit_inst *inst = blk->inst_list + inst_no;
+        union jit_immed *immed = &inst->immed;
+        struct reg_cache_ent *ent;
+        unsigned slot_base, index, slot_val;
+        bool is_float;
+
+        if (inst_is_memory_barrier(inst)) {
+            reg_cache_len = 0;
+            continue;
+        }
+
+        switch (inst->op) {
+        case JIT_OP_LOAD_SLOT_OFFSET:
+        case JIT_OP_LOAD_FLOAT_SLOT_OFFSET:
+            is_float = inst->op == JIT_OP_LOAD_FLOAT_SLOT_OFFSET;
+            if (is_float) {
+                slot_base = immed->load_float_slot_offset.slot_base;
+                index = immed->load_float_slot_offset.index;
+                slot_val = immed->load_float_slot_offset.slot_dst;
+            } else {
+                slot_base = immed->load_slot_offset.slot_base;
+                index = immed->load_slot_offset.index;
+                slot_val = immed->load_slot_offset.slot_dst;
+            }
+
+            reg_cache_invalidate_slot(slot_val);
+            ent = reg_cache_find(slot_base, index);
+            if (ent && ent->is_float == is_float) {
+                // the value is already in a slot
+                if (is_float) {
+                    inst->op = JIT_OP_MOV_FLOAT;
+                    immed->mov_float.slot_src = ent->slot_val;
+                    immed->mov_float.slot_dst = slot_val;
+                } else {
+                    inst->op = JIT_OP_MOV;
+                    immed->mov.slot_src = ent->slot_val;
+                    immed->mov.slot_dst = slot_val;
+                }
+                n_rewritten++;
+            } else {
+                reg_cache_put(slot_base, index, slot_val, is_float, -1);
+            }
+            break;
+        case JIT_OP_STORE_SLOT_OFFSET:
+        case JIT_OP_STORE_FLOAT_SLOT_OFFSET:
+            is_float = inst->op == JIT_OP_STORE_FLOAT_SLOT_OFFSET;
+            if (is_float) {
+                slot_base = immed->store_float_slot_offset.slot_base;
+                index = immed->store_float_slot_offset.index;
+                slot_val = immed->store_float_slot_offset.slot_src;
+            } else {
+                slot_base = immed->store_slot_offset.slot_base;
+                index = immed->store_slot_offset.index;
+                slot_val = immed->store_slot_offset.slot_src;
+            }
+
+            ent = reg_cache_find(slot_base, index);
+            if (ent && ent->slot_val == slot_val && ent->is_float == is_float) {
+                // the register already holds this value
+                strike_list[inst_no] = true;
+                any_strikes = true;
+                break;
+            }
+            if (ent && ent->store_inst >= 0) {
+                // nothing saw the last store to this register
+                strike_list[ent->store_inst] = true;
+                any_strikes = true;
+            }
+            reg_cache_put(slot_base, index, slot_val, is_float, inst_no);
+            break;
+        default:
+            {
+                int write_slots[JIT_IL_MAX_WRITE_SLOTS];
+                unsigned idx;
+                jit_inst_get_write_slots(inst, write_slots);
+                for (idx = 0; idx < JIT_IL_MAX_WRITE_SLOTS; idx++)
+                    if (write_slots[idx] != -1)
+                        reg_cache_invalidate_slot(write_slots[idx]);
+            }
+        }
+    }
+
+    if (any_strikes) {
+        inst_no = blk->inst_count;
+        while (inst_no--)
+            if (strike_list[inst_no])
+                il_code_block_strike_inst(blk, inst_no);
+    }
+
+    free(strike_list);
+
+    return n_rewritten;
+}
+
+/*
+ * copy propagation.
+ *
+ * After a JIT_OP_MOV or JIT_OP_MOV_FLOAT, the destination slot is a copy of
+ * the source slot until either of them gets written to.  Until then, any
+ * instruction which only reads from the destination can read from the source
+ * instead.  This frequently makes the move itself dead, in which case
+ * jit_optimize_dead_write will remove it.
+ */
+#define COPY_LIST_LEN 32
+
+static struct slot_copy {
+    unsigned slot_src, slot_dst;
+} copy_list[COPY_LIST_LEN];
+static unsigned copy_list_len;
+
+/*
+ * point the given field at slot_new if it currently points to slot_old.
+ * returns true if the field was changed.
+ */
+static bool rename_field(unsigned *field, unsigned slot_old, unsigned slot_new) {
+    if (*field == slot_old) {
+        *field = slot_new;
+        return true;
+    }
+    return false;
+}
+
+/*
+ * replace slot_old with slot_new in every operand of the given instruction
+ * which is read from but not written to.  Operands which are both read and
+ * written (such as the slot_dst of JIT_OP_ADD) are left alone.
+ *
+ * returns true if the instruction was changed.
+ */
+static bool
+rename_read_slot(struct jit_inst *inst, unsigned slot_old, unsigned slot_new) {
+    union jit_immed *immed = &inst->immed;
+    bool ret = false;
+
+    /*
+     * if the instruction already references slot_new then leave it alone.
+     * Backends don't always expect the same slot to be passed in two
+     * different operands.
+     */
+    if (jit_inst_is_read_slot(inst, slot_new) ||
+        jit_inst_is_write_slot(inst, slot_new))
+        return false;
+
+    switch (inst->op) {
+    case JIT_OP_JUMP:
+        ret = rename_field(&immed->jump.jmp_addr_slot, slot_old, slot_new);
+        ret = rename_field(&immed->jump.jmp_hash_slot,
+                           slot_old, slot_new) || ret;
+        break;
+    case JIT_CSET:
+        ret = rename_field(&immed->cset.flag_slot, slot_old, slot_new);
+        break;
+    case JIT_OP_EXIT_COND:
+        ret = rename_field(&immed->exit_cond.flag_slot, slot_old, slot_new);
+        break;
+    case JIT_OP_CALL_FUNC:
+        ret = rename_field(&immed->call_func.slot_no, slot_old, slot_new);
+        break;
+    case JIT_OP_CALL_FUNC_2:
+        ret = rename_field(&immed->call_func_2.slot_arg0, slot_old, slot_new);
+        ret = rename_field(&immed->call_func_2.slot_arg1,
+                           slot_old, slot_new) || ret;
+        break;
+    case JIT_OP_READ_8_SLOT:
+        ret = rename_field(&immed->read_8_slot.addr_slot, slot_old, slot_new);
+        break;
+    case JIT_OP_READ_16_SLOT:
+        ret = rename_field(&immed->read_16_slot.addr_slot, slot_old, slot_new);
+        break;
+    case JIT_OP_READ_32_SLOT:
+        ret = rename_field(&immed->read_32_slot.addr_slot, slot_old, slot_new);
+        break;
+    case JIT_OP_READ_FLOAT_SLOT:
+        ret = rename_field(&immed->read_float_slot.addr_slot,
+                           slot_old, slot_new);
+        break;
+    case JIT_OP_WRITE_8_SLOT:
+        ret = rename_field(&immed->write_8_slot.src_slot, slot_old, slot_new);
+        ret = rename_field(&immed->write_8_slot.addr_slot,
+                           slot_old, slot_new) || ret;
+        break;
+    case JIT_OP_WRITE_16_SLOT:
+        ret = rename_field(&immed->write_16_slot.src_slot, slot_old, slot_new);
+        ret = rename_field(&immed->write_16_slot.addr_slot,
+                           slot_old, slot_new) || ret;
+        break;
+    case JIT_OP_WRITE_32_SLOT:
+        ret = rename_field(&immed->write_32_slot.src_slot, slot_old, slot_new);
+        ret = rename_field(&immed->write_32_slot.addr_slot,
+                           slot_old, slot_new) || ret;
+        break;
+    case JIT_OP_WRITE_FLOAT_SLOT:
+        ret = rename_field(&immed->write_float_slot.src_slot,
+                           slot_old, slot_new);
+        ret = rename_field(&immed->write_float_slot.addr_slot,
+                           slot_old, slot_new) || ret;
+        break;
+    case JIT_OP_STORE_SLOT:
+        ret = rename_field(&immed->store_slot.slot_no, slot_old, slot_new);
+        break;
+    case JIT_OP_STORE_SLOT_OFFSET:
+        ret = rename_field(&immed->store_slot_offset.slot_src,
+                           slot_old, slot_new);
+        break;
+    case JIT_OP_STORE_FLOAT_SLOT:
+        ret = rename_field(&immed->store_float_slot.slot_no,
+                           slot_old, slot_new);
+        break;
+    case JIT_OP_STORE_FLOAT_SLOT_OFFSET:
+        ret = rename_field(&immed->store_float_slot_offset.slot_src,
+                           slot_old, slot_new);
+        break;
+    case JIT_OP_ADD:
+        ret = rename_field(&immed->add.slot_src, slot_old, slot_new);
+        break;
+    case JIT_OP_SUB:
+        ret = rename_field(&immed->sub.slot_src, slot_old, slot_new);
+        break;
+    case JIT_OP_ADD_CARRY:
+        ret = rename_field(&immed->add_carry.slot_src, slot_old, slot_new);
+        break;
+    case JIT_OP_SUB_CARRY:
+        ret = rename_field(&immed->sub_carry.slot_src, slot_old, slot_new);
+        break;
+    case JIT_OP_SUB_FLOAT:
+        ret = rename_field(&immed->sub_float.slot_src, slot_old, slot_new);
+        break;
+    case JIT_OP_ADD_FLOAT:
+        ret = rename_field(&immed->add_float.slot_src, slot_old, slot_new);
+        break;
+    case JIT_OP_XOR:
+        ret = rename_field(&immed->xor.slot_src, slot_old, slot_new);
+        break;
+    case JIT_OP_MOV:
+        ret = rename_field(&immed->mov.slot_src, slot_old, slot_new);
+        break;
+    case JIT_OP_MOV_FLOAT:
+        ret = rename_field(&immed->mov_float.slot_src, slot_old, slot_new);
+        break;
+    case JIT_OP_AND:
+        ret = rename_field(&immed->and.slot_src, slot_old, slot_new);
+        break;
+    case JIT_OP_OR:
+        ret = rename_field(&immed->or.slot_src, slot_old, slot_new);
+        break;
+    case JIT_OP_SHAD:
+        ret = rename_field(&immed->shad.slot_shift_amt, slot_old, slot_new);
+        break;
+    case JIT_OP_SET_GT_UNSIGNED:
+        ret = rename_field(&immed->set_gt_unsigned.slot_lhs,
+                           slot_old, slot_new);
+        ret = rename_field(&immed->set_gt_unsigned.slot_rhs,
+                           slot_old, slot_new) || ret;
+        break;
+    case JIT_OP_SET_GT_SIGNED:
+        ret = rename_field(&immed->set_gt_signed.slot_lhs, slot_old, slot_new);
+        ret = rename_field(&immed->set_gt_signed.slot_rhs,
+                           slot_old, slot_new) || ret;
+        break;
+    case JIT_OP_SET_GT_SIGNED_CONST:
+        ret = rename_field(&immed->set_gt_signed_const.slot_lhs,
+                           slot_old, slot_new);
+        break;
+    case JIT_OP_SET_EQ:
+        ret = rename_field(&immed->set_eq.slot_lhs, slot_old, slot_new);
+        ret = rename_field(&immed->set_eq.slot_rhs, slot_old, slot_new) || ret;
+        break;
+    case JIT_OP_SET_GE_UNSIGNED:
+        ret = rename_field(&immed->set_ge_unsigned.slot_lhs,
+                           slot_old, slot_new);
+        ret = rename_field(&immed->set_ge_unsigned.slot_rhs,
+                           slot_old, slot_new) || ret;
+        break;
+    case JIT_OP_SET_GE_SIGNED:
+        ret = rename_field(&immed->set_ge_signed.slot_lhs, slot_old, slot_new);
+        ret = rename_field(&immed->set_ge_signed.slot_rhs,
+                           slot_old, slot_new) || ret;
+        break;
+    case JIT_OP_SET_GE_SIGNED_CONST:
+        ret = rename_field(&immed->set_ge_signed_const.slot_lhs,
+                           slot_old, slot_new);
+        break;
+    case JIT_OP_SET_GT_FLOAT:
+        ret = rename_field(&immed->set_gt_float.slot_lhs, slot_old, slot_new);
+        ret = rename_field(&immed->set_gt_float.slot_rhs,
+                           slot_old, slot_new) || ret;
+        break;
+    case JIT_OP_MUL_U32:
+        ret = rename_field(&immed->mul_u32.slot_lhs, slot_old, slot_new);
+        ret = rename_field(&immed->mul_u32.slot_rhs, slot_old, slot_new) || ret;
+        break;
+    case JIT_OP_MUL_U64:
+        ret = rename_field(&immed->mul_u64.slot_lhs, slot_old, slot_new);
+        ret = rename_field(&immed->mul_u64.slot_rhs, slot_old, slot_new) || ret;
+        break;
+    case JIT_OP_MUL_S64:
+        ret = rename_field(&immed->mul_s64.slot_lhs, slot_old, slot_new);
+        ret = rename_field(&immed->mul_s64.slot_rhs, slot_old, slot_new) || ret;
+        break;
+    case JIT_OP_MUL_FLOAT:
+        ret = rename_field(&immed->mul_float.slot_lhs, slot_old, slot_new);
+        break;
+    case JIT_OP_DIV_FLOAT:
+        ret = rename_field(&immed->div_float.slot_src, slot_old, slot_new);
+        break;
+    case JIT_OP_LOAD_FLOAT_SLOT_INDEXED:
+        ret = rename_field(&immed->load_float_slot_indexed.slot_index,
+                           slot_old, slot_new);
+        break;
+    default:
+        break;
+    }
+
+    return ret;
+}
+
+static unsigned jit_optimize_copy_prop(struct il_code_block *blk) {
+    unsigned n_rewritten = 0;
+    unsigned inst_no;
+
+    copy_list_len = 0;
+
+    for (inst_no = 0; inst_no < blk->inst_count; inst_no++) {
+        struct jit_inst *inst = blk->inst_list + inst_no;
+        int write_slots[JIT_IL_MAX_WRITE_SLOTS];
+        unsigned idx;
+        bool renamed = false;
+
+        for (idx = 0; idx < copy_list_len; idx++) {
+            if (rename_read_slot(inst, copy_list[idx].slot_dst,
+                                 copy_list[idx].slot_src))
+                renamed = true;
+        }
+        if (renamed)
+            n_rewritten++;
+
+        // any copy whose source or destination gets overwritten is invalid
+        jit_inst_get_write_slots(inst, write_slots);
+        for (idx = 0; idx < JIT_IL_MAX_WRITE_SLOTS; idx++) {
+            unsigned copy_idx = 0;
+            if (write_slots[idx] == -1)
+                continue;
+            while (copy_idx < copy_list_len) {
+                if (copy_list[copy_idx].slot_src == write_slots[idx] ||
+                    copy_list[copy_idx].slot_dst == write_slots[idx])
+                    copy_list[copy_idx] = copy_list[--copy_list_len];
+                else
+                    copy_idx++;
+            }
+        }
+
+        if (copy_list_len < COPY_LIST_LEN) {
+            if (inst->op == JIT_OP_MOV &&
+                inst->immed.mov.slot_src != inst->immed.mov.slot_dst) {
+                copy_list[copy_list_len].slot_src = inst->immed.mov.slot_src;
+                copy_list[copy_list_len].slot_dst = inst->immed.mov.slot_dst;
+                copy_list_len++;
+            } else if (inst->op == JIT_OP_MOV_FLOAT &&
+                       inst->immed.mov_float.slot_src !=
+                       inst->immed.mov_float.slot_dst) {
+                copy_list[copy_list_len].slot_src =
+                    inst->immed.mov_float.slot_src;
+                copy_list[copy_list_len].slot_dst =
+                    inst->immed.mov_float.slot_dst;
+                copy_list_len++;
+            }
+        }
+    }
+
+    return n_rewritten;
 }
 
 // remove IL instructions which write to a slot which is not later read from
-static void jit_optimize_dead_write(struct il_code_block *blk) {
+static unsigned jit_optimize_dead_write(struct il_code_block *blk) {
     unsigned src_inst = 0;
     while (src_inst < blk->inst_count) {
         struct jit_inst *inst = blk->inst_list + src_inst;
@@ -86,6 +924,7 @@ static void jit_optimize_dead_write(struct il_code_block *blk) {
         else
             src_inst++;
     }
+    return 0;
 }
 
 static bool
@@ -23,6 +23,20 @@
 #ifndef OPTIMIZE_H_
 #define OPTIMIZE_H_
 
+#ifdef JIT_PROFILE
+#include "washdc/hostfile.h"
+#endif
+
+struct il_code_block;
+
 void jit_optimize(struct il_code_block *blk);
 
+#ifdef JIT_PROFILE
+/*
+ * print the number of IL instructions each optimization pass has removed and
+ * rewritten since startup.
+ */
+void jit_optimize_print_stats(washdc_hostfile out);
+#endif
+
 #endif
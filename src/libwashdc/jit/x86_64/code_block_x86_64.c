@@ -28,11 +28,14 @@
 #include <errno.h>
 #include <limits.h>
 #include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "log.h"
 #include "washdc/error.h"
 #include "jit/code_block.h"
 #include "jit/jit_il.h"
+#include "jit/jit_block_prof.h"
 #include "exec_mem.h"
 #include "dreamcast.h"
 #include "native_dispatch.h"
@@ -47,6 +50,10 @@
 #include "emit_x86_64.h"
 #include "code_block_x86_64.h"
 
+#ifdef ENABLE_FASTMEM
+#include "fastmem.h"
+#endif
+
 #define N_REGS 16
 #define N_XMM_REGS 16
 
@@ -324,8 +331,31 @@ struct slot {
     // if true, reg_no is valid and the slot resides in an x86 register
     // if false, rbp_offs is valid and the slot resides on the call-stack
     bool in_reg;
+
+    /*
+     * if true, this slot holds pinned_base so loads and stores through it
+     * need to go to the pinned registers instead of memory.
+     */
+    bool guest_base;
 } slots[MAX_SLOTS];
 
+/*
+ * guest registers which live in host registers for as long as native code is
+ * running (see jit_x86_64_pin_regs).  The host registers are all preserved
+ * across function calls so that they only need to be written back when
+ * something outside of native code might look at them.
+ */
+static uint32_t *pinned_base;
+static struct pinned_reg {
+    unsigned guest_idx;
+    unsigned host_reg;
+} pinned_regs[JIT_X86_64_MAX_PINNED_REGS];
+static unsigned n_pinned_regs;
+
+static unsigned const pinned_host_regs[JIT_X86_64_MAX_PINNED_REGS] = {
+    R12, R13, R15
+};
+
 /*
  * offset of the next push onto the stack.
  *
@@ -337,6 +367,17 @@ struct slot {
  */
 static int rsp_offs; // offset from base pointer to stack pointer
 
+/*
+ * JIT_OP_EXIT_COND instructions in the block currently being compiled.  Their
+ * conditional jumps get pointed at the exit stubs once the rest of the block
+ * has been emitted.
+ */
+static struct pending_side_exit {
+    int32_t *jmp_rel;
+    struct exit_cond_immed const *immed;
+} side_exits[JIT_MAX_SIDE_EXITS];
+static unsigned n_side_exits;
+
 static void evict_register(struct code_block_x86_64 *blk,
                            struct register_state *reg_state, unsigned reg_no);
 
@@ -353,6 +394,9 @@ void jit_x86_64_backend_init(void) {
 }
 
 void jit_x86_64_backend_cleanup(void) {
+    pinned_base = NULL;
+    n_pinned_regs = 0;
+
     free(gen_reg_state.reg_slots);
     gen_reg_state.reg_slots = NULL;
     gen_reg_state.n_regs = 0;
@@ -364,6 +408,68 @@ void jit_x86_64_backend_cleanup(void) {
     register_set_cleanup(&xmm_reg_state.set);
 }
 
+void jit_x86_64_pin_regs(uint32_t *base, unsigned const *indices,
+                         unsigned n_regs) {
+    if (n_regs > JIT_X86_64_MAX_PINNED_REGS)
+        RAISE_ERROR(ERROR_TOO_BIG);
+
+    unsigned idx;
+    for (idx = 0; idx < n_regs; idx++) {
+        unsigned host_reg = pinned_host_regs[idx];
+        pinned_regs[idx].guest_idx = indices[idx];
+        pinned_regs[idx].host_reg = host_reg;
+
+        // the allocator must never hand these out
+        gen_reg_state.set.regs[host_reg].locked = true;
+    }
+
+    pinned_base = base;
+    n_pinned_regs = n_regs;
+}
+
+// returns the host register guest register idx is pinned to, or -1
+static int pinned_reg_find(unsigned idx) {
+    unsigned pin_no;
+    for (pin_no = 0; pin_no < n_pinned_regs; pin_no++)
+        if (pinned_regs[pin_no].guest_idx == idx)
+            return pinned_regs[pin_no].host_reg;
+    return -1;
+}
+
+void jit_x86_64_emit_pinned_store(unsigned reg_tmp) {
+    unsigned pin_no;
+
+    if (!n_pinned_regs)
+        return;
+
+    x86asm_mov_imm64_reg64((uintptr_t)pinned_base, reg_tmp);
+    for (pin_no = 0; pin_no < n_pinned_regs; pin_no++) {
+        int disp_bytes = 4 * pinned_regs[pin_no].guest_idx;
+        unsigned host_reg = pinned_regs[pin_no].host_reg;
+        if (disp_bytes <= 127)
+            x86asm_movl_reg_disp8_reg(host_reg, disp_bytes, reg_tmp);
+        else
+            x86asm_movl_reg_disp32_reg(host_reg, disp_bytes, reg_tmp);
+    }
+}
+
+void jit_x86_64_emit_pinned_load(unsigned reg_tmp) {
+    unsigned pin_no;
+
+    if (!n_pinned_regs)
+        return;
+
+    x86asm_mov_imm64_reg64((uintptr_t)pinned_base, reg_tmp);
+    for (pin_no = 0; pin_no < n_pinned_regs; pin_no++) {
+        int disp_bytes = 4 * pinned_regs[pin_no].guest_idx;
+        unsigned host_reg = pinned_regs[pin_no].host_reg;
+        if (disp_bytes <= 127)
+            x86asm_movl_disp8_reg_reg(disp_bytes, reg_tmp, host_reg);
+        else
+            x86asm_movl_disp32_reg_reg(disp_bytes, reg_tmp, host_reg);
+    }
+}
+
 static void reset_slots(void) {
     int reg_no;
 
@@ -398,6 +504,7 @@ static void discard_slot(struct code_block_x86_64 *blk, unsigned slot_no) {
         }
     }
     slot->in_use = false;
+    slot->guest_base = false;
     slot->reg_state = NULL;
 }
 
@@ -855,25 +962,84 @@ static void ungrab_slot(unsigned slot_no) {
 
 #define X86_64_ALLOC_SIZE 32
 
+/*
+ * executable memory doesn't get allocated until the block is compiled, so
+ * tier 0 blocks never use any and the compile thread's allocations all come
+ * from the compile thread.
+ */
 void code_block_x86_64_init(struct code_block_x86_64 *blk) {
-    void *native = exec_mem_alloc(X86_64_ALLOC_SIZE);
     blk->cycle_count = 0;
     blk->bytes_used = 0;
 
-    if (!native) {
-        error_set_errno_val(errno);
-        RAISE_ERROR(ERROR_FAILED_ALLOC);
-    }
+    blk->native = NULL;
+    blk->exec_mem_alloc_start = NULL;
+    blk->link_exit = NULL;
+    blk->side_exits = NULL;
+    blk->n_side_exits = 0;
 
-    blk->native = native;
-    blk->exec_mem_alloc_start = native;
+#ifdef ENABLE_FASTMEM
+    blk->fastmem_sites = NULL;
+    blk->n_fastmem_sites = blk->fastmem_sites_alloc = 0;
+    blk->fastmem_sites_registered = false;
+#endif
 }
 
 void code_block_x86_64_cleanup(struct code_block_x86_64 *blk) {
+#ifdef ENABLE_FASTMEM
+    fastmem_remove_sites(blk);
+#endif
+    native_dispatch_exit_free(blk->link_exit);
+
+    unsigned exit_no;
+    for (exit_no = 0; exit_no < blk->n_side_exits; exit_no++)
+        native_dispatch_exit_free(blk->side_exits[exit_no]);
+    free(blk->side_exits);
+
     exec_mem_free(blk->exec_mem_alloc_start);
     memset(blk, 0, sizeof(*blk));
 }
 
+/*
+ * figure out how many different addresses the block's final jump can go to.
+ * This only counts targets which are set with JIT_SET_SLOT or JIT_CSET, which
+ * is how the frontend implements static branches.  Dynamic branches (such as
+ * JMP, RTS or RTE) return 0.
+ */
+static unsigned count_static_jump_targets(struct il_code_block const *il_blk) {
+    int idx;
+    unsigned jmp_addr_slot, n_targets = 0;
+
+    for (idx = il_blk->inst_count - 1; idx >= 0; idx--)
+        if (il_blk->inst_list[idx].op == JIT_OP_JUMP)
+            break;
+    if (idx < 0)
+        return 0;
+
+    jmp_addr_slot = il_blk->inst_list[idx].immed.jump.jmp_addr_slot;
+
+    while (--idx >= 0) {
+        struct jit_inst const *inst = il_blk->inst_list + idx;
+        if (!jit_inst_is_write_slot(inst, jmp_addr_slot))
+            continue;
+
+        if (inst->op == JIT_CSET) {
+            n_targets++;
+        } else if (inst->op == JIT_SET_SLOT) {
+            n_targets++;
+            break;
+        } else {
+            return 0;
+        }
+    }
+
+    if (idx < 0)
+        return 0; // never initialized, this shouldn't happen
+
+    if (n_targets > NATIVE_DISPATCH_MAX_LINKS)
+        n_targets = NATIVE_DISPATCH_MAX_LINKS;
+    return n_targets;
+}
+
 #ifdef INVARIANTS
 WASHDC_NORETURN static void x86_64_misaligned_stack_error(void) {
     RAISE_ERROR(ERROR_INTEGRITY);
@@ -941,6 +1107,59 @@ static void emit_stack_frame_close(void) {
     x86asm_popq_reg64(RBP);
 }
 
+/*
+ * charge the time since the last block was entered to that block and start
+ * charging time to this one (see jit_block_prof_switch).  This runs before
+ * anything else in the block, so nothing is in a register yet except for
+ * what native_dispatch passed in.
+ */
+static void emit_block_prof(struct jit_block_prof *prof, unsigned cycle_count) {
+    struct jit_block_prof_state *state = &jit_block_prof_state;
+
+    x86asm_pushq_reg64(RAX);
+    x86asm_pushq_reg64(RCX);
+    x86asm_pushq_reg64(RDX);
+
+    // %rax = now
+    x86asm_rdtsc();
+    x86asm_shlq_imm8_reg64(32, RDX);
+    x86asm_or_reg64_reg64(RDX, RAX);
+
+    // %rax = now - state->last_tick, and state->last_tick = now
+    x86asm_mov_imm64_reg64((uintptr_t)&state->last_tick, RCX);
+    x86asm_movq_indreg_reg(RCX, RDX);
+    x86asm_movq_reg64_indreg64(RAX, RCX);
+    x86asm_subq_reg64_reg64(RDX, RAX);
+
+    // state->cur->ticks += %rax
+    x86asm_mov_imm64_reg64((uintptr_t)&state->cur, RCX);
+    x86asm_movq_indreg_reg(RCX, RCX);
+    x86asm_movq_indreg_reg(RCX, RDX);
+    x86asm_addq_reg64_reg64(RAX, RDX);
+    x86asm_movq_reg64_indreg64(RDX, RCX);
+
+    // state->cur = prof
+    x86asm_mov_imm64_reg64((uintptr_t)prof, RAX);
+    x86asm_mov_imm64_reg64((uintptr_t)&state->cur, RCX);
+    x86asm_movq_reg64_indreg64(RAX, RCX);
+
+    // prof->hits++
+    x86asm_mov_imm64_reg64((uintptr_t)&prof->hits, RCX);
+    x86asm_movq_indreg_reg(RCX, RDX);
+    x86asm_addq_imm8_reg(1, RDX);
+    x86asm_movq_reg64_indreg64(RDX, RCX);
+
+    // prof->guest_cycles += cycle_count
+    x86asm_mov_imm64_reg64((uintptr_t)&prof->guest_cycles, RCX);
+    x86asm_movq_indreg_reg(RCX, RDX);
+    x86asm_addq_imm32_reg64(cycle_count, RDX);
+    x86asm_movq_reg64_indreg64(RDX, RCX);
+
+    x86asm_popq_reg64(RDX);
+    x86asm_popq_reg64(RCX);
+    x86asm_popq_reg64(RAX);
+}
+
 // JIT_OP_FALLBACK implementation
 static void emit_fallback(struct code_block_x86_64 *blk,
                           struct il_code_block const *il_blk,
@@ -952,11 +1171,15 @@ static void emit_fallback(struct code_block_x86_64 *blk,
     x86asm_mov_imm64_reg64((uint64_t)(uintptr_t)cpu, REG_ARG0);
     x86asm_mov_imm32_reg32(inst_bin, REG_ARG1);
 
+    jit_x86_64_emit_pinned_store(REG_RET);
+
     ms_shadow_open(blk);
     x86_64_align_stack(blk);
     x86asm_call_ptr(inst->immed.fallback.fallback_fn);
     ms_shadow_close();
 
+    jit_x86_64_emit_pinned_load(REG_VOL0);
+
     postfunc();
     ungrab_register(&gen_reg_state.set, REG_RET);
 }
@@ -1005,6 +1228,77 @@ static void emit_cset(struct code_block_x86_64 *blk,
     x86asm_lbl8_cleanup(&lbl);
 }
 
+// JIT_OP_EXIT_COND implementation
+static void emit_exit_cond(struct code_block_x86_64 *blk,
+                           struct il_code_block const *il_blk,
+                           void *cpu, struct jit_inst const *inst) {
+    unsigned flag_slot = inst->immed.exit_cond.flag_slot;
+
+    if (n_side_exits >= JIT_MAX_SIDE_EXITS)
+        RAISE_ERROR(ERROR_TOO_BIG);
+
+    grab_slot(blk, il_blk, inst, &gen_reg_state, flag_slot, 4);
+
+    x86asm_testb_imm8_reg8(1, slots[flag_slot].reg_no);
+    if (inst->immed.exit_cond.t_flag)
+        x86asm_jnz_disp32(0);
+    else
+        x86asm_jz_disp32(0);
+
+    struct pending_side_exit *side_exit = side_exits + n_side_exits++;
+    side_exit->jmp_rel = (int32_t*)((uint8_t*)x86asm_get_out_ptr() - 4);
+    side_exit->immed = &inst->immed.exit_cond;
+
+    ungrab_slot(flag_slot);
+}
+
+/*
+ * emit the code each side exit jumps to.  By the time this is called, the
+ * block's final exit has already been emitted and out->native and
+ * out->dirty_stack are both final.
+ *
+ * Every guest register was written back before the exit was taken, so none of
+ * the slots matter anymore.
+ */
+static void
+emit_side_exit_stubs(struct code_block_x86_64 *out,
+                     struct native_dispatch_meta const *dispatch_meta) {
+    unsigned exit_no;
+
+    if (!n_side_exits)
+        return;
+
+    out->side_exits = (struct native_dispatch_exit**)
+        calloc(n_side_exits, sizeof(struct native_dispatch_exit*));
+    if (!out->side_exits)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    out->n_side_exits = n_side_exits;
+
+    for (exit_no = 0; exit_no < n_side_exits; exit_no++) {
+        struct pending_side_exit const *side_exit = side_exits + exit_no;
+        struct exit_cond_immed const *immed = side_exit->immed;
+        uint8_t *stub = (uint8_t*)x86asm_get_out_ptr();
+
+        *(int32_t*)exec_mem_rw(side_exit->jmp_rel) =
+            stub - ((uint8_t*)side_exit->jmp_rel + 4);
+
+        x86asm_mov_imm32_reg32(immed->jmp_addr, NATIVE_DISPATCH_PC_REG);
+        x86asm_mov_imm32_reg32(immed->jmp_hash, NATIVE_DISPATCH_HASH_REG);
+        x86asm_mov_imm32_reg32(immed->cycle_count,
+                               NATIVE_DISPATCH_CYCLE_COUNT_REG);
+
+        if (out->dirty_stack)
+            emit_stack_frame_close();
+
+        if (immed->loop) {
+            native_check_cycles_emit_jmp(dispatch_meta, out->native);
+        } else {
+            out->side_exits[exit_no] =
+                native_check_cycles_emit(dispatch_meta, 1);
+        }
+    }
+}
+
 // JIT_SET_SLOT implementation
 static void emit_set_slot(struct code_block_x86_64 *blk,
                           struct il_code_block const *il_blk,
@@ -1027,6 +1321,9 @@ static void emit_set_slot_host_ptr(struct code_block_x86_64 *blk,
     grab_slot(blk, il_blk, inst, &gen_reg_state, slot_idx, 8);
     x86asm_mov_imm64_reg64(new_val, slots[slot_idx].reg_no);
     ungrab_slot(slot_idx);
+
+    slots[slot_idx].guest_base =
+        n_pinned_regs && new_val == (uintptr_t)pinned_base;
 }
 
 // JIT_OP_CALL_FUNC implementation
@@ -1041,11 +1338,15 @@ static void emit_call_func(struct code_block_x86_64 *blk,
 
     evict_register(blk, &gen_reg_state, REG_ARG1); // TODO: is this necessary ?
 
+    jit_x86_64_emit_pinned_store(REG_RET);
+
     ms_shadow_open(blk);
     x86_64_align_stack(blk);
     x86asm_call_ptr(inst->immed.call_func.func);
     ms_shadow_close();
 
+    jit_x86_64_emit_pinned_load(REG_VOL0);
+
     postfunc();
     ungrab_register(&gen_reg_state.set, REG_RET);
 }
@@ -1059,11 +1360,40 @@ static void emit_call_func_imm32(struct code_block_x86_64 *blk,
     x86asm_mov_imm64_reg64((uint64_t)(uintptr_t)cpu, REG_ARG0);
     x86asm_mov_imm32_reg32(inst->immed.call_func_imm32.imm32, REG_ARG1);
 
+    jit_x86_64_emit_pinned_store(REG_RET);
+
     ms_shadow_open(blk);
     x86_64_align_stack(blk);
     x86asm_call_ptr(inst->immed.call_func.func);
     ms_shadow_close();
 
+    jit_x86_64_emit_pinned_load(REG_VOL0);
+
+    postfunc();
+    ungrab_register(&gen_reg_state.set, REG_RET);
+}
+
+// JIT_OP_CALL_FUNC_2 implementation
+static void emit_call_func_2(struct code_block_x86_64 *blk,
+                             struct il_code_block const *il_blk,
+                             void *cpu, struct jit_inst const *inst) {
+    prefunc(blk);
+
+    x86asm_mov_imm64_reg64((uint64_t)(uintptr_t)cpu, REG_ARG0);
+    move_slot_to_reg(blk, inst->immed.call_func_2.slot_arg0, REG_ARG1);
+    evict_register(blk, &gen_reg_state, REG_ARG1);
+    move_slot_to_reg(blk, inst->immed.call_func_2.slot_arg1, REG_ARG2);
+    evict_register(blk, &gen_reg_state, REG_ARG2);
+
+    jit_x86_64_emit_pinned_store(REG_RET);
+
+    ms_shadow_open(blk);
+    x86_64_align_stack(blk);
+    x86asm_call_ptr(inst->immed.call_func_2.func);
+    ms_shadow_close();
+
+    jit_x86_64_emit_pinned_load(REG_VOL0);
+
     postfunc();
     ungrab_register(&gen_reg_state.set, REG_RET);
 }
@@ -1476,6 +1806,19 @@ static void emit_load_slot_offset(struct code_block_x86_64 *blk,
     unsigned slot_base = inst->immed.load_slot_offset.slot_base;
     unsigned slot_dst = inst->immed.load_slot_offset.slot_dst;
     unsigned index = inst->immed.load_slot_offset.index;
+    int reg_pinned = slots[slot_base].guest_base ? pinned_reg_find(index) : -1;
+
+    if (reg_pinned >= 0) {
+        if (slot_base == slot_dst) {
+            grab_slot(blk, il_blk, inst, &gen_reg_state, slot_dst, 8);
+            slots[slot_dst].n_bytes = 4;
+        } else {
+            grab_slot(blk, il_blk, inst, &gen_reg_state, slot_dst, 4);
+        }
+        x86asm_mov_reg32_reg32(reg_pinned, slots[slot_dst].reg_no);
+        ungrab_slot(slot_dst);
+        return;
+    }
 
     grab_slot(blk, il_blk, inst, &gen_reg_state, slot_base, 8);
     if (slot_base != slot_dst)
@@ -1523,6 +1866,15 @@ emit_store_slot_offset(struct code_block_x86_64 *blk,
     unsigned slot_base = inst->immed.store_slot_offset.slot_base;
     unsigned slot_src = inst->immed.store_slot_offset.slot_src;
     unsigned index = inst->immed.store_slot_offset.index;
+    int reg_pinned = slots[slot_base].guest_base ? pinned_reg_find(index) : -1;
+
+    if (reg_pinned >= 0) {
+        grab_slot(blk, il_blk, inst, &gen_reg_state, slot_src,
+                  slot_src == slot_base ? 8 : 4);
+        x86asm_mov_reg32_reg32(slots[slot_src].reg_no, reg_pinned);
+        ungrab_slot(slot_src);
+        return;
+    }
 
     grab_slot(blk, il_blk, inst, &gen_reg_state, slot_base, 8);
     if (slot_base != slot_src)
@@ -1578,6 +1930,43 @@ emit_sub(struct code_block_x86_64 *blk,
     ungrab_slot(slot_src);
 }
 
+/*
+ * JIT_OP_ADD_CARRY and JIT_OP_SUB_CARRY implementation.
+ *
+ * The lowest bit of the carry slot gets shifted into CF, then the ADC/SBB
+ * result goes back into the carry slot.  The MOV which clears the carry slot
+ * does not touch the flags.
+ */
+static void
+emit_add_sub_carry(struct code_block_x86_64 *blk,
+                   struct il_code_block const *il_blk,
+                   void *cpu, struct jit_inst const *inst,
+                   struct add_carry_immed const *immed, bool sub) {
+    unsigned slot_src = immed->slot_src;
+    unsigned slot_dst = immed->slot_dst;
+    unsigned slot_carry = immed->slot_carry;
+
+    grab_slot(blk, il_blk, inst, &gen_reg_state, slot_src, 4);
+    if (slot_src != slot_dst)
+        grab_slot(blk, il_blk, inst, &gen_reg_state, slot_dst, 4);
+    grab_slot(blk, il_blk, inst, &gen_reg_state, slot_carry, 4);
+
+    unsigned reg_carry = slots[slot_carry].reg_no;
+
+    x86asm_shrl_imm8_reg32(1, reg_carry);
+    if (sub)
+        x86asm_sbbl_reg32_reg32(slots[slot_src].reg_no, slots[slot_dst].reg_no);
+    else
+        x86asm_adcl_reg32_reg32(slots[slot_src].reg_no, slots[slot_dst].reg_no);
+    x86asm_mov_imm32_reg32(0, reg_carry);
+    x86asm_setc_reg8(reg_carry);
+
+    ungrab_slot(slot_carry);
+    if (slot_src != slot_dst)
+        ungrab_slot(slot_dst);
+    ungrab_slot(slot_src);
+}
+
 static void
 emit_add_const32(struct code_block_x86_64 *blk,
                  struct il_code_block const *il_blk,
@@ -2067,6 +2456,44 @@ static void emit_mul_u32(struct code_block_x86_64 *blk,
     ungrab_register(&gen_reg_state.set, REG_RET);
 }
 
+// JIT_OP_MUL_U64 and JIT_OP_MUL_S64 implementation
+static void emit_mul_64(struct code_block_x86_64 *blk,
+                        struct il_code_block const *il_blk,
+                        void *cpu, struct jit_inst const *inst,
+                        struct mul_64_immed const *immed, bool is_signed) {
+    unsigned slot_lhs = immed->slot_lhs;
+    unsigned slot_rhs = immed->slot_rhs;
+    unsigned slot_dst_lo = immed->slot_dst_lo;
+    unsigned slot_dst_hi = immed->slot_dst_hi;
+
+    evict_register(blk, &gen_reg_state, REG_RET);
+    grab_register(&gen_reg_state.set, REG_RET);
+    evict_register(blk, &gen_reg_state, EDX);
+    grab_register(&gen_reg_state.set, EDX);
+
+    grab_slot(blk, il_blk, inst, &gen_reg_state, slot_lhs, 4);
+    if (slot_rhs != slot_lhs)
+        grab_slot(blk, il_blk, inst, &gen_reg_state, slot_rhs, 4);
+    grab_slot(blk, il_blk, inst, &gen_reg_state, slot_dst_lo, 4);
+    grab_slot(blk, il_blk, inst, &gen_reg_state, slot_dst_hi, 4);
+
+    x86asm_mov_reg32_reg32(slots[slot_lhs].reg_no, REG_RET);
+    if (is_signed)
+        x86asm_imull_reg32(slots[slot_rhs].reg_no);
+    else
+        x86asm_mull_reg32(slots[slot_rhs].reg_no);
+    x86asm_mov_reg32_reg32(REG_RET, slots[slot_dst_lo].reg_no);
+    x86asm_mov_reg32_reg32(EDX, slots[slot_dst_hi].reg_no);
+
+    ungrab_slot(slot_dst_hi);
+    ungrab_slot(slot_dst_lo);
+    if (slot_rhs != slot_lhs)
+        ungrab_slot(slot_rhs);
+    ungrab_slot(slot_lhs);
+    ungrab_register(&gen_reg_state.set, EDX);
+    ungrab_register(&gen_reg_state.set, REG_RET);
+}
+
 static void emit_mul_float(struct code_block_x86_64 *blk,
                            struct il_code_block const *il_blk,
                            void *cpu, struct jit_inst const *inst) {
@@ -2227,6 +2654,10 @@ emit_load_float_slot_offset(struct code_block_x86_64 *blk,
     unsigned slot_dst = inst->immed.load_float_slot_offset.slot_dst;
     unsigned index = inst->immed.load_float_slot_offset.index;
 
+    // pinned registers only ever hold integers
+    if (slots[slot_base].guest_base && pinned_reg_find(index) >= 0)
+        RAISE_ERROR(ERROR_UNIMPLEMENTED);
+
     grab_slot(blk, il_blk, inst, &gen_reg_state, slot_base, 8);
     grab_slot(blk, il_blk, inst, &xmm_reg_state, slot_dst, 4);
 
@@ -2269,6 +2700,10 @@ emit_store_float_slot_offset(struct code_block_x86_64 *blk,
     unsigned slot_src = inst->immed.store_float_slot_offset.slot_src;
     unsigned index = inst->immed.store_float_slot_offset.index;
 
+    // pinned registers only ever hold integers
+    if (slots[slot_base].guest_base && pinned_reg_find(index) >= 0)
+        RAISE_ERROR(ERROR_UNIMPLEMENTED);
+
     grab_slot(blk, il_blk, inst, &gen_reg_state, slot_base, 8);
     grab_slot(blk, il_blk, inst, &xmm_reg_state, slot_src, 4);
 
@@ -2298,6 +2733,217 @@ emit_clear_float(struct code_block_x86_64 *blk,
     ungrab_slot(slot_dst);
 }
 
+static void emit_div_float(struct code_block_x86_64 *blk,
+                           struct il_code_block const *il_blk,
+                           void *cpu, struct jit_inst const *inst) {
+    unsigned slot_src = inst->immed.div_float.slot_src;
+    unsigned slot_dst = inst->immed.div_float.slot_dst;
+
+    grab_slot(blk, il_blk, inst, &xmm_reg_state, slot_src, 4);
+    if (slot_src != slot_dst)
+        grab_slot(blk, il_blk, inst, &xmm_reg_state, slot_dst, 4);
+
+    x86asm_divss_xmm_xmm(slots[slot_src].reg_no, slots[slot_dst].reg_no);
+
+    if (slot_src != slot_dst)
+        ungrab_slot(slot_dst);
+    ungrab_slot(slot_src);
+}
+
+/*
+ * grab a register which isn't associated with any slot for use as a
+ * temporary.  Call ungrab_register on it when finished.
+ */
+static unsigned grab_scratch_register(struct code_block_x86_64 *blk,
+                                      struct register_state *reg_state) {
+    int reg_no = register_pick(&reg_state->set, REGISTER_HINT_NONE);
+    evict_register(blk, reg_state, reg_no);
+    grab_register(&reg_state->set, reg_no);
+    return reg_no;
+}
+
+static void emit_sqrt_float(struct code_block_x86_64 *blk,
+                            struct il_code_block const *il_blk,
+                            void *cpu, struct jit_inst const *inst) {
+    unsigned slot_dst = inst->immed.sqrt_float.slot_dst;
+    unsigned slot_flags = inst->immed.sqrt_float.slot_flags;
+
+    unsigned xmm_zero = grab_scratch_register(blk, &xmm_reg_state);
+    unsigned reg_tmp = grab_scratch_register(blk, &gen_reg_state);
+
+    grab_slot(blk, il_blk, inst, &xmm_reg_state, slot_dst, 4);
+    grab_slot(blk, il_blk, inst, &gen_reg_state, slot_flags, 4);
+
+    unsigned reg_dst = slots[slot_dst].reg_no;
+
+    struct x86asm_lbl8 lbl_sqrt, lbl_done;
+    x86asm_lbl8_init(&lbl_sqrt);
+    x86asm_lbl8_init(&lbl_done);
+
+    /*
+     * an unordered comparison (NaN) leaves CF set, so NaNs take the same path
+     * as non-negative numbers
+     */
+    x86asm_xorps_xmm_xmm(xmm_zero, xmm_zero);
+    x86asm_ucomiss_xmm_xmm(reg_dst, xmm_zero);
+    x86asm_jbe_lbl8(&lbl_sqrt);
+
+    x86asm_mov_imm32_reg32(inst->immed.sqrt_float.neg_result, reg_tmp);
+    x86asm_movd_reg32_xmm(reg_tmp, reg_dst);
+    x86asm_orl_imm32_reg32(inst->immed.sqrt_float.neg_flags,
+                           slots[slot_flags].reg_no);
+    x86asm_jmp_lbl8(&lbl_done);
+
+    x86asm_lbl8_define(&lbl_sqrt);
+    x86asm_sqrtss_xmm_xmm(reg_dst, reg_dst);
+
+    x86asm_lbl8_define(&lbl_done);
+
+    x86asm_lbl8_cleanup(&lbl_done);
+    x86asm_lbl8_cleanup(&lbl_sqrt);
+
+    ungrab_slot(slot_flags);
+    ungrab_slot(slot_dst);
+    ungrab_register(&gen_reg_state.set, reg_tmp);
+    ungrab_register(&xmm_reg_state.set, xmm_zero);
+}
+
+static void emit_rsqrt_float(struct code_block_x86_64 *blk,
+                             struct il_code_block const *il_blk,
+                             void *cpu, struct jit_inst const *inst) {
+    unsigned slot_dst = inst->immed.rsqrt_float.slot_dst;
+
+    unsigned xmm_tmp = grab_scratch_register(blk, &xmm_reg_state);
+    unsigned reg_tmp = grab_scratch_register(blk, &gen_reg_state);
+
+    grab_slot(blk, il_blk, inst, &xmm_reg_state, slot_dst, 4);
+
+    unsigned reg_dst = slots[slot_dst].reg_no;
+    double one = 1.0;
+    uint64_t one_bits;
+    memcpy(&one_bits, &one, sizeof(one_bits));
+
+    x86asm_cvtss2sd_xmm_xmm(reg_dst, reg_dst);
+    x86asm_sqrtsd_xmm_xmm(reg_dst, reg_dst);
+    x86asm_mov_imm64_reg64(one_bits, reg_tmp);
+    x86asm_movq_reg64_xmm(reg_tmp, xmm_tmp);
+    x86asm_divsd_xmm_xmm(reg_dst, xmm_tmp);
+    x86asm_cvtsd2ss_xmm_xmm(xmm_tmp, reg_dst);
+
+    ungrab_slot(slot_dst);
+    ungrab_register(&gen_reg_state.set, reg_tmp);
+    ungrab_register(&xmm_reg_state.set, xmm_tmp);
+}
+
+static void
+emit_load_float_slot_indexed(struct code_block_x86_64 *blk,
+                             struct il_code_block const *il_blk,
+                             void *cpu, struct jit_inst const *inst) {
+    unsigned slot_index = inst->immed.load_float_slot_indexed.slot_index;
+    unsigned slot_dst = inst->immed.load_float_slot_indexed.slot_dst;
+    float const *tbl = inst->immed.load_float_slot_indexed.tbl;
+
+    unsigned reg_addr = grab_scratch_register(blk, &gen_reg_state);
+    unsigned reg_offs = grab_scratch_register(blk, &gen_reg_state);
+
+    grab_slot(blk, il_blk, inst, &gen_reg_state, slot_index, 4);
+    grab_slot(blk, il_blk, inst, &xmm_reg_state, slot_dst, 4);
+
+    // 32-bit mov zero-extends the index into the upper half of reg_offs
+    x86asm_mov_reg32_reg32(slots[slot_index].reg_no, reg_offs);
+    x86asm_sal_imm8_reg64(2, reg_offs);
+    x86asm_mov_imm64_reg64((uintptr_t)tbl, reg_addr);
+    x86asm_addq_reg64_reg64(reg_offs, reg_addr);
+    x86asm_movss_indreg_xmm(reg_addr, slots[slot_dst].reg_no);
+
+    ungrab_slot(slot_dst);
+    ungrab_slot(slot_index);
+    ungrab_register(&gen_reg_state.set, reg_offs);
+    ungrab_register(&gen_reg_state.set, reg_addr);
+}
+
+/*
+ * The products are calculated in parallel with mulps, but they are summed one
+ * at a time with addss instead of with haddps (or dpps) because those add the
+ * products pairwise, which does not round the same way as the interpreter.
+ */
+static void emit_dot4_float(struct code_block_x86_64 *blk,
+                            struct il_code_block const *il_blk,
+                            void *cpu, struct jit_inst const *inst) {
+    unsigned slot_base = inst->immed.dot4_float.slot_base;
+    int disp_lhs = 4 * inst->immed.dot4_float.index_lhs;
+    int disp_rhs = 4 * inst->immed.dot4_float.index_rhs;
+    int disp_dst = 4 * inst->immed.dot4_float.index_dst;
+
+    unsigned xmm_sum = grab_scratch_register(blk, &xmm_reg_state);
+    unsigned xmm_tmp = grab_scratch_register(blk, &xmm_reg_state);
+
+    grab_slot(blk, il_blk, inst, &gen_reg_state, slot_base, 8);
+    unsigned reg_base = slots[slot_base].reg_no;
+
+    x86asm_movups_disp32_reg_xmm(disp_lhs, reg_base, xmm_sum);
+    x86asm_movups_disp32_reg_xmm(disp_rhs, reg_base, xmm_tmp);
+    x86asm_mulps_xmm_xmm(xmm_tmp, xmm_sum);
+
+    unsigned elem;
+    for (elem = 1; elem < 4; elem++) {
+        x86asm_movaps_xmm_xmm(xmm_sum, xmm_tmp);
+        x86asm_shufps_imm8_xmm_xmm(elem * 0x55, xmm_tmp, xmm_tmp);
+        x86asm_addss_xmm_xmm(xmm_tmp, xmm_sum);
+    }
+
+    if (disp_dst <= 127 && disp_dst >= -128)
+        x86asm_movss_xmm_disp8_reg(xmm_sum, disp_dst, reg_base);
+    else
+        x86asm_movss_xmm_disp32_reg(xmm_sum, disp_dst, reg_base);
+
+    ungrab_slot(slot_base);
+    ungrab_register(&xmm_reg_state.set, xmm_tmp);
+    ungrab_register(&xmm_reg_state.set, xmm_sum);
+}
+
+/*
+ * Each column of the matrix is scaled by the corresponding element of the
+ * vector, and the columns are accumulated in order.  This yields the same
+ * order of operations for every element of the result as the interpreter.
+ */
+static void emit_xform4_float(struct code_block_x86_64 *blk,
+                              struct il_code_block const *il_blk,
+                              void *cpu, struct jit_inst const *inst) {
+    unsigned slot_base = inst->immed.xform4_float.slot_base;
+    int disp_mat = 4 * inst->immed.xform4_float.index_mat;
+    int disp_vec = 4 * inst->immed.xform4_float.index_vec;
+
+    unsigned xmm_vec = grab_scratch_register(blk, &xmm_reg_state);
+    unsigned xmm_sum = grab_scratch_register(blk, &xmm_reg_state);
+    unsigned xmm_col = grab_scratch_register(blk, &xmm_reg_state);
+    unsigned xmm_tmp = grab_scratch_register(blk, &xmm_reg_state);
+
+    grab_slot(blk, il_blk, inst, &gen_reg_state, slot_base, 8);
+    unsigned reg_base = slots[slot_base].reg_no;
+
+    x86asm_movups_disp32_reg_xmm(disp_vec, reg_base, xmm_vec);
+
+    unsigned col;
+    for (col = 0; col < 4; col++) {
+        unsigned xmm_prod = col ? xmm_tmp : xmm_sum;
+        x86asm_movaps_xmm_xmm(xmm_vec, xmm_prod);
+        x86asm_shufps_imm8_xmm_xmm(col * 0x55, xmm_prod, xmm_prod);
+        x86asm_movups_disp32_reg_xmm(disp_mat + 16 * col, reg_base, xmm_col);
+        x86asm_mulps_xmm_xmm(xmm_col, xmm_prod);
+        if (col)
+            x86asm_addps_xmm_xmm(xmm_prod, xmm_sum);
+    }
+
+    x86asm_movups_xmm_disp32_reg(xmm_sum, disp_vec, reg_base);
+
+    ungrab_slot(slot_base);
+    ungrab_register(&xmm_reg_state.set, xmm_tmp);
+    ungrab_register(&xmm_reg_state.set, xmm_col);
+    ungrab_register(&xmm_reg_state.set, xmm_sum);
+    ungrab_register(&xmm_reg_state.set, xmm_vec);
+}
+
 /*
  * pad the stack so that it is properly aligned for a function call.
  * At the beginning of the stack frame, the stack was aligned to a 16-byte
@@ -2354,15 +3000,27 @@ void code_block_x86_64_compile(void *cpu, struct code_block_x86_64 *out,
     out->cycle_count = cycle_count;
     out->dirty_stack = false;
 
+    void *native = exec_mem_alloc(X86_64_ALLOC_SIZE);
+    if (!native) {
+        error_set_errno_val(errno);
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    }
+    out->native = native;
+    out->exec_mem_alloc_start = native;
+
     x86asm_set_dst(out->exec_mem_alloc_start, &out->bytes_used,
                    X86_64_ALLOC_SIZE);
 
     reset_slots();
+    n_side_exits = 0;
 
     emit_stack_frame_open();
 
     void *skip_stack_frame = x86asm_get_out_ptr();
 
+    if (il_blk->prof)
+        emit_block_prof(il_blk->prof, cycle_count);
+
     while (inst_count--) {
         switch (inst->op) {
         case JIT_OP_FALLBACK:
@@ -2374,6 +3032,9 @@ void code_block_x86_64_compile(void *cpu, struct code_block_x86_64 *out,
         case JIT_CSET:
             emit_cset(out, il_blk, cpu, inst);
             break;
+        case JIT_OP_EXIT_COND:
+            emit_exit_cond(out, il_blk, cpu, inst);
+            break;
         case JIT_SET_SLOT:
             emit_set_slot(out, il_blk, cpu, inst);
             break;
@@ -2386,6 +3047,9 @@ void code_block_x86_64_compile(void *cpu, struct code_block_x86_64 *out,
         case JIT_OP_CALL_FUNC_IMM32:
             emit_call_func_imm32(out, il_blk, cpu, inst);
             break;
+        case JIT_OP_CALL_FUNC_2:
+            emit_call_func_2(out, il_blk, cpu, inst);
+            break;
         case JIT_OP_READ_16_CONSTADDR:
             emit_read_16_constaddr(out, il_blk, cpu, inst);
             break;
@@ -2440,6 +3104,14 @@ void code_block_x86_64_compile(void *cpu, struct code_block_x86_64 *out,
         case JIT_OP_SUB:
             emit_sub(out, il_blk, cpu, inst);
             break;
+        case JIT_OP_ADD_CARRY:
+            emit_add_sub_carry(out, il_blk, cpu, inst,
+                               &inst->immed.add_carry, false);
+            break;
+        case JIT_OP_SUB_CARRY:
+            emit_add_sub_carry(out, il_blk, cpu, inst,
+                               &inst->immed.sub_carry, true);
+            break;
         case JIT_OP_SUB_FLOAT:
             emit_sub_float(out, il_blk, cpu, inst);
             break;
@@ -2518,6 +3190,12 @@ void code_block_x86_64_compile(void *cpu, struct code_block_x86_64 *out,
         case JIT_OP_MUL_U32:
             emit_mul_u32(out, il_blk, cpu, inst);
             break;
+        case JIT_OP_MUL_U64:
+            emit_mul_64(out, il_blk, cpu, inst, &inst->immed.mul_u64, false);
+            break;
+        case JIT_OP_MUL_S64:
+            emit_mul_64(out, il_blk, cpu, inst, &inst->immed.mul_s64, true);
+            break;
         case JIT_OP_MUL_FLOAT:
             emit_mul_float(out, il_blk, cpu, inst);
             break;
@@ -2542,9 +3220,37 @@ void code_block_x86_64_compile(void *cpu, struct code_block_x86_64 *out,
         case JIT_OP_CLEAR_FLOAT:
             emit_clear_float(out, il_blk, cpu, inst);
             break;
+        case JIT_OP_DIV_FLOAT:
+            emit_div_float(out, il_blk, cpu, inst);
+            break;
+        case JIT_OP_SQRT_FLOAT:
+            emit_sqrt_float(out, il_blk, cpu, inst);
+            break;
+        case JIT_OP_RSQRT_FLOAT:
+            emit_rsqrt_float(out, il_blk, cpu, inst);
+            break;
+        case JIT_OP_LOAD_FLOAT_SLOT_INDEXED:
+            emit_load_float_slot_indexed(out, il_blk, cpu, inst);
+            break;
+        case JIT_OP_DOT4_FLOAT:
+            emit_dot4_float(out, il_blk, cpu, inst);
+            break;
+        case JIT_OP_XFORM4_FLOAT:
+            emit_xform4_float(out, il_blk, cpu, inst);
+            break;
         default:
             RAISE_ERROR(ERROR_UNIMPLEMENTED);
         }
+
+        if (n_pinned_regs && inst->op != JIT_SET_SLOT_HOST_PTR) {
+            int write_slots[JIT_IL_MAX_WRITE_SLOTS];
+            unsigned write_no;
+            jit_inst_get_write_slots(inst, write_slots);
+            for (write_no = 0; write_no < JIT_IL_MAX_WRITE_SLOTS; write_no++)
+                if (write_slots[write_no] >= 0)
+                    slots[write_slots[write_no]].guest_base = false;
+        }
+
         inst++;
     }
 
@@ -2557,5 +3263,8 @@ void code_block_x86_64_compile(void *cpu, struct code_block_x86_64 *out,
         out->native = skip_stack_frame;
     }
 
-    native_check_cycles_emit(dispatch_meta);
+    unsigned n_links = count_static_jump_targets(il_blk);
+    out->link_exit = native_check_cycles_emit(dispatch_meta, n_links);
+
+    emit_side_exit_stubs(out, dispatch_meta);
 }
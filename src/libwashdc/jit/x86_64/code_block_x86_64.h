@@ -32,6 +32,8 @@
 
 struct il_code_block;
 struct native_dispatch_meta;
+struct native_dispatch_exit;
+struct fastmem_site;
 
 struct code_block_x86_64 {
     /*
@@ -46,11 +48,62 @@ struct code_block_x86_64 {
     unsigned bytes_used;
 
     bool dirty_stack;
+
+    /*
+     * link slots at the end of this block which native_dispatch can point
+     * directly at the blocks that follow it.  This is NULL if the block's
+     * successor could not be determined at compile-time.
+     */
+    struct native_dispatch_exit *link_exit;
+
+    /*
+     * exits taken from the middle of a superblock.  Exits which loop back to
+     * the beginning of the block jump there directly and don't need one, so
+     * their entries are NULL.
+     */
+    struct native_dispatch_exit **side_exits;
+    unsigned n_side_exits;
+
+#ifdef ENABLE_FASTMEM
+    /*
+     * every fastmem load/store in this block, so that they can be registered
+     * with the fault handler before the block runs and unregistered when the
+     * block is freed.
+     */
+    struct fastmem_site *fastmem_sites;
+    unsigned n_fastmem_sites, fastmem_sites_alloc;
+    bool fastmem_sites_registered;
+#endif
 };
 
 void jit_x86_64_backend_init(void);
 void jit_x86_64_backend_cleanup(void);
 
+#define JIT_X86_64_MAX_PINNED_REGS 3
+
+/*
+ * keep the guest registers at base[indices[0]] through base[indices[n_regs-1]]
+ * in host registers for as long as native code is running.  They get loaded
+ * when native_dispatch is entered and written back when it returns, or when
+ * native code calls into C.
+ *
+ * Guest code can only reach the pinned registers through a slot set with
+ * JIT_SET_SLOT_HOST_PTR to base.
+ *
+ * This must be called after jit_x86_64_backend_init and before
+ * native_dispatch_init.
+ */
+void jit_x86_64_pin_regs(uint32_t *base, unsigned const *indices,
+                         unsigned n_regs);
+
+/*
+ * emit code to write the pinned registers back to memory, or to reload them
+ * from memory.  reg_tmp gets clobbered.  These do nothing if no registers are
+ * pinned.
+ */
+void jit_x86_64_emit_pinned_store(unsigned reg_tmp);
+void jit_x86_64_emit_pinned_load(unsigned reg_tmp);
+
 void code_block_x86_64_init(struct code_block_x86_64 *blk);
 void code_block_x86_64_cleanup(struct code_block_x86_64 *blk);
 
@@ -0,0 +1,363 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#include <stdlib.h>
+
+#include "threading.h"
+#include "atomics.h"
+#include "washdc/error.h"
+#include "log.h"
+#include "config.h"
+#include "jit/code_block.h"
+#include "jit/code_cache.h"
+#include "jit/optimize.h"
+#include "jit/jit_il.h"
+#include "code_block_x86_64.h"
+#include "native_dispatch.h"
+
+#ifdef ENABLE_FASTMEM
+#include "fastmem.h"
+#endif
+
+#include "compile_thread.h"
+#include "jit_perf.h"
+
+/*
+ * A compile_job is created by the emulation thread and then owned by the
+ * compile thread until it's put on the done list.  The only field the
+ * emulation thread touches while the compile thread owns a job is ent, which
+ * it sets to NULL (while holding job_lock) to cancel the job.
+ */
+struct compile_job {
+    struct compile_job *next;
+
+    // the cache entry this job is compiling for, or NULL if it got cancelled
+    struct cache_entry *ent;
+
+    void *cpu;
+    struct native_dispatch_meta const *meta;
+    unsigned cycle_count;
+
+    // length of il_blk after optimization, for jit_block_prof
+    unsigned il_insts;
+
+    struct il_code_block il_blk;
+    struct code_block_x86_64 blk;
+};
+
+static washdc_thread compile_td;
+static washdc_mutex job_lock = WASHDC_MUTEX_STATIC_INIT;
+static washdc_cvar job_cond = WASHDC_CVAR_STATIC_INIT;
+
+// jobs waiting for the compile thread, in the order they were submitted
+static struct compile_job *pending_first, *pending_last;
+
+// jobs the compile thread is done with which haven't been published yet
+static struct compile_job *done_jobs;
+
+/*
+ * nonzero if there's anything on done_jobs.  This lets compile_thread_publish
+ * check for finished jobs without taking job_lock.
+ */
+static washdc_atomic_int have_done_jobs = WASHDC_ATOMIC_INT_INIT(0);
+
+static bool stop_thread;
+
+// 0 if tiering is disabled
+static unsigned hotness_threshold;
+
+static unsigned long n_submitted, n_published, n_discarded;
+
+static void compile_thread_main(void *argp);
+static void compile_job_run(struct compile_job *job);
+static void compile_job_free(struct compile_job *job);
+
+void compile_thread_init(unsigned hotness) {
+#ifdef JIT_PROFILE
+    /*
+     * the profiler expects every block to have been compiled by
+     * code_block_x86_64_compile on the emulation thread.
+     */
+    if (hotness) {
+        LOG_WARN("Tiered compilation is not supported when the JIT profiler "
+                 "is enabled.\n");
+        hotness = 0;
+    }
+#endif
+
+    hotness_threshold = hotness;
+    if (!hotness)
+        return;
+
+    pending_first = pending_last = done_jobs = NULL;
+    stop_thread = false;
+    n_submitted = n_published = n_discarded = 0;
+
+    LOG_INFO("starting the JIT compile thread; blocks will be compiled to "
+             "native code after %u executions\n", hotness);
+
+    washdc_thread_create(&compile_td, compile_thread_main, NULL);
+}
+
+void compile_thread_cleanup(void) {
+    if (!hotness_threshold)
+        return;
+
+    washdc_mutex_lock(&job_lock);
+    stop_thread = true;
+    washdc_cvar_signal(&job_cond);
+    washdc_mutex_unlock(&job_lock);
+
+    washdc_thread_join(&compile_td);
+
+    // the compile thread is gone, so there's no need to lock anything now
+    while (pending_first) {
+        struct compile_job *next = pending_first->next;
+        compile_job_free(pending_first);
+        pending_first = next;
+    }
+    pending_last = NULL;
+
+    while (done_jobs) {
+        struct compile_job *next = done_jobs->next;
+        compile_job_free(done_jobs);
+        done_jobs = next;
+    }
+
+    int one = 1;
+    washdc_atomic_int_compare_exchange(&have_done_jobs, &one, 0);
+
+    LOG_INFO("JIT compile thread: %lu blocks submitted, %lu published, "
+             "%lu discarded\n", n_submitted, n_published, n_discarded);
+
+    hotness_threshold = 0;
+}
+
+bool compile_thread_enabled(void) {
+    return hotness_threshold != 0;
+}
+
+void compile_thread_tier0(struct cache_entry *ent, void *cpu,
+                          struct native_dispatch_meta const *meta,
+                          addr32_t pc) {
+    struct tier0_block *tier0 =
+        (struct tier0_block*)calloc(1, sizeof(struct tier0_block));
+    if (!tier0)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    struct il_code_block tier0_il;
+    il_code_block_init(&tier0_il);
+    unsigned cycle_count =
+        meta->build_il(cpu, &ent->blk, &tier0_il, pc, true, false);
+    code_block_intp_compile(cpu, &tier0->intp, &tier0_il, cycle_count);
+    il_code_block_cleanup(&tier0_il);
+
+    tier0->pc = pc;
+
+    ent->tier0 = tier0;
+    ent->blk.x86_64.native = meta->tier0_stub;
+    code_cache_set_code_bytes(ent, tier0->intp.inst_count *
+                              sizeof(struct jit_inst) +
+                              tier0->intp.n_slots * sizeof(union slot_val));
+}
+
+void compile_thread_tier0_hit(struct cache_entry *ent, void *cpu,
+                              struct native_dispatch_meta const *meta) {
+    struct tier0_block *tier0 = ent->tier0;
+
+    if (tier0->job || ++tier0->hotness < hotness_threshold)
+        return;
+
+    struct compile_job *job =
+        (struct compile_job*)calloc(1, sizeof(struct compile_job));
+    if (!job)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+
+    job->ent = ent;
+    job->cpu = cpu;
+    job->meta = meta;
+
+    /*
+     * the RAM this block was compiled from is already being watched on behalf
+     * of the tier 0 block, and the native block will take over the same cache
+     * entry.  A superblock can cover more RAM than the tier 0 block did
+     * though, so in that case the watch gets replaced.
+     */
+    bool superblock = config_get_jit_superblocks();
+    il_code_block_init(&job->il_blk);
+    job->cycle_count = meta->build_il(cpu, &ent->blk, &job->il_blk, tier0->pc,
+                                      superblock, superblock);
+    job->il_blk.prof = ent->blk.prof;
+    code_block_x86_64_init(&job->blk);
+
+    tier0->job = job;
+    n_submitted++;
+
+    washdc_mutex_lock(&job_lock);
+    if (pending_last)
+        pending_last->next = job;
+    else
+        pending_first = job;
+    pending_last = job;
+    washdc_cvar_signal(&job_cond);
+    washdc_mutex_unlock(&job_lock);
+}
+
+void compile_thread_tier0_exit(struct tier0_block *tier0, addr32_t pc) {
+    unsigned idx;
+    for (idx = 0; idx < 2; idx++) {
+        if (!tier0->exit_count[idx]) {
+            tier0->exit_pc[idx] = pc;
+            tier0->exit_count[idx] = 1;
+            return;
+        }
+        if (tier0->exit_pc[idx] == pc) {
+            tier0->exit_count[idx]++;
+            return;
+        }
+    }
+}
+
+unsigned compile_thread_tier0_exit_count(jit_hash hash, addr32_t pc) {
+    struct cache_entry *ent = code_cache_lookup(hash);
+    if (!ent || !ent->tier0)
+        return 0;
+
+    struct tier0_block const *tier0 = ent->tier0;
+    unsigned idx;
+    for (idx = 0; idx < 2; idx++)
+        if (tier0->exit_count[idx] && tier0->exit_pc[idx] == pc)
+            return tier0->exit_count[idx];
+    return 0;
+}
+
+void compile_thread_tier0_free(struct tier0_block *tier0) {
+    if (tier0->job) {
+        washdc_mutex_lock(&job_lock);
+        tier0->job->ent = NULL;
+        washdc_mutex_unlock(&job_lock);
+        tier0->job = NULL;
+    }
+
+    code_block_intp_cleanup(&tier0->intp);
+    free(tier0);
+}
+
+void compile_thread_publish(void) {
+    if (!hotness_threshold || !washdc_atomic_int_load(&have_done_jobs))
+        return;
+
+    washdc_mutex_lock(&job_lock);
+    struct compile_job *job = done_jobs;
+    done_jobs = NULL;
+    int one = 1;
+    washdc_atomic_int_compare_exchange(&have_done_jobs, &one, 0);
+    washdc_mutex_unlock(&job_lock);
+
+    /*
+     * only the emulation thread ever cancels jobs, so job->ent can't change
+     * out from under us now that the jobs are off the done list.
+     */
+    while (job) {
+        struct compile_job *next = job->next;
+        struct cache_entry *ent = job->ent;
+
+        /*
+         * entries which got evicted or invalidated don't get freed until the
+         * next code_cache_gc, so they still have their tier 0 block but
+         * they're not in the code_cache_tbl anymore.
+         */
+        if (ent && code_cache_is_live(ent)) {
+            struct tier0_block *tier0 = ent->tier0;
+            tier0->job = NULL;
+            compile_thread_tier0_free(tier0);
+            ent->tier0 = NULL;
+
+            ent->blk.x86_64 = job->blk;
+#ifdef ENABLE_FASTMEM
+            fastmem_register_sites(&ent->blk.x86_64);
+#endif
+            code_cache_set_code_bytes(ent, ent->blk.x86_64.bytes_used);
+            jit_perf_block_loaded(ent->key, &ent->blk.x86_64);
+            jit_block_prof_set_code(ent->blk.prof, job->il_insts,
+                                    ent->blk.x86_64.bytes_used);
+            n_published++;
+        } else {
+            if (ent)
+                ent->tier0->job = NULL;
+            code_block_x86_64_cleanup(&job->blk);
+            n_discarded++;
+        }
+
+        free(job);
+        job = next;
+    }
+}
+
+static void compile_thread_main(void *argp) {
+    washdc_mutex_lock(&job_lock);
+    while (!stop_thread) {
+        struct compile_job *job = pending_first;
+        if (!job) {
+            washdc_cvar_wait(&job_cond, &job_lock);
+            continue;
+        }
+
+        pending_first = job->next;
+        if (!pending_first)
+            pending_last = NULL;
+        bool cancelled = !job->ent;
+        washdc_mutex_unlock(&job_lock);
+
+        if (!cancelled)
+            compile_job_run(job);
+        il_code_block_cleanup(&job->il_blk);
+
+        washdc_mutex_lock(&job_lock);
+        job->next = done_jobs;
+        done_jobs = job;
+        int zero = 0;
+        washdc_atomic_int_compare_exchange(&have_done_jobs, &zero, 1);
+    }
+    washdc_mutex_unlock(&job_lock);
+}
+
+static void compile_job_run(struct compile_job *job) {
+    jit_optimize(&job->il_blk);
+    job->il_insts = job->il_blk.inst_count;
+
+#ifdef INVARIANTS
+    jit_sanity_checks(job->il_blk.inst_list, job->il_blk.inst_count);
+#endif
+
+    code_block_x86_64_compile(job->cpu, &job->blk, &job->il_blk,
+                              job->meta, job->cycle_count);
+}
+
+// only call this once the compile thread is done with job
+static void compile_job_free(struct compile_job *job) {
+    if (job->ent)
+        job->ent->tier0->job = NULL;
+    il_code_block_cleanup(&job->il_blk);
+    code_block_x86_64_cleanup(&job->blk);
+    free(job);
+}
@@ -0,0 +1,136 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef COMPILE_THREAD_H_
+#define COMPILE_THREAD_H_
+
+#ifndef ENABLE_JIT_X86_64
+#error this file should not be built when the x86_64 JIT backend is disabled
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "washdc/types.h"
+#include "jit/defs.h"
+#include "jit/jit_intp/code_block_intp.h"
+
+/*
+ * Tiered compilation for the native JIT.
+ *
+ * When tiering is enabled, blocks don't get compiled to native code the first
+ * time they're executed.  Instead their IL is handed to the IL interpreter
+ * (tier 0) and the block's native pointer is set to the tier0_stub, which
+ * runs the block in the interpreter from within the native dispatcher.
+ *
+ * Once a tier 0 block has been executed enough times, its IL is rebuilt and
+ * handed to the compile thread, which optimizes it and compiles it to native
+ * code.  Finished blocks get published back into the code cache from the
+ * emulation thread by compile_thread_publish; until then the block keeps
+ * running in the interpreter.
+ *
+ * The IL itself is always built on the emulation thread because building it
+ * reads guest memory and sets up the code cache's RAM watches.  The compile
+ * thread only ever touches the IL it was given and the exec_mem it allocates.
+ */
+
+struct cache_entry;
+struct compile_job;
+struct native_dispatch_meta;
+
+struct tier0_block {
+    struct code_block_intp intp;
+
+    // the PC this block was built from
+    addr32_t pc;
+
+    // how many times this block has been executed in the interpreter
+    unsigned hotness;
+
+    /*
+     * the first two different PCs this block exited to, and how many times
+     * it went to each one.  Superblocks use this to decide which way a
+     * conditional branch usually goes.
+     */
+    addr32_t exit_pc[2];
+    unsigned exit_count[2];
+
+    // the compile thread's job for this block, or NULL if it hasn't got one
+    struct compile_job *job;
+};
+
+/*
+ * start the compile thread.  Blocks get promoted to native code after they've
+ * been executed hotness times in tier 0.  If hotness is 0 then tiering is
+ * disabled, and blocks are compiled to native code on the emulation thread
+ * the first time they're executed like they always have been.
+ */
+void compile_thread_init(unsigned hotness);
+
+/*
+ * stop the compile thread and throw away any work it hasn't published yet.
+ * The code cache should be cleaned up before this gets called.
+ */
+void compile_thread_cleanup(void);
+
+bool compile_thread_enabled(void);
+
+/*
+ * build the IL for the block at pc into a new tier 0 block which belongs to
+ * ent, and point ent's native code at the tier0_stub.
+ */
+void compile_thread_tier0(struct cache_entry *ent, void *cpu,
+                          struct native_dispatch_meta const *meta,
+                          addr32_t pc);
+
+/*
+ * count an execution of ent's tier 0 block, and hand it to the compile
+ * thread if it's hot enough.  This needs to be called before the block is
+ * executed so that the IL gets built from the CPU state the block started
+ * with.
+ */
+void compile_thread_tier0_hit(struct cache_entry *ent, void *cpu,
+                              struct native_dispatch_meta const *meta);
+
+// record that tier0 just exited to pc
+void compile_thread_tier0_exit(struct tier0_block *tier0, addr32_t pc);
+
+/*
+ * returns how many times the tier 0 block for the given hash has exited to
+ * pc, or 0 if that block isn't in tier 0 anymore (or never was).
+ */
+unsigned compile_thread_tier0_exit_count(jit_hash hash, addr32_t pc);
+
+/*
+ * free a tier 0 block.  If it has a job on the compile thread, that job gets
+ * cancelled.
+ */
+void compile_thread_tier0_free(struct tier0_block *tier0);
+
+/*
+ * install every block the compile thread has finished into the code cache.
+ * This must be called from the emulation thread, and it's cheap to call when
+ * the compile thread hasn't finished anything.
+ */
+void compile_thread_publish(void);
+
+#endif
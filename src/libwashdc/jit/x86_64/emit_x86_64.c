@@ -42,6 +42,11 @@
 static void *alloc_start;
 static unsigned alloc_len;
 
+/*
+ * washdc_emitp always points into the executable view of exec_mem so that
+ * jump targets and RIP-relative offsets come out right; the actual stores go
+ * through exec_mem_rw.
+ */
 static uint8_t *washdc_emitp;
 static unsigned *n_bytes_out;
 static unsigned washdc_emitp_len;
@@ -65,7 +70,7 @@ static void try_grow(void) {
 WASHDC_UNUSED
 static void put8(uint8_t val) {
     if (washdc_emitp_len >= 1) {
-        *washdc_emitp++ = val;
+        *(uint8_t*)exec_mem_rw(washdc_emitp++) = val;
         washdc_emitp_len--;
         if (n_bytes_out)
             *n_bytes_out += sizeof(uint8_t);
@@ -78,7 +83,7 @@ static void put8(uint8_t val) {
 WASHDC_UNUSED
 static void put16(uint16_t val) {
     if (washdc_emitp_len >= 2) {
-        memcpy(washdc_emitp, &val, sizeof(val));
+        memcpy(exec_mem_rw(washdc_emitp), &val, sizeof(val));
         washdc_emitp += 2;
         washdc_emitp_len -= 2;
         if (n_bytes_out)
@@ -92,7 +97,7 @@ static void put16(uint16_t val) {
 WASHDC_UNUSED
 static void put32(uint32_t val) {
     if (washdc_emitp_len >= 4) {
-        memcpy(washdc_emitp, &val, sizeof(val));
+        memcpy(exec_mem_rw(washdc_emitp), &val, sizeof(val));
         washdc_emitp += 4;
         washdc_emitp_len -= 4;
         if (n_bytes_out)
@@ -106,7 +111,7 @@ static void put32(uint32_t val) {
 WASHDC_UNUSED
 static void put64(uint64_t val) {
     if (washdc_emitp_len >= 8) {
-        memcpy(washdc_emitp, &val, sizeof(val));
+        memcpy(exec_mem_rw(washdc_emitp), &val, sizeof(val));
         washdc_emitp += 8;
         washdc_emitp_len -= 8;
         if (n_bytes_out)
@@ -588,6 +593,14 @@ void x86asm_movq_reg_riprel(unsigned reg_dst, uint32_t relptr) {
     put32(relptr);
 }
 
+/*
+ * incq (%rip+disp32)
+ */
+void x86asm_incq_riprel(uint32_t relptr) {
+    emit_mod_reg_rm_riprel(REX_W, 0xff, 0, 0);
+    put32(relptr);
+}
+
 // movq (%<reg_base>, <scale>, %<reg_index>), %<reg_dst>
 void x86asm_movq_sib_reg(unsigned reg_base, unsigned scale,
                          unsigned reg_index, unsigned reg_dst) {
@@ -914,6 +927,13 @@ void x86asm_movb_reg_disp8_reg(unsigned reg_src, int disp8, unsigned reg_dst) {
     put8(disp8);
 }
 
+// movb $<imm8>, <disp8>(%<reg_dst>)
+void x86asm_movb_imm8_disp8_reg(unsigned imm8, int disp8, unsigned reg_dst) {
+    emit_mod_reg_rm(0, 0xc6, 1, 0, reg_dst);
+    put8(disp8);
+    put8(imm8);
+}
+
 // movl <reg_src>, <disp8>(<reg_dst>)
 void
 x86asm_movl_reg_disp8_reg(unsigned reg_src, int disp8, unsigned reg_dst) {
@@ -988,6 +1008,16 @@ void x86asm_subl_reg32_reg32(unsigned reg_src, unsigned reg_dst) {
     emit_mod_reg_rm(0, 0x29, 3, reg_src, reg_dst);
 }
 
+// adcl %<reg_src>, %<reg_dst>
+void x86asm_adcl_reg32_reg32(unsigned reg_src, unsigned reg_dst) {
+    emit_mod_reg_rm(0, 0x11, 3, reg_src, reg_dst);
+}
+
+// sbbl %<reg_src>, %<reg_dst>
+void x86asm_sbbl_reg32_reg32(unsigned reg_src, unsigned reg_dst) {
+    emit_mod_reg_rm(0, 0x19, 3, reg_src, reg_dst);
+}
+
 // subq %<reg_src>, %<reg_dst>
 void x86asm_subq_reg64_reg64(unsigned reg_src, unsigned reg_dst) {
     emit_mod_reg_rm(REX_W, 0x29, 3, reg_src, reg_dst);
@@ -1150,6 +1180,12 @@ void x86asm_jz_disp8(int disp8) {
     put8(disp8);
 }
 
+void x86asm_jz_disp32(uint32_t disp32) {
+    put8(0x0f);
+    put8(0x84);
+    put32(disp32);
+}
+
 void x86asm_jz_lbl8(struct x86asm_lbl8 *lbl) {
     struct lbl_jmp_pt pt;
     put8(0x74);
@@ -1166,6 +1202,12 @@ void x86asm_jnz_disp8(int disp8) {
     put8(disp8);
 }
 
+void x86asm_jnz_disp32(uint32_t disp32) {
+    put8(0x0f);
+    put8(0x85);
+    put32(disp32);
+}
+
 void x86asm_jnz_lbl8(struct x86asm_lbl8 *lbl) {
     struct lbl_jmp_pt pt;
     put8(0x75);
@@ -1378,6 +1420,12 @@ void x86asm_shll_imm8_reg32(unsigned imm8, unsigned reg_no) {
     put8(imm8);
 }
 
+// shlq $<imm8>, %reg_no
+void x86asm_shlq_imm8_reg64(unsigned imm8, unsigned reg_no) {
+    emit_mod_reg_rm(REX_W, 0xc1, 3, 4, reg_no);
+    put8(imm8);
+}
+
 // sarl $<imm8>, %reg_no
 void x86asm_sarl_imm8_reg32(unsigned imm8, unsigned reg_no) {
     emit_mod_reg_rm(0, 0xc1, 3, 7, reg_no);
@@ -1425,7 +1473,7 @@ void x86asm_lbl8_define(struct x86asm_lbl8 *lbl) {
             RAISE_ERROR(ERROR_TOO_BIG);
         if (offs < INT8_MIN)
             RAISE_ERROR(ERROR_TOO_SMALL);
-        *pt->offs = offs;
+        *(int8_t*)exec_mem_rw(pt->offs) = offs;
     }
 }
 
@@ -1438,7 +1486,7 @@ void x86asm_lbl8_push_jmp_pt(struct x86asm_lbl8 *lbl,
             RAISE_ERROR(ERROR_TOO_BIG);
         if (offs < INT8_MIN)
             RAISE_ERROR(ERROR_TOO_SMALL);
-        *jmp_pt->offs = offs;
+        *(int8_t*)exec_mem_rw(jmp_pt->offs) = offs;
     } else {
         // save this jump point for when the label gets defined later
         if (lbl->n_jump_points >= MAX_LABEL_JUMPS)
@@ -1451,6 +1499,10 @@ void x86asm_mull_reg32(unsigned reg_no) {
     emit_mod_reg_rm(0, 0xf7, 3, 4, reg_no);
 }
 
+void x86asm_imull_reg32(unsigned reg_no) {
+    emit_mod_reg_rm(0, 0xf7, 3, 5, reg_no);
+}
+
 void x86asm_testl_reg32_reg32(unsigned reg_src, unsigned reg_dst) {
     emit_mod_reg_rm(0, 0x85, 3, reg_src, reg_dst);
 }
@@ -1548,6 +1600,13 @@ void x86asm_setz_reg8(unsigned reg_no) {
     emit_mod_reg_rm_2(rex, 0x0f, 0x94, 3, 0, reg_no);
 }
 
+void x86asm_setc_reg8(unsigned reg_no) {
+    unsigned rex = 0;
+    if (reg_no == SP || reg_no == BP || reg_no == SI || reg_no == DI)
+        rex = 0x40;
+    emit_mod_reg_rm_2(rex, 0x0f, 0x92, 3, 0, reg_no);
+}
+
 void x86asm_negl_reg32(unsigned reg_no) {
     emit_mod_reg_rm(0, 0xf7, 3, 3, reg_no);
 }
@@ -1556,6 +1615,11 @@ void x86asm_nop(void) {
     put8(0x90);
 }
 
+void x86asm_rdtsc(void) {
+    put8(0x0f);
+    put8(0x31);
+}
+
 void x86asm_movss_indreg_xmm(unsigned reg_src, unsigned xmm_reg_dst) {
     put8(0xf3);
     emit_mod_reg_rm_2(0, 0x0f, 0x10, 0, xmm_reg_dst, reg_src);
@@ -1710,3 +1774,73 @@ void x86asm_xorps_xmm_xmm(unsigned xmm_reg_src, unsigned xmm_reg_dst) {
 void x86asm_ucomiss_xmm_xmm(unsigned xmm_reg_rhs, unsigned xmm_reg_lhs) {
     emit_mod_reg_rm_2(0, 0x0f, 0x2e, 3, xmm_reg_lhs, xmm_reg_rhs);
 }
+
+// divss %<xmm_reg_src>, %<xmm_reg_dst>
+void x86asm_divss_xmm_xmm(unsigned xmm_reg_src, unsigned xmm_reg_dst) {
+    put8(0xf3);
+    emit_mod_reg_rm_2(0, 0x0f, 0x5e, 3, xmm_reg_dst, xmm_reg_src);
+}
+
+// sqrtss %<xmm_reg_src>, %<xmm_reg_dst>
+void x86asm_sqrtss_xmm_xmm(unsigned xmm_reg_src, unsigned xmm_reg_dst) {
+    put8(0xf3);
+    emit_mod_reg_rm_2(0, 0x0f, 0x51, 3, xmm_reg_dst, xmm_reg_src);
+}
+
+// movaps %<xmm_reg_src>, %<xmm_reg_dst>
+void x86asm_movaps_xmm_xmm(unsigned xmm_reg_src, unsigned xmm_reg_dst) {
+    emit_mod_reg_rm_2(0, 0x0f, 0x28, 3, xmm_reg_dst, xmm_reg_src);
+}
+
+// shufps $<imm8>, %<xmm_reg_src>, %<xmm_reg_dst>
+void x86asm_shufps_imm8_xmm_xmm(unsigned imm8, unsigned xmm_reg_src,
+                                unsigned xmm_reg_dst) {
+    emit_mod_reg_rm_2(0, 0x0f, 0xc6, 3, xmm_reg_dst, xmm_reg_src);
+    put8(imm8);
+}
+
+// mulps %<xmm_reg_src>, %<xmm_reg_dst>
+void x86asm_mulps_xmm_xmm(unsigned xmm_reg_src, unsigned xmm_reg_dst) {
+    emit_mod_reg_rm_2(0, 0x0f, 0x59, 3, xmm_reg_dst, xmm_reg_src);
+}
+
+// addps %<xmm_reg_src>, %<xmm_reg_dst>
+void x86asm_addps_xmm_xmm(unsigned xmm_reg_src, unsigned xmm_reg_dst) {
+    emit_mod_reg_rm_2(0, 0x0f, 0x58, 3, xmm_reg_dst, xmm_reg_src);
+}
+
+// movd %<reg_src>, %<xmm_reg_dst>
+void x86asm_movd_reg32_xmm(unsigned reg_src, unsigned xmm_reg_dst) {
+    put8(0x66);
+    emit_mod_reg_rm_2(0, 0x0f, 0x6e, 3, xmm_reg_dst, reg_src);
+}
+
+// movq %<reg_src>, %<xmm_reg_dst>
+void x86asm_movq_reg64_xmm(unsigned reg_src, unsigned xmm_reg_dst) {
+    put8(0x66);
+    emit_mod_reg_rm_2(REX_W, 0x0f, 0x6e, 3, xmm_reg_dst, reg_src);
+}
+
+// cvtss2sd %<xmm_reg_src>, %<xmm_reg_dst>
+void x86asm_cvtss2sd_xmm_xmm(unsigned xmm_reg_src, unsigned xmm_reg_dst) {
+    put8(0xf3);
+    emit_mod_reg_rm_2(0, 0x0f, 0x5a, 3, xmm_reg_dst, xmm_reg_src);
+}
+
+// cvtsd2ss %<xmm_reg_src>, %<xmm_reg_dst>
+void x86asm_cvtsd2ss_xmm_xmm(unsigned xmm_reg_src, unsigned xmm_reg_dst) {
+    put8(0xf2);
+    emit_mod_reg_rm_2(0, 0x0f, 0x5a, 3, xmm_reg_dst, xmm_reg_src);
+}
+
+// sqrtsd %<xmm_reg_src>, %<xmm_reg_dst>
+void x86asm_sqrtsd_xmm_xmm(unsigned xmm_reg_src, unsigned xmm_reg_dst) {
+    put8(0xf2);
+    emit_mod_reg_rm_2(0, 0x0f, 0x51, 3, xmm_reg_dst, xmm_reg_src);
+}
+
+// divsd %<xmm_reg_src>, %<xmm_reg_dst>
+void x86asm_divsd_xmm_xmm(unsigned xmm_reg_src, unsigned xmm_reg_dst) {
+    put8(0xf2);
+    emit_mod_reg_rm_2(0, 0x0f, 0x5e, 3, xmm_reg_dst, xmm_reg_src);
+}
@@ -207,6 +207,14 @@ void x86asm_movq_riprel_reg(uint32_t relptr, unsigned reg_dst);
  */
 void x86asm_movq_reg_riprel(unsigned reg_dst, uint32_t relptr);
 
+/*
+ * incq (%rip+disp32)
+ *
+ * relptr is relative to the address *after* this instruction.  This
+ * instruction will always be 7 bytes long.
+ */
+void x86asm_incq_riprel(uint32_t relptr);
+
 // movl (<reg_src>), <reg_dst>
 void x86asm_mov_indreg32_reg32(unsigned reg_src, unsigned reg_dst);
 
@@ -291,6 +299,12 @@ void x86asm_addl_reg32_reg32(unsigned reg_src, unsigned reg_dst);
 // subl %<reg_src>, %<reg_dst>
 void x86asm_subl_reg32_reg32(unsigned reg_src, unsigned reg_dst);
 
+// adcl %<reg_src>, %<reg_dst>
+void x86asm_adcl_reg32_reg32(unsigned reg_src, unsigned reg_dst);
+
+// sbbl %<reg_src>, %<reg_dst>
+void x86asm_sbbl_reg32_reg32(unsigned reg_src, unsigned reg_dst);
+
 // subl %<reg_src>, %<reg_dst>
 void x86asm_subq_reg64_reg64(unsigned reg_src, unsigned reg_dst);
 
@@ -374,11 +388,13 @@ void x86asm_cmpq_reg64_reg64(unsigned reg_lhs, unsigned reg_rhs);
  * jump if the zero-flag is set (meaning a cmp was equal)
  */
 void x86asm_jz_disp8(int disp8);
+void x86asm_jz_disp32(uint32_t disp32);
 
 void x86asm_jz_lbl8(struct x86asm_lbl8 *lbl);
 
 // jnz (pc + disp8)
 void x86asm_jnz_disp8(int disp8);
+void x86asm_jnz_disp32(uint32_t disp32);
 void x86asm_jnz_lbl8(struct x86asm_lbl8 *lbl);
 
 // jnge (pc + disp8)
@@ -468,6 +484,9 @@ void x86asm_shll_imm8_reg32(unsigned imm8, unsigned reg_no);
 // shll %cl, reg_no
 void x86asm_shll_cl_reg32(unsigned reg_no);
 
+// shlq $<imm8>, %reg_no
+void x86asm_shlq_imm8_reg64(unsigned imm8, unsigned reg_no);
+
 // shrl $<imm8>, %reg_no
 void x86asm_shrl_imm8_reg32(unsigned imm8, unsigned reg_no);
 
@@ -492,6 +511,9 @@ void* x86asm_get_outp(void);
  */
 void x86asm_mull_reg32(unsigned reg_no);
 
+// this is like x86asm_mull_reg32, except the multiplication is signed.
+void x86asm_imull_reg32(unsigned reg_no);
+
 void x86asm_testl_reg32_reg32(unsigned reg_src, unsigned reg_dst);
 void x86asm_testq_reg64_reg64(unsigned reg_src, unsigned reg_dst);
 
@@ -529,6 +551,7 @@ void x86asm_setg_reg8(unsigned reg_no);
 void x86asm_setge_reg8(unsigned reg_no);
 void x86asm_setnz_reg8(unsigned reg_no);
 void x86asm_setz_reg8(unsigned reg_no);
+void x86asm_setc_reg8(unsigned reg_no);
 
 void x86asm_negl_reg32(unsigned reg_no);
 
@@ -542,11 +565,17 @@ void x86asm_movb_disp8_reg_reg(int disp8, unsigned reg_src, unsigned reg_dst);
 // movb %<reg_src>, <disp8>(%<reg_dst>)
 void x86asm_movb_reg_disp8_reg(unsigned reg_src, int disp8, unsigned reg_dst);
 
+// movb $<imm8>, <disp8>(%<reg_dst>)
+void x86asm_movb_imm8_disp8_reg(unsigned imm8, int disp8, unsigned reg_dst);
+
 void x86asm_jmp_disp8(int disp8);
 void x86asm_jmp_lbl8(struct x86asm_lbl8 *lbl);
 
 void x86asm_nop(void);
 
+// rdtsc (clobbers %eax and %edx)
+void x86asm_rdtsc(void);
+
 /*******************************************************************************
  *
  * SSE instructions
@@ -609,4 +638,47 @@ void x86asm_xorps_xmm_xmm(unsigned xmm_reg_src, unsigned xmm_reg_dst);
 // ucomiss %<xmm_reg_rhs>, %<xmm_reg_lhs>
 void x86asm_ucomiss_xmm_xmm(unsigned xmm_reg_rhs, unsigned xmm_reg_lhs);
 
+// divss %<xmm_reg_src>, %<xmm_reg_dst>
+void x86asm_divss_xmm_xmm(unsigned xmm_reg_src, unsigned xmm_reg_dst);
+
+// sqrtss %<xmm_reg_src>, %<xmm_reg_dst>
+void x86asm_sqrtss_xmm_xmm(unsigned xmm_reg_src, unsigned xmm_reg_dst);
+
+// movaps %<xmm_reg_src>, %<xmm_reg_dst>
+void x86asm_movaps_xmm_xmm(unsigned xmm_reg_src, unsigned xmm_reg_dst);
+
+// shufps $<imm8>, %<xmm_reg_src>, %<xmm_reg_dst>
+void x86asm_shufps_imm8_xmm_xmm(unsigned imm8, unsigned xmm_reg_src,
+                                unsigned xmm_reg_dst);
+
+// mulps %<xmm_reg_src>, %<xmm_reg_dst>
+void x86asm_mulps_xmm_xmm(unsigned xmm_reg_src, unsigned xmm_reg_dst);
+
+// addps %<xmm_reg_src>, %<xmm_reg_dst>
+void x86asm_addps_xmm_xmm(unsigned xmm_reg_src, unsigned xmm_reg_dst);
+
+// movd %<reg_src>, %<xmm_reg_dst>
+void x86asm_movd_reg32_xmm(unsigned reg_src, unsigned xmm_reg_dst);
+
+// movq %<reg_src>, %<xmm_reg_dst>
+void x86asm_movq_reg64_xmm(unsigned reg_src, unsigned xmm_reg_dst);
+
+/*******************************************************************************
+ *
+ * SSE2 double-precision instructions
+ *
+ *******************************************************************************/
+
+// cvtss2sd %<xmm_reg_src>, %<xmm_reg_dst>
+void x86asm_cvtss2sd_xmm_xmm(unsigned xmm_reg_src, unsigned xmm_reg_dst);
+
+// cvtsd2ss %<xmm_reg_src>, %<xmm_reg_dst>
+void x86asm_cvtsd2ss_xmm_xmm(unsigned xmm_reg_src, unsigned xmm_reg_dst);
+
+// sqrtsd %<xmm_reg_src>, %<xmm_reg_dst>
+void x86asm_sqrtsd_xmm_xmm(unsigned xmm_reg_src, unsigned xmm_reg_dst);
+
+// divsd %<xmm_reg_src>, %<xmm_reg_dst>
+void x86asm_divsd_xmm_xmm(unsigned xmm_reg_src, unsigned xmm_reg_dst);
+
 #endif
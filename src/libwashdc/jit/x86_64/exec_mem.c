@@ -19,7 +19,6 @@
  *
  *
  ******************************************************************************/
-
 #ifndef ENABLE_JIT_X86_64
 #error this file should not be built when the x86_64 JIT backend is disabled
 #endif
@@ -28,6 +27,9 @@
 #include "i_hate_windows.h"
 #include <memoryapi.h>
 #else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <sys/mman.h>
 #endif
 
@@ -36,28 +38,46 @@
 #include <stdbool.h>
 
 #include "log.h"
+#include "threading.h"
 #include "washdc/error.h"
 
 #include "exec_mem.h"
 
+#if defined(ENABLE_JIT_WX) && defined(_WIN32)
+#error ENABLE_JIT_WX is not supported on Windows
+#endif
+
 #define X86_64_ALLOC_SIZE (512 * 1024 * 1024)
 
-static void *native;
+#define ARENA_SHIFT 21
+#define ARENA_SIZE (1 << ARENA_SHIFT)
+#define N_ARENAS (X86_64_ALLOC_SIZE / ARENA_SIZE)
 
-#define FREE_CHUNK_MAGIC  0xca55e77e
-#define ALLOC_CHUNK_MAGIC 0xfeedface
+// memory gets committed in chunks of this size as the bump pointer advances
+#define COMMIT_SIZE (64 * 1024)
+
+/*
+ * a new allocation only goes into the current arena if there will still be at
+ * least this much room after it.  Code blocks start out small and grow as the
+ * code is emitted, so they need room to grow into.
+ */
+#define ARENA_HEADROOM (256 * 1024)
 
-#define MIN_FREE_CHUNK_SIZE sizeof(struct free_chunk)
+/*
+ * Every allocation is aligned to a 16-byte boundary.  Strictly speaking,
+ * alignment is not needed on x86 but it's better for instruction fetch.
+ */
+#define ALLOC_ALIGN 16
 
-// this list should always be sorted from small addrs to large addrs
-static struct free_chunk {
-#ifdef INVARIANTS
-    unsigned magic;
+static uint8_t *native;
+
+#ifdef ENABLE_JIT_WX
+ptrdiff_t exec_mem_rw_offs;
+static int exec_mem_fd = -1;
 #endif
-    struct free_chunk *next;
-    struct free_chunk **pprev;
-    size_t len;
-} *free_mem;
+
+#define FREE_CHUNK_MAGIC  0xca55e77e
+#define ALLOC_CHUNK_MAGIC 0xfeedface
 
 struct alloc_chunk {
 #ifdef INVARIANTS
@@ -66,516 +86,462 @@ struct alloc_chunk {
     size_t len, len_req;
 };
 
+#define ALLOC_HDR_LEN                                                   \
+    ((sizeof(struct alloc_chunk) + ALLOC_ALIGN - 1) & ~(ALLOC_ALIGN - 1))
+
+struct arena {
+    // offset of the bump pointer from the start of the arena
+    size_t top;
+
+    // how many bytes from the start of the arena are committed
+    size_t committed;
+
+    // bytes belonging to allocations which have not been freed yet
+    size_t live_bytes;
+    unsigned n_live;
+
+    bool in_use;
+};
+
+static struct arena arenas[N_ARENAS];
+
+// stack of arenas which are not in use
+static unsigned free_arenas[N_ARENAS];
+static unsigned n_free_arenas;
+
+static struct arena *cur_arena;
+
 static size_t n_allocations;
-unsigned largest_alloc, smallest_alloc;
 
 /*
- * This returns a pointer to the true start of the allocation, which is its
- * struct alloc_chunk.
+ * the background compile thread allocates and grows code while the emulation
+ * thread frees it, so everything that touches the arenas holds this lock.
  */
-static void *get_alloc_start(void *alloc_ptr);
+static washdc_mutex exec_mem_lock = WASHDC_MUTEX_STATIC_INIT;
+
+static void new_generation(void);
+static void get_stats(struct exec_mem_stats *stats);
+
+static size_t align_len(size_t len) {
+    return (len + ALLOC_ALIGN - 1) & ~(size_t)(ALLOC_ALIGN - 1);
+}
+
+static uint8_t *arena_base(struct arena const *arena) {
+    return native + (size_t)(arena - arenas) * ARENA_SIZE;
+}
+
+static struct alloc_chunk *chunk_rw(struct alloc_chunk *chunk) {
+    return (struct alloc_chunk*)exec_mem_rw(chunk);
+}
+
+static void commit_range(uint8_t *first, size_t len) {
+#ifdef _WIN32
+    if (!VirtualAlloc(first, len, MEM_COMMIT, PAGE_EXECUTE_READWRITE))
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+#elif defined(ENABLE_JIT_WX)
+    if (mprotect(first, len, PROT_READ | PROT_EXEC) != 0 ||
+        mprotect(exec_mem_rw(first), len, PROT_READ | PROT_WRITE) != 0) {
+        error_set_errno_val(errno);
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    }
+#else
+    if (mprotect(first, len, PROT_READ | PROT_WRITE | PROT_EXEC) != 0) {
+        error_set_errno_val(errno);
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    }
+#endif
+}
+
+static void decommit_range(uint8_t *first, size_t len) {
+#ifdef _WIN32
+    VirtualFree(first, len, MEM_DECOMMIT);
+#elif defined(ENABLE_JIT_WX)
+    mprotect(first, len, PROT_NONE);
+    mprotect(exec_mem_rw(first), len, PROT_NONE);
+    fallocate(exec_mem_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+              first - native, len);
+#else
+    /*
+     * mapping fresh anonymous memory over the range throws away the old
+     * pages.
+     */
+    if (mmap(first, len, PROT_NONE,
+             MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+             -1, 0) == MAP_FAILED) {
+        error_set_errno_val(errno);
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    }
+#endif
+}
+
+// make sure the first len bytes of the arena are committed
+static void arena_commit(struct arena *arena, size_t len) {
+    if (len <= arena->committed)
+        return;
+
+    size_t new_committed = (len + COMMIT_SIZE - 1) & ~(size_t)(COMMIT_SIZE - 1);
+    commit_range(arena_base(arena) + arena->committed,
+                 new_committed - arena->committed);
+    arena->committed = new_committed;
+}
+
+static void arena_reclaim(struct arena *arena) {
+    if (arena->committed)
+        decommit_range(arena_base(arena), arena->committed);
+    arena->committed = 0;
+    arena->top = 0;
+    arena->in_use = false;
+    free_arenas[n_free_arenas++] = arena - arenas;
+}
+
+static struct arena *arena_take(void) {
+    if (!n_free_arenas)
+        return NULL;
+    struct arena *arena = arenas + free_arenas[--n_free_arenas];
+    arena->in_use = true;
+    arena->top = 0;
+    arena->live_bytes = 0;
+    arena->n_live = 0;
+    return arena;
+}
 
 void exec_mem_init(void) {
 #ifdef _WIN32
-    native = VirtualAlloc(NULL, X86_64_ALLOC_SIZE, MEM_RESERVE | MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+    native = VirtualAlloc(NULL, X86_64_ALLOC_SIZE, MEM_RESERVE, PAGE_NOACCESS);
     if (!native)
         RAISE_ERROR(ERROR_FAILED_ALLOC);
-    DWORD garbage;
-    if (!VirtualProtect(native, X86_64_ALLOC_SIZE,
-                        PAGE_EXECUTE_READWRITE, &garbage))
+#elif defined(ENABLE_JIT_WX)
+    /*
+     * the same memfd is mapped twice, back-to-back.  Keeping both views in one
+     * reservation means that generated code can still use RIP-relative
+     * addressing to reach data in the writable view.
+     */
+    exec_mem_fd = memfd_create("washdc_exec_mem", 0);
+    if (exec_mem_fd < 0) {
+        error_set_errno_val(errno);
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    }
+    if (ftruncate(exec_mem_fd, X86_64_ALLOC_SIZE) != 0) {
+        error_set_errno_val(errno);
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    }
+
+    void *rsv = mmap(NULL, 2 * (size_t)X86_64_ALLOC_SIZE, PROT_NONE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (rsv == MAP_FAILED) {
+        error_set_errno_val(errno);
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    }
+    native = (uint8_t*)rsv;
+    exec_mem_rw_offs = X86_64_ALLOC_SIZE;
+
+    if (mmap(native, X86_64_ALLOC_SIZE, PROT_NONE, MAP_SHARED | MAP_FIXED,
+             exec_mem_fd, 0) == MAP_FAILED ||
+        mmap(native + exec_mem_rw_offs, X86_64_ALLOC_SIZE, PROT_NONE,
+             MAP_SHARED | MAP_FIXED, exec_mem_fd, 0) == MAP_FAILED) {
+        error_set_errno_val(errno);
         RAISE_ERROR(ERROR_FAILED_ALLOC);
+    }
 #else
-    native = mmap(NULL, X86_64_ALLOC_SIZE, PROT_WRITE | PROT_EXEC | PROT_READ,
-                  MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-    if (native == MAP_FAILED)
+    void *rsv = mmap(NULL, X86_64_ALLOC_SIZE, PROT_NONE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (rsv == MAP_FAILED)
         RAISE_ERROR(ERROR_FAILED_ALLOC);
+    native = (uint8_t*)rsv;
 #endif
 
-    free_mem = native;
-    free_mem->next = NULL;
-    free_mem->len = X86_64_ALLOC_SIZE;
-    free_mem->pprev = &free_mem;
+    memset(arenas, 0, sizeof(arenas));
 
-#ifdef INVARIANTS
-    free_mem->magic = FREE_CHUNK_MAGIC;
-#endif
+    // push them backwards so that the lowest addresses get used first
+    unsigned idx;
+    n_free_arenas = 0;
+    for (idx = N_ARENAS; idx > 0; idx--)
+        free_arenas[n_free_arenas++] = idx - 1;
+
+    cur_arena = NULL;
+    n_allocations = 0;
 }
 
 void exec_mem_cleanup(void) {
+    struct exec_mem_stats stats;
+    exec_mem_get_stats(&stats);
+    exec_mem_print_stats(&stats);
+
 #ifdef _WIN32
     VirtualFree(native, 0, MEM_RELEASE);
+#elif defined(ENABLE_JIT_WX)
+    munmap(native, 2 * (size_t)X86_64_ALLOC_SIZE);
+    close(exec_mem_fd);
+    exec_mem_fd = -1;
+    exec_mem_rw_offs = 0;
 #else
     munmap(native, X86_64_ALLOC_SIZE);
 #endif
     native = NULL;
+    cur_arena = NULL;
 }
 
-/*
- * This function always returns memory that is aligned to an 8-byte boundary
- * due to autism.  Strictly speaking, alignment is not needed on x86 but I like
- * it.
- */
 void* exec_mem_alloc(size_t len_req) {
-    struct free_chunk *curs;
-    struct free_chunk *candidate = NULL;
-    size_t len = len_req;
-
-    // add in metadata plus room for padding
-    len += sizeof(struct alloc_chunk) + 8;
-
-    // make sure the next chunk after the one we return is 8-byte aligned
-    while (len % 8)
-        len++;
-
-    /*
-     * pull off of the beginning of the largest available allocation.
-     * this way, reallocations are more likely to succeed.
-     */
-    for (curs = free_mem; curs; curs = curs->next) {
-#ifdef INVARIANTS
-        if (curs->magic != FREE_CHUNK_MAGIC) {
-            LOG_ERROR("%s - memory corruption detected at %p\n",
-                      __func__, curs);
-            RAISE_ERROR(ERROR_INTEGRITY);
-        }
-#endif
-
-        if (curs->len >= len) {
-            if (!candidate || curs->len > candidate->len)
-                candidate = curs;
-        }
-    }
+    size_t len = align_len(ALLOC_HDR_LEN + len_req);
 
-    if (!candidate) {
-        struct exec_mem_stats stats;
-        LOG_ERROR("%s - failed alloc of size %llu\n",
+    if (len > ARENA_SIZE) {
+        LOG_ERROR("%s - allocation of size %llu is bigger than an arena\n",
                   __func__, (unsigned long long)len);
-        LOG_ERROR("exec_mem stats dump follows\n");
-        exec_mem_get_stats(&stats);
-        exec_mem_print_stats(&stats);
         return NULL;
     }
 
-    if (candidate->len == len) {
-        // easy case - just remove candidate from the pool
-        if (candidate->next)
-            candidate->next->pprev = candidate->pprev;
-        *candidate->pprev = candidate->next;
-    } else if (candidate->len - len < MIN_FREE_CHUNK_SIZE) {
-        /*
-         * remove the candidate from the pool and increase length because we
-         * can't possibly store another chunk after this.
-         */
-        len = candidate->len;
-        if (candidate->next)
-            candidate->next->pprev = candidate->pprev;
-        *candidate->pprev = candidate->next;
-    } else {
-        // split candidate allocation
-        struct free_chunk *new_chunk =
-            (struct free_chunk*)(((uint8_t*)candidate) + len/* sizeof(candidate) */);
-        new_chunk->next = candidate->next;
-        if (new_chunk->next)
-            new_chunk->next->pprev = &new_chunk->next;
-        new_chunk->pprev = candidate->pprev;
-        *new_chunk->pprev = new_chunk;
-        new_chunk->len = candidate->len - len;
-#ifdef INVARIANTS
-        new_chunk->magic = FREE_CHUNK_MAGIC;
-#endif
+    washdc_mutex_lock(&exec_mem_lock);
+
+    if (!cur_arena ||
+        (cur_arena->top &&
+         ARENA_SIZE - cur_arena->top < len + ARENA_HEADROOM)) {
+        new_generation();
+        cur_arena = arena_take();
+        if (!cur_arena) {
+            struct exec_mem_stats stats;
+            get_stats(&stats);
+            washdc_mutex_unlock(&exec_mem_lock);
+
+            LOG_ERROR("%s - failed alloc of size %llu\n",
+                      __func__, (unsigned long long)len);
+            LOG_ERROR("exec_mem stats dump follows\n");
+            exec_mem_print_stats(&stats);
+            return NULL;
+        }
     }
 
-    struct alloc_chunk *chunk = (struct alloc_chunk*)(void*)candidate;
-    chunk->len = len;
-    chunk->len_req = len_req;
+    struct arena *arena = cur_arena;
+    arena_commit(arena, arena->top + len);
 
+    struct alloc_chunk *chunk =
+        (struct alloc_chunk*)(arena_base(arena) + arena->top);
+    struct alloc_chunk *chunk_w = chunk_rw(chunk);
+    chunk_w->len = len;
+    chunk_w->len_req = len_req;
 #ifdef INVARIANTS
-    chunk->magic = ALLOC_CHUNK_MAGIC;
+    chunk_w->magic = ALLOC_CHUNK_MAGIC;
 #endif
 
-    /*
-     * align the output.  This is safe to do because we reserved an extra
-     * 8 bytes earlier when we were determing the allocation length.
-     */
-    uintptr_t ret_ptr = (uintptr_t)(void*)candidate + sizeof(*chunk);
-    while (ret_ptr % 8)
-        ret_ptr++;
-
+    arena->top += len;
+    arena->live_bytes += len;
+    arena->n_live++;
     n_allocations++;
 
-    void *ret = (void*)ret_ptr;
-    memset(ret, 0, len_req);
+    void *ret = ((uint8_t*)chunk) + ALLOC_HDR_LEN;
+    memset(exec_mem_rw(ret), 0, len_req);
+
+    washdc_mutex_unlock(&exec_mem_lock);
     return ret;
 }
 
-void exec_mem_free(void *ptr) {
-    // match behavior of the libc free function by ignoring NULL
-    if (!ptr)
-        return;
-
-    void *alloc_start = get_alloc_start(ptr);
-    struct alloc_chunk *alloc = (struct alloc_chunk*)alloc_start;
-    struct free_chunk *free_chunk = (struct free_chunk*)alloc_start;
-
-    uintptr_t as_int = (uintptr_t)alloc_start;
+/*
+ * This returns the struct alloc_chunk at the start of the allocation, and the
+ * arena it belongs to.
+ */
+static struct alloc_chunk *get_chunk(void *alloc_ptr, struct arena **arenap) {
+    uint8_t *ptr = (uint8_t*)alloc_ptr;
 
-#ifdef INVARIANTS
-    if (as_int % 8) {
-        LOG_ERROR("0x%08llx is not 8-byte aligned!\n", (long long)as_int);
-        RAISE_ERROR(ERROR_INTEGRITY);
-    }
+#ifdef ENABLE_JIT_WX
+    // translate pointers into the writable view back to the executable view
+    if (ptr >= native + exec_mem_rw_offs)
+        ptr -= exec_mem_rw_offs;
 #endif
 
-#ifdef INVARIANTS
-    if (alloc->magic != ALLOC_CHUNK_MAGIC) {
-        LOG_ERROR("Corrupted alloc_chunk at %p\n", alloc);
+    if (ptr < native + ALLOC_HDR_LEN || ptr >= native + X86_64_ALLOC_SIZE) {
+        LOG_ERROR("%s - %p is not in exec_mem\n", __func__, alloc_ptr);
         RAISE_ERROR(ERROR_INTEGRITY);
     }
-#endif
 
-    size_t len = alloc->len;
+    struct alloc_chunk *chunk = (struct alloc_chunk*)(ptr - ALLOC_HDR_LEN);
 
-    memset(free_chunk, 0, sizeof(*free_chunk));
-
-    if (!free_mem) {
-        // Oh wow, this is the only chunk.
 #ifdef INVARIANTS
-        free_chunk->magic = FREE_CHUNK_MAGIC;
-#endif
-        free_chunk->len = len;
-        free_chunk->pprev = &free_mem;
-        free_mem = free_chunk;
-        goto successful_free;
+    if (chunk_rw(chunk)->magic != ALLOC_CHUNK_MAGIC) {
+        LOG_ERROR("Corrupted alloc_chunk at %p\n", chunk);
+        RAISE_ERROR(ERROR_INTEGRITY);
     }
-
-    uintptr_t first_addr = as_int;
-    uintptr_t last_addr = first_addr + (len - 1);
-
-    uintptr_t free_mem_first = (uintptr_t)(void*)free_mem;
-    if ((free_mem_first - 1) > last_addr) {
-        // this is the new first chunk
-#ifdef INVARIANTS
-        free_chunk->magic = FREE_CHUNK_MAGIC;
 #endif
-        free_chunk->len = len;
-        free_chunk->pprev = &free_mem;
-        free_chunk->next = free_mem;
-        free_chunk->next->pprev = &free_chunk->next;
-        free_mem = free_chunk;
-        goto successful_free;
-    } else if ((free_mem_first - 1) == last_addr) {
-        // absorb free_mem into this chunk and make it the new free_mem
-#ifdef INVARIANTS
-        free_chunk->magic = FREE_CHUNK_MAGIC;
-#endif
-        free_chunk->len = len + free_mem->len;
-        free_chunk->next = free_mem->next;
-        if (free_chunk->next)
-            free_chunk->next->pprev = &free_chunk->next;
-        free_chunk->pprev = &free_mem;
-        free_mem = free_chunk;
-        goto successful_free;
-    }
 
-    struct free_chunk *curs, *pre = NULL, *post = NULL;
-    for (curs = free_mem; curs; curs = curs->next) {
+    *arenap = arenas + (((uint8_t*)chunk - native) >> ARENA_SHIFT);
+    return chunk;
+}
 
-#ifdef INVARIANTS
-        if (curs->magic != FREE_CHUNK_MAGIC)
-            RAISE_ERROR(ERROR_INTEGRITY);
-#endif
+void exec_mem_free(void *ptr) {
+    // match behavior of the libc free function by ignoring NULL
+    if (!ptr)
+        return;
 
-        struct free_chunk *next = curs->next;
-        if (next) {
-            uintptr_t next_first = (uintptr_t)(void*)next;
-            if (next_first > last_addr) {
-                pre = curs;
-                post = next;
-                break;
-            }
-        } else {
-            pre = curs;
-            post = NULL;
-            break;
-        }
-    }
+    washdc_mutex_lock(&exec_mem_lock);
 
-    if (!pre) {
-        RAISE_ERROR(ERROR_INTEGRITY);
-    }
+    struct arena *arena;
+    struct alloc_chunk *chunk = get_chunk(ptr, &arena);
+    struct alloc_chunk *chunk_w = chunk_rw(chunk);
+    size_t offs = (uint8_t*)chunk - arena_base(arena);
 
-#ifdef INVARIANTS
-    if (pre->magic != FREE_CHUNK_MAGIC)
-        RAISE_ERROR(ERROR_INTEGRITY);
-    if (post && post->magic != FREE_CHUNK_MAGIC)
+    if (!arena->in_use || !arena->n_live || arena->live_bytes < chunk_w->len)
         RAISE_ERROR(ERROR_INTEGRITY);
-#endif
-
-    uintptr_t pre_first = (uintptr_t)(void*)pre;
-    uintptr_t pre_last = pre_first + (pre->len - 1);
 
-    if (post) {
-#ifdef INVARIANTS
-        if (post->pprev != &pre->next)
-            RAISE_ERROR(ERROR_INTEGRITY);
-#endif
+    arena->live_bytes -= chunk_w->len;
+    arena->n_live--;
+    n_allocations--;
 
-        // add the new free chunk inbetween pre and post
-        uintptr_t post_first = (uintptr_t)(void*)post;
-#ifdef INVARIANTS
-        uintptr_t post_last = post_first + (post->len - 1);
-
-        if (post_first <= last_addr) {
-            LOG_ERROR("pre range: 0x%08llx through 0x%08llx\n",
-                      (unsigned long long)pre_first,
-                      (unsigned long long)pre_last);
-            LOG_ERROR("new chunk: 0x%08llx through 0x%08llx\n",
-                      (unsigned long long)first_addr,
-                      (unsigned long long)last_addr);
-            LOG_ERROR("post range: 0x%08llx through 0x%08llx\n",
-                      (unsigned long long)post_first,
-                      (unsigned long long)post_last);
-            RAISE_ERROR(ERROR_INTEGRITY);
-        }
-#endif
+    // if this was the most recent allocation then its space can be reused
+    if (offs + chunk_w->len == arena->top)
+        arena->top = offs;
 
 #ifdef INVARIANTS
-        free_chunk->magic = FREE_CHUNK_MAGIC;
+    chunk_w->magic = FREE_CHUNK_MAGIC;
 #endif
-        free_chunk->len = len;
-
-        if ((first_addr - 1) == pre_last) {
-            // absorb free_chunk into pre
-            pre->len += len;
-            free_chunk = pre;
-        } else {
-            // build a link from pre to free_chunk
-            pre->next = free_chunk;
-            free_chunk->pprev = &pre->next;
-        }
-
-        if ((post_first - 1) == last_addr) {
-            // absorb post into free_chunk
-            free_chunk->next = post->next;
-            if (free_chunk->next)
-                free_chunk->next->pprev = &free_chunk->next;
-            free_chunk->len += post->len;
-        } else {
-            // build a link from free_chunk to post
-            free_chunk->next = post;
-            post->pprev = &free_chunk->next;
-        }
 
-        goto successful_free;
-    } else if ((first_addr - 1) == pre_last) {
-        // this is easy, abosrb free_chunk into pre
-        // pre is the last chunk, and it will continue to be the last chunk
-        pre->len += len;
-        goto successful_free;
-    } else {
-        // free_chunk is the new last chunk
-#ifdef INVARIANTS
-        free_chunk->magic = FREE_CHUNK_MAGIC;
-#endif
-        free_chunk->len = len;
-        free_chunk->next = NULL;
-        free_chunk->pprev = &pre->next;
-        pre->next = free_chunk;
-        goto successful_free;
+    if (!arena->n_live) {
+        if (arena == cur_arena)
+            arena->top = 0;
+        else
+            arena_reclaim(arena);
     }
 
-    RAISE_ERROR(ERROR_INTEGRITY);
-
-successful_free:
-    n_allocations--;
+    washdc_mutex_unlock(&exec_mem_lock);
 }
 
 int exec_mem_grow(void *ptr, size_t len_req) {
-    struct alloc_chunk *alloc = (struct alloc_chunk*)get_alloc_start(ptr);
-    uintptr_t alloc_first = (uintptr_t)alloc;
-    uintptr_t alloc_last = alloc_first + (alloc->len - 1);
-
-    /*
-     * len_req_aligned represents the size of the allocation post-growth
-     * including the size of the struct alloc_chunk and any necessary padding.
-     */
-    size_t grow_amt = len_req - alloc->len_req;
-    size_t len_req_aligned = alloc->len + grow_amt;
-    while (len_req_aligned % 8)
-        len_req_aligned++;
-    uintptr_t alloc_goal = alloc_first + len_req_aligned - 1;
+    int ret = 0;
 
-#ifdef INVARIANTS
-    if (alloc->magic != ALLOC_CHUNK_MAGIC)
-        RAISE_ERROR(ERROR_INTEGRITY);
-#endif
+    washdc_mutex_lock(&exec_mem_lock);
 
-    if (alloc->len_req >= len_req)
-        return 0; // nothing to do here, i suppose
+    struct arena *arena;
+    struct alloc_chunk *chunk = get_chunk(ptr, &arena);
+    struct alloc_chunk *chunk_w = chunk_rw(chunk);
 
-    struct free_chunk *curs;
-    for (curs = free_mem; curs; curs = curs->next) {
-        uintptr_t curs_first = (uintptr_t)curs;
-        uintptr_t curs_last = curs_first + (curs->len - 1);
+    if (chunk_w->len_req >= len_req)
+        goto unlock; // nothing to do here, i suppose
 
-#ifdef INVARIANTS
-        // make sure the allocation doesn't overlap with the free chunk
-        if ((alloc_first >= curs_first && alloc_first <= curs_last) ||
-            (alloc_last >= curs_first && alloc_last <= curs_last))
-            RAISE_ERROR(ERROR_INTEGRITY);
-#endif
+    size_t offs = (uint8_t*)chunk - arena_base(arena);
+    size_t new_len = align_len(ALLOC_HDR_LEN + len_req);
 
-#ifdef INVARIANTS
-        if (curs->magic != FREE_CHUNK_MAGIC)
-            RAISE_ERROR(ERROR_INTEGRITY);
-#endif
+    // only the most recent allocation in the arena can grow
+    if (offs + chunk_w->len != arena->top || offs + new_len > ARENA_SIZE) {
+        ret = -1;
+        goto unlock;
+    }
 
-        if ((curs_first - 1) == alloc_last) {
-            if (alloc_goal <= curs_last) {
-#ifdef INVARIANTS
-                if (*curs->pprev != curs)
-                    RAISE_ERROR(ERROR_INTEGRITY);
-#endif
+    arena_commit(arena, offs + new_len);
 
-                // we can do it!
-                if (alloc->len - len_req_aligned + curs->len <
-                    MIN_FREE_CHUNK_SIZE) {
-                    // take the entire chunk
-                    if (curs->next)
-                        curs->next->pprev = curs->pprev;
-                    *curs->pprev = curs->next;
-                    alloc->len += curs->len;
-                    memset(curs, 0, sizeof(*curs));
-                    alloc->len_req = len_req;
-#ifdef INVARIANTS
-                    if (curs == free_mem)
-                        RAISE_ERROR(ERROR_INTEGRITY);
-#endif
-                    return 0;
-                } else {
-                    // split curs
-                    struct free_chunk *new_chunk =
-                        (struct free_chunk*)(void*)(alloc_goal + 1);
-                    memset(new_chunk, 0xaa, sizeof(*new_chunk));
-#ifdef INVARIANTS
-                    new_chunk->magic = FREE_CHUNK_MAGIC;
-#endif
-                    new_chunk->pprev = curs->pprev;
-                    *new_chunk->pprev = new_chunk;
-                    new_chunk->next = curs->next;
-                    if (new_chunk->next)
-                        new_chunk->next->pprev = &new_chunk->next;
-                    new_chunk->len = curs_last - (alloc_goal + 1) + 1;
-                    alloc->len_req = len_req;
-                    alloc->len = alloc_goal - alloc_first + 1;
-#ifdef INVARIANTS
-                    if (curs == free_mem)
-                        RAISE_ERROR(ERROR_INTEGRITY);
-#endif
-                    return 0;
-                }
-            } else {
-                /*
-                 * exec_mem_free always merges adjacent regions when it is
-                 * possible to do so.  This means that if curs isn't big enough
-                 * to grow the allocation, then it cannot be done.
-                 */
-                return -1;
-            }
-        } else if (curs_first > alloc_last) {
-            /*
-             * memory is too fragmented, the byte immediately following the
-             * allocation is already taken.
-             */
-            return -1;
-        }
-    }
+    arena->live_bytes += new_len - chunk_w->len;
+    arena->top = offs + new_len;
+    chunk_w->len = new_len;
+    chunk_w->len_req = len_req;
 
-    return -1;
+unlock:
+    washdc_mutex_unlock(&exec_mem_lock);
+    return ret;
 }
 
-static void *get_alloc_start(void *alloc_ptr) {
-    uintptr_t as_int = (uintptr_t)alloc_ptr;
+static void new_generation(void) {
+    if (!cur_arena)
+        return;
 
-    /*
-     * as_int will be aligned to eight bytes.
-     * the alloc_chunk will begin before that at the first 8-byte boundary
-     * which has enough space between it and as_int to hold alloc_chunk.
-     */
-    size_t disp = sizeof(struct alloc_chunk);
-    while (disp % 8)
-        disp++;
-    as_int -= disp;
+    struct arena *arena = cur_arena;
+    cur_arena = NULL;
+    if (!arena->n_live)
+        arena_reclaim(arena);
+}
 
-    return (void*)as_int;
+void exec_mem_new_generation(void) {
+    washdc_mutex_lock(&exec_mem_lock);
+    new_generation();
+    washdc_mutex_unlock(&exec_mem_lock);
 }
 
 void exec_mem_get_stats(struct exec_mem_stats *stats) {
-    size_t n_bytes = 0;
-    unsigned n_free_chunks = 0;
-    struct free_chunk *curs;
-    for (curs = free_mem; curs; curs = curs->next) {
-        n_bytes += curs->len;
-        n_free_chunks++;
+    washdc_mutex_lock(&exec_mem_lock);
+    get_stats(stats);
+    washdc_mutex_unlock(&exec_mem_lock);
+}
+
+static void get_stats(struct exec_mem_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+
+    unsigned idx;
+    for (idx = 0; idx < N_ARENAS; idx++) {
+        struct arena const *arena = arenas + idx;
+        stats->committed_bytes += arena->committed;
+        if (arena->in_use) {
+            stats->used_bytes += arena->top;
+            stats->live_bytes += arena->live_bytes;
+            stats->n_arenas_used++;
+        }
     }
 
     stats->total_bytes = X86_64_ALLOC_SIZE;
-    stats->free_bytes = n_bytes;
     stats->n_allocations = n_allocations;
-    stats->n_free_chunks = n_free_chunks;
+    stats->n_arenas_free = n_free_arenas;
 }
 
 void exec_mem_print_stats(struct exec_mem_stats const *stats) {
-    double percent =
-        100.0 * (double)stats->free_bytes / (double)stats->total_bytes;
+    double frag_percent = 0.0;
+    if (stats->used_bytes) {
+        frag_percent = 100.0 * (double)(stats->used_bytes - stats->live_bytes) /
+            (double)stats->used_bytes;
+    }
 
-    LOG_INFO("exec_mem: %llu free bytes out of %llu total (%f%%)\n",
-             (unsigned long long)stats->free_bytes,
-             (unsigned long long)stats->total_bytes,
-             percent);
+    LOG_INFO("exec_mem: %llu bytes committed out of %llu reserved\n",
+             (unsigned long long)stats->committed_bytes,
+             (unsigned long long)stats->total_bytes);
+    LOG_INFO("exec_mem: %llu live bytes out of %llu used (%f%% fragmented)\n",
+             (unsigned long long)stats->live_bytes,
+             (unsigned long long)stats->used_bytes, frag_percent);
     LOG_INFO("exec_mem: There are %u active allocations\n",
              stats->n_allocations);
-    LOG_INFO("exec_mem: There are %u total free chunks\n", stats->n_free_chunks);
+    LOG_INFO("exec_mem: %u arenas in use, %u free\n",
+             stats->n_arenas_used, stats->n_arenas_free);
 }
 
 #ifdef INVARIANTS
 void exec_mem_check_integrity(void) {
-    struct free_chunk *curs;
-    for (curs = free_mem; curs->next; curs = curs->next) {
-        struct free_chunk *next = curs->next;
-        uintptr_t curs_first = (uintptr_t)curs;
-        uintptr_t curs_last = curs_first + (curs->len - 1);
-        uintptr_t next_first = (uintptr_t)next;
-
-        if (next_first - 1 == curs_last) {
-            LOG_ERROR("exec_mem: needless memory fragmentation\n");
+    washdc_mutex_lock(&exec_mem_lock);
+
+    unsigned idx;
+    for (idx = 0; idx < N_ARENAS; idx++) {
+        struct arena const *arena = arenas + idx;
+        if (!arena->in_use) {
+            if (arena->top || arena->committed) {
+                LOG_ERROR("exec_mem: unused arena %u is not empty\n", idx);
+                RAISE_ERROR(ERROR_INTEGRITY);
+            }
+            continue;
+        }
+
+        if (arena->top > arena->committed || arena->committed > ARENA_SIZE) {
+            LOG_ERROR("exec_mem: arena %u is not committed\n", idx);
             RAISE_ERROR(ERROR_INTEGRITY);
         }
 
-        struct free_chunk *curs2;
-        for (curs2 = next; curs2; curs2 = curs2->next) {
-            uintptr_t curs2_first = (uintptr_t)curs2;
-            uintptr_t curs2_last = curs2_first + (curs2->len - 1);
-
-            if (curs2_first <= curs_last || curs2_last <= curs_last) {
-                LOG_ERROR("exec_mem: out-of-order memory chunks\n");
-                LOG_ERROR("[0x%08llx-0x%08llx] should not come after "
-                          "[0x%08llx-0x%08llx]\n",
-                          (long long)curs_first, (long long)curs_last,
-                          (long long)curs2_first, (long long)curs2_last);
+        size_t offs = 0, live_bytes = 0;
+        unsigned n_live = 0;
+        while (offs < arena->top) {
+            struct alloc_chunk *chunk = chunk_rw((struct alloc_chunk*)
+                                                 (arena_base(arena) + offs));
+            if ((chunk->magic != ALLOC_CHUNK_MAGIC &&
+                 chunk->magic != FREE_CHUNK_MAGIC) ||
+                !chunk->len || chunk->len % ALLOC_ALIGN) {
+                LOG_ERROR("exec_mem: memory corruption detected at %p\n",
+                          arena_base(arena) + offs);
                 RAISE_ERROR(ERROR_INTEGRITY);
             }
-
-            if ((curs_first >= curs2_first && curs_first <= curs2_last) ||
-                (curs_last >= curs2_first && curs_last <= curs2_first)) {
-                LOG_ERROR("exec_mem: memory overlap\n");
-                LOG_ERROR("[0x%08llx-0x%08llx] overlaps with "
-                          "[0x%08llx-0x%08llx]\n",
-                          (long long)curs_first, (long long)curs_last,
-                          (long long)curs2_first, (long long)curs2_last);
-                RAISE_ERROR(ERROR_INTEGRITY);
+            if (chunk->magic == ALLOC_CHUNK_MAGIC) {
+                n_live++;
+                live_bytes += chunk->len;
             }
+            offs += chunk->len;
+        }
+
+        if (offs != arena->top || n_live != arena->n_live ||
+            live_bytes != arena->live_bytes) {
+            LOG_ERROR("exec_mem: arena %u has inconsistent bookkeeping\n",
+                      idx);
+            RAISE_ERROR(ERROR_INTEGRITY);
         }
     }
+
+    washdc_mutex_unlock(&exec_mem_lock);
 }
 #endif
@@ -29,10 +29,29 @@
 
 #include <stddef.h>
 
+/*
+ * exec_mem reserves one big region of address space for JIT code and divides
+ * it into arenas.  Allocations are bump-allocated out of the current arena,
+ * and memory is only committed as the bump pointer reaches it.  Nothing gets
+ * reused until every allocation in an arena has been freed, at which point
+ * the entire arena is decommitted and returned to the pool in one step.
+ *
+ * If ENABLE_JIT_WX is defined then the region is mapped twice: once as
+ * read+execute and once as read+write, so that no page is ever writable and
+ * executable at the same time.  exec_mem_alloc returns pointers into the
+ * executable view, and anything that writes to exec_mem (including the code
+ * emitter) must go through exec_mem_rw to get the writable alias.
+ */
+
 void exec_mem_init(void);
 void exec_mem_cleanup(void);
 
 void *exec_mem_alloc(size_t len_req);
+
+/*
+ * ptr can point to either view of the allocation (ie it can come from
+ * exec_mem_alloc or exec_mem_rw).
+ */
 void exec_mem_free(void *ptr);
 
 /*
@@ -43,20 +62,52 @@ void exec_mem_free(void *ptr);
  * allocator is designed for executable code, and moving an allocation could
  * damage existing pointers and offsets; that is why this function can call.
  *
- * For best results, only attempt to grow the latest allocation.  The allocator
- * used by exec_mem_alloc will always pick an allocation at the beginning of the
- * largest contiguous area of memory; this means that growing the most recent
- * allocation will have a high probability of success, but growing older
- * allocations will have a high probability of failure.  I don't think the JIT
- * will ever have a good reason to grow an old allocation, anyways.
+ * Only the latest allocation in an arena can grow.  exec_mem_alloc always
+ * leaves plenty of room after a new allocation, so growing the most recent
+ * allocation will almost always succeed.  I don't think the JIT will ever
+ * have a good reason to grow an old allocation, anyways.
  */
 int exec_mem_grow(void *ptr, size_t len_req);
 
+/*
+ * stop allocating from the current arena.  Everything allocated after this
+ * goes into a fresh arena, so when the code cache throws out all of its
+ * blocks at once the arenas they were in become completely free and can be
+ * reclaimed whole instead of being pinned by blocks compiled afterwards.
+ */
+void exec_mem_new_generation(void);
+
+#ifdef ENABLE_JIT_WX
+extern ptrdiff_t exec_mem_rw_offs;
+
+// return the writable alias of a pointer returned by exec_mem_alloc
+static inline void *exec_mem_rw(void *ptr) {
+    return (char*)ptr + exec_mem_rw_offs;
+}
+#else
+static inline void *exec_mem_rw(void *ptr) {
+    return ptr;
+}
+#endif
+
 struct exec_mem_stats {
-    size_t free_bytes;
+    // size of the reserved region
     size_t total_bytes;
+
+    // how much of the reserved region is actually backed by memory
+    size_t committed_bytes;
+
+    /*
+     * bytes which have been bump-allocated out of arenas that are still in
+     * use, and how many of those bytes belong to allocations which have not
+     * been freed yet.  The difference between the two is fragmentation.
+     */
+    size_t used_bytes;
+    size_t live_bytes;
+
     unsigned n_allocations;
-    unsigned n_free_chunks;
+    unsigned n_arenas_used;
+    unsigned n_arenas_free;
 };
 
 void exec_mem_get_stats(struct exec_mem_stats *stats);
@@ -64,10 +115,11 @@ void exec_mem_print_stats(struct exec_mem_stats const *stats);
 
 #ifdef INVARIANTS
 /*
- * This checks to make sure no blocks overlap each other, and there is no
- * needless fragmentation.  It cannot check for "dangling pointer" situations
- * where some memory allocation that another component thinks is not free
- * actually is.  It also cannot prove there are no memory leaks.
+ * This checks to make sure every arena's allocations add up to its bump
+ * pointer and that the live allocation counts are accurate.  It cannot check
+ * for "dangling pointer" situations where some memory allocation that another
+ * component thinks is not free actually is.  It also cannot prove there are
+ * no memory leaks.
  */
 void exec_mem_check_integrity(void);
 #endif
@@ -0,0 +1,445 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#if !defined(__linux__) || !defined(__x86_64__)
+#error fastmem is only supported on x86_64 linux
+#endif
+
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "log.h"
+#include "memory.h"
+#include "washdc/error.h"
+#include "washdc/MemoryMap.h"
+#include "code_block_x86_64.h"
+#include "exec_mem.h"
+
+#include "fastmem.h"
+
+/*
+ * The window covers the full 32-bit address space rather than just the 29-bit
+ * external address space because P4 and the operand cache RAM area don't
+ * mirror into the lower 512MB.  Masking addresses down to 29 bits would send
+ * those accesses to whatever happens to be mapped underneath them instead of
+ * faulting.  The guard area at the end catches multi-byte accesses that start
+ * on the last page.
+ */
+#define FASTMEM_WINDOW_LEN (((size_t)1) << 32)
+#define FASTMEM_GUARD_LEN (((size_t)1) << MEMORY_MAP_PAGE_SHIFT)
+
+#define FASTMEM_SITE_EMPTY 0
+#define FASTMEM_SITE_TOMBSTONE 1
+
+#define FASTMEM_SITE_TBL_INIT_LEN 4096
+
+// x86 opcode for jmp with an 8-bit displacement
+#define JMP_DISP8_OPCODE 0xeb
+
+// a mapping of system RAM into the window
+struct fastmem_view {
+    size_t win_offs, ram_offs, len;
+};
+
+static struct memory_map const *fastmem_map;
+static struct Memory *fastmem_ram;
+static uint8_t *window;
+
+static struct fastmem_view *views;
+static unsigned n_views;
+
+/*
+ * open-addressed hash table which maps the host address of every fastmem
+ * access to its slow path.  This gets read from the signal handler, so it may
+ * only be modified while JIT code is not running.
+ */
+static struct fastmem_site *site_tbl;
+static size_t site_tbl_len, n_sites, n_tombstones;
+
+static unsigned long n_patched, n_unprotected;
+
+static struct sigaction old_sigsegv_action;
+
+static void fastmem_map_ram(struct memory_map const *map,
+                            struct Memory const *ram);
+static void protect_ram_page(unsigned page_no, int prot);
+static void fastmem_sigsegv(int sig, siginfo_t *info, void *uctx_ptr);
+static void site_tbl_resize(size_t new_len);
+
+void fastmem_init(struct memory_map const *map, struct Memory *ram) {
+    LOG_INFO("initializing fastmem...\n");
+
+    // code pages get write-protected one RAM page at a time
+    if (sysconf(_SC_PAGESIZE) != MEMORY_PAGE_SIZE) {
+        error_set_feature("fastmem on hosts whose page size is not 4KB");
+        RAISE_ERROR(ERROR_UNIMPLEMENTED);
+    }
+
+    void *win = mmap(NULL, FASTMEM_WINDOW_LEN + FASTMEM_GUARD_LEN, PROT_NONE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (win == MAP_FAILED) {
+        error_set_errno_val(errno);
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    }
+    window = (uint8_t*)win;
+    fastmem_map = map;
+    fastmem_ram = ram;
+
+    fastmem_map_ram(map, ram);
+
+    // the JIT might already have compiled code from some pages
+    unsigned page_no;
+    for (page_no = 0; page_no < MEMORY_N_PAGES; page_no++)
+        if (ram->page_flags[page_no] & MEMORY_PAGE_CODE)
+            fastmem_watch_ram_page(page_no, true);
+
+    site_tbl_resize(FASTMEM_SITE_TBL_INIT_LEN);
+    n_patched = n_unprotected = 0;
+
+    struct sigaction act;
+    memset(&act, 0, sizeof(act));
+    act.sa_sigaction = fastmem_sigsegv;
+    act.sa_flags = SA_SIGINFO | SA_NODEFER;
+    sigemptyset(&act.sa_mask);
+    if (sigaction(SIGSEGV, &act, &old_sigsegv_action) != 0) {
+        error_set_errno_val(errno);
+        RAISE_ERROR(ERROR_EXT_FAILURE);
+    }
+}
+
+void fastmem_cleanup(void) {
+    LOG_INFO("fastmem: %lu sites were patched to the slow path\n", n_patched);
+    LOG_INFO("fastmem: %lu writes to code pages were caught\n",
+             n_unprotected);
+
+    sigaction(SIGSEGV, &old_sigsegv_action, NULL);
+
+    if (n_sites)
+        LOG_ERROR("%s - %u fastmem sites were never removed\n",
+                  __func__, (unsigned)n_sites);
+    free(site_tbl);
+    site_tbl = NULL;
+    site_tbl_len = n_sites = n_tombstones = 0;
+
+    munmap(window, FASTMEM_WINDOW_LEN + FASTMEM_GUARD_LEN);
+    window = NULL;
+    fastmem_map = NULL;
+    fastmem_ram = NULL;
+
+    free(views);
+    views = NULL;
+    n_views = 0;
+}
+
+bool fastmem_enabled(struct memory_map const *map) {
+    return map && map == fastmem_map;
+}
+
+void *fastmem_base(void) {
+    return window;
+}
+
+void fastmem_watch_ram_page(unsigned page_no, bool watch) {
+    if (window)
+        protect_ram_page(page_no, watch ? PROT_READ : PROT_READ | PROT_WRITE);
+}
+
+/*
+ * change the protection of every view of the given page of RAM.  This gets
+ * called from the signal handler, so it must not allocate memory.
+ */
+static void protect_ram_page(unsigned page_no, int prot) {
+    size_t ram_offs = ((size_t)page_no) << MEMORY_PAGE_SHIFT;
+    unsigned view_no;
+    for (view_no = 0; view_no < n_views; view_no++) {
+        struct fastmem_view const *view = views + view_no;
+        if (ram_offs >= view->ram_offs &&
+            ram_offs < view->ram_offs + view->len) {
+            uint8_t *page = window + view->win_offs +
+                (ram_offs - view->ram_offs);
+            if (mprotect(page, MEMORY_PAGE_SIZE, prot) != 0) {
+                error_set_errno_val(errno);
+                RAISE_ERROR(ERROR_EXT_FAILURE);
+            }
+        }
+    }
+}
+
+/*
+ * map a view of RAM over every page in the window which the memory map
+ * resolves to RAM.  Contiguous runs of pages get coalesced so that each
+ * mirror only costs one mmap.
+ */
+static void fastmem_map_ram(struct memory_map const *map,
+                            struct Memory const *ram) {
+    static size_t const page_len = ((size_t)1) << MEMORY_MAP_PAGE_SHIFT;
+    size_t run_addr = 0, run_offs = 0, run_len = 0;
+    unsigned n_alloc = 0;
+    size_t page_no;
+
+    for (page_no = 0; page_no <= MEMORY_MAP_N_PAGES; page_no++) {
+        bool is_ram = false;
+        size_t page_addr = page_no << MEMORY_MAP_PAGE_SHIFT;
+        size_t offs = 0;
+
+        if (page_no < MEMORY_MAP_N_PAGES) {
+            unsigned ent = map->page_tbl[page_no];
+            if (ent != MEMORY_MAP_PAGE_UNMAPPED &&
+                ent != MEMORY_MAP_PAGE_MIXED) {
+                struct memory_map_region const *region =
+                    map->regions + (ent - 1);
+                if (region->host_ptr == ram->mem) {
+                    is_ram = true;
+                    offs = page_addr & region->host_mask;
+                }
+            }
+        }
+
+        if (run_len && (!is_ram || offs != run_offs + run_len)) {
+            void *view = mmap(window + run_addr, run_len,
+                              PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+                              ram->fd, run_offs);
+            if (view == MAP_FAILED) {
+                error_set_errno_val(errno);
+                error_set_address(run_addr);
+                RAISE_ERROR(ERROR_FAILED_ALLOC);
+            }
+
+            if (n_views >= n_alloc) {
+                n_alloc = n_alloc ? n_alloc * 2 : 16;
+                struct fastmem_view *new_views = (struct fastmem_view*)
+                    realloc(views, n_alloc * sizeof(struct fastmem_view));
+                if (!new_views)
+                    RAISE_ERROR(ERROR_FAILED_ALLOC);
+                views = new_views;
+            }
+            views[n_views].win_offs = run_addr;
+            views[n_views].ram_offs = run_offs;
+            views[n_views].len = run_len;
+            n_views++;
+
+            run_len = 0;
+        }
+
+        if (is_ram) {
+            if (!run_len) {
+                run_addr = page_addr;
+                run_offs = offs;
+            }
+            run_len += page_len;
+        }
+    }
+
+    LOG_INFO("fastmem: mapped %u views of system RAM\n", n_views);
+}
+
+static inline size_t site_hash(uintptr_t site) {
+    return (size_t)((site * 0x9e3779b97f4a7c15ull) >> 32);
+}
+
+static struct fastmem_site *site_find(uintptr_t site) {
+    size_t mask = site_tbl_len - 1;
+    size_t idx = site_hash(site) & mask;
+    for (;;) {
+        struct fastmem_site *ent = site_tbl + idx;
+        if (ent->site == site)
+            return ent;
+        else if (ent->site == FASTMEM_SITE_EMPTY)
+            return NULL;
+        idx = (idx + 1) & mask;
+    }
+}
+
+static void site_insert(uintptr_t site, uintptr_t slow_path) {
+    size_t mask = site_tbl_len - 1;
+    size_t idx = site_hash(site) & mask;
+    for (;;) {
+        struct fastmem_site *ent = site_tbl + idx;
+        if (ent->site == FASTMEM_SITE_EMPTY ||
+            ent->site == FASTMEM_SITE_TOMBSTONE) {
+            if (ent->site == FASTMEM_SITE_TOMBSTONE)
+                n_tombstones--;
+            ent->site = site;
+            ent->slow_path = slow_path;
+            n_sites++;
+            return;
+        }
+        idx = (idx + 1) & mask;
+    }
+}
+
+static void site_tbl_resize(size_t new_len) {
+    struct fastmem_site *old_tbl = site_tbl;
+    size_t old_len = site_tbl_len;
+
+    site_tbl = (struct fastmem_site*)calloc(new_len, sizeof(*site_tbl));
+    if (!site_tbl)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    site_tbl_len = new_len;
+    n_sites = n_tombstones = 0;
+
+    size_t idx;
+    for (idx = 0; idx < old_len; idx++) {
+        if (old_tbl[idx].site != FASTMEM_SITE_EMPTY &&
+            old_tbl[idx].site != FASTMEM_SITE_TOMBSTONE)
+            site_insert(old_tbl[idx].site, old_tbl[idx].slow_path);
+    }
+    free(old_tbl);
+}
+
+void fastmem_add_site(struct code_block_x86_64 *blk,
+                      void *site, void *slow_path) {
+    intptr_t disp = (intptr_t)slow_path - ((intptr_t)site + 2);
+    if (disp < INT8_MIN || disp > INT8_MAX)
+        RAISE_ERROR(ERROR_TOO_BIG);
+
+    if (blk->n_fastmem_sites >= blk->fastmem_sites_alloc) {
+        unsigned new_alloc = blk->fastmem_sites_alloc ?
+            blk->fastmem_sites_alloc * 2 : 8;
+        struct fastmem_site *new_sites = (struct fastmem_site*)
+            realloc(blk->fastmem_sites, new_alloc * sizeof(*new_sites));
+        if (!new_sites)
+            RAISE_ERROR(ERROR_FAILED_ALLOC);
+        blk->fastmem_sites = new_sites;
+        blk->fastmem_sites_alloc = new_alloc;
+    }
+
+    struct fastmem_site *ent = blk->fastmem_sites + blk->n_fastmem_sites++;
+    ent->site = (uintptr_t)site;
+    ent->slow_path = (uintptr_t)slow_path;
+}
+
+void fastmem_register_sites(struct code_block_x86_64 *blk) {
+    if (blk->fastmem_sites_registered)
+        RAISE_ERROR(ERROR_INTEGRITY);
+
+    unsigned idx;
+    for (idx = 0; idx < blk->n_fastmem_sites; idx++) {
+        // keep the load factor under one half, counting tombstones
+        if ((n_sites + n_tombstones + 1) * 2 > site_tbl_len) {
+            size_t new_len = site_tbl_len;
+            if ((n_sites + 1) * 4 > site_tbl_len)
+                new_len *= 2;
+            site_tbl_resize(new_len);
+        }
+
+        site_insert(blk->fastmem_sites[idx].site,
+                    blk->fastmem_sites[idx].slow_path);
+    }
+
+    blk->fastmem_sites_registered = true;
+}
+
+void fastmem_remove_sites(struct code_block_x86_64 *blk) {
+    unsigned idx;
+    if (blk->fastmem_sites_registered) {
+        for (idx = 0; idx < blk->n_fastmem_sites; idx++) {
+            struct fastmem_site *ent =
+                site_find(blk->fastmem_sites[idx].site);
+            if (!ent)
+                RAISE_ERROR(ERROR_INTEGRITY);
+            ent->site = FASTMEM_SITE_TOMBSTONE;
+            ent->slow_path = 0;
+            n_sites--;
+            n_tombstones++;
+        }
+    }
+
+    free(blk->fastmem_sites);
+    blk->fastmem_sites = NULL;
+    blk->n_fastmem_sites = blk->fastmem_sites_alloc = 0;
+    blk->fastmem_sites_registered = false;
+}
+
+static void fastmem_sigsegv(int sig, siginfo_t *info, void *uctx_ptr) {
+    ucontext_t *uctx = (ucontext_t*)uctx_ptr;
+    uintptr_t fault_addr = (uintptr_t)info->si_addr;
+    uintptr_t win_start = (uintptr_t)window;
+
+    if (fault_addr >= win_start &&
+        fault_addr < win_start + FASTMEM_WINDOW_LEN + FASTMEM_GUARD_LEN) {
+        /*
+         * writes to pages of RAM which have code on them fault because those
+         * pages are write-protected.  Mark the page as dirty and unprotect it,
+         * then retry the write.  The page gets protected again once the code
+         * cache throws out the blocks on it and something compiles new ones.
+         */
+        uintptr_t win_offs = fault_addr - win_start;
+        unsigned view_no;
+        for (view_no = 0; view_no < n_views; view_no++) {
+            struct fastmem_view const *view = views + view_no;
+            if (win_offs >= view->win_offs &&
+                win_offs < view->win_offs + view->len) {
+                size_t ram_offs = view->ram_offs + (win_offs - view->win_offs);
+                unsigned page_no = ram_offs >> MEMORY_PAGE_SHIFT;
+                uint8_t *flags = fastmem_ram->page_flags + page_no;
+                if (*flags & MEMORY_PAGE_CODE) {
+                    if (!(*flags & MEMORY_PAGE_DIRTY)) {
+                        *flags |= MEMORY_PAGE_DIRTY;
+                        fastmem_ram->n_dirty_pages++;
+                    }
+                    protect_ram_page(page_no, PROT_READ | PROT_WRITE);
+                    n_unprotected++;
+                    return;
+                }
+                break;
+            }
+        }
+
+        uintptr_t rip = uctx->uc_mcontext.gregs[REG_RIP];
+        struct fastmem_site *ent = site_find(rip);
+        if (ent) {
+            /*
+             * overwrite the faulting instruction with a jump to the slow path
+             * so this site never faults again, then resume execution on the
+             * slow path.  Whatever bytes are left over from the original
+             * instruction are dead code.
+             */
+            uint8_t *code = (uint8_t*)exec_mem_rw((void*)rip);
+            code[0] = JMP_DISP8_OPCODE;
+            code[1] = (uint8_t)(int8_t)(ent->slow_path - (rip + 2));
+            uctx->uc_mcontext.gregs[REG_RIP] = ent->slow_path;
+            n_patched++;
+            return;
+        }
+    }
+
+    // not ours; hand it to whoever was there before
+    if (old_sigsegv_action.sa_flags & SA_SIGINFO) {
+        old_sigsegv_action.sa_sigaction(sig, info, uctx_ptr);
+    } else if (old_sigsegv_action.sa_handler == SIG_DFL ||
+               old_sigsegv_action.sa_handler == SIG_IGN) {
+        /*
+         * restore the default action and return; the faulting instruction
+         * will be re-executed and kill the process like it normally would.
+         */
+        sigaction(SIGSEGV, &old_sigsegv_action, NULL);
+    } else {
+        old_sigsegv_action.sa_handler(sig);
+    }
+}
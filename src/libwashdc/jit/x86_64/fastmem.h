@@ -0,0 +1,100 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+#ifndef FASTMEM_H_
+#define FASTMEM_H_
+
+#ifndef ENABLE_JIT_X86_64
+#error this file should not be built when the x86_64 JIT backend is disabled
+#endif
+
+#ifndef ENABLE_FASTMEM
+#error this file should not be built when fastmem is disabled
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * fastmem reserves a window of host address space the size of the SH4's
+ * entire 32-bit address space and maps every page of it which belongs to main
+ * system RAM onto the same memfd that backs dc_mem.  Everything else in the
+ * window is left inaccessible.
+ *
+ * The native JIT emits guest loads and stores as a single mov relative to the
+ * base of the window.  When one of these touches a page that isn't RAM, the
+ * host raises SIGSEGV and the fault handler rewrites that mov into a jump to
+ * the slow-path (the normal native_mem implementation) which is emitted right
+ * after it.  Every subsequent execution of that site goes straight to the slow
+ * path.
+ *
+ * Pages of RAM which the JIT has compiled code from are write-protected in the
+ * window.  Writes to those pages fault, and the fault handler marks the page
+ * as dirty in the struct Memory's page flags before unprotecting it so that
+ * the code cache knows to invalidate the blocks compiled from it.
+ */
+
+struct memory_map;
+struct Memory;
+struct code_block_x86_64;
+
+void fastmem_init(struct memory_map const *map, struct Memory *ram);
+void fastmem_cleanup(void);
+
+// returns true if accesses to the given map can go through the fastmem window
+bool fastmem_enabled(struct memory_map const *map);
+
+void *fastmem_base(void);
+
+/*
+ * write-protect (or unprotect) the given page of RAM (see MEMORY_PAGE_SHIFT)
+ * in the fastmem window.  This does nothing if fastmem is not initialized.
+ */
+void fastmem_watch_ram_page(unsigned page_no, bool watch);
+
+struct fastmem_site {
+    uintptr_t site;
+    uintptr_t slow_path;
+};
+
+/*
+ * record the instruction at site as a fastmem access belonging to blk.
+ * slow_path is where execution should resume if site faults.  The distance
+ * from site to slow_path must fit in a signed 8-bit displacement.
+ *
+ * The fault handler doesn't know about the site until
+ * fastmem_register_sites is called for blk.  This way blocks can be compiled
+ * on another thread without touching the fault handler's table.
+ */
+void fastmem_add_site(struct code_block_x86_64 *blk,
+                      void *site, void *slow_path);
+
+/*
+ * hand all of blk's fastmem sites to the fault handler.  This must be called
+ * from the emulation thread before blk is executed for the first time.
+ */
+void fastmem_register_sites(struct code_block_x86_64 *blk);
+
+// unregister all of blk's fastmem sites.  Call this before freeing blk.
+void fastmem_remove_sites(struct code_block_x86_64 *blk);
+
+#endif
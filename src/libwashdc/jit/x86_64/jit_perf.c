@@ -0,0 +1,264 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#include "log.h"
+#include "hw/sh4/sh4_jit.h"
+#include "code_block_x86_64.h"
+
+#include "jit_perf.h"
+
+// see tools/perf/Documentation/jitdump-specification.txt in the linux tree
+#define JITDUMP_MAGIC 0x4a695444
+#define JITDUMP_VERSION 1
+#define JITDUMP_EM_X86_64 62
+#define JITDUMP_CODE_LOAD 0
+#define JITDUMP_CODE_CLOSE 3
+
+struct jitdump_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t total_size;
+    uint32_t elf_mach;
+    uint32_t pad1;
+    uint32_t pid;
+    uint64_t timestamp;
+    uint64_t flags;
+};
+
+struct jitdump_record {
+    uint32_t id;
+    uint32_t total_size;
+    uint64_t timestamp;
+};
+
+struct jitdump_code_load {
+    struct jitdump_record rec;
+    uint32_t pid;
+    uint32_t tid;
+    uint64_t vma;
+    uint64_t code_addr;
+    uint64_t code_size;
+    uint64_t code_index;
+    // followed by the name (NUL-terminated) and then the code bytes
+};
+
+static enum jit_perf_mode perf_mode;
+static FILE *perf_file;
+static void *jitdump_marker;
+static size_t jitdump_marker_len;
+static uint64_t code_index;
+static unsigned long n_loaded, n_unloaded;
+
+#ifdef __linux__
+
+static uint64_t jit_perf_timestamp(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void jit_perf_block_name(char *out, size_t len, jit_hash hash) {
+    snprintf(out, len, "sh4_%08x_pr%u_sz%u",
+             (unsigned)(hash & SH4_JIT_HASH_MASK),
+             (unsigned)((hash >> SH4_JIT_HASH_PR_SHIFT) & 1),
+             (unsigned)((hash >> SH4_JIT_HASH_SZ_SHIFT) & 1));
+}
+
+static void jit_perf_open_map(void) {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/perf-%d.map", (int)getpid());
+    perf_file = fopen(path, "w");
+    if (!perf_file) {
+        LOG_ERROR("%s - unable to open %s\n", __func__, path);
+        return;
+    }
+    LOG_INFO("writing JIT symbols to %s\n", path);
+}
+
+static void jit_perf_open_jitdump(void) {
+    char path[64];
+    snprintf(path, sizeof(path), "jit-%d.dump", (int)getpid());
+    perf_file = fopen(path, "w+");
+    if (!perf_file) {
+        LOG_ERROR("%s - unable to open %s\n", __func__, path);
+        return;
+    }
+
+    /*
+     * perf record finds jitdump files by looking for an executable mapping of
+     * them, so this mapping has to stay around until the file is closed.
+     */
+    jitdump_marker_len = sysconf(_SC_PAGESIZE);
+    jitdump_marker = mmap(NULL, jitdump_marker_len, PROT_READ | PROT_EXEC,
+                          MAP_PRIVATE, fileno(perf_file), 0);
+    if (jitdump_marker == MAP_FAILED) {
+        LOG_ERROR("%s - unable to map %s\n", __func__, path);
+        jitdump_marker = NULL;
+        fclose(perf_file);
+        perf_file = NULL;
+        return;
+    }
+
+    struct jitdump_header hdr = {
+        .magic = JITDUMP_MAGIC,
+        .version = JITDUMP_VERSION,
+        .total_size = sizeof(hdr),
+        .elf_mach = JITDUMP_EM_X86_64,
+        .pid = (uint32_t)getpid(),
+        .timestamp = jit_perf_timestamp()
+    };
+    fwrite(&hdr, sizeof(hdr), 1, perf_file);
+    fflush(perf_file);
+
+    LOG_INFO("writing JIT code to %s\n", path);
+}
+
+void jit_perf_init(enum jit_perf_mode mode) {
+    perf_mode = mode;
+    perf_file = NULL;
+    jitdump_marker = NULL;
+    code_index = 0;
+    n_loaded = n_unloaded = 0;
+
+    if (mode == JIT_PERF_MAP)
+        jit_perf_open_map();
+    else if (mode == JIT_PERF_JITDUMP)
+        jit_perf_open_jitdump();
+
+    if (!perf_file)
+        perf_mode = JIT_PERF_NONE;
+}
+
+void jit_perf_cleanup(void) {
+    if (perf_mode == JIT_PERF_NONE)
+        return;
+
+    if (perf_mode == JIT_PERF_JITDUMP) {
+        struct jitdump_record rec = {
+            .id = JITDUMP_CODE_CLOSE,
+            .total_size = sizeof(rec),
+            .timestamp = jit_perf_timestamp()
+        };
+        fwrite(&rec, sizeof(rec), 1, perf_file);
+        munmap(jitdump_marker, jitdump_marker_len);
+        jitdump_marker = NULL;
+    }
+
+    fclose(perf_file);
+    perf_file = NULL;
+
+    LOG_INFO("JIT perf: %lu blocks loaded, %lu unloaded\n",
+             n_loaded, n_unloaded);
+    perf_mode = JIT_PERF_NONE;
+}
+
+void jit_perf_block_loaded(jit_hash hash,
+                           struct code_block_x86_64 const *blk) {
+    if (perf_mode == JIT_PERF_NONE)
+        return;
+
+    char name[64];
+    jit_perf_block_name(name, sizeof(name), hash);
+
+    /*
+     * native can be a little past the start of the allocation if the block
+     * skips its stack frame, but the whole allocation is reported so that the
+     * prologue gets attributed to the block too.
+     */
+    uintptr_t start = (uintptr_t)blk->exec_mem_alloc_start;
+    size_t len = blk->bytes_used;
+
+    if (perf_mode == JIT_PERF_MAP) {
+        fprintf(perf_file, "%lx %lx %s\n",
+                (unsigned long)start, (unsigned long)len, name);
+    } else {
+        size_t name_len = strlen(name) + 1;
+        struct jitdump_code_load rec = {
+            .rec = {
+                .id = JITDUMP_CODE_LOAD,
+                .total_size = sizeof(rec) + name_len + len,
+                .timestamp = jit_perf_timestamp()
+            },
+            .pid = (uint32_t)getpid(),
+            .tid = (uint32_t)syscall(SYS_gettid),
+            .vma = start,
+            .code_addr = start,
+            .code_size = len,
+            .code_index = code_index++
+        };
+        fwrite(&rec, sizeof(rec), 1, perf_file);
+        fwrite(name, name_len, 1, perf_file);
+        fwrite(blk->exec_mem_alloc_start, len, 1, perf_file);
+    }
+
+    /*
+     * perf only reads these once the program is done, but flushing keeps the
+     * file useful if the emulator crashes.
+     */
+    fflush(perf_file);
+    n_loaded++;
+}
+
+void jit_perf_block_unloaded(jit_hash hash,
+                             struct code_block_x86_64 const *blk) {
+    if (perf_mode == JIT_PERF_NONE)
+        return;
+
+    char name[64];
+    jit_perf_block_name(name, sizeof(name), hash);
+    LOG_DBG("JIT perf: unloading %s at %p\n",
+            name, blk->exec_mem_alloc_start);
+    n_unloaded++;
+}
+
+#else
+
+void jit_perf_init(enum jit_perf_mode mode) {
+    if (mode != JIT_PERF_NONE)
+        LOG_WARN("JIT perf output is only supported on Linux\n");
+    perf_mode = JIT_PERF_NONE;
+}
+
+void jit_perf_cleanup(void) {
+}
+
+void jit_perf_block_loaded(jit_hash hash,
+                           struct code_block_x86_64 const *blk) {
+}
+
+void jit_perf_block_unloaded(jit_hash hash,
+                             struct code_block_x86_64 const *blk) {
+}
+
+#endif
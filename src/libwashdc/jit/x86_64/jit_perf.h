@@ -0,0 +1,67 @@
+/*******************************************************************************
+ *
+ *
+ *    WashingtonDC Dreamcast Emulator
+ *    Copyright (C) 2020 snickerbockers
+ *
+ *    This program is free software: you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation, either version 3 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *
+ ******************************************************************************/
+
+
+#ifndef JIT_PERF_H_
+#define JIT_PERF_H_
+
+#ifndef ENABLE_JIT_X86_64
+#error this file should not be built when the x86_64 JIT backend is disabled
+#endif
+
+#include "jit/defs.h"
+
+/*
+ * Lets host profilers see native JIT code.  Without this, all the time spent
+ * in compiled blocks shows up as anonymous addresses inside of exec_mem.
+ *
+ * In JIT_PERF_MAP mode, every block is written to /tmp/perf-<pid>.map, which
+ * perf reads when it reports on samples.  In JIT_PERF_JITDUMP mode, every
+ * block (along with its code bytes) is written to jit-<pid>.dump in the
+ * current directory in the jitdump format.  That file needs to be merged into
+ * a perf recording with perf inject --jit, and perf record has to be run with
+ * -k mono for the timestamps to line up.
+ *
+ * Blocks are named after their guest PC and the FPSCR's PR and SZ bits.
+ * Neither format has a way to unload code, so blocks which get thrown away are
+ * only logged.
+ */
+
+enum jit_perf_mode {
+    JIT_PERF_NONE,
+    JIT_PERF_MAP,
+    JIT_PERF_JITDUMP
+};
+
+struct code_block_x86_64;
+
+void jit_perf_init(enum jit_perf_mode mode);
+void jit_perf_cleanup(void);
+
+// call this once blk's native code is ready to run
+void jit_perf_block_loaded(jit_hash hash, struct code_block_x86_64 const *blk);
+
+// call this before freeing a block which was passed to jit_perf_block_loaded
+void jit_perf_block_unloaded(jit_hash hash,
+                             struct code_block_x86_64 const *blk);
+
+#endif
@@ -23,25 +23,41 @@
 #include <assert.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "washdc/error.h"
 #include "dc_sched.h"
 #include "exec_mem.h"
 #include "jit/code_cache.h"
 #include "jit/jit.h"
+#include "jit/jit_block_prof.h"
 #include "abi.h"
+#include "compile_thread.h"
+#include "jit_perf.h"
+
+#ifdef ENABLE_FASTMEM
+#include "fastmem.h"
+#endif
 
 #include "emit_x86_64.h"
 #include "native_dispatch.h"
 
 #define BASIC_ALLOC 32
+#define PROBE_ALLOC 128
 
-// for native_dispatch
+/*
+ * for native_dispatch
+ *
+ * tmp_reg_1, native_reg and code_hash_reg are all volatile because the
+ * remaining non-volatile registers are reserved for pinned guest registers (see
+ * jit_x86_64_pin_regs).  None of them need to survive a function call.
+ */
 static unsigned const cachep_reg = REG_NONVOL0;
-static unsigned const tmp_reg_1 = REG_NONVOL1;
-static unsigned const native_reg = REG_NONVOL2;
+static unsigned const tmp_reg_1 = REG_ARG3;
+static unsigned const native_reg = REG_VOL0;
 static unsigned const code_cache_tbl_ptr_reg = REG_NONVOL3;
-static unsigned const code_hash_reg = REG_NONVOL4;
+static unsigned const code_hash_reg = REG_VOL1;
 
 // for native_check_cycles
 static unsigned const sched_tgt_reg = REG_NONVOL0;
@@ -61,6 +77,33 @@ static void jmp_to_addr(void *addr, unsigned clobber_reg);
 
 static void jmp_to_addr_jbe(void *addr, unsigned clobber_reg);
 
+static void inc_quad(uint64_t *qptr);
+
+#ifndef JIT_PROFILE
+static void native_dispatch_link_stub_create(struct native_dispatch_meta *meta);
+static void native_dispatch_tier0_stub_create(struct native_dispatch_meta *meta);
+#endif
+
+/*
+ * hash value which no block can have.  Unlinked link slots compare against
+ * this so that they never match.
+ */
+#define NATIVE_DISPATCH_NO_LINK 0xffffffff
+
+#define LINK_STAT_LINKED 0
+#define LINK_STAT_DISPATCHED 1
+#define LINK_STAT_COUNT 2
+
+#define TIER0_VAL_HASH 0
+#define TIER0_VAL_CYCLES 1
+#define TIER0_VAL_COUNT 2
+
+/*
+ * list of every native_dispatch_exit which is currently linked to at least one
+ * other block.
+ */
+static struct native_dispatch_exit *linked_exits;
+
 void native_dispatch_entry_create(struct native_dispatch_meta *meta);
 
 #ifdef JIT_PROFILE
@@ -70,6 +113,8 @@ static void create_profile_code(struct native_dispatch_meta *meta);
 static void
 native_dispatch_create_slow_path_entry(struct native_dispatch_meta *meta);
 
+static void native_dispatch_probe_create(struct native_dispatch_meta *meta);
+
 static void
 native_dispatch_trampoline_create(struct native_dispatch_meta *meta);
 
@@ -86,12 +131,24 @@ static void native_dispatch_ms_shadow_close(void) {
 void native_dispatch_init(struct native_dispatch_meta *meta, void *ctx_ptr) {
     meta->ctx_ptr = ctx_ptr;
 
+    /*
+     * the clock values and link stats get written by both C code and JIT
+     * code, so they use the writable view of exec_mem.
+     */
     meta->clock_vals =
-        exec_mem_alloc(sizeof(meta->clock_vals[0]) * WASHDC_CLOCK_IDX_COUNT);
+        exec_mem_rw(exec_mem_alloc(sizeof(meta->clock_vals[0]) *
+                                   WASHDC_CLOCK_IDX_COUNT));
 
     clock_set_ptrs_priv(meta->clk, meta->clock_vals);
 
+    meta->link_stats =
+        exec_mem_rw(exec_mem_alloc(sizeof(meta->link_stats[0]) *
+                                   LINK_STAT_COUNT));
+    memset(meta->link_stats, 0,
+           sizeof(meta->link_stats[0]) * LINK_STAT_COUNT);
+
     native_dispatch_create_slow_path_entry(meta);
+    native_dispatch_probe_create(meta);
     create_return_fn(meta);
 #ifdef JIT_PROFILE
     create_profile_code(meta);
@@ -99,12 +156,28 @@ void native_dispatch_init(struct native_dispatch_meta *meta, void *ctx_ptr) {
     native_dispatch_entry_create(meta);
 
     native_dispatch_trampoline_create(meta);
+#ifndef JIT_PROFILE
+    native_dispatch_link_stub_create(meta);
+
+    meta->tier0_vals =
+        exec_mem_rw(exec_mem_alloc(sizeof(meta->tier0_vals[0]) *
+                                   TIER0_VAL_COUNT));
+    memset(meta->tier0_vals, 0,
+           sizeof(meta->tier0_vals[0]) * TIER0_VAL_COUNT);
+    native_dispatch_tier0_stub_create(meta);
+#else
+    meta->link_stub = NULL;
+    meta->tier0_vals = NULL;
+    meta->tier0_stub = NULL;
+#endif
 }
 
 void native_dispatch_cleanup(struct native_dispatch_meta *meta) {
     // TODO: free all executable memory pointers
     exec_mem_free(meta->entry);
     exec_mem_free(meta->return_fn);
+    exec_mem_free(meta->dispatch_probe);
+    meta->dispatch_probe = NULL;
 #ifdef JIT_PROFILE
     exec_mem_free(meta->profile_code);
 #endif
@@ -118,12 +191,29 @@ void native_dispatch_cleanup(struct native_dispatch_meta *meta) {
 
     exec_mem_free(meta->trampoline);
     code_cache_set_default(NULL);
+
+    if (meta->link_stub)
+        exec_mem_free(meta->link_stub);
+    meta->link_stub = NULL;
+
+    exec_mem_free(meta->link_stats);
+    meta->link_stats = NULL;
+
+    if (meta->tier0_stub)
+        exec_mem_free(meta->tier0_stub);
+    meta->tier0_stub = NULL;
+
+    if (meta->tier0_vals)
+        exec_mem_free(meta->tier0_vals);
+    meta->tier0_vals = NULL;
 }
 
 static void create_return_fn(struct native_dispatch_meta *meta) {
     meta->return_fn = exec_mem_alloc(BASIC_ALLOC);
     x86asm_set_dst(meta->return_fn, NULL, BASIC_ALLOC);
 
+    jit_x86_64_emit_pinned_store(REG_VOL0);
+
     // return PC
     x86asm_mov_reg32_reg32(new_pc_reg, REG_RET);
 
@@ -274,6 +364,8 @@ void native_dispatch_entry_create(struct native_dispatch_meta *meta) {
     x86asm_mov_imm64_reg64((uintptr_t)(void*)code_cache_tbl,
                            code_cache_tbl_ptr_reg);
 
+    jit_x86_64_emit_pinned_load(REG_VOL0);
+
     /*
      * JIT code is only expected to preserve the base pointer, and to leave the
      * new value of the PC in RAX.  Other than that, it may do as it pleases.
@@ -286,20 +378,31 @@ void native_dispatch_entry_create(struct native_dispatch_meta *meta) {
 static struct cache_entry *
 dispatch_slow_path(uint32_t pc, struct native_dispatch_meta const *meta) {
     void *ctx_ptr = meta->ctx_ptr;
-    struct cache_entry *entry = code_cache_find_slow(meta->hash_func(ctx_ptr, pc));
 
-    code_cache_tbl[pc & CODE_CACHE_HASH_TBL_MASK] = entry;
+    // don't charge the lookup or the compiler to the block we came from
+    if (jit_block_prof_enabled())
+        jit_block_prof_switch(NULL);
+
+    struct cache_entry *entry = code_cache_find(meta->hash_func(ctx_ptr, pc));
 
     if (!entry->valid) {
-        meta->on_compile(ctx_ptr, meta, &entry->blk, pc);
-        entry->valid = 1;
+        if (compile_thread_enabled()) {
+            compile_thread_tier0(entry, ctx_ptr, meta, pc);
+        } else {
+            meta->on_compile(ctx_ptr, meta, &entry->blk, pc);
+#ifdef ENABLE_FASTMEM
+            fastmem_register_sites(&entry->blk.x86_64);
+#endif
+            jit_perf_block_loaded(entry->key, &entry->blk.x86_64);
+        }
+        code_cache_set_valid(entry);
     }
 
     return entry;
 }
 
 static void native_dispatch_emit(struct native_dispatch_meta const *meta) {
-    struct x86asm_lbl8 code_cache_slow_path, have_valid_ent;
+    struct x86asm_lbl8 code_cache_probe, have_valid_ent;
 
     /*
      * BEFORE CALLING THIS FUNCTION, REG_ARG0 MUST HOLD THE 32-BIT CODE HASH
@@ -312,20 +415,28 @@ static void native_dispatch_emit(struct native_dispatch_meta const *meta) {
      *    EDI holds the 32-bit SH4 PC address
      *    ECX holds the index into the code_cache_tbl
      *
+     *    Only the block's home slot is checked here.  If the block isn't
+     *    there then the dispatch_probe checks the rest of the slots that it
+     *    could be in.
+     *
      *    All other registers are considered to be "temporary" registers whose
      *    values change often.
      */
 
-    x86asm_lbl8_init(&code_cache_slow_path);
+    x86asm_lbl8_init(&code_cache_probe);
     x86asm_lbl8_init(&have_valid_ent);
 
+    inc_quad(meta->link_stats + LINK_STAT_DISPATCHED);
+
+    // this needs to match CODE_CACHE_HASH_IDX
     x86asm_mov_reg32_reg32(hash_reg, code_hash_reg);
+    x86asm_shrl_imm8_reg32(1, code_hash_reg);
     x86asm_andl_imm32_reg32(CODE_CACHE_HASH_TBL_MASK, code_hash_reg);
 
     x86asm_movq_sib_reg(code_cache_tbl_ptr_reg, 8, code_hash_reg, cachep_reg);
 
     // now check the address against the one that's still in hash_reg
-    size_t const addr_offs = offsetof(struct cache_entry, node.key);
+    size_t const addr_offs = offsetof(struct cache_entry, key);
     if (addr_offs >= 256)
         RAISE_ERROR(ERROR_INTEGRITY); // this will never happen
     x86asm_movl_disp8_reg_reg(addr_offs, cachep_reg, tmp_reg_1);
@@ -336,11 +447,17 @@ static void native_dispatch_emit(struct native_dispatch_meta const *meta) {
     x86asm_movq_disp8_reg_reg(native_offs, cachep_reg, native_reg);
 
     x86asm_cmpl_reg32_reg32(tmp_reg_1, hash_reg);
-    x86asm_jnz_lbl8(&code_cache_slow_path);// not equal
+    x86asm_jnz_lbl8(&code_cache_probe);// not equal
 
     x86asm_lbl8_define(&have_valid_ent);
     // cachep_reg points to a valid struct cache_entry which we want to jump to.
 
+    // let the code cache know this block is still in use
+    size_t const referenced_offs = offsetof(struct cache_entry, referenced);
+    if (referenced_offs >= 256)
+        RAISE_ERROR(ERROR_INTEGRITY); // this will never happen
+    x86asm_movb_imm8_disp8_reg(1, referenced_offs, cachep_reg);
+
 #ifdef JIT_PROFILE
     x86asm_pushq_reg64(native_reg);
     jmp_to_addr(meta->profile_code, REG_RET);
@@ -350,17 +467,21 @@ static void native_dispatch_emit(struct native_dispatch_meta const *meta) {
 
     // after this point no code is executed
 
-    x86asm_lbl8_define(&code_cache_slow_path);
+    x86asm_lbl8_define(&code_cache_probe);
 
     x86asm_mov_imm64_reg64((uintptr_t)have_valid_ent.ptr, REG_RET);
     x86asm_pushq_reg64(REG_RET);
-    jmp_to_addr(meta->dispatch_slow_path, REG_RET);
+    jmp_to_addr(meta->dispatch_probe, REG_RET);
 
     x86asm_lbl8_cleanup(&have_valid_ent);
-    x86asm_lbl8_cleanup(&code_cache_slow_path);
+    x86asm_lbl8_cleanup(&code_cache_probe);
 }
 
-void native_check_cycles_emit(struct native_dispatch_meta const *meta) {
+/*
+ * subtract the block's cycles from the countdown, and return to the caller of
+ * native_dispatch_entry if it ran out.
+ */
+static void emit_countdown(struct native_dispatch_meta const *meta) {
     static_assert(sizeof(dc_cycle_stamp_t) == 8,
                   "dc_cycle_stamp_t is not a quadword!");
 
@@ -372,16 +493,313 @@ void native_check_cycles_emit(struct native_dispatch_meta const *meta) {
 
     store_quad_from_reg(meta->clock_vals + WASHDC_CLOCK_IDX_COUNTDOWN,
                         countdown_reg, REG_VOL1);
+}
+
+struct native_dispatch_exit *
+native_check_cycles_emit(struct native_dispatch_meta const *meta,
+                         unsigned n_links) {
+    emit_countdown(meta);
+
+    if (n_links > NATIVE_DISPATCH_MAX_LINKS)
+        n_links = NATIVE_DISPATCH_MAX_LINKS;
+    if (!meta->link_stub)
+        n_links = 0;
+
+    if (!n_links) {
+        // call native_dispatch
+        native_dispatch_emit(meta);
+
+        /*
+         * the code created by native_dispatch_emit does not return, so
+         * execution does not continue past this point.
+         */
+        return NULL;
+    }
+
+    struct native_dispatch_exit *exit =
+        (struct native_dispatch_exit*)calloc(1, sizeof(*exit));
+    if (!exit)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    exit->n_links = n_links;
+
+    size_t const referenced_offs = offsetof(struct cache_entry, referenced);
+    if (referenced_offs >= 256)
+        RAISE_ERROR(ERROR_INTEGRITY); // this will never happen
+
+    /*
+     * each link slot compares the new hash against the hash of the block it's
+     * linked to and jumps straight to that block if they match.  Unlinked
+     * slots compare against NATIVE_DISPATCH_NO_LINK and their jump has a
+     * displacement of zero, so they always fall through to the next slot.
+     *
+     * Linked blocks never go through the code cache probe, so the slot has to
+     * mark the block as referenced itself.  Otherwise the code cache would
+     * think the hottest blocks are the least-recently-used ones.
+     */
+    unsigned link_no;
+    for (link_no = 0; link_no < n_links; link_no++) {
+        struct x86asm_lbl8 next_link;
+        x86asm_lbl8_init(&next_link);
+
+        x86asm_cmpl_imm32_reg32(NATIVE_DISPATCH_NO_LINK, hash_reg);
+        exit->links[link_no].hash_imm =
+            (uint32_t*)((uint8_t*)x86asm_get_outp() - 4);
+        x86asm_jnz_lbl8(&next_link);
+
+        inc_quad(meta->link_stats + LINK_STAT_LINKED);
+        x86asm_mov_imm64_reg64(0, native_reg);
+        exit->links[link_no].entry_imm =
+            (uint64_t*)((uint8_t*)x86asm_get_outp() - 8);
+        x86asm_movb_imm8_disp8_reg(1, referenced_offs, native_reg);
+        x86asm_jmpq_offs32(0);
+        exit->links[link_no].jmp_rel =
+            (int32_t*)((uint8_t*)x86asm_get_outp() - 4);
+
+        x86asm_lbl8_define(&next_link);
+        x86asm_lbl8_cleanup(&next_link);
+    }
+
+    // no link matched; this goes to link_call until all the links are used up
+    x86asm_jmpq_offs32(0);
+    exit->miss_rel = (int32_t*)((uint8_t*)x86asm_get_outp() - 4);
 
-    // call native_dispatch
     native_dispatch_emit(meta);
 
+    uint8_t *link_call = (uint8_t*)x86asm_get_outp();
+    exit->link_call = link_call;
+    *(int32_t*)exec_mem_rw(exit->miss_rel) =
+        link_call - ((uint8_t*)exit->miss_rel + 4);
+
+    inc_quad(meta->link_stats + LINK_STAT_DISPATCHED);
+
+    // PC is still in REG_ARG0
+    x86asm_mov_imm64_reg64((uintptr_t)exit, REG_ARG1);
+    jmp_to_addr(meta->link_stub, REG_RET);
+
+    return exit;
+}
+
+void native_check_cycles_emit_jmp(struct native_dispatch_meta const *meta,
+                                  void *dst) {
+    emit_countdown(meta);
+
+    if (!meta->link_stub) {
+        // linking is disabled, so go through native_dispatch like always
+        native_dispatch_emit(meta);
+        return;
+    }
+
+    inc_quad(meta->link_stats + LINK_STAT_LINKED);
+    jmp_to_addr(dst, REG_VOL0);
+}
+
+void native_dispatch_exit_free(struct native_dispatch_exit *exit) {
+    if (!exit)
+        return;
+
+    if (exit->n_linked) {
+        if (exit->prev_linked)
+            exit->prev_linked->next_linked = exit->next_linked;
+        else
+            linked_exits = exit->next_linked;
+        if (exit->next_linked)
+            exit->next_linked->prev_linked = exit->prev_linked;
+    }
+
+    free(exit);
+}
+
+void native_dispatch_unlink_all(void) {
+    struct native_dispatch_exit *exit = linked_exits;
+    while (exit) {
+        struct native_dispatch_exit *next = exit->next_linked;
+
+        unsigned link_no;
+        for (link_no = 0; link_no < exit->n_links; link_no++) {
+            struct native_dispatch_link *link = exit->links + link_no;
+            uint64_t *entry_imm = (uint64_t*)exec_mem_rw(link->entry_imm);
+
+            /*
+             * entries don't get freed until after they've been unlinked, so
+             * this is still safe even if the linked block is dead.
+             */
+            struct cache_entry *target =
+                (struct cache_entry*)(uintptr_t)*entry_imm;
+            if (target)
+                target->link_target = false;
+
+            *(uint32_t*)exec_mem_rw(link->hash_imm) = NATIVE_DISPATCH_NO_LINK;
+            *entry_imm = 0;
+            *(int32_t*)exec_mem_rw(link->jmp_rel) = 0;
+        }
+
+        *(int32_t*)exec_mem_rw(exit->miss_rel) =
+            (uint8_t*)exit->link_call - ((uint8_t*)exit->miss_rel + 4);
+
+        exit->n_linked = 0;
+        exit->prev_linked = exit->next_linked = NULL;
+        exit = next;
+    }
+
+    linked_exits = NULL;
+}
+
+void native_dispatch_get_link_stats(struct native_dispatch_meta const *meta,
+                                    uint64_t *n_linked, uint64_t *n_dispatched) {
+    if (meta->link_stats) {
+        *n_linked = meta->link_stats[LINK_STAT_LINKED];
+        *n_dispatched = meta->link_stats[LINK_STAT_DISPATCHED];
+    } else {
+        *n_linked = *n_dispatched = 0;
+    }
+}
+
+#ifndef JIT_PROFILE
+/*
+ * called by the link_stub.  This finds (and compiles if necessary) the block
+ * at pc, links the exit to it and returns the block's cache_entry so that the
+ * link_stub can jump to it.
+ *
+ * Tier 0 blocks don't get linked to because their native code is going to
+ * change once the compile thread is done with them.
+ */
+static struct cache_entry *
+dispatch_link(uint32_t pc, struct native_dispatch_exit *exit,
+              struct native_dispatch_meta const *meta) {
+    struct cache_entry *entry = dispatch_slow_path(pc, meta);
+    uint8_t *native = (uint8_t*)entry->blk.x86_64.native;
+
+    if (entry->tier0)
+        return entry;
+
+    if (exit->n_linked < exit->n_links) {
+        struct native_dispatch_link *link = exit->links + exit->n_linked;
+        intptr_t disp = native - ((uint8_t*)link->jmp_rel + 4);
+        if (disp < INT32_MIN || disp > INT32_MAX)
+            return entry;
+
+        *(uint32_t*)exec_mem_rw(link->hash_imm) = entry->key;
+        *(uint64_t*)exec_mem_rw(link->entry_imm) = (uintptr_t)entry;
+        *(int32_t*)exec_mem_rw(link->jmp_rel) = disp;
+        entry->link_target = true;
+
+        if (!exit->n_linked) {
+            exit->prev_linked = NULL;
+            exit->next_linked = linked_exits;
+            if (linked_exits)
+                linked_exits->prev_linked = exit;
+            linked_exits = exit;
+        }
+
+        if (++exit->n_linked == exit->n_links)
+            *(int32_t*)exec_mem_rw(exit->miss_rel) = 0;
+    }
+
+    return entry;
+}
+
+static void native_dispatch_link_stub_create(struct native_dispatch_meta *meta) {
+    size_t const native_offs = offsetof(struct cache_entry, blk.x86_64.native);
+    if (native_offs >= 256)
+        RAISE_ERROR(ERROR_INTEGRITY); // this will never happen
+
+    meta->link_stub = exec_mem_alloc(BASIC_ALLOC);
+    x86asm_set_dst(meta->link_stub, NULL, BASIC_ALLOC);
+
     /*
-     * the code created by native_dispatch_emit does not return, so execution
-     * does not continue past this point.
+     * PC is in REG_ARG0 and the native_dispatch_exit is in REG_ARG1.
+     *
+     * The stack is already aligned on a 16-byte boundary because we got here
+     * via a jump from the end of a code block.
      */
+    x86asm_mov_imm64_reg64((uintptr_t)(void*)meta, REG_ARG2);
+    x86asm_mov_imm64_reg64((uintptr_t)(void*)dispatch_link, REG_RET);
+
+#ifdef ABI_MICROSOFT
+    native_dispatch_ms_shadow_open();
+#endif
+    x86asm_call_reg(REG_RET);
+#ifdef ABI_MICROSOFT
+    native_dispatch_ms_shadow_close();
+#endif
+
+    /*
+     * cachep_reg needs to point to the block's cache_entry, same as when it
+     * gets jumped to from native_dispatch; the tier0_stub relies on this.
+     */
+    x86asm_mov_reg64_reg64(REG_RET, cachep_reg);
+    x86asm_movq_disp8_reg_reg(native_offs, cachep_reg, native_reg);
+    x86asm_jmpq_reg64(native_reg); // tail-call elimination
 }
 
+/*
+ * called by the tier0_stub.  This runs ent's tier 0 block in the IL
+ * interpreter and returns the new PC.
+ */
+static uint32_t dispatch_tier0(struct cache_entry *ent,
+                               struct native_dispatch_meta const *meta) {
+    void *ctx_ptr = meta->ctx_ptr;
+    struct tier0_block *tier0 = ent->tier0;
+
+    if (!tier0)
+        RAISE_ERROR(ERROR_INTEGRITY); // this will never happen
+
+    compile_thread_tier0_hit(ent, ctx_ptr, meta);
+
+    struct jit_block_prof *prof = ent->blk.prof;
+    if (prof) {
+        jit_block_prof_switch(prof);
+        prof->guest_cycles += tier0->intp.cycle_count;
+    }
+
+    uint32_t new_pc = code_block_intp_exec(ctx_ptr, &tier0->intp);
+    compile_thread_tier0_exit(tier0, new_pc);
+
+    meta->tier0_vals[TIER0_VAL_HASH] = meta->hash_func(ctx_ptr, new_pc);
+    meta->tier0_vals[TIER0_VAL_CYCLES] = tier0->intp.cycle_count;
+
+    // this might free tier0 if the native version of the block is ready
+    compile_thread_publish();
+
+    return new_pc;
+}
+
+static void native_dispatch_tier0_stub_create(struct native_dispatch_meta *meta) {
+    meta->tier0_stub = exec_mem_alloc(BASIC_ALLOC);
+    x86asm_set_dst(meta->tier0_stub, NULL, BASIC_ALLOC);
+
+    /*
+     * cachep_reg points to the block's cache_entry.
+     *
+     * The stack is already aligned on a 16-byte boundary because we got here
+     * via a jump from native_dispatch or the link_stub.
+     *
+     * The IL interpreter works on the guest registers in memory, so the
+     * pinned ones get written back first and reloaded afterwards.
+     */
+    jit_x86_64_emit_pinned_store(REG_RET);
+    x86asm_mov_reg64_reg64(cachep_reg, REG_ARG0);
+    x86asm_mov_imm64_reg64((uintptr_t)(void*)meta, REG_ARG1);
+    x86asm_mov_imm64_reg64((uintptr_t)(void*)dispatch_tier0, REG_RET);
+
+#ifdef ABI_MICROSOFT
+    native_dispatch_ms_shadow_open();
+#endif
+    x86asm_call_reg(REG_RET);
+#ifdef ABI_MICROSOFT
+    native_dispatch_ms_shadow_close();
+#endif
+
+    jit_x86_64_emit_pinned_load(REG_VOL0);
+
+    // now leave the same way a native block would
+    x86asm_mov_reg32_reg32(REG_RET, new_pc_reg);
+    load_quad_into_reg(meta->tier0_vals + TIER0_VAL_HASH, hash_reg);
+    load_quad_into_reg(meta->tier0_vals + TIER0_VAL_CYCLES, cycle_stamp_reg);
+    native_check_cycles_emit(meta, 0);
+}
+#endif
+
 static void
 native_dispatch_create_slow_path_entry(struct native_dispatch_meta *meta) {
     size_t const native_offs = offsetof(struct cache_entry, blk.x86_64.native);
@@ -415,6 +833,66 @@ native_dispatch_create_slow_path_entry(struct native_dispatch_meta *meta) {
     x86asm_ret();
 }
 
+/*
+ * the dispatch_probe is where native_dispatch goes when the block it wants
+ * isn't in its home slot in the code_cache_tbl.  It checks the rest of the
+ * slots the block could be in, and goes to the dispatch_slow_path if it hits
+ * an empty slot or runs out of slots to check.
+ *
+ * Like the dispatch_slow_path, the address to return to is on the stack and
+ * cachep_reg and native_reg are set when it returns.
+ */
+static void native_dispatch_probe_create(struct native_dispatch_meta *meta) {
+    struct x86asm_lbl8 next_slot, miss, hit;
+
+    size_t const addr_offs = offsetof(struct cache_entry, key);
+    size_t const native_offs = offsetof(struct cache_entry, blk.x86_64.native);
+    if (addr_offs >= 256 || native_offs >= 256)
+        RAISE_ERROR(ERROR_INTEGRITY); // this will never happen
+
+    x86asm_lbl8_init(&next_slot);
+    x86asm_lbl8_init(&miss);
+    x86asm_lbl8_init(&hit);
+
+    meta->dispatch_probe = exec_mem_alloc(PROBE_ALLOC);
+    x86asm_set_dst(meta->dispatch_probe, NULL, PROBE_ALLOC);
+
+    /*
+     * empty slots point to the fake_cache_entry, and native_reg counts how
+     * many slots are left to check.  The home slot has already been checked.
+     */
+    x86asm_mov_imm64_reg64((uintptr_t)&meta->fake_cache_entry, REG_RET);
+    x86asm_mov_imm32_reg32(CODE_CACHE_MAX_PROBE - 1, native_reg);
+
+    x86asm_lbl8_define(&next_slot);
+
+    // no block can be past an empty slot
+    x86asm_cmpq_reg64_reg64(REG_RET, cachep_reg);
+    x86asm_jz_lbl8(&miss);
+
+    x86asm_addl_imm8_reg32(1, code_hash_reg);
+    x86asm_andl_imm32_reg32(CODE_CACHE_HASH_TBL_MASK, code_hash_reg);
+    x86asm_movq_sib_reg(code_cache_tbl_ptr_reg, 8, code_hash_reg, cachep_reg);
+
+    x86asm_movl_disp8_reg_reg(addr_offs, cachep_reg, tmp_reg_1);
+    x86asm_cmpl_reg32_reg32(tmp_reg_1, hash_reg);
+    x86asm_jz_lbl8(&hit);
+
+    x86asm_addl_imm8_reg32(-1, native_reg);
+    x86asm_jnz_lbl8(&next_slot);
+
+    x86asm_lbl8_define(&miss);
+    jmp_to_addr(meta->dispatch_slow_path, REG_RET);
+
+    x86asm_lbl8_define(&hit);
+    x86asm_movq_disp8_reg_reg(native_offs, cachep_reg, native_reg);
+    x86asm_ret();
+
+    x86asm_lbl8_cleanup(&hit);
+    x86asm_lbl8_cleanup(&miss);
+    x86asm_lbl8_cleanup(&next_slot);
+}
+
 static void native_dispatch_trampoline_create(struct native_dispatch_meta *meta) {
     meta->trampoline = exec_mem_alloc(BASIC_ALLOC);
     x86asm_set_dst(meta->trampoline, NULL, BASIC_ALLOC);
@@ -446,7 +924,7 @@ static void native_dispatch_trampoline_create(struct native_dispatch_meta *meta)
     memset(&meta->fake_cache_entry, 0, sizeof(meta->fake_cache_entry));
     meta->fake_cache_entry.valid = 1;
     meta->fake_cache_entry.blk.x86_64.native = meta->trampoline;
-    meta->fake_cache_entry.node.key = 0xa0000000;
+    meta->fake_cache_entry.key = 0xa0000000;
 
     code_cache_set_default(&meta->fake_cache_entry);
 }
@@ -478,6 +956,17 @@ static void store_quad_from_reg(void *qptr, unsigned reg_no,
     }
 }
 
+static void inc_quad(uint64_t *qptr) {
+    intptr_t qaddr = (uintptr_t)qptr;
+    intptr_t rip = (uintptr_t)x86asm_get_outp() + 7;
+
+    intptr_t disp = qaddr - rip;
+    if (disp >= INT32_MIN && disp <= INT32_MAX)
+        x86asm_incq_riprel(disp);
+    else
+        RAISE_ERROR(ERROR_UNIMPLEMENTED);
+}
+
 static void jmp_to_addr(void *addr, unsigned clobber_reg) {
     char *base = ((char*)x86asm_get_outp()) + 5;
     intptr_t diff = ((char*)addr) - base;
@@ -24,6 +24,7 @@
 #define NATIVE_DISPATCH_H_
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #include "washdc/types.h"
 #include "dc_sched.h"
@@ -55,6 +56,18 @@ void(*native_dispatch_compile_func)(void*,struct native_dispatch_meta const*,
 
 typedef jit_hash(*native_dispatch_hash_func)(void*,uint32_t);
 
+/*
+ * build the IL for the block at the given PC without compiling it, and return
+ * the block's cycle count.  If the first bool parameter is true, the RAM the
+ * block came from gets watched on behalf of the jit_code_block.  If the second
+ * one is true, the block may be built as a superblock which continues past
+ * conditional branches; those can only be compiled to native code.
+ */
+struct il_code_block;
+typedef unsigned(*native_dispatch_build_il_func)(void*,struct jit_code_block*,
+                                                 struct il_code_block*,
+                                                 addr32_t,bool,bool);
+
 #ifdef JIT_PROFILE
 typedef
 void(*native_dispatch_profile_notify_func)(void*,
@@ -73,6 +86,7 @@ struct native_dispatch_meta {
     struct dc_clock *clk;
     void *return_fn;
     void *dispatch_slow_path;
+    void *dispatch_probe;
 #ifdef JIT_PROFILE
     void *profile_code;
 #endif
@@ -84,6 +98,9 @@ struct native_dispatch_meta {
 #endif
     native_dispatch_compile_func on_compile; // user-specified
 
+    // only used for tiered compilation (see compile_thread.h)
+    native_dispatch_build_il_func build_il; // user-specified
+
     /*
      * entry is a generated function which saves all call-stack registers which
      * ought to be saved, calls native_dispatch, and then returns after
@@ -108,6 +125,78 @@ struct native_dispatch_meta {
     struct cache_entry fake_cache_entry;
 
     native_dispatch_hash_func hash_func;
+
+    /*
+     * generated function that block exits jump to when none of their link
+     * slots match.  It compiles the destination if necessary, links it into
+     * the exit and then jumps to it.
+     */
+    void *link_stub;
+
+    /*
+     * link_stats[0] counts transitions which went directly from one block to
+     * the next through a link.  link_stats[1] counts transitions which went
+     * through native_dispatch.  These live in executable memory so that the
+     * generated code can increment them with a RIP-relative address.
+     */
+    uint64_t *link_stats;
+
+    /*
+     * generated function that tier 0 blocks point their native code at.  It
+     * runs the block in the IL interpreter and then goes back to
+     * native_dispatch the same way a native block would.
+     */
+    void *tier0_stub;
+
+    /*
+     * the hash of the next block and the cycle count of the tier 0 block which
+     * just ran, for the tier0_stub to pick up after it calls into C.
+     */
+    uint64_t *tier0_vals;
+};
+
+/*
+ * maximum number of successors a single block exit can be linked to.  Two is
+ * enough for conditional branches, which can go to either the branch target
+ * or the fall-through address.
+ */
+#define NATIVE_DISPATCH_MAX_LINKS 2
+
+struct native_dispatch_link {
+    // imm32 operand of the cmp against the successor's hash
+    uint32_t *hash_imm;
+
+    /*
+     * imm64 operand of the mov which loads the successor's cache_entry so
+     * that it can be marked as referenced before jumping to it.
+     */
+    uint64_t *entry_imm;
+
+    // rel32 operand of the jmp to the successor's native code
+    int32_t *jmp_rel;
+};
+
+/*
+ * Every block with statically-known successors gets one of these.  Its link
+ * slots start out unlinked and get patched to jump directly to the successor
+ * the first time the block exits to it.
+ */
+struct native_dispatch_exit {
+    struct native_dispatch_link links[NATIVE_DISPATCH_MAX_LINKS];
+    unsigned n_links, n_linked;
+
+    /*
+     * rel32 operand of the jump which is taken when none of the links match.
+     * This goes to link_call while there are unused links, and gets patched to
+     * go straight to native_dispatch once all the links are used up.
+     */
+    int32_t *miss_rel;
+
+    // code which passes this exit to the link_stub
+    void *link_call;
+
+    // list of exits which currently have at least one link
+    struct native_dispatch_exit *prev_linked, *next_linked;
 };
 
 /*
@@ -122,8 +211,37 @@ struct native_dispatch_meta {
  * This function's second argument is the new PC (in ESI).
  *
  * This function should not be called from C code.
+ *
+ * If n_links is nonzero, the block's exit gets that many link slots after the
+ * cycle check, and the returned native_dispatch_exit (which belongs to the
+ * caller and must be freed with native_dispatch_exit_free) tracks them.
+ * Otherwise this returns NULL and the block always exits through
+ * native_dispatch.
+ */
+struct native_dispatch_exit *
+native_check_cycles_emit(struct native_dispatch_meta const *meta,
+                         unsigned n_links);
+
+/*
+ * like native_check_cycles_emit, but if there are cycles left over this jumps
+ * straight to dst instead of looking up the next block.  dst must be the
+ * native code for the block at the PC in ESI.  This is used for the back-edges
+ * of loops in superblocks, where the destination is known at compile-time and
+ * never changes.
  */
-void
-native_check_cycles_emit(struct native_dispatch_meta const *meta);
+void native_check_cycles_emit_jmp(struct native_dispatch_meta const *meta,
+                                  void *dst);
+
+void native_dispatch_exit_free(struct native_dispatch_exit *exit);
+
+/*
+ * undo every link between blocks.  This must be called before any block which
+ * has its cache_entry's link_target flag set gets freed.  Exits will get linked
+ * again the next time they're taken.
+ */
+void native_dispatch_unlink_all(void);
+
+void native_dispatch_get_link_stats(struct native_dispatch_meta const *meta,
+                                    uint64_t *n_linked, uint64_t *n_dispatched);
 
 #endif
@@ -38,6 +38,10 @@
 #include "native_mem.h"
 #include "emit_x86_64.h"
 
+#ifdef ENABLE_FASTMEM
+#include "fastmem.h"
+#endif
+
 #define BASIC_ALLOC 32
 
 static void* emit_native_mem_read_float(struct memory_map const *map);
@@ -66,6 +70,25 @@ emit_ram_write_32(struct memory_map_region const *region, void *ctxt);
 static void
 emit_ram_write_float(struct memory_map_region const *region, void *ctxt);
 
+#ifdef ENABLE_FASTMEM
+static void *emit_fastmem_read_float(void);
+static void *emit_fastmem_read_32(void);
+static void *emit_fastmem_read_16(void);
+static void *emit_fastmem_read_8(void);
+static void *emit_fastmem_write_8(void);
+static void *emit_fastmem_write_16(void);
+static void *emit_fastmem_write_32(void);
+static void *emit_fastmem_write_float(void);
+
+#define FASTMEM_EMITTER(op) emit_fastmem_##op
+#else
+#define FASTMEM_EMITTER(op) NULL
+#endif
+
+static void emit_native_mem_call(struct code_block_x86_64 *blk,
+                                 struct memory_map const *map, void *impl,
+                                 void *(*emit_fast)(void));
+
 struct native_mem_map {
     struct memory_map const *map;
     struct fifo_node node;
@@ -106,7 +129,8 @@ void native_mem_read_float(struct code_block_x86_64 *blk,
     struct native_mem_map *native_map = mem_map_impl(map);
     if (!native_map)
         RAISE_ERROR(ERROR_INTEGRITY);
-    x86asm_call_ptr(native_map->read_float_impl);
+    emit_native_mem_call(blk, map, native_map->read_float_impl,
+                         FASTMEM_EMITTER(read_float));
     ms_shadow_close();
 }
 
@@ -117,7 +141,8 @@ void native_mem_read_32(struct code_block_x86_64 *blk,
     struct native_mem_map *native_map = mem_map_impl(map);
     if (!native_map)
         RAISE_ERROR(ERROR_INTEGRITY);
-    x86asm_call_ptr(native_map->read_32_impl);
+    emit_native_mem_call(blk, map, native_map->read_32_impl,
+                         FASTMEM_EMITTER(read_32));
     ms_shadow_close();
 }
 
@@ -128,7 +153,8 @@ void native_mem_read_8(struct code_block_x86_64 *blk,
     struct native_mem_map *native_map = mem_map_impl(map);
     if (!native_map)
         RAISE_ERROR(ERROR_INTEGRITY);
-    x86asm_call_ptr(native_map->read_8_impl);
+    emit_native_mem_call(blk, map, native_map->read_8_impl,
+                         FASTMEM_EMITTER(read_8));
     x86asm_and_imm32_rax(0x0000ff);
     ms_shadow_close();
 }
@@ -140,7 +166,8 @@ void native_mem_read_16(struct code_block_x86_64 *blk,
     struct native_mem_map *native_map = mem_map_impl(map);
     if (!native_map)
         RAISE_ERROR(ERROR_INTEGRITY);
-    x86asm_call_ptr(native_map->read_16_impl);
+    emit_native_mem_call(blk, map, native_map->read_16_impl,
+                         FASTMEM_EMITTER(read_16));
     x86asm_and_imm32_rax(0x0000ffff);
     ms_shadow_close();
 }
@@ -153,7 +180,8 @@ void native_mem_write_8(struct code_block_x86_64 *blk,
     if (!native_map)
         RAISE_ERROR(ERROR_INTEGRITY);
     x86asm_andl_imm32_reg32(0xff, REG_ARG1);
-    x86asm_call_ptr(native_map->write_8_impl);
+    emit_native_mem_call(blk, map, native_map->write_8_impl,
+                         FASTMEM_EMITTER(write_8));
     ms_shadow_close();
 }
 
@@ -165,7 +193,8 @@ void native_mem_write_16(struct code_block_x86_64 *blk,
     if (!native_map)
         RAISE_ERROR(ERROR_INTEGRITY);
     x86asm_andl_imm32_reg32(0xffff, REG_ARG1);
-    x86asm_call_ptr(native_map->write_16_impl);
+    emit_native_mem_call(blk, map, native_map->write_16_impl,
+                         FASTMEM_EMITTER(write_16));
     ms_shadow_close();
 }
 
@@ -176,7 +205,8 @@ void native_mem_write_32(struct code_block_x86_64 *blk,
     struct native_mem_map *native_map = mem_map_impl(map);
     if (!native_map)
         RAISE_ERROR(ERROR_INTEGRITY);
-    x86asm_call_ptr(native_map->write_32_impl);
+    emit_native_mem_call(blk, map, native_map->write_32_impl,
+                         FASTMEM_EMITTER(write_32));
     ms_shadow_close();
 }
 
@@ -187,10 +217,119 @@ void native_mem_write_float(struct code_block_x86_64 *blk,
     struct native_mem_map *native_map = mem_map_impl(map);
     if (!native_map)
         RAISE_ERROR(ERROR_INTEGRITY);
-    x86asm_call_ptr(native_map->write_float_impl);
+    emit_native_mem_call(blk, map, native_map->write_float_impl,
+                         FASTMEM_EMITTER(write_float));
     ms_shadow_close();
 }
 
+/*
+ * emit a call to one of the per-map native_mem implementations.  If the map
+ * is backed by the fastmem window then the call becomes the slow-path for an
+ * inline access which goes straight to the window instead.  emit_fast emits
+ * that inline access and returns a pointer to the instruction which touches
+ * guest memory.
+ *
+ * Because the fault handler resumes on the slow path with whatever was in the
+ * registers at the time of the fault, emit_fast must leave the address in
+ * REG_ARG0 and the value (for writes) in REG_ARG1 or the float argument
+ * register untouched.
+ */
+static void emit_native_mem_call(struct code_block_x86_64 *blk,
+                                 struct memory_map const *map, void *impl,
+                                 void *(*emit_fast)(void)) {
+#ifdef ENABLE_FASTMEM
+    if (fastmem_enabled(map)) {
+        struct x86asm_lbl8 done;
+        x86asm_lbl8_init(&done);
+
+        // zero-extend the address since it gets used as a 64-bit index
+        x86asm_mov_reg32_reg32(REG_ARG0, REG_ARG0);
+
+        void *site = emit_fast();
+        x86asm_jmp_lbl8(&done);
+
+        void *slow_path = x86asm_get_out_ptr();
+        x86asm_call_ptr(impl);
+
+        x86asm_lbl8_define(&done);
+        x86asm_lbl8_cleanup(&done);
+
+        fastmem_add_site(blk, site, slow_path);
+        return;
+    }
+#endif
+
+    x86asm_call_ptr(impl);
+}
+
+#ifdef ENABLE_FASTMEM
+static void *emit_fastmem_read_float(void) {
+    x86asm_mov_imm64_reg64((uintptr_t)fastmem_base(), REG_ARG1);
+    void *site = x86asm_get_out_ptr();
+    x86asm_movss_sib_xmm(REG_ARG1, 1, REG_ARG0, REG_RET_XMM);
+    return site;
+}
+
+static void *emit_fastmem_read_32(void) {
+    x86asm_mov_imm64_reg64((uintptr_t)fastmem_base(), REG_ARG1);
+    void *site = x86asm_get_out_ptr();
+    x86asm_movl_sib_reg(REG_ARG1, 1, REG_ARG0, REG_RET);
+    return site;
+}
+
+static void *emit_fastmem_read_16(void) {
+    x86asm_mov_imm64_reg64((uintptr_t)fastmem_base(), REG_ARG1);
+    x86asm_xorl_reg32_reg32(REG_RET, REG_RET);
+    void *site = x86asm_get_out_ptr();
+    x86asm_movw_sib_reg(REG_ARG1, 1, REG_ARG0, REG_RET);
+    return site;
+}
+
+static void *emit_fastmem_read_8(void) {
+    x86asm_mov_imm64_reg64((uintptr_t)fastmem_base(), REG_ARG1);
+    x86asm_xorl_reg32_reg32(REG_RET, REG_RET);
+    void *site = x86asm_get_out_ptr();
+    x86asm_movb_sib_reg(REG_ARG1, 1, REG_ARG0, REG_RET);
+    return site;
+}
+
+static void *emit_fastmem_write_8(void) {
+    x86asm_mov_imm64_reg64((uintptr_t)fastmem_base(), REG_RET);
+    x86asm_mov_reg32_reg32(REG_ARG1, REG_ARG3);
+    void *site = x86asm_get_out_ptr();
+    x86asm_movb_reg_sib(REG_ARG3, REG_RET, 1, REG_ARG0);
+    return site;
+}
+
+static void *emit_fastmem_write_16(void) {
+    x86asm_mov_imm64_reg64((uintptr_t)fastmem_base(), REG_RET);
+    x86asm_mov_reg32_reg32(REG_ARG1, REG_ARG3);
+    void *site = x86asm_get_out_ptr();
+    x86asm_movw_reg_sib(REG_ARG3, REG_RET, 1, REG_ARG0);
+    return site;
+}
+
+static void *emit_fastmem_write_32(void) {
+    x86asm_mov_imm64_reg64((uintptr_t)fastmem_base(), REG_RET);
+    void *site = x86asm_get_out_ptr();
+    x86asm_movl_reg_sib(REG_ARG1, REG_RET, 1, REG_ARG0);
+    return site;
+}
+
+static void *emit_fastmem_write_float(void) {
+    x86asm_mov_imm64_reg64((uintptr_t)fastmem_base(), REG_RET);
+    void *site = x86asm_get_out_ptr();
+#if defined(ABI_MICROSOFT)
+    x86asm_movss_xmm_sib(REG_ARG1_XMM, REG_RET, 1, REG_ARG0);
+#elif defined(ABI_UNIX)
+    x86asm_movss_xmm_sib(REG_ARG0_XMM, REG_RET, 1, REG_ARG0);
+#else
+#error unknown abi
+#endif
+    return site;
+}
+#endif
+
 static void error_func(void) {
     RAISE_ERROR(ERROR_INTEGRITY);
 }
@@ -731,6 +870,33 @@ emit_ram_read_8(struct memory_map_region const *region, void *ctxt) {
     x86asm_movb_sib_reg(REG_ARG1, 1, REG_ARG0, REG_RET);
 }
 
+/*
+ * If the page being written to has code on it, tail-call write_fn instead of
+ * falling through so that the page gets marked as dirty.  The address should
+ * already be masked with MEMORY_MASK in REG_ARG0.  This clobbers REG_RET,
+ * REG_ARG3 and REG_VOL0.
+ */
+static void emit_ram_write_watch(struct Memory *mem, uintptr_t write_fn,
+                                 unsigned ctxt_reg) {
+    struct x86asm_lbl8 not_watched;
+    x86asm_lbl8_init(&not_watched);
+
+    x86asm_mov_reg32_reg32(REG_ARG0, REG_RET);
+    x86asm_shrl_imm8_reg32(MEMORY_PAGE_SHIFT, REG_RET);
+    x86asm_mov_imm64_reg64((uintptr_t)mem->page_flags, REG_ARG3);
+    x86asm_xorl_reg32_reg32(REG_VOL0, REG_VOL0);
+    x86asm_movb_sib_reg(REG_ARG3, 1, REG_RET, REG_VOL0);
+    x86asm_testl_reg32_reg32(REG_VOL0, REG_VOL0);
+    x86asm_jz_lbl8(&not_watched);
+
+    x86asm_mov_imm64_reg64((uintptr_t)mem, ctxt_reg);
+    x86asm_mov_imm64_reg64(write_fn, REG_ARG3);
+    x86asm_jmpq_reg64(REG_ARG3);
+
+    x86asm_lbl8_define(&not_watched);
+    x86asm_lbl8_cleanup(&not_watched);
+}
+
 static void
 emit_ram_write_8(struct memory_map_region const *region, void *ctxt) {
     // value to write should be in ESI
@@ -738,6 +904,7 @@ emit_ram_write_8(struct memory_map_region const *region, void *ctxt) {
     struct Memory *mem = (struct Memory*)ctxt;
 
     x86asm_andl_imm32_reg32(MEMORY_MASK, REG_ARG0);
+    emit_ram_write_watch(mem, (uintptr_t)ram_intf.write8, REG_ARG2);
     x86asm_mov_imm64_reg64((uintptr_t)mem->mem, REG_RET);
     x86asm_mov_reg32_reg32(REG_ARG1, REG_ARG3);
     x86asm_movb_reg_sib(REG_ARG3, REG_RET, 1, REG_ARG0);
@@ -750,6 +917,7 @@ emit_ram_write_16(struct memory_map_region const *region, void *ctxt) {
     struct Memory *mem = (struct Memory*)ctxt;
 
     x86asm_andl_imm32_reg32(MEMORY_MASK, REG_ARG0);
+    emit_ram_write_watch(mem, (uintptr_t)ram_intf.write16, REG_ARG2);
     x86asm_mov_imm64_reg64((uintptr_t)mem->mem, REG_RET);
     x86asm_mov_reg32_reg32(REG_ARG1, REG_ARG3);
     x86asm_movw_reg_sib(REG_ARG3, REG_RET, 1, REG_ARG0);
@@ -762,6 +930,7 @@ emit_ram_write_32(struct memory_map_region const *region, void *ctxt) {
     struct Memory *mem = (struct Memory*)ctxt;
 
     x86asm_andl_imm32_reg32(MEMORY_MASK, REG_ARG0);
+    emit_ram_write_watch(mem, (uintptr_t)ram_intf.write32, REG_ARG2);
     x86asm_mov_imm64_reg64((uintptr_t)mem->mem, REG_RET);
     x86asm_movl_reg_sib(REG_ARG1, REG_RET, 1, REG_ARG0);
 }
@@ -772,6 +941,13 @@ emit_ram_write_float(struct memory_map_region const *region, void *ctxt) {
     struct Memory *mem = (struct Memory*)ctxt;
 
     x86asm_andl_imm32_reg32(MEMORY_MASK, REG_ARG0);
+#if defined(ABI_MICROSOFT)
+    emit_ram_write_watch(mem, (uintptr_t)ram_intf.writefloat, REG_ARG2);
+#elif defined(ABI_UNIX)
+    emit_ram_write_watch(mem, (uintptr_t)ram_intf.writefloat, REG_ARG1);
+#else
+#error unknown abi
+#endif
     x86asm_mov_imm64_reg64((uintptr_t)mem->mem, REG_RET);
 
 #if defined(ABI_MICROSOFT)
@@ -20,22 +20,103 @@
  *
  ******************************************************************************/
 
+#include <errno.h>
 #include <string.h>
 #include <stdlib.h>
 
+#ifdef ENABLE_FASTMEM
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
 #include "memory.h"
 
 void memory_init(struct Memory *mem) {
+#ifdef ENABLE_FASTMEM
+    mem->fd = memfd_create("washdc_ram", 0);
+    if (mem->fd < 0) {
+        error_set_errno_val(errno);
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    }
+
+    if (ftruncate(mem->fd, MEMORY_SIZE) != 0) {
+        error_set_errno_val(errno);
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    }
+
+    void *ptr = mmap(NULL, MEMORY_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     mem->fd, 0);
+    if (ptr == MAP_FAILED) {
+        error_set_errno_val(errno);
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+    }
+    mem->mem = (uint8_t*)ptr;
+#else
+    mem->mem = (uint8_t*)malloc(sizeof(mem->mem[0]) * MEMORY_SIZE);
+    if (!mem->mem)
+        RAISE_ERROR(ERROR_FAILED_ALLOC);
+#endif
+
     memory_clear(mem);
+
+    memset(mem->page_flags, 0, sizeof(mem->page_flags));
+    mem->n_dirty_pages = 0;
 }
 
 void memory_cleanup(struct Memory *mem) {
+#ifdef ENABLE_FASTMEM
+    munmap(mem->mem, MEMORY_SIZE);
+    close(mem->fd);
+    mem->fd = -1;
+#else
+    free(mem->mem);
+#endif
+    mem->mem = NULL;
 }
 
 void memory_clear(struct Memory *mem) {
     memset(mem->mem, 0, sizeof(mem->mem[0]) * MEMORY_SIZE);
 }
 
+/*
+ * block transfers get split wherever they run off the end of memory so that
+ * they wrap around the same way individual accesses do.
+ */
+static void
+memory_read_block(addr32_t addr, void *dst, unsigned n_bytes, void *ctxt) {
+    struct Memory *mem = (struct Memory*)ctxt;
+    uint8_t *dst8 = (uint8_t*)dst;
+
+    addr &= MEMORY_MASK;
+    while (n_bytes) {
+        unsigned chunk = MEMORY_SIZE - addr;
+        if (chunk > n_bytes)
+            chunk = n_bytes;
+        memory_read(mem, dst8, addr, chunk);
+        dst8 += chunk;
+        n_bytes -= chunk;
+        addr = 0;
+    }
+}
+
+static void
+memory_write_block(addr32_t addr, void const *src,
+                   unsigned n_bytes, void *ctxt) {
+    struct Memory *mem = (struct Memory*)ctxt;
+    uint8_t const *src8 = (uint8_t const*)src;
+
+    addr &= MEMORY_MASK;
+    while (n_bytes) {
+        unsigned chunk = MEMORY_SIZE - addr;
+        if (chunk > n_bytes)
+            chunk = n_bytes;
+        memory_write(mem, src8, addr, chunk);
+        src8 += chunk;
+        n_bytes -= chunk;
+        addr = 0;
+    }
+}
+
 struct memory_interface ram_intf = {
     .readdouble = memory_read_double,
     .readfloat = memory_read_float,
@@ -47,5 +128,8 @@ struct memory_interface ram_intf = {
     .writefloat = memory_write_float,
     .write32 = memory_write_32,
     .write16 = memory_write_16,
-    .write8 = memory_write_8
+    .write8 = memory_write_8,
+
+    .read_block = memory_read_block,
+    .write_block = memory_write_block
 };
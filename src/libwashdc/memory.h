@@ -35,8 +35,37 @@
 #define MEMORY_SIZE (1 << MEMORY_SIZE_SHIFT)
 #define MEMORY_MASK (MEMORY_SIZE - 1)
 
+/*
+ * RAM is divided into 4KB pages so that the JIT can find out when code it has
+ * already compiled gets overwritten.
+ */
+#define MEMORY_PAGE_SHIFT 12
+#define MEMORY_PAGE_SIZE (1 << MEMORY_PAGE_SHIFT)
+#define MEMORY_N_PAGES (MEMORY_SIZE >> MEMORY_PAGE_SHIFT)
+
+// the JIT has compiled code from this page
+#define MEMORY_PAGE_CODE 1
+
+// this page has been written to since the JIT compiled code from it
+#define MEMORY_PAGE_DIRTY 2
+
 struct Memory {
-    uint8_t mem[MEMORY_SIZE];
+    uint8_t *mem;
+
+    /*
+     * one byte of MEMORY_PAGE_* flags for every page.  Writes to a page which
+     * has MEMORY_PAGE_CODE set will also set MEMORY_PAGE_DIRTY.
+     */
+    uint8_t page_flags[MEMORY_N_PAGES];
+    unsigned n_dirty_pages;
+
+#ifdef ENABLE_FASTMEM
+    /*
+     * mem is a shared mapping of this memfd so that the fastmem window can map
+     * additional views of it.
+     */
+    int fd;
+#endif
 };
 
 void memory_init(struct Memory *mem);
@@ -46,6 +75,15 @@ void memory_cleanup(struct Memory *mem);
 /* zero out all the memory */
 void memory_clear(struct Memory *mem);
 
+// addr must already be masked with MEMORY_MASK
+static inline void memory_note_write(struct Memory *mem, addr32_t addr) {
+    uint8_t *flags = mem->page_flags + (addr >> MEMORY_PAGE_SHIFT);
+    if (*flags == MEMORY_PAGE_CODE) {
+        *flags |= MEMORY_PAGE_DIRTY;
+        mem->n_dirty_pages++;
+    }
+}
+
 static inline int
 memory_read(struct Memory const *mem, void *buf, size_t addr, size_t len) {
     size_t end_addr = addr + (len - 1);
@@ -73,6 +111,11 @@ memory_write(struct Memory *mem, void const *buf, size_t addr, size_t len) {
 
     memcpy(mem->mem + addr, buf, len);
 
+    size_t page_addr;
+    for (page_addr = addr & ~(MEMORY_PAGE_SIZE - 1); page_addr <= end_addr;
+         page_addr += MEMORY_PAGE_SIZE)
+        memory_note_write(mem, page_addr);
+
     return 0;
 }
 
@@ -81,6 +124,7 @@ memory_write_8(addr32_t addr, uint8_t val, void *ctxt) {
     struct Memory *mem = (struct Memory*)ctxt;
     addr &= MEMORY_MASK;
     memcpy(mem->mem + addr, &val, sizeof(val));
+    memory_note_write(mem, addr);
 }
 
 static inline void
@@ -88,6 +132,7 @@ memory_write_16(addr32_t addr, uint16_t val, void *ctxt) {
     struct Memory *mem = (struct Memory*)ctxt;
     addr &= MEMORY_MASK;
     memcpy(mem->mem + addr, &val, sizeof(val));
+    memory_note_write(mem, addr);
 }
 
 static inline void
@@ -95,6 +140,7 @@ memory_write_32(addr32_t addr, uint32_t val, void *ctxt) {
     struct Memory *mem = (struct Memory*)ctxt;
     addr &= MEMORY_MASK;
     memcpy(mem->mem + addr, &val, sizeof(val));
+    memory_note_write(mem, addr);
 }
 
 static inline void
@@ -102,6 +148,7 @@ memory_write_float(addr32_t addr, float val, void *ctxt) {
     struct Memory *mem = (struct Memory*)ctxt;
     addr &= MEMORY_MASK;
     memcpy(mem->mem + addr, &val, sizeof(val));
+    memory_note_write(mem, addr);
 }
 
 static inline void
@@ -109,6 +156,7 @@ memory_write_double(addr32_t addr, double val, void *ctxt) {
     struct Memory *mem = (struct Memory*)ctxt;
     addr &= MEMORY_MASK;
     memcpy(mem->mem + addr, &val, sizeof(val));
+    memory_note_write(mem, addr);
 }
 
 static inline uint8_t
@@ -62,6 +62,16 @@ washdc_init(struct washdc_launch_settings const *settings) {
 #ifdef ENABLE_JIT_X86_64
     config_set_native_jit(settings->enable_native_jit);
 #endif
+    config_set_jit_cache_budget_mb(settings->jit_cache_budget_mb);
+    config_set_jit_tier_threshold(settings->jit_tier_threshold);
+    config_set_jit_superblocks(settings->jit_superblocks);
+    config_set_jit_arm7(settings->jit_arm7);
+    config_set_jit_perf(settings->jit_perf);
+    config_set_jit_block_prof(settings->jit_block_prof);
+    config_set_jit_pin_regs(settings->jit_pin_regs);
+    config_set_idle_skip(settings->idle_skip);
+    config_set_arm7_thread(settings->arm7_thread);
+    config_set_arm7_skew(settings->arm7_skew);
     config_set_boot_mode(translate_boot_mode(settings->boot_mode));
     config_set_exec_bin_path(settings->path_1st_read_bin);
     config_set_dc_bios_path(settings->path_dc_bios);
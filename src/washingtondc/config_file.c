@@ -84,6 +84,51 @@ void cfg_create_default_config(FILE *cfg_file) {
         "; purposes)\n"
         "wash.dbg.dump_mem_on_error false\n"
         "\n"
+        "; how many megabytes of memory the jit's code cache is allowed to\n"
+        "; use.  When it goes over this, the least-recently-used blocks get\n"
+        "; thrown away and recompiled later if they're needed again.\n"
+        "wash.jit.cache_budget_mb 128\n"
+        "\n"
+        "; if this is nonzero, the native jit runs new blocks in the IL\n"
+        "; interpreter and compiles them to native code on a background\n"
+        "; thread once they've been executed this many times.  Zero compiles\n"
+        "; every block to native code right away.\n"
+        "wash.jit.tier_threshold 0\n"
+        "\n"
+        "; if this is true, the native jit keeps compiling past conditional\n"
+        "; branches so that hot paths end up in a single block.\n"
+        "wash.jit.superblocks false\n"
+        "\n"
+        "; if this is true, the AICA's ARM7 gets its own JIT.  Otherwise it\n"
+        "; always runs in the interpreter.\n"
+        "wash.jit.arm7 false\n"
+        "\n"
+        "; lets perf see native jit code.  0 disables this, 1 writes\n"
+        "; /tmp/perf-<pid>.map and 2 writes a jitdump file for perf inject.\n"
+        "wash.jit.perf 0\n"
+        "\n"
+        "; if this is true, the jit records hit counts and host time for every\n"
+        "; block and writes them to sh4_block_prof.csv on exit.\n"
+        "wash.jit.block_prof false\n"
+        "\n"
+        "; if this is true, the native jit keeps the SH4's R0, R14 and R15 in\n"
+        "; host registers instead of writing them back after every block.\n"
+        "wash.jit.pin_regs false\n"
+        "\n"
+        "; if this is true, the SH4 skips ahead to its next event whenever it's\n"
+        "; spinning in a loop that's just waiting for something to change.\n"
+        "wash.sh4.idle_skip true\n"
+        "\n"
+        "; if this is true, the ARM7 and AICA get their own thread instead of\n"
+        "; taking turns with the SH4.  The debugger and AICA tracing turn this\n"
+        "; off.\n"
+        "wash.arm7.thread false\n"
+        "\n"
+        "; how many timeslices the ARM7 thread is allowed to get ahead of or\n"
+        "; fall behind the SH4.  Bigger numbers mean less waiting but worse\n"
+        "; audio timing.\n"
+        "wash.arm7.skew 1\n"
+        "\n"
         "; background color (use html hex syntax)\n"
         "ui.bgcolor #3d77c0\n"
         "\n"
@@ -467,6 +467,18 @@ int main(int argc, char **argv) {
     settings.controllers[3][2] = get_cfg_controller("wash.dc.port.3.2");
 
     cfg_get_bool("wash.dbg.dump_mem_on_error", &settings.dump_mem_on_error);
+    cfg_get_int("wash.jit.cache_budget_mb", &settings.jit_cache_budget_mb);
+    cfg_get_int("wash.jit.tier_threshold", &settings.jit_tier_threshold);
+    cfg_get_bool("wash.jit.superblocks", &settings.jit_superblocks);
+    cfg_get_bool("wash.jit.arm7", &settings.jit_arm7);
+    cfg_get_int("wash.jit.perf", &settings.jit_perf);
+    cfg_get_bool("wash.jit.block_prof", &settings.jit_block_prof);
+    cfg_get_bool("wash.jit.pin_regs", &settings.jit_pin_regs);
+    settings.idle_skip = true;
+    cfg_get_bool("wash.sh4.idle_skip", &settings.idle_skip);
+    cfg_get_bool("wash.arm7.thread", &settings.arm7_thread);
+    settings.arm7_skew = 1;
+    cfg_get_int("wash.arm7.skew", &settings.arm7_skew);
 
     if (enable_debugger && enable_washdbg) {
         fprintf(stderr, "You can't enable WashDbg and GDB at the same time\n");